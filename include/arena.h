@@ -0,0 +1,30 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_block arena_block_t;
+
+/*
+ * Bump allocator. Allocations are never freed on their own, `arena_free`
+ * releases everything at once.
+ */
+typedef struct arena
+{
+    arena_block_t *blocks;
+
+    /* statistics */
+    size_t allocations;
+    size_t bytes;
+    size_t block_count;
+} arena_t;
+
+void arena_init(arena_t *arena);
+void arena_free(arena_t *arena);
+
+/* zeroed memory aligned for any type */
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_memdup(arena_t *arena, const void *data, size_t size);
+char *arena_strndup(arena_t *arena, const char *text, size_t length);
+
+#endif /* !__ARENA_H */
@@ -0,0 +1,102 @@
+#ifndef __ASSEMBLER_H
+#define __ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* x86-64 registers, the ones above 7 need a REX prefix */
+typedef enum asm_register
+{
+    ASM_RAX = 0,
+    ASM_RCX = 1,
+    ASM_RDX = 2,
+    ASM_RBX = 3,
+    ASM_RSP = 4,
+    ASM_RBP = 5,
+    ASM_RSI = 6,
+    ASM_RDI = 7,
+    ASM_R12 = 12,
+    ASM_R13 = 13,
+    ASM_R14 = 14,
+    ASM_R15 = 15,
+} asm_register_t;
+
+/* condition codes of `jcc` and `setcc`, ASM_ALWAYS for `jmp` */
+#define ASM_ALWAYS -1
+#define ASM_B 0x2
+#define ASM_AE 0x3
+#define ASM_E 0x4
+#define ASM_NE 0x5
+#define ASM_BE 0x6
+#define ASM_A 0x7
+#define ASM_P 0xA
+#define ASM_NP 0xB
+
+/* x87 operations `st(1) = st(1) op st(0)` that pop `st(0)` */
+#define ASM_FADDP 0xDEC1
+#define ASM_FMULP 0xDEC9
+#define ASM_FSUBP 0xDEE9
+#define ASM_FDIVP 0xDEF9
+
+/* other x87 operations on registers */
+#define ASM_FLD1 0xD9E8
+#define ASM_FCHS 0xD9E0
+#define ASM_FPREM 0xD9F8
+#define ASM_FUCOMIP 0xDFE9        /**< compares st(0) to st(1) and pops */
+#define ASM_FSTP_ST0 0xDDD8
+#define ASM_FSTP_ST1 0xDDD9
+
+/*
+ * Encodes x86-64 machine code into a growing buffer. The code only jumps
+ * within itself and calls through registers, so it runs wherever
+ * `asm_map` copies it.
+ */
+typedef struct assembler
+{
+    uint8_t *code;
+    size_t length;
+    size_t capacity;
+} assembler_t;
+
+void asm_init(assembler_t *as);
+void asm_free(assembler_t *as);
+
+void asm_byte(assembler_t *as, uint8_t byte);
+void asm_u32(assembler_t *as, uint32_t value);
+void asm_u64(assembler_t *as, uint64_t value);
+
+/* `opcode reg, [base + disp]`, `reg` is the opcode extension of some */
+void asm_memory(assembler_t *as, bool wide, uint16_t opcode, int reg, int base, int32_t disp);
+/* two-byte x87 operations on registers */
+void asm_x87(assembler_t *as, uint16_t opcode);
+
+void asm_mov(assembler_t *as, int to, int from);
+void asm_mov_imm(assembler_t *as, int reg, uint64_t value);
+void asm_lea(assembler_t *as, int reg, int base, int32_t disp);
+void asm_push(assembler_t *as, int reg);
+void asm_pop(assembler_t *as, int reg);
+
+/* calls through rax, helpers are out of reach of a 32-bit displacement */
+void asm_call(assembler_t *as, uintptr_t helper);
+
+/* the 80-bit `long double` at `[base + disp]` */
+void asm_fld(assembler_t *as, int base, int32_t disp);
+void asm_fstp(assembler_t *as, int base, int32_t disp);
+
+/* `setcc al` */
+void asm_setcc(assembler_t *as, int condition);
+
+/* a jump bound later by `asm_bind`, returns where its displacement goes */
+size_t asm_jump_forward(assembler_t *as, int condition);
+void asm_bind(assembler_t *as, size_t at);
+/* points the jump whose displacement is at `at` to `target` */
+void asm_patch(assembler_t *as, size_t at, size_t target);
+/* a jump to code emitted already */
+void asm_jump_to(assembler_t *as, int condition, size_t target);
+
+/* copies the code to a new read and execute only mapping, NULL when that fails */
+uint8_t *asm_map(assembler_t *as, size_t *size);
+void asm_unmap(uint8_t *code, size_t size);
+
+#endif /* !__ASSEMBLER_H */
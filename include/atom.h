@@ -0,0 +1,31 @@
+#ifndef __ATOM_H
+#define __ATOM_H
+
+#include <stddef.h>
+
+/*
+ * Interned name. Equal names are the same pointer, so atoms are compared
+ * with `==` and never freed on their own. The text is NUL terminated and
+ * lives until `atom_free_all`.
+ */
+typedef const char *atom_t;
+
+/* process-wide atom table, filled by the lexer for every identifier */
+atom_t atom_intern(const char *text, size_t length);
+atom_t atom_from_cstr(const char *text);
+
+size_t atom_length(atom_t atom);
+
+/*
+ * Atoms stored outside the table (AST cache). `atom_store` writes
+ * `atom_storage_size` bytes, aligned like a pointer, and returns the offset
+ * of the text in them. `atom_adopt` interns stored text in place, unless an
+ * equal atom exists, so the storage has to stay mapped while atoms are used.
+ */
+size_t atom_storage_size(atom_t atom);
+size_t atom_store(void *storage, atom_t atom);
+atom_t atom_adopt(const char *stored);
+
+void atom_free_all(void);
+
+#endif /* !__ATOM_H */
@@ -0,0 +1,161 @@
+#ifndef __BYTECODE_H
+#define __BYTECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "node.h"
+#include "value.h"
+
+/*
+ * Instructions as X(name, operands, stack effect). An instruction is its
+ * opcode byte followed by `operands` 32-bit words, jumps are relative to the
+ * end of the instruction. CALL and TAIL_CALL also pop their arguments.
+ */
+#define BYTECODE_OPS(X) \
+    X(PUSH_CONSTANT,        1,  1)  /* constant index */ \
+    X(PUSH_UNDEFINED,       0,  1) \
+    X(PUSH_NULL,            0,  1) \
+    X(PUSH_TRUE,            0,  1) \
+    X(PUSH_FALSE,           0,  1) \
+    X(POP,                  0, -1) \
+    X(DUP,                  0,  1) \
+    X(GET_LOCAL,            1,  1)  /* frame slot */ \
+    X(SET_LOCAL,            1,  0) \
+    X(GET_GLOBAL,           1,  1)  /* global cell */ \
+    X(SET_GLOBAL,           1,  0) \
+    X(GET_ENV,              2,  1)  /* hops, env slot */ \
+    X(SET_ENV,              2,  0) \
+    X(GET_CALLEE,           0,  1) \
+    X(GET_MEMBER,           1,  0)  /* constant index of the name */ \
+    X(ADD,                  0, -1) \
+    X(SUB,                  0, -1) \
+    X(MUL,                  0, -1) \
+    X(DIV,                  0, -1) \
+    X(MOD,                  0, -1) \
+    X(POW,                  0, -1) \
+    X(BIT_AND,              0, -1) \
+    X(BIT_OR,               0, -1) \
+    X(BIT_XOR,              0, -1) \
+    X(SHL,                  0, -1) \
+    X(SHR,                  0, -1) \
+    X(EQ,                   0, -1) \
+    X(NE,                   0, -1) \
+    X(STRICT_EQ,            0, -1) \
+    X(LT,                   0, -1) \
+    X(GT,                   0, -1) \
+    X(LE,                   0, -1) \
+    X(GE,                   0, -1) \
+    X(ADD_NUMBER,           0, -1)  /* operands sema proved numbers */ \
+    X(SUB_NUMBER,           0, -1) \
+    X(MUL_NUMBER,           0, -1) \
+    X(DIV_NUMBER,           0, -1) \
+    X(LT_NUMBER,            0, -1) \
+    X(GT_NUMBER,            0, -1) \
+    X(LE_NUMBER,            0, -1) \
+    X(GE_NUMBER,            0, -1) \
+    X(NEGATE,               0,  0) \
+    X(TO_NUMBER,            0,  0) \
+    X(BIT_NOT,              0,  0) \
+    X(NOT,                  0,  0) \
+    X(TYPEOF,               0,  0) \
+    X(IS_UNDEFINED,         0,  0) \
+    X(INC,                  0,  0) \
+    X(DEC,                  0,  0) \
+    X(JUMP,                 1,  0)  /* offset */ \
+    X(JUMP_IF_FALSE,        1, -1) \
+    X(JUMP_IF_TRUE,         1, -1) \
+    X(JUMP_IF_FALSE_KEEP,   1,  0) \
+    X(JUMP_IF_TRUE_KEEP,    1,  0) \
+    X(LOOP,                 2,  0)  /* offset back to the loop, loop index */ \
+    X(ENTER_SCOPE,          1,  0)  /* env size */ \
+    X(LEAVE_SCOPE,          0,  0) \
+    X(COPY_SCOPE,           0,  0) \
+    X(CLOSURE,              1,  1)  /* function index */ \
+    X(CALL,                 1,  0)  /* argument count */ \
+    X(TAIL_CALL,            1,  0) \
+    X(RETURN,               0, -1)
+
+typedef enum bytecode_op
+{
+#define BYTECODE_ENUM(name, operands, effect) BYTECODE_##name,
+    BYTECODE_OPS(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+
+    /* the number of instructions */
+    BYTECODE_COUNT,
+} bytecode_op_t;
+
+/* back-edges taken before a loop is traced */
+#define TRACE_HOT_LOOP 56
+/* failed recordings before a loop is left to the interpreter */
+#define TRACE_ABORTS_LIMIT 4
+
+/*
+ * A loop of a function, counted down by its LOOP instruction. When
+ * `countdown` reaches zero the next iteration is recorded into `trace`.
+ */
+typedef struct bytecode_loop
+{
+    uint32_t countdown;
+    uint32_t aborts;        /**< recordings that failed */
+    struct trace *trace;    /**< NULL until recorded */
+} bytecode_loop_t;
+
+/*
+ * Compiled code of a function or of the program, contiguous instructions
+ * and the constants and nested functions they index. A function that was
+ * pre-parsed lazily is compiled before its first call.
+ */
+typedef struct bytecode_function
+{
+    node_t *node;           /**< NODE_FUNCTION or NODE_PROGRAM */
+    bool compiled;
+
+    uint8_t *code;
+    size_t length;
+    size_t capacity;
+
+    value_t *constants;
+    size_t constant_count;
+    size_t constant_capacity;
+
+    struct bytecode_function **functions;
+    size_t function_count;
+    size_t function_capacity;
+
+    bytecode_loop_t *loops;
+    size_t loop_count;
+    size_t loop_capacity;
+
+    /* what a call pushes, see `vm_run` */
+    uint32_t param_count;
+    uint32_t frame_size;
+    uint32_t env_size;
+    uint32_t stack_size;    /**< most operands on the stack at once */
+
+    /* machine code, compiled once `calls` reaches `JIT_THRESHOLD` */
+    uint32_t calls;
+    struct jit_code *jit;
+} bytecode_function_t;
+
+bytecode_function_t *bytecode_function_create(node_t *node);
+/* frees `function` and its nested functions */
+void bytecode_function_free(bytecode_function_t *function);
+
+/* returns the offset of the instruction */
+size_t bytecode_emit(bytecode_function_t *function, bytecode_op_t op);
+void bytecode_emit_operand(bytecode_function_t *function, uint32_t operand);
+void bytecode_patch_operand(bytecode_function_t *function, size_t at, uint32_t operand);
+
+uint32_t bytecode_add_constant(bytecode_function_t *function, value_t value);
+uint32_t bytecode_add_function(bytecode_function_t *function, bytecode_function_t *nested);
+/* returns the index for the LOOP instruction of a new loop */
+uint32_t bytecode_add_loop(bytecode_function_t *function);
+
+int bytecode_op_effect(bytecode_op_t op);
+/* 32-bit words after the opcode */
+int bytecode_op_operands(bytecode_op_t op);
+
+#endif /* !__BYTECODE_H */
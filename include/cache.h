@@ -0,0 +1,49 @@
+#ifndef __CACHE_H
+#define __CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "node.h"
+#include "source.h"
+
+/*
+ * On-disk AST cache. A program is serialized for a fixed base address with
+ * a relocation table, loading maps the file there and uses the nodes in
+ * place, patching them only when that address is taken. Entries are keyed by
+ * a hash of the source contents and the interpreter version, and store the
+ * source to confirm a hit. Only entries this user alone can write are used.
+ */
+typedef struct cache
+{
+    /* the mapped cache file, owns `program` */
+    void *base;
+    size_t size;
+
+    node_t *program;
+} cache_t;
+
+uint64_t cache_hash(const char *data, size_t length);
+
+/*
+ * Path of the cache entry for `filename`: `$ROSE_CACHE_DIR/<hash>.ast` when
+ * the variable is set, otherwise `<filename>.ast`. NULL when the directory
+ * can be written by other users. Caller frees.
+ */
+char *cache_path(const char *filename, uint64_t hash);
+
+/*
+ * `hash` is `cache_hash` of the source contents. False on a miss, stale or
+ * corrupt entries are misses as well, the whole entry is checksummed before
+ * any of it is used. Atoms of the program may live in the
+ * mapping, so it is freed after `atom_free_all`, and an entry found corrupt
+ * after its atoms were adopted is a miss that stays mapped.
+ */
+bool cache_load(cache_t *cache, const char *path, source_id_t file, uint64_t hash, const char *version);
+void cache_free(cache_t *cache);
+
+/* best effort, false if the entry could not be written */
+bool cache_store(const char *path, source_id_t file, uint64_t hash, const char *version, node_t *program);
+
+#endif /* !__CACHE_H */
@@ -0,0 +1,244 @@
+#ifndef __CLOSURE_H
+#define __CLOSURE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "env.h"
+#include "node.h"
+#include "parser.h"
+#include "sema.h"
+#include "stack.h"
+#include "value.h"
+
+/* calls recurse in C, deeper ones abort */
+#define CLOSURE_CALLS_CAPACITY (8 * 1024)
+
+/* rewrites of a node before it settles on its generic handler */
+#define CLOSURE_REWRITES_LIMIT 4
+
+typedef struct closure closure_t;
+typedef struct closure_ctx closure_ctx_t;
+
+/* runs a compiled node, statements return undefined */
+typedef value_t (*closure_handler_t)(closure_ctx_t *ctx, closure_t *closure);
+
+/*
+ * The handlers of a binary operator, for operands that were numbers or
+ * strings so far and for any operands. `apply` computes the generic result
+ * of operands a rewritten node has evaluated already.
+ */
+typedef struct closure_specializations
+{
+    closure_handler_t numbers;
+    closure_handler_t strings;      /**< NULL when strings take the generic one */
+    closure_handler_t generic;
+    value_t (*apply)(value_t left, value_t right);
+} closure_specializations_t;
+
+/* a function or the program, compiled on its first call if it was parsed lazily */
+typedef struct closure_function
+{
+    node_t *node;           /**< NODE_FUNCTION or NODE_PROGRAM */
+    closure_t *body;        /**< NULL until compiled */
+
+    uint32_t param_count;
+    uint32_t frame_size;
+    uint32_t env_size;
+} closure_function_t;
+
+/*
+ * A node compiled once into the handler for its operator and operand kinds,
+ * e.g. `closure_add_num_num` for an addition of numbers. The children are
+ * compiled too and variables are resolved, so running it is a call through
+ * `handler`. The node is kept for locations and printing.
+ *
+ * Operators sema could not type, member accesses and calls start out
+ * uninitialized and rewrite `handler` for the operands they see, e.g. to
+ * `closure_add_numbers` which only checks that both are still numbers.
+ */
+struct closure
+{
+    closure_handler_t handler;
+    node_t *node;
+    uint8_t rewrites;
+
+    union
+    {
+        value_t constant;
+        node_binding_t binding;
+
+        /* operators, unary ones only have `right` */
+        struct
+        {
+            closure_t *left;
+            closure_t *right;
+            const closure_specializations_t *specializations;
+        } operands;
+
+        /* stores to a variable, `++` and `--` add `delta` */
+        struct
+        {
+            node_binding_t binding;
+            closure_t *value;
+            int delta;
+            bool postfix;
+        } store;
+
+        /* a parameter moved to the env or given its default value */
+        struct
+        {
+            node_binding_t binding;
+            uint32_t index;
+            closure_t *default_value;
+        } param;
+
+        /* `if` and the ternary */
+        struct
+        {
+            closure_t *condition;
+            closure_t *then;
+            closure_t *otherwise;
+        } branch;
+
+        /* loops, `env_size` is the env copied for each iteration of a `for` */
+        struct
+        {
+            closure_t *init;
+            closure_t *condition;
+            closure_t *update;
+            closure_t *body;
+            uint32_t env_size;
+            atom_t label;
+        } loop;
+
+        struct
+        {
+            closure_t **statements;
+            size_t count;
+            uint32_t env_size;
+        } block;
+
+        /* a labeled statement that is not a loop */
+        struct
+        {
+            closure_t *body;
+            atom_t label;
+        } labeled;
+
+        /* the bodies follow each other, so a body without `break` falls through */
+        struct
+        {
+            closure_t *value;
+            closure_t **labels;
+            size_t *label_cases;    /**< body of each label */
+            size_t label_count;
+            closure_t **bodies;
+            size_t count;
+            size_t fallback;        /**< `count` without `default` */
+            atom_t label;
+        } cases;
+
+        struct
+        {
+            closure_t *callee;
+            closure_t **args;
+            uint32_t argc;
+            closure_function_t *target;     /**< the code called last time */
+        } call;
+
+        struct
+        {
+            closure_t *object;
+            atom_t name;
+            size_t index;                   /**< where the name was found last time */
+        } member;
+
+        closure_t *value;           /**< of `return` */
+        atom_t label;               /**< of `break` and `continue` */
+        closure_function_t *function;
+    };
+};
+
+typedef struct closure_compiler
+{
+    /* parse and check lazily parsed bodies, NULL for cached programs */
+    parser_t *parser;
+    sema_t *sema;
+
+    /* closures and functions, released together */
+    arena_t arena;
+
+    /* `break` and `continue` targets of the function being compiled */
+    struct closure_target *target;
+    atom_t label;
+
+    bool had_error;
+
+    /* statistics */
+    size_t function_count;
+    size_t closure_count;
+} closure_compiler_t;
+
+#define CLOSURE_COMPILER_ERROR(compiler, ...) \
+    do { \
+        fprintf(stderr, __VA_ARGS__); \
+        (compiler)->had_error = true; \
+    } while (0)
+
+/* how the last statement finished */
+typedef enum closure_completion
+{
+    CLOSURE_NORMAL,
+    CLOSURE_BREAK,
+    CLOSURE_CONTINUE,
+    CLOSURE_RETURN,
+    CLOSURE_TAIL_CALL,
+} closure_completion_t;
+
+/*
+ * State of a running program. Statements report `break`, `continue` and
+ * `return` in `completion`, and the statements around them stop until the
+ * one they target.
+ */
+struct closure_ctx
+{
+    closure_compiler_t *compiler;
+    env_t *globals;
+    value_stack_t stack;
+    size_t depth;               /**< calls in progress */
+
+    /* the running function */
+    value_t *frame;
+    env_t *env;
+    value_t callee;
+
+    closure_completion_t completion;
+    atom_t label;               /**< of a `break` or `continue` */
+    value_t result;             /**< of a `return` */
+
+    /* a tail call, its arguments are at the top of the stack */
+    value_t tail_callee;
+    value_t *tail_args;
+    uint32_t tail_argc;
+
+    /* statistics */
+    size_t rewrites;
+};
+
+void closure_compiler_init(closure_compiler_t *compiler, parser_t *parser, sema_t *sema);
+void closure_compiler_free(closure_compiler_t *compiler);
+
+/* NULL after reporting what can not be compiled */
+closure_function_t *closure_compile_program(closure_compiler_t *compiler, node_t *program);
+
+void closure_init(closure_ctx_t *ctx, closure_compiler_t *compiler);
+void closure_free(closure_ctx_t *ctx);
+
+/* returns the value of the program's last expression statement */
+value_t closure_run(closure_ctx_t *ctx, closure_function_t *program);
+
+#endif /* !__CLOSURE_H */
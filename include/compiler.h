@@ -0,0 +1,64 @@
+#ifndef __COMPILER_H
+#define __COMPILER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "bytecode.h"
+#include "parser.h"
+#include "sema.h"
+
+/* a loop, switch or labeled statement that `break` can leave */
+typedef struct compiler_loop
+{
+    struct compiler_loop *enclosing;
+    atom_t label;
+    bool is_loop;           /**< `continue` applies to it */
+    size_t scope_depth;     /**< envs entered before its body */
+
+    /* jumps patched once their targets are known */
+    size_t *breaks;
+    size_t break_count;
+    size_t *continues;
+    size_t continue_count;
+} compiler_loop_t;
+
+/*
+ * Compiles checked programs to bytecode. Variables are already resolved by
+ * sema, so the compiler only picks the instruction for each binding.
+ */
+typedef struct compiler
+{
+    /* parse and check lazily parsed bodies, NULL for cached programs */
+    parser_t *parser;
+    sema_t *sema;
+
+    /* the function being compiled */
+    bytecode_function_t *function;
+    size_t depth;           /**< operands on the stack */
+    size_t scope_depth;     /**< envs entered */
+    compiler_loop_t *loop;
+    atom_t label;           /**< of the statement compiled next */
+
+    bool had_error;
+
+    /* statistics */
+    size_t function_count;
+    size_t code_bytes;
+} compiler_t;
+
+#define COMPILER_ERROR(compiler, ...) \
+    do { \
+        fprintf(stderr, __VA_ARGS__); \
+        (compiler)->had_error = true; \
+    } while (0)
+
+void compiler_init(compiler_t *compiler, parser_t *parser, sema_t *sema);
+
+/* NULL after reporting what can not be compiled */
+bytecode_function_t *compile_program(compiler_t *compiler, node_t *program);
+
+/* compiles a function pre-parsed in lazy mode, before its first call */
+bool compile_function(compiler_t *compiler, bytecode_function_t *function);
+
+#endif /* !__COMPILER_H */
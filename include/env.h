@@ -1,32 +1,26 @@
-
-
 #ifndef __ENV_H
 #define __ENV_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "atom.h"
 #include "value.h"
 
-#define ENV_INITIAL_CAPACITY 8
-
-typedef struct variable
-{
-    char *name;
-    value_t value;
-} variable_t;
-
+/*
+ * Runtime scope. Variables are resolved by sema, each one lives in a slot
+ * of the scope `hops` parents up (see `node_binding_t`).
+ */
 typedef struct env
 {
     struct env *parent;
-    variable_t *vars;
-    size_t size;        /**< current number of variables */
-    size_t capacity;    /**< allocated slots in the array */
+    value_t *slots;
+    size_t size;        /**< number of slots */
 } env_t;
 
-env_t *env_create(env_t *parent);
+env_t *env_create(env_t *parent, size_t size);
 void env_free(env_t *env);
-variable_t *env_get(env_t *env, const char *name);
-void env_set(env_t *env, const char *name, value_t val);
-env_t *env_enter_scope(env_t *env);
+value_t *env_lookup(env_t *env, uint32_t hops, uint32_t slot);
+env_t *env_enter_scope(env_t *env, size_t size);
 env_t *env_leave_scope(env_t *env);
 
-#endif /* !__ENV_H */
\ No newline at end of file
+#endif /* !__ENV_H */
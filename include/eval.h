@@ -5,10 +5,17 @@
 
 #include "env.h"
 #include "value.h"
+#include "stack.h"
 
 typedef struct eval_context
 {
   env_t *current_scope;
+  /* cells of the global scope, indexed by resolved bindings */
+  env_t *globals;
+
+  /* locals no nested function captures */
+  value_stack_t stack;
+  value_t *frame;
 
 } eval_context_t;
 
@@ -0,0 +1,115 @@
+#ifndef __FLAT_H
+#define __FLAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "node.h"
+
+/* index of a node, list word or pool entry in a flat tree */
+typedef uint32_t flat_index_t;
+
+#define FLAT_NONE ((flat_index_t) UINT32_MAX)
+
+/*
+ * Payload of a flat node, three words whose meaning depends on the kind:
+ *
+ *   NUMBER                 a: numbers index
+ *   STRING                 a: chars offset of the NUL terminated text
+ *   BOOL                   a: value
+ *   IDENTIFIER             a: atoms index
+ *   ARRAY, PROGRAM, BLOCK  a: lists start, b: count of nodes
+ *   OBJECT                 a: lists start, b: count of (key atom, value) pairs
+ *   SPREAD, UNARY, POSTFIX,
+ *   AWAIT, NEW, THROW,
+ *   RETURN                 a: operand
+ *   BINARY                 a: left, b: right
+ *   ASSIGNMENT             a: target, b: value
+ *   TERNARY, IF            a: condition, b: then, c: else
+ *   WHILE                  a: condition, b: body
+ *   DO_WHILE               a: body, b: condition
+ *   FOR                    a: lists start of (init, condition, increment, body)
+ *   CALL                   a: callee, b: lists start, c: count of arguments
+ *   INDEX                  a: array, b: index
+ *   MEMBER                 a: object, b: property
+ *   FUNCTION               a: body, b: lists start of (name atom, async) and
+ *                          (name atom, default value, rest) per parameter,
+ *                          c: count of parameters
+ *   DECLARATION            a: lists start, b: count of (name, value) pairs,
+ *                          `op` is the kind
+ *   SWITCH                 a: expression, b: lists start of (default, body,
+ *                          count, labels...) per case, c: count of cases
+ *   LABEL                  a: name atom, b: statement
+ *   BREAK, CONTINUE        a: label atom
+ *   TRY                    a: lists start of (try, catch parameter atom,
+ *                          catch, finally)
+ *   IMPORT                 a: lists start of (module, default name) and the
+ *                          imported names as chars offsets, b: count of names
+ *   EXPORT                 a: declaration, b: lists start of chars offsets,
+ *                          c: count of names, `op` is set for default exports
+ *
+ * Absent children, atoms and strings are FLAT_NONE.
+ */
+typedef struct flat_payload
+{
+    flat_index_t a;
+    flat_index_t b;
+    flat_index_t c;
+} flat_payload_t;
+
+/*
+ * Index-based copy of a tree in struct-of-arrays form, built for sema. Nodes
+ * are stored in pre-order, so a subtree is the range [index, ends[index])
+ * and its children come after it. `nodes` leads back to the tree, which
+ * keeps what sema computes for the engines.
+ */
+typedef struct flat
+{
+    /* per node */
+    uint8_t *kinds;
+    node_op_t *ops;
+    uint8_t *flags;
+    uint32_t *offsets;    /**< source offsets, all nodes come from `file` */
+    flat_index_t *ends;
+    flat_payload_t *payloads;
+    node_t **nodes;
+    size_t count;
+    size_t capacity;
+
+    source_id_t file;
+
+    /* child ranges and multi-word payloads */
+    flat_index_t *lists;
+    size_t list_count;
+    size_t list_capacity;
+
+    /* pools */
+    number_t *numbers;
+    size_t number_count;
+    size_t number_capacity;
+
+    atom_t *atoms;
+    size_t atom_count;
+    size_t atom_capacity;
+
+    char *chars;
+    size_t char_count;
+    size_t char_capacity;
+} flat_t;
+
+void flat_init(flat_t *flat);
+void flat_free(flat_t *flat);
+
+/* appends `node`'s tree, returns the index of its root */
+flat_index_t flat_build(flat_t *flat, node_t *node);
+
+/* bytes used by the flat tree, for --stats */
+size_t flat_bytes(const flat_t *flat);
+
+#define FLAT_LOCATION(flat, index) \
+    ((location_t) { .file = (flat)->file, .offset = (flat)->offsets[index] })
+
+/* the atom at pool index `at`, NULL for FLAT_NONE */
+#define FLAT_ATOM(flat, at) ((at) == FLAT_NONE ? NULL : (flat)->atoms[at])
+
+#endif /* !__FLAT_H */
@@ -0,0 +1,69 @@
+#ifndef __JIT_H
+#define __JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bytecode.h"
+#include "env.h"
+#include "value.h"
+
+/* machine code on x86-64 Linux, `make JIT=0` leaves it out */
+#if defined(__x86_64__) && defined(__linux__) && !defined(JIT_DISABLED)
+#define JIT_AVAILABLE 1
+#else
+#define JIT_AVAILABLE 0
+#endif
+
+/* calls of a function before it is compiled to machine code */
+#define JIT_THRESHOLD 64
+
+/* where machine code finds the parts of a value */
+#define JIT_VALUE ((int32_t) sizeof(value_t))
+#define JIT_TYPE ((int32_t) offsetof(value_t, type))
+#define JIT_NUMBER ((int32_t) offsetof(value_t, number))
+#define JIT_BOOLEAN ((int32_t) offsetof(value_t, boolean))
+
+/*
+ * Machine code of a bytecode function, templates for its instructions
+ * stitched together in an executable mapping. `offsets` maps the offset of
+ * each instruction to its template, so the code can be entered at any
+ * instruction.
+ */
+typedef struct jit_code
+{
+    uint8_t *code;          /**< mapped read and execute only */
+    size_t length;
+    size_t size;            /**< of the mapping */
+    uint32_t *offsets;
+} jit_code_t;
+
+/*
+ * Registers of the VM while machine code runs in its frame. The code
+ * returns to the VM before calls, tail calls and returns, which the VM runs
+ * itself, and the VM enters the code again where the caller resumes.
+ */
+typedef struct jit_state
+{
+    value_t *sp;
+    value_t *base;
+    value_t *globals;
+    env_t *env;
+    bytecode_function_t *function;
+} jit_state_t;
+
+/*
+ * NULL when the function can not be compiled, it is interpreted then. With
+ * `traces` its loops return to the VM when they are hot or have a trace.
+ */
+jit_code_t *jit_compile(bytecode_function_t *function, bool traces);
+void jit_code_free(jit_code_t *code);
+
+/* runs from the instruction at `at`, returns the offset of the one the VM runs next */
+uint32_t jit_run(jit_code_t *code, jit_state_t *state, uint32_t at);
+
+/* runs the instruction at `ip` like `vm_run`, except jumps, calls and returns */
+value_t *jit_step(jit_state_t *state, value_t *sp, const uint8_t *ip);
+
+#endif /* !__JIT_H */
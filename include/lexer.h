@@ -10,35 +10,64 @@
 #include "location.h"
 #include "token.h"
 
+/*
+ * tokens still referenced by the parser: previous, current and one token
+ * of lookahead (power of two)
+ */
+#define LEXER_RING_SIZE 4
+
 typedef struct lexer
 {
-    token_t *tokens;
-    size_t index;
-    size_t capacity;
-    size_t count;
+    /* tokens are scanned on demand into a small ring buffer */
+    token_t ring[LEXER_RING_SIZE];
+    size_t head;    /**< number of tokens scanned */
+    size_t index;   /**< number of tokens consumed */
+    size_t count;   /**< tokens produced, for statistics */
+
+    /* decoded number literals, out of the tokens to keep them small */
+    number_t numbers[LEXER_RING_SIZE];
 
-    char *source;
+    /* owned by the source registry */
+    const char *source;
     size_t length;
-    location_t loc;
+
+    /* decoded string literals with escapes, NUL separated */
+    char *strings;
+    size_t strings_length;
+    size_t strings_capacity;
+
+    source_id_t file;
     size_t pos;
 
     bool had_error;
 } lexer_t;
 
-#define LEXER_ERROR(lexer, msg, ...) \
+#define LEXER_ERROR_AT(lexer, offset, msg, ...) \
     do { \
         fprintf(stderr, "[ERROR] [%s:%zu:%zu]: " msg, \
-            (lexer)->loc.filename, (lexer)->loc.line, (lexer)->loc.column, ##__VA_ARGS__\
+            source_name((lexer)->file), \
+            source_line((lexer)->file, (offset)), \
+            source_column((lexer)->file, (offset)), ##__VA_ARGS__\
         ); \
         (lexer)->had_error = true; \
     } while (0)
 
+/* error at the current position */
+#define LEXER_ERROR(lexer, msg, ...) \
+    LEXER_ERROR_AT(lexer, (lexer)->pos, msg, ##__VA_ARGS__)
+
 void lexer_init(lexer_t *lexer, char *filename, char *source);
+/* lexes the bytes in [start, end) of a loaded source */
+void lexer_init_range(lexer_t *lexer, source_id_t file, size_t start, size_t end);
 void lexer_free(lexer_t *lexer);
 
-char *lexer_readfile(char *filename);
+const char *lexer_token_text(const lexer_t *lexer, const token_t *token);
+char *lexer_token_strdup(const lexer_t *lexer, const token_t *token);
+/* value of a TOKEN_NUMBER_LITERAL, valid while the token is in the ring */
+number_t lexer_token_number(const lexer_t *lexer, const token_t *token);
 
 token_t *lexer_next(lexer_t *lexer);
+token_t *lexer_lookahead(lexer_t *lexer);
 
 
 #endif /* !__LEXER_H */
\ No newline at end of file
@@ -4,21 +4,24 @@
 #define __LOCATION_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "source.h"
 
 typedef struct location
 {
-    /* source file name */
-    char *filename;
-
-    /* line number (1-based) */
-    size_t line;
+    /* source file in the registry */
+    source_id_t file;
 
-    /* column number (1-based) */
-    size_t column;
+    /* byte offset into the source, line and column are computed on demand */
+    uint32_t offset;
 } location_t;
 
+/* expands to the file name, line and column for a "%s:%zu:%zu" format */
 #define LOCATION(_location) \
-    (_location).filename, (_location).line, (_location).column
+    source_name((_location).file), \
+    source_line((_location).file, (_location).offset), \
+    source_column((_location).file, (_location).offset)
 
 
-#endif /* !__LOCATION_H */
\ No newline at end of file
+#endif /* !__LOCATION_H */
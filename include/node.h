@@ -5,7 +5,10 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "atom.h"
+#include "arena.h"
 #include "types.h"
 #include "token.h"
 #include "location.h"
@@ -59,11 +62,51 @@ typedef enum node_type
     NODE_COUNT,
 } node_type_t;
 
+/* operator of a node, the token type it was parsed from */
+typedef uint8_t node_op_t;
+
+/*
+ * Variable resolved by sema. Variables used by nested functions live in
+ * `slot` of the env `hops` envs up, only scopes with such variables have an
+ * env. The others live in the stack frame of their function.
+ */
+typedef struct node_binding
+{
+    uint32_t hops;
+    uint32_t slot;
+} node_binding_t;
+
+/* `hops` of variables in the global scope, `slot` indexes its cells */
+#define NODE_HOPS_GLOBAL UINT32_MAX
+
+/* `hops` of variables in the current frame, `slot` indexes it */
+#define NODE_HOPS_LOCAL (UINT32_MAX - 1)
+
+/* `slot` of anonymous functions */
+#define NODE_SLOT_NONE UINT32_MAX
+
+/* the value is always a number, set for literals and inferred by sema */
+#define NODE_FLAG_NUMBER 0x01
+
+/* a call whose result the function returns, set by sema */
+#define NODE_FLAG_TAIL_CALL 0x02
+
+/*
+ * Nodes are allocated at the size of their variant (see `node_size`), only
+ * the members of `type`'s variant may be accessed and nodes are never
+ * copied by value.
+ */
 typedef struct node
 {
     node_type_t type;
     location_t loc;
 
+    /* NODE_BINARY, NODE_UNARY, NODE_ASSIGNMENT, NODE_POSTFIX */
+    node_op_t op;
+
+    /* NODE_FLAG_* */
+    uint8_t flags;
+
     union
     {
         /* NODE_NUMBER */
@@ -76,7 +119,13 @@ typedef struct node
         bool boolean;
 
         /* NODE_IDENTIFIER */
-        char *identifier;
+        struct
+        {
+            atom_t identifier;
+
+            /* set by sema, the last member of the variant */
+            node_binding_t binding;
+        };
 
         /* NODE_ARRAY */
         struct
@@ -88,7 +137,7 @@ typedef struct node
         /* NODE_OBJECT */
         struct
         {
-            char **keys;
+            atom_t *keys;
             struct node **values;
             size_t count;
         } object;
@@ -113,6 +162,14 @@ typedef struct node
 
             /* count of statements in block */
             size_t count;
+
+            /*
+             * Set by sema. Blocks that declare nothing have no scope and run
+             * in the enclosing one, the others need an env for their
+             * captured variables if any.
+             */
+            bool scoped;
+            uint32_t env_size;
         } block;
 
         struct
@@ -122,14 +179,15 @@ typedef struct node
 
             /* count of statements in program */
             size_t count;
+
+            /* global cells and frame slots of top level blocks, set by sema */
+            uint32_t slot_count;
+            uint32_t frame_size;
         } program;
 
         /* NODE_BINARY */
         struct
         {
-            /* operand for binary node */
-            struct token op;
-            
             /* lhs for binary node */
             struct node *left;
 
@@ -140,19 +198,13 @@ typedef struct node
         /* NODE_UNARY */
         struct
         {
-            /* operand for unary node */
-            struct token op;
-
             /* rhs for unary node */
             struct node *right;
         } unary;
 
-        /* NODE_ASSIGNMENT */
+        /* NODE_ASSIGNMENT, `op` is the assign operator (=, +=, -=, ...) */
         struct
         {
-            /* assign operator (=, +=, -=, ...) */
-            struct token op;
-
             struct node *target;
             struct node *value;
         } assignment;
@@ -195,6 +247,9 @@ typedef struct node
             struct node *init;
             struct node *condition;
             struct node *increment;
+
+            /* captured variables of the scope around a `let`/`const` init */
+            uint32_t env_size;
         } for_stmt;
 
         /* NODE_CALL */
@@ -223,7 +278,6 @@ typedef struct node
         /* NODE_POSTFIX */
         struct
         {
-            struct token op;
             struct node *left;
         } postfix;
 
@@ -231,28 +285,48 @@ typedef struct node
         struct
         {
             bool is_async;
-            char *name;
-            struct
+            atom_t name;
+            struct node_param
             {
-                char *name;
+                atom_t name;
                 struct node *default_value;
                 bool is_rest;
+                node_binding_t binding;
             } *params;
             size_t param_count;
             
+            /* NULL until a lazily pre-parsed body is parsed on first use */
             struct node *body;
+
+            /* source range of the body from its '{' to its '}' inclusive */
+            uint32_t body_start;
+            uint32_t body_end;
+
+            /*
+             * Set by sema. `binding` holds the function's name, in the
+             * enclosing scope for declarations and in its own scope for named
+             * expressions. A call pushes `frame_size` frame slots and an env
+             * of `env_size` slots if any.
+             */
+            bool is_declaration;
+            node_binding_t binding;
+            uint32_t frame_size;
+            uint32_t env_size;
+
+            /* sema's enclosing scope while the body is not parsed yet */
+            void *scope;
         } function;
 
         /* NODE_BREAK */
         struct
         {
-            char *label;
+            atom_t label;
         } break_stmt;
 
         /* NODE_CONTINUE */
         struct
         {
-            char *label;
+            atom_t label;
         } continue_stmt;
 
         /* NODE_THROW */
@@ -265,9 +339,12 @@ typedef struct node
         struct
         {
             struct node *try_block;
-            char *catch_param;
+            /* in a scope of its own, with an env of `catch_env_size` if any */
+            atom_t catch_param;
             struct node *catch_block;
             struct node *finally_block;
+            node_binding_t catch_binding;
+            uint32_t catch_env_size;
         } try_stmt;
 
         /* NODE_RETURN */
@@ -305,7 +382,8 @@ typedef struct node
         /* NODE_DECLARATION */
         struct
         {
-            struct token kind;
+            /* let, const or var */
+            node_op_t kind;
             struct node **names;
             /* optional initializers */
             struct node **values;
@@ -316,7 +394,7 @@ typedef struct node
         struct
         {
             struct node *expr;
-            struct
+            struct node_case
             {
                 struct node **labels;
                 size_t labels_count;
@@ -329,7 +407,7 @@ typedef struct node
         /* NODE_LABEL */
         struct
         {
-            char *name;
+            atom_t name;
             struct node *statement;
         } label;
 
@@ -354,61 +432,73 @@ typedef struct node
 } node_t;
 
 void node_print(node_t *node);
-void node_free(node_t *node);
 void node_build(node_t *node);
 
+/*
+ * Nodes, their child arrays and strings are allocated from an arena and
+ * released together with it, there is no per-node free.
+ */
+node_t *node_new(arena_t *arena, node_type_t type, location_t loc);
+size_t node_size(node_type_t type);
+
+/* nodes and bytes allocated per node type, for --stats */
+void node_stats_print(void);
+
 // simple literals
-node_t *node_create_number(number_t value, location_t loc);
-node_t *node_create_string(string_t value, location_t loc);
-node_t *node_create_bool(bool value, location_t loc);
-node_t *node_create_identifier(const char *name, location_t loc);
-node_t *node_create_null(location_t loc);
-node_t *node_create_undefined(location_t loc);
-node_t *node_create_this(location_t loc);
+node_t *node_create_number(arena_t *arena, number_t value, location_t loc);
+node_t *node_create_string(arena_t *arena, string_t value, location_t loc);
+node_t *node_create_bool(arena_t *arena, bool value, location_t loc);
+node_t *node_create_identifier(arena_t *arena, atom_t name, location_t loc);
+node_t *node_create_null(arena_t *arena, location_t loc);
+node_t *node_create_undefined(arena_t *arena, location_t loc);
+node_t *node_create_this(arena_t *arena, location_t loc);
 
 // unary / binary / ternary
-node_t *node_create_unary(token_t op, node_t *right, location_t loc);
-// node_t *node_create_prefix(token_t op, node_t *right, location_t loc); // optional for ++i, --i
-node_t *node_create_postfix(token_t op, node_t *left, location_t loc);
-node_t *node_create_binary(node_t *left, token_t op, node_t *right, location_t loc);
-node_t *node_create_assignment(node_t *target, token_t op, node_t *value, location_t loc);
-node_t *node_create_ternary(node_t *condition, node_t *true_expr, node_t *false_expr, location_t loc);
+node_t *node_create_unary(arena_t *arena, node_op_t op, node_t *right, location_t loc);
+// node_t *node_create_prefix(arena_t *arena, node_op_t op, node_t *right, location_t loc); // optional for ++i, --i
+node_t *node_create_postfix(arena_t *arena, node_op_t op, node_t *left, location_t loc);
+node_t *node_create_binary(arena_t *arena, node_t *left, node_op_t op, node_t *right, location_t loc);
+node_t *node_create_assignment(arena_t *arena, node_t *target, node_op_t op, node_t *value, location_t loc);
+node_t *node_create_ternary(arena_t *arena, node_t *condition, node_t *true_expr, node_t *false_expr, location_t loc);
 
 // control flow
-node_t *node_create_if(node_t *condition, node_t *then_branch, node_t *else_branch, location_t loc);
-node_t *node_create_while(node_t *condition, node_t *body, location_t loc);
-node_t *node_create_do_while(node_t *body, node_t *condition, location_t loc);
-node_t *node_create_for(node_t *init, node_t *condition, node_t *increment, node_t *body, location_t loc);
-node_t *node_create_break(const char *label, location_t loc);
-node_t *node_create_continue(const char *label, location_t loc);
-node_t *node_create_return(node_t *value, location_t loc);
-node_t *node_create_throw(node_t *value, location_t loc);
-node_t *node_create_try(node_t *try_block, const char *catch_param, node_t *catch_block, node_t *finally_block, location_t loc);
-node_t *node_create_switch(node_t *expr, size_t cases_count, location_t loc); // cases handled separately
-node_t *node_create_label(const char *name, node_t *statement, location_t loc);
+node_t *node_create_if(arena_t *arena, node_t *condition, node_t *then_branch, node_t *else_branch, location_t loc);
+node_t *node_create_while(arena_t *arena, node_t *condition, node_t *body, location_t loc);
+node_t *node_create_do_while(arena_t *arena, node_t *body, node_t *condition, location_t loc);
+node_t *node_create_for(arena_t *arena, node_t *init, node_t *condition, node_t *increment, node_t *body, location_t loc);
+node_t *node_create_break(arena_t *arena, atom_t label, location_t loc);
+node_t *node_create_continue(arena_t *arena, atom_t label, location_t loc);
+node_t *node_create_return(arena_t *arena, node_t *value, location_t loc);
+node_t *node_create_throw(arena_t *arena, node_t *value, location_t loc);
+node_t *node_create_try(arena_t *arena, node_t *try_block, atom_t catch_param, node_t *catch_block, node_t *finally_block, location_t loc);
+node_t *node_create_switch(arena_t *arena, node_t *expr, size_t cases_count, location_t loc); // cases handled separately
+node_t *node_create_label(arena_t *arena, atom_t name, node_t *statement, location_t loc);
 
 // blocks and programs
-node_t *node_create_block(node_t **statements, size_t count, location_t loc);
-node_t *node_create_program(node_t **statements, size_t count, location_t loc);
+node_t *node_create_block(arena_t *arena, node_t **statements, size_t count, location_t loc);
+node_t *node_create_program(arena_t *arena, node_t **statements, size_t count, location_t loc);
 
 // functions / calls
-node_t *node_create_function(const char *name, bool is_async, size_t param_count, location_t loc);
-node_t *node_create_call(node_t *callee, node_t **args, size_t arg_count, location_t loc);
-node_t *node_create_index(node_t *array, node_t *index, location_t loc);
-node_t *node_create_member(node_t *object, node_t *property, location_t loc);
+node_t *node_create_function(arena_t *arena, atom_t name, bool is_async, size_t param_count, location_t loc);
+node_t *node_create_call(arena_t *arena, node_t *callee, node_t **args, size_t arg_count, location_t loc);
+node_t *node_create_index(arena_t *arena, node_t *array, node_t *index, location_t loc);
+node_t *node_create_member(arena_t *arena, node_t *object, node_t *property, location_t loc);
 
 // arrays / objects / spread
-node_t *node_create_array(node_t **elements, size_t count, location_t loc);
-node_t *node_create_object(char **keys, node_t **values, size_t count, location_t loc);
-node_t *node_create_spread(node_t *argument, location_t loc);
+node_t *node_create_array(arena_t *arena, node_t **elements, size_t count, location_t loc);
+node_t *node_create_object(arena_t *arena, atom_t *keys, node_t **values, size_t count, location_t loc);
+node_t *node_create_spread(arena_t *arena, node_t *argument, location_t loc);
 
 // imports / exports / declarations
-node_t *node_create_import(const char *module, const char *default_name, size_t named_count, char **imported, location_t loc);
-node_t *node_create_export(node_t *declaration, bool is_default, size_t named_count, char **exported, location_t loc);
-node_t *node_create_declaration(token_t kind, node_t **names, node_t **values, size_t count, location_t loc);
+node_t *node_create_import(arena_t *arena, const char *module, const char *default_name, size_t named_count, char **imported, location_t loc);
+node_t *node_create_export(arena_t *arena, node_t *declaration, bool is_default, size_t named_count, char **exported, location_t loc);
+node_t *node_create_declaration(arena_t *arena, node_op_t kind, node_t **names, node_t **values, size_t count, location_t loc);
+
+node_t *node_create_await(arena_t *arena, node_t *argument, location_t loc);
+node_t *node_create_empty(arena_t *arena, location_t loc);
 
-node_t *node_create_await(node_t *argument, location_t loc);
-node_t *node_create_empty(location_t loc);
+/* whether the node is an expression, which a statement can be too */
+bool node_is_expression(const node_t *node);
 
 const char *node_type_to_string(node_type_t type);
 
@@ -0,0 +1,33 @@
+#ifndef __OPTIMIZE_H
+#define __OPTIMIZE_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "atom.h"
+#include "node.h"
+
+/*
+ * Optimization pass over a checked program. Folds constant subtrees into
+ * literal nodes and drops statements and branches that can never run.
+ */
+typedef struct optimizer
+{
+    /* literals created by folding */
+    arena_t arena;
+
+    /* `Math`, NULL when the program may rebind it */
+    atom_t math;
+
+    /* statistics */
+    size_t folded;
+    size_t removed;
+} optimizer_t;
+
+void optimizer_init(optimizer_t *optimizer);
+void optimizer_free(optimizer_t *optimizer);
+
+/* rewrites `program` in place, the new nodes live until `optimizer_free` */
+void optimize_program(optimizer_t *optimizer, node_t *program);
+
+#endif /* !__OPTIMIZE_H */
@@ -5,12 +5,28 @@
 
 #include "lexer.h"
 #include "node.h"
+#include "arena.h"
 
 typedef struct parser
 {
     lexer_t *lexer;
     token_t *current;
     token_t *previous;
+
+    /* expression nesting, bounded by `PARSER_MAX_DEPTH` */
+    size_t depth;
+
+    /* only pre-parse function bodies, see `parser_function_body` */
+    bool lazy;
+    size_t lazy_functions;
+
+    /* owns the parsed program, released by `parser_free` */
+    arena_t arena;
+
+    /* child lists under construction, see `parser_list_begin` */
+    char *scratch;
+    size_t scratch_length;
+    size_t scratch_capacity;
 } parser_t;
 
 #define PARSER_ERROR(parser, ...) \
@@ -18,9 +34,19 @@ typedef struct parser
         fprintf(stderr, __VA_ARGS__); \
     } while (0)
 
+/* `%.*s` arguments for printing the text of a token */
+#define TOKEN_TEXT(parser, token) \
+    (int) (token)->length, lexer_token_text((parser)->lexer, (token))
+
 void parser_init(parser_t *parser, lexer_t *lexer);
 void parser_free(parser_t *parser);
 
 node_t *parse_program(parser_t *parser);
 
+/*
+ * Parses the body of a function pre-parsed in lazy mode, once. Needed before
+ * the first call, returns NULL after reporting a syntax error.
+ */
+node_t *parser_function_body(parser_t *parser, node_t *function);
+
 #endif /* !__PARSER_H */
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef __RUNTIME_H
+#define __RUNTIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atom.h"
+#include "env.h"
+#include "value.h"
+
+/*
+ * Semantics of values shared by the engines that run checked programs,
+ * the bytecode VM and the compiled closures.
+ */
+
+bool runtime_truthy(value_t value);
+number_t runtime_to_number(value_t value);
+int32_t runtime_to_int32(number_t number);
+const char *runtime_typeof(value_t value);
+
+/* `+`, which concatenates when either side is a string */
+value_t runtime_add(value_t left, value_t right);
+value_t runtime_concat(value_t left, value_t right);
+bool runtime_less(value_t left, value_t right, bool or_equal);
+
+bool runtime_strict_equals(value_t a, value_t b);
+bool runtime_equals(value_t a, value_t b);
+
+/* aborts on values that are not objects */
+value_t runtime_member(value_t object, atom_t name);
+
+/* sets the builtins in the global cells sema reserved for them */
+void runtime_builtins(env_t *globals);
+
+#endif /* !__RUNTIME_H */
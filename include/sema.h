@@ -1,5 +1,3 @@
-
-
 #ifndef __SEMA_H
 #define __SEMA_H
 
@@ -7,13 +5,118 @@
 #include "node.h"
 #include "env.h"
 #include "lexer.h"
+#include "arena.h"
+#include "flat.h"
+
+/* globals defined by the evaluator, they take the first global cells */
+typedef enum sema_builtin
+{
+    SEMA_BUILTIN_MATH,
+    SEMA_BUILTIN_INFINITY,
+    SEMA_BUILTIN_NAN,
+    SEMA_BUILTIN_PRINT,
+
+    /* the number of builtins */
+    SEMA_BUILTIN_COUNT,
+} sema_builtin_t;
+
+typedef struct sema_variable
+{
+    atom_t name;
+    node_op_t kind;     /**< TOKEN_LET, TOKEN_CONST, TOKEN_VAR or TOKEN_FUNCTION */
+    bool captured;      /**< used by a nested function, lives in the scope's env */
+    bool numeric;       /**< only ever holds numbers, see `sema_infer` */
+    uint32_t declared_at; /**< `sema_t::declarations` after its declaration, 0 before */
+    uint32_t index;     /**< frame or env slot, set when the scope is closed */
+} sema_variable_t;
+
+/* a use of a variable, bound once the variable's scope is closed */
+typedef struct sema_reference
+{
+    node_binding_t *binding;
+    struct sema_scope *scope;       /**< where the variable is used */
+    struct sema_scope *declared;
+    uint32_t variable;
+} sema_reference_t;
+
+/* a value stored into a variable, `op` is the assignment operator */
+typedef struct sema_write
+{
+    struct sema_scope *scope;
+    uint32_t variable;
+    flat_index_t value;
+    node_op_t op;
+} sema_write_t;
+
+/* an identifier reading a variable */
+typedef struct sema_use
+{
+    flat_index_t identifier;
+    struct sema_scope *scope;
+    uint32_t variable;
+} sema_use_t;
+
+typedef struct sema_scope
+{
+    struct sema_scope *parent;
+
+    sema_variable_t *variables;
+    size_t count;
+    size_t capacity;
+
+    sema_reference_t *references;
+    size_t reference_count;
+    size_t reference_capacity;
+
+    bool is_function;       /**< `var`s are hoisted to it, it owns a frame */
+    bool closed;
+    uint32_t frame_base;    /**< frame slot of the first variable */
+    uint32_t frame_size;    /**< of the whole function, for function scopes */
+    uint32_t env_size;      /**< captured variables */
+    uint32_t callable_at;   /**< declarations visited before the function can first run */
+} sema_scope_t;
 
 typedef struct sema
 {
     node_t *program;
     size_t loop_depth;
+    size_t switch_depth;
+    size_t try_depth;       /**< blocks a return leaves through a `finally` */
     bool in_async_function;
     bool had_error;
+
+    /* `let` and `const` declarations visited so far, in source order */
+    uint32_t declarations;
+    uint32_t hoisted_at;    /**< when the current block's functions are declared */
+
+    /*
+     * The tree is checked in its flat form, `flat` is the program's or that
+     * of a lazily parsed function. Results go to the nodes the engines run.
+     */
+    flat_t program_flat;
+    flat_t *flat;
+
+    /* scopes stay alive for lazily parsed bodies */
+    arena_t arena;
+    sema_scope_t *scope;
+
+    /* numeric inference, collected by the visit and reset by `sema_infer` */
+    sema_write_t *writes;
+    size_t write_count;
+    size_t write_capacity;
+
+    sema_use_t *uses;
+    size_t use_count;
+    size_t use_capacity;
+
+    flat_index_t *expressions;  /**< in post-order, operands come first */
+    size_t expression_count;
+    size_t expression_capacity;
+
+    /* `Math` is trusted while it is only read as `Math.name` */
+    size_t math_uses;
+    size_t math_reads;
+    bool lazy_bodies;       /**< unchecked code may use `Math` in any way */
 } sema_t;
 
 #define SEMA_ERROR(ctx, ...) \
@@ -25,5 +128,9 @@ typedef struct sema
 void sema_init(sema_t *ctx, node_t *program);
 void sema_free(sema_t *ctx);
 void sema_analyze(sema_t *ctx);
+/* checks a function whose body was parsed lazily, before its first call */
+bool sema_analyze_function(sema_t *ctx, node_t *function);
+
+const char *sema_builtin_name(sema_builtin_t builtin);
 
-#endif /* !__SEMA_H */
\ No newline at end of file
+#endif /* !__SEMA_H */
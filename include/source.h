@@ -0,0 +1,50 @@
+#ifndef __SOURCE_H
+#define __SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* id of a loaded source file, 0 means no source */
+typedef uint32_t source_id_t;
+
+#define SOURCE_NONE ((source_id_t) 0)
+
+typedef struct source
+{
+    /* file name as given by the user */
+    char *name;
+
+    /* file contents, not NUL terminated */
+    const char *data;
+    size_t length;
+
+    /* `data` is a read-only mapping, otherwise it is heap allocated */
+    bool mapped;
+
+    /* offsets of line starts, built on the first line lookup */
+    uint32_t *lines;
+    size_t line_count;
+} source_t;
+
+/* locations store 32-bit offsets */
+#define SOURCE_MAX_LENGTH ((size_t) UINT32_MAX)
+
+/*
+ * Process-wide registry of loaded sources. Files are mapped read-only,
+ * stdin ("-") and in-memory text (REPL) fall back to a heap copy.
+ * Returns SOURCE_NONE on failure.
+ */
+source_id_t source_load(const char *filename);
+source_id_t source_from_string(const char *name, const char *text);
+
+const source_t *source_get(source_id_t id);
+const char *source_name(source_id_t id);
+
+/* 1-based line and column of a byte offset, only needed for diagnostics */
+size_t source_line(source_id_t id, size_t offset);
+size_t source_column(source_id_t id, size_t offset);
+
+void source_free_all(void);
+
+#endif /* !__SOURCE_H */
@@ -0,0 +1,28 @@
+#ifndef __STACK_H
+#define __STACK_H
+
+#include <stddef.h>
+
+#include "value.h"
+
+#define VALUE_STACK_CAPACITY (256 * 1024)
+
+/*
+ * Frames of locals that no nested function captures, see `node_binding_t`.
+ * The stack never moves, so frame pointers stay valid while it grows.
+ */
+typedef struct value_stack
+{
+    value_t *values;
+    size_t top;
+    size_t capacity;
+} value_stack_t;
+
+void value_stack_init(value_stack_t *stack);
+void value_stack_free(value_stack_t *stack);
+
+/* `size` slots set to undefined, aborts on overflow */
+value_t *value_stack_push_frame(value_stack_t *stack, size_t size);
+void value_stack_pop_frame(value_stack_t *stack, size_t size);
+
+#endif /* !__STACK_H */
@@ -3,7 +3,10 @@
 #define __TOKEN_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
+#include "atom.h"
+#include "types.h"
 #include "location.h"
 
 typedef enum token_type
@@ -120,18 +123,75 @@ typedef enum token_type
 	TOKEN_COUNT,
 } token_type_t;
 
+/*
+ * Reserved words, X(type, spelling, first char, second char). The first two
+ * characters are spelled out so that the lexer can hash them at compile time,
+ * the lexer asserts that they match the spelling.
+ */
+#define TOKEN_KEYWORDS(X) \
+    X(TOKEN_IF,            "if",        'i', 'f') \
+    X(TOKEN_ELSE,          "else",      'e', 'l') \
+    X(TOKEN_WHILE,         "while",     'w', 'h') \
+    X(TOKEN_DO,            "do",        'd', 'o') \
+    X(TOKEN_FOR,           "for",       'f', 'o') \
+    X(TOKEN_FUNCTION,      "function",  'f', 'u') \
+    X(TOKEN_SWITCH,        "switch",    's', 'w') \
+    X(TOKEN_CASE,          "case",      'c', 'a') \
+    X(TOKEN_DEFAULT,       "default",   'd', 'e') \
+    X(TOKEN_LET,           "let",       'l', 'e') \
+    X(TOKEN_CONST,         "const",     'c', 'o') \
+    X(TOKEN_VAR,           "var",       'v', 'a') \
+    X(TOKEN_NULL,          "null",      'n', 'u') \
+    X(TOKEN_UNDEFINED,     "undefined", 'u', 'n') \
+    X(TOKEN_RETURN,        "return",    'r', 'e') \
+    X(TOKEN_BREAK,         "break",     'b', 'r') \
+    X(TOKEN_CONTINUE,      "continue",  'c', 'o') \
+    X(TOKEN_IMPORT,        "import",    'i', 'm') \
+    X(TOKEN_EXPORT,        "export",    'e', 'x') \
+    X(TOKEN_TRY,           "try",       't', 'r') \
+    X(TOKEN_CATCH,         "catch",     'c', 'a') \
+    X(TOKEN_FINALLY,       "finally",   'f', 'i') \
+    X(TOKEN_THROW,         "throw",     't', 'h') \
+    X(TOKEN_TYPEOF,        "typeof",    't', 'y') \
+    X(TOKEN_ASYNC,         "async",     'a', 's') \
+    X(TOKEN_AWAIT,         "await",     'a', 'w') \
+    X(TOKEN_BOOL_LITERAL,  "true",      't', 'r') \
+    X(TOKEN_BOOL_LITERAL,  "false",     'f', 'a') \
+    X(TOKEN_FROM,          "from",      'f', 'r') \
+    X(TOKEN_DELETE,        "delete",    'd', 'e') \
+    X(TOKEN_THIS,          "this",      't', 'h') \
+    X(TOKEN_VOID,          "void",      'v', 'o') \
+    X(TOKEN_NEW,           "new",       'n', 'e') \
+    X(TOKEN_DEBUGGER,      "debugger",  'd', 'e')
+
 
 typedef struct token
 {
-    char *value;
+    /* the text starts at `loc`, see `lexer_token_text` */
     size_t length;
     token_type_t type;
-    
+
+    /* string literal with escapes, text lives in the lexer's string buffer */
+    bool escaped;
+
+    union
+    {
+        /* TOKEN_IDENTIFIER, interned name */
+        atom_t atom;
+
+        /* TOKEN_NUMBER_LITERAL, see `lexer_token_number` */
+        uint32_t number;
+
+        /* escaped TOKEN_STRING_LITERAL, offset in the lexer's string buffer */
+        uint32_t string;
+    };
+
     // size_t line;
     // size_t column;
     location_t loc;
 } token_t;
 
 const char *token_type_to_string(token_type_t type);
+const char *token_type_to_lexeme(token_type_t type);
 
 #endif /* !__TOKEN_H */
@@ -0,0 +1,147 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bytecode.h"
+#include "jit.h"
+#include "value.h"
+
+/* instructions of a trace before its recording gives up */
+#define TRACE_MAX_LENGTH 1024
+
+/* an instruction of the trace, its result is referenced by its index */
+typedef uint16_t trace_ref_t;
+
+#define TRACE_NONE UINT16_MAX
+
+/*
+ * Instructions of a trace. Every value is a number or a boolean, numbers
+ * live unboxed in the trace's frame and booleans only decide guards.
+ */
+typedef enum trace_op
+{
+    TRACE_NUMBER,           /**< constants */
+    TRACE_BOOL,
+    TRACE_LOAD,             /**< a variable on entry, checked to be a number */
+    TRACE_ADD,
+    TRACE_SUB,
+    TRACE_MUL,
+    TRACE_DIV,
+    TRACE_MOD,
+    TRACE_NEG,
+    TRACE_LT,
+    TRACE_LE,
+    TRACE_EQ,
+    TRACE_NOT,
+    TRACE_GUARD,            /**< leaves the trace unless `left` is `expect` */
+    TRACE_STORE,            /**< writes `left` to a variable */
+
+    /* the number of instructions */
+    TRACE_COUNT,
+} trace_op_t;
+
+/* a frame slot or a global cell */
+typedef struct trace_var
+{
+    bool global;
+    uint32_t slot;
+} trace_var_t;
+
+typedef struct trace_ins
+{
+    trace_op_t op;
+    trace_ref_t left;
+    trace_ref_t right;
+
+    union
+    {
+        number_t number;
+        bool boolean;
+        trace_var_t var;
+
+        struct
+        {
+            bool expect;
+            uint32_t snapshot;
+        } guard;
+    };
+
+    bool invariant;         /**< computed once before the loop */
+    bool live;
+} trace_ins_t;
+
+/* where a guard leaves the trace, with the operands the VM continues with */
+typedef struct trace_snapshot
+{
+    uint32_t exit;          /**< bytecode offset */
+    uint32_t start;         /**< of the operands in `stack` */
+    uint32_t count;
+} trace_snapshot_t;
+
+/* a variable the trace uses, `ref` is its value so far */
+typedef struct trace_slot
+{
+    trace_var_t var;
+    trace_ref_t load;       /**< TRACE_NONE when it was stored before it was read */
+    trace_ref_t ref;
+    bool stored;
+} trace_slot_t;
+
+/*
+ * Records one iteration of a hot loop while running it. Each instruction is
+ * run by `jit_step` and appended to `ins` for the values it computes, with
+ * constants folded and repeated instructions and guards shared.
+ */
+typedef struct trace_recorder
+{
+    bytecode_function_t *function;
+    uint32_t header;
+
+    trace_ins_t ins[TRACE_MAX_LENGTH];
+    size_t count;
+
+    /* the operands the iteration pushed */
+    trace_ref_t stack[TRACE_MAX_LENGTH];
+    size_t depth;
+
+    trace_slot_t slots[TRACE_MAX_LENGTH];
+    size_t slot_count;
+
+    trace_snapshot_t snapshots[TRACE_MAX_LENGTH];
+    size_t snapshot_count;
+    trace_ref_t snapshot_stack[TRACE_MAX_LENGTH];
+    size_t snapshot_depth;
+} trace_recorder_t;
+
+/*
+ * Machine code of a loop recorded once it got hot. Variables the loop
+ * reads are checked and loaded once, then the iterations run on unboxed
+ * numbers until a guard fails, which returns to the VM where the bytecode
+ * would have gone. Stores write through, so the VM finds the variables as
+ * the bytecode left them.
+ */
+typedef struct trace
+{
+    uint8_t *code;          /**< mapped read and execute only */
+    size_t length;
+    size_t size;            /**< of the mapping */
+    uint32_t header;        /**< offset of the loop's first instruction */
+} trace_t;
+
+/*
+ * Runs an iteration of the loop at `header` whose back-edge is the LOOP
+ * instruction at `back_edge` and compiles it to `loop->trace`. Returns the
+ * offset the VM continues at, the header or the instruction the recording
+ * stopped at, with the operands left in `state->sp`.
+ */
+uint32_t trace_record(jit_state_t *state, bytecode_loop_t *loop, const uint8_t *header, const uint8_t *back_edge);
+
+/* returns the offset the VM continues at */
+uint32_t trace_run(trace_t *trace, jit_state_t *state);
+
+void trace_free(trace_t *trace);
+
+#endif /* !__TRACE_H */
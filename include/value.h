@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 
+#include "atom.h"
 #include "types.h"
 #include "node.h"
 
@@ -24,7 +25,7 @@ typedef struct array
 
 typedef struct object
 {
-    char **keys;
+    atom_t *keys;
     value_t *values;
     size_t count;
     size_t capacity;
@@ -38,9 +39,14 @@ typedef struct function
         struct
         {
             size_t param_count;
-            char **param_names;
+            atom_t *param_names;
             node_t *body;
             env_t *closure;
+
+            /* compiled code, run by the bytecode VM */
+            struct bytecode_function *code;
+            /* compiled closures, run by `closure_run` */
+            struct closure_function *closures;
         } user;
 
         value_t (*native_ptr)(eval_context_t *ctx, size_t argc, value_t *argv);
@@ -83,7 +89,7 @@ value_t value_function(function_t *func);
 
 value_t value_object(object_t object);
 value_t value_object_create(void);
-void object_set(object_t *obj, const char *key, value_t val);
+void object_set(object_t *obj, atom_t key, value_t val);
 
 value_t value_null();
 value_t value_undefined();
@@ -0,0 +1,60 @@
+#ifndef __VM_H
+#define __VM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "bytecode.h"
+#include "compiler.h"
+#include "env.h"
+#include "stack.h"
+#include "value.h"
+
+#define VM_FRAMES_CAPACITY (64 * 1024)
+
+/* a running function, its callee is at `base[-1]` */
+typedef struct vm_frame
+{
+    bytecode_function_t *function;
+    const uint8_t *ip;      /**< where the caller resumes, saved on calls */
+    value_t *base;          /**< frame slots, followed by operands */
+    env_t *env;
+} vm_frame_t;
+
+/*
+ * Runs bytecode. Frames and operands share one value stack and calls
+ * between Rose functions do not recurse in C.
+ */
+typedef struct vm
+{
+    value_stack_t stack;
+    vm_frame_t *frames;
+    size_t frame_count;
+
+    /* cells of the global scope, created by `vm_run` */
+    env_t *globals;
+
+    /* compiles lazily parsed functions */
+    compiler_t *compiler;
+
+    /* hot functions run as machine code, see `jit_compile` */
+    bool jit;
+    size_t jit_functions;
+    size_t jit_bytes;
+
+    /* hot loops are recorded and run as traces, see `trace_record` */
+    bool trace;
+    size_t traces;
+    size_t trace_aborts;
+} vm_t;
+
+void vm_init(vm_t *vm, compiler_t *compiler);
+void vm_free(vm_t *vm);
+
+/* returns the value of the program's last expression statement */
+value_t vm_run(vm_t *vm, bytecode_function_t *program);
+
+/* a Rose function of `code` closing over `env` */
+function_t *vm_closure(bytecode_function_t *code, env_t *env);
+
+#endif /* !__VM_H */
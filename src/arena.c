@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "utils.h"
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct arena_block
+{
+    struct arena_block *next;
+    size_t used;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+void arena_init(arena_t *arena)
+{
+    *arena = (arena_t) {0};
+}
+
+void arena_free(arena_t *arena)
+{
+    arena_block_t *block = arena->blocks;
+    while (block)
+    {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    *arena = (arena_t) {0};
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    arena_block_t *block = arena->blocks;
+    if (!block || block->used + size > block->size)
+    {
+        /* blocks are zeroed once, so allocations need no memset */
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = calloc(1, sizeof(arena_block_t) + block_size);
+        if (!block)
+        {
+            ERROR("Calloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        block->size = block_size;
+
+        /* keep filling the current block after an oversized allocation */
+        if (arena->blocks && size > ARENA_BLOCK_SIZE)
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+        arena->block_count++;
+    }
+
+    void *memory = &block->data[block->used];
+    block->used += size;
+
+    arena->allocations++;
+    arena->bytes += size;
+    return memory;
+}
+
+void *arena_memdup(arena_t *arena, const void *data, size_t size)
+{
+    void *memory = arena_alloc(arena, size);
+    return size ? memcpy(memory, data, size) : memory;
+}
+
+char *arena_strndup(arena_t *arena, const char *text, size_t length)
+{
+    /* the terminator is already zero */
+    char *copy = arena_alloc(arena, length + 1);
+    return memcpy(copy, text, length);
+}
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "assembler.h"
+#include "jit.h"
+
+#if JIT_AVAILABLE
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ASM_INITIAL_CAPACITY 256
+
+void asm_init(assembler_t *as)
+{
+    *as = (assembler_t) {0};
+}
+
+void asm_free(assembler_t *as)
+{
+    free(as->code);
+    *as = (assembler_t) {0};
+}
+
+void asm_byte(assembler_t *as, uint8_t byte)
+{
+    if (as->length == as->capacity)
+    {
+        size_t capacity = as->capacity ? as->capacity * 2 : ASM_INITIAL_CAPACITY;
+        uint8_t *code = realloc(as->code, capacity);
+        if (!code)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        as->code = code;
+        as->capacity = capacity;
+    }
+    as->code[as->length++] = byte;
+}
+
+void asm_u32(assembler_t *as, uint32_t value)
+{
+    for (int i = 0; i < 32; i += 8)
+        asm_byte(as, (uint8_t) (value >> i));
+}
+
+void asm_u64(assembler_t *as, uint64_t value)
+{
+    for (int i = 0; i < 64; i += 8)
+        asm_byte(as, (uint8_t) (value >> i));
+}
+
+/* REX prefix for 64-bit operands and registers above 7 */
+static void asm_rex(assembler_t *as, bool wide, int reg, int base)
+{
+    uint8_t rex = 0x40 | wide << 3 | (reg >> 3) << 2 | base >> 3;
+    if (rex != 0x40) asm_byte(as, rex);
+}
+
+void asm_memory(assembler_t *as, bool wide, uint16_t opcode, int reg, int base, int32_t disp)
+{
+    asm_rex(as, wide, reg, base);
+    if (opcode > 0xFF) asm_byte(as, opcode >> 8);
+    asm_byte(as, opcode & 0xFF);
+
+    /* always a 32-bit displacement, rsp and r12 need a SIB byte */
+    asm_byte(as, 0x80 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == ASM_RSP) asm_byte(as, 0x24);
+    asm_u32(as, (uint32_t) disp);
+}
+
+void asm_x87(assembler_t *as, uint16_t opcode)
+{
+    asm_byte(as, opcode >> 8);
+    asm_byte(as, opcode & 0xFF);
+}
+
+void asm_mov(assembler_t *as, int to, int from)
+{
+    asm_rex(as, true, from, to);
+    asm_byte(as, 0x89);
+    asm_byte(as, 0xC0 | (from & 7) << 3 | (to & 7));
+}
+
+void asm_mov_imm(assembler_t *as, int reg, uint64_t value)
+{
+    asm_rex(as, true, 0, reg);
+    asm_byte(as, 0xB8 + (reg & 7));
+    asm_u64(as, value);
+}
+
+void asm_lea(assembler_t *as, int reg, int base, int32_t disp)
+{
+    asm_memory(as, true, 0x8D, reg, base, disp);
+}
+
+void asm_push(assembler_t *as, int reg)
+{
+    asm_rex(as, false, 0, reg);
+    asm_byte(as, 0x50 + (reg & 7));
+}
+
+void asm_pop(assembler_t *as, int reg)
+{
+    asm_rex(as, false, 0, reg);
+    asm_byte(as, 0x58 + (reg & 7));
+}
+
+void asm_call(assembler_t *as, uintptr_t helper)
+{
+    asm_mov_imm(as, ASM_RAX, helper);
+    asm_byte(as, 0xFF);
+    asm_byte(as, 0xD0);
+}
+
+void asm_fld(assembler_t *as, int base, int32_t disp)
+{
+    asm_memory(as, false, 0xDB, 5, base, disp);
+}
+
+void asm_fstp(assembler_t *as, int base, int32_t disp)
+{
+    asm_memory(as, false, 0xDB, 7, base, disp);
+}
+
+void asm_setcc(assembler_t *as, int condition)
+{
+    asm_byte(as, 0x0F);
+    asm_byte(as, 0x90 | condition);
+    asm_byte(as, 0xC0);
+}
+
+size_t asm_jump_forward(assembler_t *as, int condition)
+{
+    if (condition == ASM_ALWAYS)
+        asm_byte(as, 0xE9);
+    else
+    {
+        asm_byte(as, 0x0F);
+        asm_byte(as, 0x80 | condition);
+    }
+
+    size_t at = as->length;
+    asm_u32(as, 0);
+    return at;
+}
+
+void asm_patch(assembler_t *as, size_t at, size_t target)
+{
+    int32_t displacement = (int32_t) ((int64_t) target - (int64_t) (at + sizeof(int32_t)));
+    memcpy(as->code + at, &displacement, sizeof(displacement));
+}
+
+void asm_bind(assembler_t *as, size_t at)
+{
+    asm_patch(as, at, as->length);
+}
+
+void asm_jump_to(assembler_t *as, int condition, size_t target)
+{
+    asm_patch(as, asm_jump_forward(as, condition), target);
+}
+
+/* written first, executable after */
+uint8_t *asm_map(assembler_t *as, size_t *size)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    *size = (as->length + page - 1) / page * page;
+
+    uint8_t *code = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return NULL;
+
+    memcpy(code, as->code, as->length);
+    if (mprotect(code, *size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(code, *size);
+        return NULL;
+    }
+    return code;
+}
+
+void asm_unmap(uint8_t *code, size_t size)
+{
+    munmap(code, size);
+}
+
+#endif /* JIT_AVAILABLE */
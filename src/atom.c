@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "atom.h"
+
+#define ATOM_TABLE_INITIAL_CAPACITY 256
+#define ATOM_CHUNK_SIZE (64 * 1024)
+
+/* header in front of the text an atom points to */
+typedef struct atom_entry
+{
+    uint32_t hash;
+    uint32_t length;
+    char text[];
+} atom_entry_t;
+
+/* entries are bump allocated, they never move once interned */
+typedef struct atom_chunk
+{
+    struct atom_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} atom_chunk_t;
+
+typedef struct atom_table
+{
+    /* open addressing, capacity is a power of two */
+    atom_entry_t **slots;
+    size_t count;
+    size_t capacity;
+
+    atom_chunk_t *chunks;
+} atom_table_t;
+
+static atom_table_t table = {0};
+
+/* FNV-1a */
+static uint32_t atom_hash(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static atom_entry_t *atom_alloc(size_t length)
+{
+    size_t size = sizeof(atom_entry_t) + length + 1;
+    size = (size + _Alignof(atom_entry_t) - 1) & ~(_Alignof(atom_entry_t) - 1);
+
+    atom_chunk_t *chunk = table.chunks;
+    if (!chunk || chunk->used + size > chunk->size)
+    {
+        size_t chunk_size = size > ATOM_CHUNK_SIZE ? size : ATOM_CHUNK_SIZE;
+        chunk = malloc(sizeof(atom_chunk_t) + chunk_size);
+        if (!chunk)
+        {
+            ERROR("Malloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        chunk->next = table.chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        table.chunks = chunk;
+    }
+
+    atom_entry_t *entry = (atom_entry_t *) &chunk->data[chunk->used];
+    chunk->used += size;
+    return entry;
+}
+
+static void atom_grow(void)
+{
+    size_t capacity = table.capacity ? table.capacity * 2 : ATOM_TABLE_INITIAL_CAPACITY;
+    atom_entry_t **slots = calloc(capacity, sizeof(atom_entry_t *));
+    if (!slots)
+    {
+        ERROR("Calloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < table.capacity; i++)
+    {
+        atom_entry_t *entry = table.slots[i];
+        if (!entry) continue;
+
+        size_t slot = entry->hash & (capacity - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = entry;
+    }
+
+    free(table.slots);
+    table.slots = slots;
+    table.capacity = capacity;
+}
+
+/* slot of an equal atom, or the empty slot to insert it at */
+static size_t atom_find(const char *text, size_t length, uint32_t hash)
+{
+    /* keep the load factor at most 1/2 */
+    if ((table.count + 1) * 2 > table.capacity)
+        atom_grow();
+
+    size_t slot = hash & (table.capacity - 1);
+
+    atom_entry_t *entry;
+    while ((entry = table.slots[slot]) != NULL)
+    {
+        if (entry->hash == hash &&
+            entry->length == length &&
+            memcmp(entry->text, text, length) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & (table.capacity - 1);
+    }
+
+    return slot;
+}
+
+atom_t atom_intern(const char *text, size_t length)
+{
+    uint32_t hash = atom_hash(text, length);
+    size_t slot = atom_find(text, length, hash);
+
+    atom_entry_t *entry = table.slots[slot];
+    if (entry) return entry->text;
+
+    entry = atom_alloc(length);
+    entry->hash = hash;
+    entry->length = (uint32_t) length;
+    memcpy(entry->text, text, length);
+    entry->text[length] = '\0';
+
+    table.slots[slot] = entry;
+    table.count++;
+
+    return entry->text;
+}
+
+atom_t atom_from_cstr(const char *text)
+{
+    return atom_intern(text, strlen(text));
+}
+
+size_t atom_length(atom_t atom)
+{
+    const atom_entry_t *entry = (const atom_entry_t *) (atom - offsetof(atom_entry_t, text));
+    return entry->length;
+}
+
+size_t atom_storage_size(atom_t atom)
+{
+    size_t size = sizeof(atom_entry_t) + atom_length(atom) + 1;
+    return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+size_t atom_store(void *storage, atom_t atom)
+{
+    const atom_entry_t *entry = (const atom_entry_t *) (atom - offsetof(atom_entry_t, text));
+    memcpy(storage, entry, sizeof(atom_entry_t) + entry->length + 1);
+    return offsetof(atom_entry_t, text);
+}
+
+atom_t atom_adopt(const char *stored)
+{
+    atom_entry_t *entry = (atom_entry_t *) (stored - offsetof(atom_entry_t, text));
+
+    /* a damaged entry is copied instead, the table relies on its hash */
+    uint32_t hash = atom_hash(entry->text, entry->length);
+    if (hash != entry->hash || entry->text[entry->length] != '\0')
+        return atom_intern(entry->text, entry->length);
+
+    size_t slot = atom_find(entry->text, entry->length, hash);
+
+    if (!table.slots[slot])
+    {
+        /* the stored entry becomes the atom, it is never written */
+        table.slots[slot] = entry;
+        table.count++;
+    }
+
+    return table.slots[slot]->text;
+}
+
+void atom_free_all(void)
+{
+    atom_chunk_t *chunk = table.chunks;
+    while (chunk)
+    {
+        atom_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(table.slots);
+    table = (atom_table_t) {0};
+}
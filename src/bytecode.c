@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "bytecode.h"
+#include "jit.h"
+#include "trace.h"
+
+#define BYTECODE_INITIAL_CAPACITY 64
+
+static_assert(BYTECODE_COUNT <= UINT8_MAX + 1, "Instructions must fit in an opcode byte");
+
+static const int bytecode_effects[BYTECODE_COUNT] = {
+#define BYTECODE_EFFECT(name, operands, effect) [BYTECODE_##name] = effect,
+    BYTECODE_OPS(BYTECODE_EFFECT)
+#undef BYTECODE_EFFECT
+};
+
+static const uint8_t bytecode_operands[BYTECODE_COUNT] = {
+#define BYTECODE_OPERANDS(name, operands, effect) [BYTECODE_##name] = operands,
+    BYTECODE_OPS(BYTECODE_OPERANDS)
+#undef BYTECODE_OPERANDS
+};
+
+int bytecode_op_effect(bytecode_op_t op)
+{
+    return bytecode_effects[op];
+}
+
+int bytecode_op_operands(bytecode_op_t op)
+{
+    return bytecode_operands[op];
+}
+
+/* makes room for `needed` items of `size` bytes */
+static void *bytecode_grow(void *items, size_t *capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity) return items;
+
+    size_t new_capacity = *capacity ? *capacity : BYTECODE_INITIAL_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    items = realloc(items, new_capacity * size);
+    if (!items)
+    {
+        ERROR("Realloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *capacity = new_capacity;
+    return items;
+}
+
+bytecode_function_t *bytecode_function_create(node_t *node)
+{
+    bytecode_function_t *function = calloc(1, sizeof(bytecode_function_t));
+    if (!function)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    function->node = node;
+    return function;
+}
+
+void bytecode_function_free(bytecode_function_t *function)
+{
+    if (!function) return;
+
+    for (size_t i = 0; i < function->function_count; i++)
+        bytecode_function_free(function->functions[i]);
+
+    /* strings in the pool belong to the AST */
+    free(function->code);
+    free(function->constants);
+    free(function->functions);
+    for (size_t i = 0; i < function->loop_count; i++)
+        trace_free(function->loops[i].trace);
+    free(function->loops);
+    jit_code_free(function->jit);
+    free(function);
+}
+
+size_t bytecode_emit(bytecode_function_t *function, bytecode_op_t op)
+{
+    size_t at = function->length;
+    size_t length = at + 1 + bytecode_operands[op] * sizeof(uint32_t);
+    function->code = bytecode_grow(function->code, &function->capacity, length, sizeof(uint8_t));
+
+    function->code[function->length++] = op;
+    return at;
+}
+
+void bytecode_emit_operand(bytecode_function_t *function, uint32_t operand)
+{
+    function->code = bytecode_grow(function->code, &function->capacity,
+        function->length + sizeof(operand), sizeof(uint8_t));
+
+    memcpy(function->code + function->length, &operand, sizeof(operand));
+    function->length += sizeof(operand);
+}
+
+void bytecode_patch_operand(bytecode_function_t *function, size_t at, uint32_t operand)
+{
+    assert(at + sizeof(operand) <= function->length);
+    memcpy(function->code + at, &operand, sizeof(operand));
+}
+
+uint32_t bytecode_add_constant(bytecode_function_t *function, value_t value)
+{
+    function->constants = bytecode_grow(function->constants, &function->constant_capacity,
+        function->constant_count + 1, sizeof(value_t));
+
+    function->constants[function->constant_count] = value;
+    return function->constant_count++;
+}
+
+uint32_t bytecode_add_function(bytecode_function_t *function, bytecode_function_t *nested)
+{
+    function->functions = bytecode_grow(function->functions, &function->function_capacity,
+        function->function_count + 1, sizeof(bytecode_function_t *));
+
+    function->functions[function->function_count] = nested;
+    return function->function_count++;
+}
+
+uint32_t bytecode_add_loop(bytecode_function_t *function)
+{
+    function->loops = bytecode_grow(function->loops, &function->loop_capacity,
+        function->loop_count + 1, sizeof(bytecode_loop_t));
+
+    function->loops[function->loop_count] = (bytecode_loop_t) { .countdown = TRACE_HOT_LOOP };
+    return function->loop_count++;
+}
@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "cache.h"
+
+#define CACHE_MAGIC "ROSEAST"
+
+/* bump when the serialized layout or the builtins change and `node_t` keeps its size */
+#define CACHE_FORMAT 7
+
+#define CACHE_ALIGNMENT 16
+#define CACHE_VERSION_LENGTH 16
+
+/*
+ * Pointers are stored as if the file was mapped at CACHE_BASE, which the
+ * loader asks for first. Mapped there, with every stored atom adopted by the
+ * atom table, a cached program is used as is without writing to it.
+ */
+#define CACHE_BASE ((uintptr_t) 0x3e0000000000ull)
+
+/* older systems take the address as a hint, a mapping elsewhere is patched */
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
+/* a relocation is the offset of a slot in the file, tagged with its kind */
+#define CACHE_RELOC_POINTER 0   /**< the slot points into the file */
+#define CACHE_RELOC_ATOM    1   /**< the slot points to an atom stored in the file */
+
+static_assert(sizeof(void *) == sizeof(uint64_t), "Cache slots assume 64-bit pointers");
+
+typedef struct cache_header
+{
+    char magic[8];
+    uint32_t format;
+
+    /* layout of the nodes, a different build misses the cache */
+    uint32_t node_size;
+    uint32_t node_count;
+    uint32_t token_count;
+    char version[CACHE_VERSION_LENGTH];
+
+    /* key, a hit is confirmed against the stored source */
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint64_t source;
+
+    /* file id stored in the locations */
+    uint32_t source_file;
+    uint32_t atom_count;
+
+    /* `cache_checksum` of the entry, taken with this field zero */
+    uint64_t checksum;
+
+    uint64_t size;
+    uint64_t program;
+
+    /* offsets of the stored atoms' text, ascending */
+    uint64_t atoms;
+
+    /* tagged slot offsets */
+    uint64_t relocs;
+    uint64_t reloc_count;
+
+    /* offsets of `loc.file` of every node, patched when the file id differs */
+    uint64_t file_relocs;
+    uint64_t file_reloc_count;
+} cache_header_t;
+
+uint64_t cache_hash(const char *data, size_t length)
+{
+    /* multiply and fold a word at a time, this keys a cache and is not a MAC */
+    const uint64_t k = 0x9e3779b97f4a7c15ull;
+    uint64_t hash = k ^ length;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 32;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    hash = (hash ^ tail) * k;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*
+ * Loaded nodes are used without being checked again, so a damaged entry has
+ * to be caught before any of it is trusted. Like the key, this is not a MAC.
+ */
+static uint64_t cache_checksum(const char *data, size_t size)
+{
+    cache_header_t header;
+    memcpy(&header, data, sizeof(header));
+    header.checksum = 0;
+
+    uint64_t hash = cache_hash((const char *) &header, sizeof(header));
+    return hash * 0x9e3779b97f4a7c15ull ^ cache_hash(data + sizeof(header), size - sizeof(header));
+}
+
+/* whether only this user can have written the file, entries are trusted as they are */
+static bool cache_private(const struct stat *st)
+{
+    return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+char *cache_path(const char *filename, uint64_t hash)
+{
+    const char *dir = getenv("ROSE_CACHE_DIR");
+
+    struct stat st;
+    if (dir && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || !cache_private(&st)))
+    {
+        fprintf(stderr, "ROSE_CACHE_DIR '%s' is not a directory only this user can write, not caching\n", dir);
+        return NULL;
+    }
+
+    size_t length = dir ? strlen(dir) + 1 + 16 + 4 : strlen(filename) + 4;
+    char *path = malloc(length + 1);
+    if (!path)
+    {
+        ERROR("Malloc failed!\n");
+        return NULL;
+    }
+
+    if (dir)
+        snprintf(path, length + 1, "%s/%016llx.ast", dir, (unsigned long long) hash);
+    else
+        snprintf(path, length + 1, "%s.ast", filename);
+    return path;
+}
+
+/* serialization */
+
+typedef struct cache_vector
+{
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} cache_vector_t;
+
+typedef struct cache_writer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+
+    cache_vector_t relocs;
+    cache_vector_t file_relocs;
+
+    /* atoms by index, stored after the nodes */
+    cache_vector_t atoms;
+
+    /* atom to index + 1, open addressing on the pointer */
+    atom_t *atom_keys;
+    uint32_t *atom_indices;
+    size_t atom_capacity;
+
+    /* set for trees which cannot be cached */
+    bool failed;
+} cache_writer_t;
+
+static void cache_vector_push(cache_vector_t *vector, uint64_t item)
+{
+    if (vector->count == vector->capacity)
+    {
+        vector->capacity = vector->capacity ? vector->capacity * 2 : 256;
+        vector->items = realloc(vector->items, vector->capacity * sizeof(uint64_t));
+        if (!vector->items)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    vector->items[vector->count++] = item;
+}
+
+/* zeroed and aligned room for `size` bytes, returns its offset */
+static uint64_t cache_reserve(cache_writer_t *writer, size_t size)
+{
+    size_t at = (writer->length + CACHE_ALIGNMENT - 1) & ~(size_t) (CACHE_ALIGNMENT - 1);
+
+    if (at + size > writer->capacity)
+    {
+        size_t capacity = writer->capacity ? writer->capacity : 64 * 1024;
+        while (at + size > capacity)
+            capacity *= 2;
+
+        writer->data = realloc(writer->data, capacity);
+        if (!writer->data)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        writer->capacity = capacity;
+    }
+
+    memset(writer->data + writer->length, 0, at + size - writer->length);
+    writer->length = at + size;
+    return at;
+}
+
+static uint64_t cache_write_bytes(cache_writer_t *writer, const void *data, size_t size)
+{
+    uint64_t at = cache_reserve(writer, size);
+    /* empty tables have no storage */
+    if (size) memcpy(writer->data + at, data, size);
+    return at;
+}
+
+/* offset 0 is the header, so it doubles as NULL until `cache_relocate` */
+static void cache_set_offset(cache_writer_t *writer, uint64_t slot, uint64_t target)
+{
+    memcpy(writer->data + slot, &target, sizeof(target));
+    if (target) cache_vector_push(&writer->relocs, slot << 1 | CACHE_RELOC_POINTER);
+}
+
+static uint32_t cache_atom_index(cache_writer_t *writer, atom_t atom)
+{
+    if (2 * (writer->atoms.count + 1) > writer->atom_capacity)
+    {
+        /* rehash at half load */
+        size_t capacity = writer->atom_capacity ? writer->atom_capacity * 2 : 1024;
+        atom_t *keys = calloc(capacity, sizeof(atom_t));
+        uint32_t *indices = calloc(capacity, sizeof(uint32_t));
+        if (!keys || !indices)
+        {
+            ERROR("Calloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < writer->atom_capacity; i++)
+        {
+            if (!writer->atom_keys[i]) continue;
+
+            size_t j = ((uintptr_t) writer->atom_keys[i] >> 4) & (capacity - 1);
+            while (keys[j]) j = (j + 1) & (capacity - 1);
+            keys[j] = writer->atom_keys[i];
+            indices[j] = writer->atom_indices[i];
+        }
+
+        free(writer->atom_keys);
+        free(writer->atom_indices);
+        writer->atom_keys = keys;
+        writer->atom_indices = indices;
+        writer->atom_capacity = capacity;
+    }
+
+    size_t mask = writer->atom_capacity - 1;
+    size_t i = ((uintptr_t) atom >> 4) & mask;
+    while (writer->atom_keys[i])
+    {
+        if (writer->atom_keys[i] == atom) return writer->atom_indices[i] - 1;
+        i = (i + 1) & mask;
+    }
+
+    uint32_t index = writer->atoms.count;
+    cache_vector_push(&writer->atoms, (uintptr_t) atom);
+
+    writer->atom_keys[i] = atom;
+    writer->atom_indices[i] = index + 1;
+    return index;
+}
+
+static void cache_set_atom(cache_writer_t *writer, uint64_t slot, atom_t atom)
+{
+    uint64_t index = atom ? cache_atom_index(writer, atom) : 0;
+    memcpy(writer->data + slot, &index, sizeof(index));
+    if (atom) cache_vector_push(&writer->relocs, slot << 1 | CACHE_RELOC_ATOM);
+}
+
+static uint64_t cache_write_string(cache_writer_t *writer, const char *string)
+{
+    return string ? cache_write_bytes(writer, string, strlen(string) + 1) : 0;
+}
+
+static uint64_t cache_write_strings(cache_writer_t *writer, char **strings, size_t count)
+{
+    if (!strings) return 0;
+
+    uint64_t at = cache_reserve(writer, count * sizeof(char *));
+    for (size_t i = 0; i < count; i++)
+        cache_set_offset(writer, at + i * sizeof(char *), cache_write_string(writer, strings[i]));
+    return at;
+}
+
+static uint64_t cache_write_atoms(cache_writer_t *writer, atom_t *atoms, size_t count)
+{
+    if (!atoms) return 0;
+
+    uint64_t at = cache_reserve(writer, count * sizeof(atom_t));
+    for (size_t i = 0; i < count; i++)
+        cache_set_atom(writer, at + i * sizeof(atom_t), atoms[i]);
+    return at;
+}
+
+static uint64_t cache_write_node(cache_writer_t *writer, node_t *node);
+
+static uint64_t cache_write_nodes(cache_writer_t *writer, node_t **nodes, size_t count)
+{
+    if (!nodes) return 0;
+
+    uint64_t at = cache_reserve(writer, count * sizeof(node_t *));
+    for (size_t i = 0; i < count; i++)
+        cache_set_offset(writer, at + i * sizeof(node_t *), cache_write_node(writer, nodes[i]));
+    return at;
+}
+
+static uint64_t cache_write_node(cache_writer_t *writer, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'cache_write_node'");
+
+    if (!node) return 0;
+
+    uint64_t at = cache_write_bytes(writer, node, node_size(node->type));
+    cache_vector_push(&writer->file_relocs, at + offsetof(node_t, loc.file));
+
+/* slot of a member of the node being written */
+#define SLOT(member) (at + offsetof(node_t, member))
+#define NODE(member) cache_set_offset(writer, SLOT(member), cache_write_node(writer, node->member))
+#define NODES(member, count) \
+    cache_set_offset(writer, SLOT(member), cache_write_nodes(writer, node->member, node->count))
+#define ATOM(member) cache_set_atom(writer, SLOT(member), node->member)
+
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+        case NODE_BOOL:
+        case NODE_UNDEFINED:
+        case NODE_NULL:
+        case NODE_THIS:
+        case NODE_DEBUGGER:
+        case NODE_EMPTY:
+            break;
+
+        case NODE_STRING:
+            cache_set_offset(writer, SLOT(string), cache_write_string(writer, node->string));
+            break;
+
+        case NODE_IDENTIFIER: ATOM(identifier); break;
+        case NODE_ARRAY: NODES(array.elements, array.count); break;
+
+        case NODE_OBJECT:
+            cache_set_offset(writer, SLOT(object.keys),
+                cache_write_atoms(writer, node->object.keys, node->object.count));
+            NODES(object.values, object.count);
+            break;
+
+        case NODE_SPREAD: NODE(spread.argument); break;
+        case NODE_PROGRAM: NODES(program.statements, program.count); break;
+        case NODE_BLOCK: NODES(block.statements, block.count); break;
+
+        case NODE_BINARY:
+            NODE(binary.left);
+            NODE(binary.right);
+            break;
+
+        case NODE_UNARY: NODE(unary.right); break;
+
+        case NODE_ASSIGNMENT:
+            NODE(assignment.target);
+            NODE(assignment.value);
+            break;
+
+        case NODE_TERNARY:
+            NODE(ternary.condition);
+            NODE(ternary.true_expr);
+            NODE(ternary.false_expr);
+            break;
+
+        case NODE_IF:
+            NODE(if_stmt.condition);
+            NODE(if_stmt.then_branch);
+            NODE(if_stmt.else_branch);
+            break;
+
+        case NODE_WHILE:
+            NODE(while_stmt.condition);
+            NODE(while_stmt.body);
+            break;
+
+        case NODE_DO_WHILE:
+            NODE(do_while_stmt.body);
+            NODE(do_while_stmt.condition);
+            break;
+
+        case NODE_FOR:
+            NODE(for_stmt.body);
+            NODE(for_stmt.init);
+            NODE(for_stmt.condition);
+            NODE(for_stmt.increment);
+            break;
+
+        case NODE_CALL:
+            NODE(call.callee);
+            NODES(call.args, call.arg_count);
+            break;
+
+        case NODE_INDEX:
+            NODE(index.array);
+            NODE(index.index);
+            break;
+
+        case NODE_MEMBER:
+            NODE(member.object);
+            NODE(member.property);
+            break;
+
+        case NODE_POSTFIX: NODE(postfix.left); break;
+
+        case NODE_FUNCTION:
+        {
+            /* lazily pre-parsed bodies need their parser */
+            if (!node->function.body) writer->failed = true;
+
+            ATOM(function.name);
+            NODE(function.body);
+
+            if (!node->function.params) break;
+
+            size_t size = sizeof(struct node_param);
+            uint64_t params = cache_write_bytes(writer, node->function.params, node->function.param_count * size);
+            for (size_t i = 0; i < node->function.param_count; i++)
+            {
+                struct node_param *param = &node->function.params[i];
+                cache_set_atom(writer, params + i * size + offsetof(struct node_param, name), param->name);
+                cache_set_offset(writer, params + i * size + offsetof(struct node_param, default_value),
+                    cache_write_node(writer, param->default_value));
+            }
+            cache_set_offset(writer, SLOT(function.params), params);
+            break;
+        }
+
+        case NODE_DECLARATION:
+            NODES(declaration.names, declaration.count);
+            NODES(declaration.values, declaration.count);
+            break;
+
+        case NODE_SWITCH:
+        {
+            NODE(switch_stmt.expr);
+
+            if (!node->switch_stmt.cases) break;
+
+            size_t size = sizeof(struct node_case);
+            uint64_t cases = cache_write_bytes(writer, node->switch_stmt.cases, node->switch_stmt.cases_count * size);
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+            {
+                struct node_case *c = &node->switch_stmt.cases[i];
+                cache_set_offset(writer, cases + i * size + offsetof(struct node_case, labels),
+                    cache_write_nodes(writer, c->labels, c->labels_count));
+                cache_set_offset(writer, cases + i * size + offsetof(struct node_case, body),
+                    cache_write_node(writer, c->body));
+            }
+            cache_set_offset(writer, SLOT(switch_stmt.cases), cases);
+            break;
+        }
+
+        case NODE_LABEL:
+            ATOM(label.name);
+            NODE(label.statement);
+            break;
+
+        case NODE_AWAIT: NODE(await_expr.argument); break;
+        case NODE_NEW: NODE(new_expr.argument); break;
+        case NODE_BREAK: ATOM(break_stmt.label); break;
+        case NODE_CONTINUE: ATOM(continue_stmt.label); break;
+        case NODE_THROW: NODE(throw_stmt.value); break;
+
+        case NODE_TRY:
+            NODE(try_stmt.try_block);
+            ATOM(try_stmt.catch_param);
+            NODE(try_stmt.catch_block);
+            NODE(try_stmt.finally_block);
+            break;
+
+        case NODE_RETURN: NODE(return_stmt.value); break;
+
+        case NODE_IMPORT:
+            cache_set_offset(writer, SLOT(import_stmt.module),
+                cache_write_string(writer, node->import_stmt.module));
+            cache_set_offset(writer, SLOT(import_stmt.default_name),
+                cache_write_string(writer, node->import_stmt.default_name));
+            cache_set_offset(writer, SLOT(import_stmt.imported),
+                cache_write_strings(writer, node->import_stmt.imported, node->import_stmt.named_count));
+            break;
+
+        case NODE_EXPORT:
+            NODE(export_stmt.declaration);
+            cache_set_offset(writer, SLOT(export_stmt.exported),
+                cache_write_strings(writer, node->export_stmt.exported, node->export_stmt.named_count));
+            break;
+
+        default:
+            UNREACHABLE;
+    }
+
+#undef SLOT
+#undef NODE
+#undef NODES
+#undef ATOM
+
+    return at;
+}
+
+static uint64_t cache_write_vector(cache_writer_t *writer, const cache_vector_t *vector)
+{
+    return cache_write_bytes(writer, vector->items, vector->count * sizeof(uint64_t));
+}
+
+/* stores the atoms together, replacing each by the offset of its text */
+static void cache_write_atom_texts(cache_writer_t *writer)
+{
+    for (size_t i = 0; i < writer->atoms.count; i++)
+    {
+        atom_t atom = (atom_t) (uintptr_t) writer->atoms.items[i];
+        uint64_t at = cache_reserve(writer, atom_storage_size(atom));
+        writer->atoms.items[i] = at + atom_store(writer->data + at, atom);
+    }
+}
+
+/* turns offsets and atom indices into addresses relative to CACHE_BASE */
+static void cache_relocate(cache_writer_t *writer)
+{
+    for (size_t i = 0; i < writer->relocs.count; i++)
+    {
+        uint64_t slot = writer->relocs.items[i] >> 1;
+
+        uint64_t value;
+        memcpy(&value, writer->data + slot, sizeof(value));
+
+        if ((writer->relocs.items[i] & 1) == CACHE_RELOC_ATOM)
+            value = writer->atoms.items[value];
+        value += CACHE_BASE;
+
+        memcpy(writer->data + slot, &value, sizeof(value));
+    }
+}
+
+bool cache_store(const char *path, source_id_t file, uint64_t hash, const char *version, node_t *program)
+{
+    const source_t *source = source_get(file);
+    if (!source || !program) return false;
+
+    cache_writer_t writer = {0};
+    cache_reserve(&writer, sizeof(cache_header_t));
+
+    cache_header_t header = {
+        .magic = CACHE_MAGIC,
+        .format = CACHE_FORMAT,
+        .node_size = sizeof(node_t),
+        .node_count = NODE_COUNT,
+        .token_count = TOKEN_COUNT,
+        .source_hash = hash,
+        .source_length = source->length,
+        .source_file = file,
+    };
+    strncpy(header.version, version, CACHE_VERSION_LENGTH - 1);
+
+    header.program = cache_write_node(&writer, program);
+    cache_write_atom_texts(&writer);
+    cache_relocate(&writer);
+
+    header.atom_count = writer.atoms.count;
+    header.atoms = cache_write_vector(&writer, &writer.atoms);
+    header.reloc_count = writer.relocs.count;
+    header.relocs = cache_write_vector(&writer, &writer.relocs);
+    header.file_reloc_count = writer.file_relocs.count;
+    header.file_relocs = cache_write_vector(&writer, &writer.file_relocs);
+    header.source = cache_write_bytes(&writer, source->data, source->length);
+    header.size = writer.length;
+    memcpy(writer.data, &header, sizeof(header));
+
+    header.checksum = cache_checksum(writer.data, writer.length);
+    memcpy(writer.data, &header, sizeof(header));
+
+    bool stored = false;
+    if (!writer.failed)
+    {
+        /* written aside and renamed, concurrent runs never see a partial file */
+        size_t length = strlen(path) + 32;
+        char *temp = malloc(length);
+        if (temp)
+        {
+            snprintf(temp, length, "%s.%ld.tmp", path, (long) getpid());
+
+            int fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+            FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+            if (fd >= 0 && !f) close(fd);
+            if (f)
+            {
+                stored = fwrite(writer.data, 1, writer.length, f) == writer.length;
+                stored = fclose(f) == 0 && stored;
+                stored = stored && rename(temp, path) == 0;
+                if (!stored) remove(temp);
+            }
+            free(temp);
+        }
+    }
+
+    free(writer.data);
+    free(writer.relocs.items);
+    free(writer.file_relocs.items);
+    free(writer.atoms.items);
+    free(writer.atom_keys);
+    free(writer.atom_indices);
+    return stored;
+}
+
+/* loading */
+
+static bool cache_in_bounds(const cache_header_t *header, uint64_t offset, uint64_t count, size_t size)
+{
+    return offset <= header->size && count <= (header->size - offset) / size;
+}
+
+static bool cache_valid(const cache_header_t *header, size_t size, const source_t *source,
+                        uint64_t hash, const char *version)
+{
+    return size >= sizeof(cache_header_t) &&
+           memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->format == CACHE_FORMAT &&
+           header->node_size == sizeof(node_t) &&
+           header->node_count == NODE_COUNT &&
+           header->token_count == TOKEN_COUNT &&
+           strncmp(header->version, version, CACHE_VERSION_LENGTH - 1) == 0 &&
+           header->size == size &&
+           header->source_length == source->length &&
+           header->source_hash == hash &&
+           cache_in_bounds(header, header->source, header->source_length, 1) &&
+           header->program && cache_in_bounds(header, header->program, 1, sizeof(node_t)) &&
+           cache_in_bounds(header, header->atoms, header->atom_count, sizeof(uint64_t)) &&
+           cache_in_bounds(header, header->relocs, header->reloc_count, sizeof(uint64_t)) &&
+           cache_in_bounds(header, header->file_relocs, header->file_reloc_count, sizeof(uint64_t));
+}
+
+/* index of the stored atom whose text is at `offset`, -1 if there is none */
+static ptrdiff_t cache_atom_search(const uint64_t *atoms, size_t count, uint64_t offset)
+{
+    size_t low = 0, high = count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (atoms[mid] < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low < count && atoms[low] == offset ? (ptrdiff_t) low : -1;
+}
+
+/*
+ * Checks the tables `cache_patch` and the file relocations use, before any
+ * atom of the mapping is adopted. A miss after that has to keep it mapped.
+ */
+static bool cache_check(const char *base, const cache_header_t *header)
+{
+    const uint64_t *stored = (const uint64_t *) (base + header->atoms);
+    const uint64_t *relocs = (const uint64_t *) (base + header->relocs);
+    const uint64_t *file_relocs = (const uint64_t *) (base + header->file_relocs);
+
+    for (size_t i = 0; i < header->atom_count; i++)
+    {
+        if (stored[i] < sizeof(cache_header_t) || stored[i] >= header->size ||
+            (i && stored[i] <= stored[i - 1])) return false;
+
+        const char *text = base + stored[i];
+        if (!cache_in_bounds(header, stored[i], atom_length(text) + 1, 1)) return false;
+    }
+
+    for (size_t i = 0; i < header->reloc_count; i++)
+    {
+        uint64_t slot = relocs[i] >> 1;
+        if (!cache_in_bounds(header, slot, 1, sizeof(uint64_t))) return false;
+
+        uint64_t value;
+        memcpy(&value, base + slot, sizeof(value));
+
+        uint64_t offset = value - CACHE_BASE;
+        if (offset >= header->size) return false;
+        if ((relocs[i] & 1) == CACHE_RELOC_ATOM && cache_atom_search(stored, header->atom_count, offset) < 0)
+            return false;
+    }
+
+    for (size_t i = 0; i < header->file_reloc_count; i++)
+        if (!cache_in_bounds(header, file_relocs[i], 1, sizeof(source_id_t))) return false;
+
+    return true;
+}
+
+/*
+ * Patches the slots a different base address or an already interned atom
+ * invalidates. `cache_check` passed, so this only fails for slots that
+ * overlap ones patched before.
+ */
+static bool cache_patch(char *base, const cache_header_t *header, const atom_t *atoms, bool moved)
+{
+    const uint64_t *stored = (const uint64_t *) (base + header->atoms);
+    const uint64_t *relocs = (const uint64_t *) (base + header->relocs);
+
+    for (size_t i = 0; i < header->reloc_count; i++)
+    {
+        uint64_t slot = relocs[i] >> 1;
+        if (!cache_in_bounds(header, slot, 1, sizeof(uint64_t))) return false;
+
+        uint64_t value;
+        memcpy(&value, base + slot, sizeof(value));
+
+        uint64_t offset = value - CACHE_BASE;
+        if (offset >= header->size) return false;
+
+        char *pointer = base + offset;
+        if ((relocs[i] & 1) == CACHE_RELOC_ATOM)
+        {
+            ptrdiff_t index = cache_atom_search(stored, header->atom_count, offset);
+            if (index < 0) return false;
+            pointer = (char *) atoms[index];
+        }
+        else if (!moved)
+        {
+            continue;
+        }
+
+        if ((uintptr_t) pointer != value)
+            memcpy(base + slot, &pointer, sizeof(pointer));
+    }
+
+    return true;
+}
+
+bool cache_load(cache_t *cache, const char *path, source_id_t file, uint64_t hash, const char *version)
+{
+    *cache = (cache_t) {0};
+
+    const source_t *source = source_get(file);
+    if (!source) return false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !cache_private(&st) ||
+        (size_t) st.st_size < sizeof(cache_header_t))
+    {
+        close(fd);
+        return false;
+    }
+
+    /*
+     * Private and writable: in the common case nothing is written, otherwise
+     * patching copies only the pages it touches.
+     */
+    size_t size = st.st_size;
+    char *base = mmap((void *) CACHE_BASE, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+    if (base == MAP_FAILED)
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    const cache_header_t *header = (const cache_header_t *) base;
+    atom_t *atoms = NULL;
+
+    if (!cache_valid(header, size, source, hash, version)) goto miss;
+    if (cache_checksum(base, size) != header->checksum) goto miss;
+    if (memcmp(base + header->source, source->data, source->length) != 0) goto miss;
+
+    atoms = malloc((header->atom_count + 1) * sizeof(atom_t));
+    if (!atoms) goto miss;
+
+    bool moved = (uintptr_t) base != CACHE_BASE;
+    bool adopted = true;
+
+    if (!cache_check(base, header)) goto miss;
+
+    const uint64_t *stored = (const uint64_t *) (base + header->atoms);
+    for (size_t i = 0; i < header->atom_count; i++)
+    {
+        const char *text = base + stored[i];
+        atoms[i] = atom_adopt(text);
+        adopted = adopted && atoms[i] == text;
+    }
+
+    /* adopted atoms point into the file, from here on it stays mapped */
+    if ((moved || !adopted) && !cache_patch(base, header, atoms, moved)) goto adopted_miss;
+
+    /* the source usually gets the same id as when the entry was written */
+    if (header->source_file != file)
+    {
+        const uint64_t *file_relocs = (const uint64_t *) (base + header->file_relocs);
+        for (size_t i = 0; i < header->file_reloc_count; i++)
+        {
+            if (!cache_in_bounds(header, file_relocs[i], 1, sizeof(source_id_t))) goto adopted_miss;
+            memcpy(base + file_relocs[i], &file, sizeof(file));
+        }
+    }
+
+    free(atoms);
+
+    cache->base = base;
+    cache->size = size;
+    cache->program = (node_t *) (base + header->program);
+    return true;
+
+adopted_miss:
+    free(atoms);
+    return false;
+
+miss:
+    free(atoms);
+    munmap(base, size);
+    return false;
+}
+
+void cache_free(cache_t *cache)
+{
+    if (cache->base) munmap(cache->base, cache->size);
+    *cache = (cache_t) {0};
+}
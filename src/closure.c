@@ -0,0 +1,1310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "closure.h"
+#include "runtime.h"
+
+#define CLOSURE_ERROR(...) \
+    do { \
+        ERROR(__VA_ARGS__); \
+        exit(EXIT_FAILURE); \
+    } while (0)
+
+#define CLOSURE_RUN(closure) ((closure)->handler(ctx, (closure)))
+
+#define CLOSURE_INT32(value) runtime_to_int32(runtime_to_number(value))
+
+/* a loop, switch or labeled statement that `break` can leave */
+typedef struct closure_target
+{
+    struct closure_target *enclosing;
+    atom_t label;
+    bool is_loop;           /**< `continue` applies to it */
+} closure_target_t;
+
+static bool closure_compile_function(closure_compiler_t *compiler, closure_function_t *function);
+
+/* the slot of a variable, for the handlers that are not specialized by binding */
+static value_t *closure_slot(closure_ctx_t *ctx, node_binding_t binding)
+{
+    if (binding.hops == NODE_HOPS_GLOBAL) return &ctx->globals->slots[binding.slot];
+    if (binding.hops == NODE_HOPS_LOCAL) return &ctx->frame[binding.slot];
+    return env_lookup(ctx->env, binding.hops, binding.slot);
+}
+
+/* expressions */
+
+static value_t closure_constant(closure_ctx_t *ctx, closure_t *closure)
+{
+    (void) ctx;
+    return closure->constant;
+}
+
+static value_t closure_get_local(closure_ctx_t *ctx, closure_t *closure)
+{
+    return ctx->frame[closure->binding.slot];
+}
+
+static value_t closure_get_global(closure_ctx_t *ctx, closure_t *closure)
+{
+    return ctx->globals->slots[closure->binding.slot];
+}
+
+static value_t closure_get_env(closure_ctx_t *ctx, closure_t *closure)
+{
+    return *env_lookup(ctx->env, closure->binding.hops, closure->binding.slot);
+}
+
+static value_t closure_get_callee(closure_ctx_t *ctx, closure_t *closure)
+{
+    (void) closure;
+    return ctx->callee;
+}
+
+#define CLOSURE_SET(name, slot) \
+    static value_t closure_set_##name(closure_ctx_t *ctx, closure_t *closure) \
+    { \
+        value_t value = CLOSURE_RUN(closure->store.value); \
+        return *(slot) = value; \
+    }
+
+CLOSURE_SET(local, &ctx->frame[closure->store.binding.slot])
+CLOSURE_SET(global, &ctx->globals->slots[closure->store.binding.slot])
+CLOSURE_SET(env, env_lookup(ctx->env, closure->store.binding.hops, closure->store.binding.slot))
+
+/* the old value of `x++` is converted too */
+#define CLOSURE_UPDATE(name, slot_address) \
+    static value_t closure_update_##name(closure_ctx_t *ctx, closure_t *closure) \
+    { \
+        value_t *slot = slot_address; \
+        number_t old = runtime_to_number(*slot); \
+        *slot = value_number(old + closure->store.delta); \
+        return closure->store.postfix ? value_number(old) : *slot; \
+    }
+
+CLOSURE_UPDATE(local, &ctx->frame[closure->store.binding.slot])
+CLOSURE_UPDATE(global, &ctx->globals->slots[closure->store.binding.slot])
+CLOSURE_UPDATE(env, env_lookup(ctx->env, closure->store.binding.hops, closure->store.binding.slot))
+
+#define CLOSURE_BINARY(name, expression) \
+    static value_t closure_##name(closure_ctx_t *ctx, closure_t *closure) \
+    { \
+        value_t left = CLOSURE_RUN(closure->operands.left); \
+        value_t right = CLOSURE_RUN(closure->operands.right); \
+        return expression; \
+    }
+
+/*
+ * Installs `handler`, or the payload it checks changed. Recursive calls
+ * that were running the node's old handler rewrite it again as they
+ * return, which only counts when it changes something.
+ */
+static void closure_rewrite(closure_ctx_t *ctx, closure_t *closure, closure_handler_t handler, bool changed)
+{
+    if (handler == closure->handler && !changed) return;
+
+    closure->handler = handler;
+    closure->rewrites++;
+    ctx->rewrites++;
+}
+
+/*
+ * Rewrites a binary node for the operand types it just saw. A node that
+ * keeps seeing new types settles on the generic handler.
+ */
+static value_t closure_respecialize(closure_ctx_t *ctx, closure_t *closure, value_t left, value_t right)
+{
+    const closure_specializations_t *specializations = closure->operands.specializations;
+
+    closure_handler_t handler = specializations->generic;
+    if (closure->rewrites < CLOSURE_REWRITES_LIMIT)
+    {
+        if (left.type == VALUE_NUMBER && right.type == VALUE_NUMBER)
+            handler = specializations->numbers;
+        else if (left.type == VALUE_STRING && right.type == VALUE_STRING && specializations->strings)
+            handler = specializations->strings;
+    }
+
+    closure_rewrite(ctx, closure, handler, false);
+    return specializations->apply(left, right);
+}
+
+CLOSURE_BINARY(binary_uninitialized, closure_respecialize(ctx, closure, left, right))
+
+/* operands sema proved numbers */
+CLOSURE_BINARY(add_num_num, value_number(left.number + right.number))
+CLOSURE_BINARY(sub_num_num, value_number(left.number - right.number))
+CLOSURE_BINARY(mul_num_num, value_number(left.number * right.number))
+CLOSURE_BINARY(div_num_num, value_number(left.number / right.number))
+CLOSURE_BINARY(lt_num_num, value_bool(left.number < right.number))
+CLOSURE_BINARY(gt_num_num, value_bool(left.number > right.number))
+CLOSURE_BINARY(le_num_num, value_bool(left.number <= right.number))
+CLOSURE_BINARY(ge_num_num, value_bool(left.number >= right.number))
+
+/* the generic handler and the one for the numbers seen so far */
+#define CLOSURE_OPERATOR(name, generic_expression, number_expression) \
+    static value_t closure_apply_##name(value_t left, value_t right) \
+    { \
+        return generic_expression; \
+    } \
+    CLOSURE_BINARY(name##_generic, closure_apply_##name(left, right)) \
+    CLOSURE_BINARY(name##_numbers, left.type == VALUE_NUMBER && right.type == VALUE_NUMBER \
+        ? number_expression : closure_respecialize(ctx, closure, left, right))
+
+#define CLOSURE_STRINGS(name, string_expression) \
+    CLOSURE_BINARY(name##_strings, left.type == VALUE_STRING && right.type == VALUE_STRING \
+        ? string_expression : closure_respecialize(ctx, closure, left, right))
+
+#define CLOSURE_SPECIALIZATIONS(name, strings) \
+    static const closure_specializations_t closure_##name##_specializations = { \
+        closure_##name##_numbers, strings, closure_##name##_generic, closure_apply_##name \
+    };
+
+#define CLOSURE_NUMBER(value) runtime_to_number(value)
+#define CLOSURE_COMPARE(left, right) strcmp((left).string, (right).string)
+
+CLOSURE_OPERATOR(add, runtime_add(left, right), value_number(left.number + right.number))
+CLOSURE_OPERATOR(sub, value_number(CLOSURE_NUMBER(left) - CLOSURE_NUMBER(right)), value_number(left.number - right.number))
+CLOSURE_OPERATOR(mul, value_number(CLOSURE_NUMBER(left) * CLOSURE_NUMBER(right)), value_number(left.number * right.number))
+CLOSURE_OPERATOR(div, value_number(CLOSURE_NUMBER(left) / CLOSURE_NUMBER(right)), value_number(left.number / right.number))
+CLOSURE_OPERATOR(mod, value_number(fmodl(CLOSURE_NUMBER(left), CLOSURE_NUMBER(right))), value_number(fmodl(left.number, right.number)))
+CLOSURE_OPERATOR(pow, value_number(powl(CLOSURE_NUMBER(left), CLOSURE_NUMBER(right))), value_number(powl(left.number, right.number)))
+CLOSURE_OPERATOR(bit_and,
+    value_number((number_t) (CLOSURE_INT32(left) & CLOSURE_INT32(right))),
+    value_number((number_t) (runtime_to_int32(left.number) & runtime_to_int32(right.number))))
+CLOSURE_OPERATOR(bit_or,
+    value_number((number_t) (CLOSURE_INT32(left) | CLOSURE_INT32(right))),
+    value_number((number_t) (runtime_to_int32(left.number) | runtime_to_int32(right.number))))
+CLOSURE_OPERATOR(bit_xor,
+    value_number((number_t) (CLOSURE_INT32(left) ^ CLOSURE_INT32(right))),
+    value_number((number_t) (runtime_to_int32(left.number) ^ runtime_to_int32(right.number))))
+CLOSURE_OPERATOR(shl,
+    value_number((number_t) (int32_t) ((uint32_t) CLOSURE_INT32(left) << (CLOSURE_INT32(right) & 31))),
+    value_number((number_t) (int32_t) ((uint32_t) runtime_to_int32(left.number) << (runtime_to_int32(right.number) & 31))))
+CLOSURE_OPERATOR(shr,
+    value_number((number_t) (CLOSURE_INT32(left) >> (CLOSURE_INT32(right) & 31))),
+    value_number((number_t) (runtime_to_int32(left.number) >> (runtime_to_int32(right.number) & 31))))
+CLOSURE_OPERATOR(eq, value_bool(runtime_equals(left, right)), value_bool(left.number == right.number))
+CLOSURE_OPERATOR(ne, value_bool(!runtime_equals(left, right)), value_bool(left.number != right.number))
+CLOSURE_OPERATOR(lt, value_bool(runtime_less(left, right, false)), value_bool(left.number < right.number))
+CLOSURE_OPERATOR(gt, value_bool(runtime_less(right, left, false)), value_bool(left.number > right.number))
+CLOSURE_OPERATOR(le, value_bool(runtime_less(left, right, true)), value_bool(left.number <= right.number))
+CLOSURE_OPERATOR(ge, value_bool(runtime_less(right, left, true)), value_bool(left.number >= right.number))
+
+CLOSURE_STRINGS(add, runtime_concat(left, right))
+CLOSURE_STRINGS(eq, value_bool(CLOSURE_COMPARE(left, right) == 0))
+CLOSURE_STRINGS(ne, value_bool(CLOSURE_COMPARE(left, right) != 0))
+CLOSURE_STRINGS(lt, value_bool(CLOSURE_COMPARE(left, right) < 0))
+CLOSURE_STRINGS(gt, value_bool(CLOSURE_COMPARE(left, right) > 0))
+CLOSURE_STRINGS(le, value_bool(CLOSURE_COMPARE(left, right) <= 0))
+CLOSURE_STRINGS(ge, value_bool(CLOSURE_COMPARE(left, right) >= 0))
+
+CLOSURE_SPECIALIZATIONS(add, closure_add_strings)
+CLOSURE_SPECIALIZATIONS(sub, NULL)
+CLOSURE_SPECIALIZATIONS(mul, NULL)
+CLOSURE_SPECIALIZATIONS(div, NULL)
+CLOSURE_SPECIALIZATIONS(mod, NULL)
+CLOSURE_SPECIALIZATIONS(pow, NULL)
+CLOSURE_SPECIALIZATIONS(bit_and, NULL)
+CLOSURE_SPECIALIZATIONS(bit_or, NULL)
+CLOSURE_SPECIALIZATIONS(bit_xor, NULL)
+CLOSURE_SPECIALIZATIONS(shl, NULL)
+CLOSURE_SPECIALIZATIONS(shr, NULL)
+CLOSURE_SPECIALIZATIONS(eq, closure_eq_strings)
+CLOSURE_SPECIALIZATIONS(ne, closure_ne_strings)
+CLOSURE_SPECIALIZATIONS(lt, closure_lt_strings)
+CLOSURE_SPECIALIZATIONS(gt, closure_gt_strings)
+CLOSURE_SPECIALIZATIONS(le, closure_le_strings)
+CLOSURE_SPECIALIZATIONS(ge, closure_ge_strings)
+
+/* `a && b` is `a` when that decides it and `b` otherwise */
+static value_t closure_and(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t left = CLOSURE_RUN(closure->operands.left);
+    return runtime_truthy(left) ? CLOSURE_RUN(closure->operands.right) : left;
+}
+
+static value_t closure_or(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t left = CLOSURE_RUN(closure->operands.left);
+    return runtime_truthy(left) ? left : CLOSURE_RUN(closure->operands.right);
+}
+
+#define CLOSURE_UNARY(name, expression) \
+    static value_t closure_##name(closure_ctx_t *ctx, closure_t *closure) \
+    { \
+        value_t right = CLOSURE_RUN(closure->operands.right); \
+        return expression; \
+    }
+
+CLOSURE_UNARY(negate, value_number(-runtime_to_number(right)))
+CLOSURE_UNARY(to_number, value_number(runtime_to_number(right)))
+CLOSURE_UNARY(bit_not, value_number((number_t) ~CLOSURE_INT32(right)))
+CLOSURE_UNARY(not, value_bool(!runtime_truthy(right)))
+CLOSURE_UNARY(typeof, ((value_t) { .type = VALUE_STRING, .string = (char *) runtime_typeof(right) }))
+CLOSURE_UNARY(void, ((void) right, value_undefined()))
+
+static value_t closure_ternary(closure_ctx_t *ctx, closure_t *closure)
+{
+    return runtime_truthy(CLOSURE_RUN(closure->branch.condition))
+        ? CLOSURE_RUN(closure->branch.then)
+        : CLOSURE_RUN(closure->branch.otherwise);
+}
+
+static value_t closure_member(closure_ctx_t *ctx, closure_t *closure)
+{
+    return runtime_member(CLOSURE_RUN(closure->member.object), closure->member.name);
+}
+
+static value_t closure_member_cached(closure_ctx_t *ctx, closure_t *closure);
+
+/* objects have no shapes, the index where the name was found is the cache */
+static value_t closure_member_respecialize(closure_ctx_t *ctx, closure_t *closure, value_t object)
+{
+    closure_handler_t handler = closure_member;
+    size_t index = closure->member.index;
+    if (object.type == VALUE_OBJECT && closure->rewrites < CLOSURE_REWRITES_LIMIT)
+    {
+        for (size_t i = 0; i < object.object.count; i++)
+        {
+            if (object.object.keys[i] != closure->member.name) continue;
+
+            handler = closure_member_cached;
+            closure->member.index = i;
+            break;
+        }
+    }
+
+    closure_rewrite(ctx, closure, handler, closure->member.index != index);
+    return runtime_member(object, closure->member.name);
+}
+
+static value_t closure_member_uninitialized(closure_ctx_t *ctx, closure_t *closure)
+{
+    return closure_member_respecialize(ctx, closure, CLOSURE_RUN(closure->member.object));
+}
+
+static value_t closure_member_cached(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t object = CLOSURE_RUN(closure->member.object);
+    size_t index = closure->member.index;
+    if (object.type == VALUE_OBJECT && index < object.object.count && object.object.keys[index] == closure->member.name)
+        return object.object.values[index];
+    return closure_member_respecialize(ctx, closure, object);
+}
+
+static value_t closure_make_function(closure_ctx_t *ctx, closure_t *closure)
+{
+    function_t *function = malloc(sizeof(function_t));
+    if (!function)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node_t *node = closure->function->node;
+    function->is_native = false;
+    function->user.param_count = node->function.param_count;
+    function->user.param_names = NULL;
+    function->user.body = node->function.body;
+    function->user.closure = ctx->env;
+    function->user.code = NULL;
+    function->user.closures = closure->function;
+    return value_function(function);
+}
+
+/*
+ * The arguments are the first slots of the callee's frame, which starts
+ * where the caller evaluated them. A tail call in the body replaces the
+ * callee and its arguments, and runs in the same C frame. `function` is
+ * the callee's compiled code when the call site has checked it already.
+ */
+static value_t closure_invoke(closure_ctx_t *ctx, value_t callee, closure_function_t *function,
+                              value_t *args, uint32_t argc)
+{
+    value_t *frame = ctx->frame;
+    env_t *env = ctx->env;
+    value_t caller = ctx->callee;
+    size_t top = args - ctx->stack.values;
+
+    if (++ctx->depth > CLOSURE_CALLS_CAPACITY)
+        CLOSURE_ERROR("Stack overflow, %zu calls deep\n", ctx->depth - 1);
+
+    value_t result = value_undefined();
+    for (;;)
+    {
+        if (!function)
+        {
+            if (callee.type != VALUE_FUNCTION)
+                CLOSURE_ERROR("TypeError: %s is not a function\n", runtime_typeof(callee));
+
+            if (callee.function->is_native)
+            {
+                result = callee.function->native_ptr(NULL, argc, args);
+                break;
+            }
+
+            function = callee.function->user.closures;
+            if (!function->body && !closure_compile_function(ctx->compiler, function))
+                exit(EXIT_FAILURE);
+        }
+
+        ctx->stack.top = top + argc;
+        if (function->frame_size > argc)
+            value_stack_push_frame(&ctx->stack, function->frame_size - argc);
+        for (uint32_t i = function->param_count; i < argc && i < function->frame_size; i++)
+            args[i] = value_undefined();
+
+        ctx->frame = args;
+        ctx->env = callee.function->user.closure;
+        if (function->env_size)
+            ctx->env = env_enter_scope(ctx->env, function->env_size);
+        ctx->callee = callee;
+
+        CLOSURE_RUN(function->body);
+        if (ctx->completion != CLOSURE_TAIL_CALL)
+        {
+            if (ctx->completion == CLOSURE_RETURN)
+                result = ctx->result;
+            break;
+        }
+
+        callee = ctx->tail_callee;
+        function = NULL;
+        argc = ctx->tail_argc;
+        memmove(args, ctx->tail_args, argc * sizeof(value_t));
+        ctx->completion = CLOSURE_NORMAL;
+    }
+
+    ctx->completion = CLOSURE_NORMAL;
+    ctx->stack.top = top;
+    ctx->frame = frame;
+    ctx->env = env;
+    ctx->callee = caller;
+    ctx->depth--;
+    return result;
+}
+
+/* evaluates the arguments at the top of the stack */
+static value_t *closure_args(closure_ctx_t *ctx, closure_t *closure)
+{
+    uint32_t argc = closure->call.argc;
+    value_t *args = value_stack_push_frame(&ctx->stack, argc);
+    for (uint32_t i = 0; i < argc; i++)
+    {
+        value_t arg = CLOSURE_RUN(closure->call.args[i]);
+        args[i] = arg;
+    }
+    return args;
+}
+
+static value_t closure_call(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t callee = CLOSURE_RUN(closure->call.callee);
+    value_t *args = closure_args(ctx, closure);
+    return closure_invoke(ctx, callee, NULL, args, closure->call.argc);
+}
+
+static value_t closure_call_native(closure_ctx_t *ctx, closure_t *closure);
+static value_t closure_call_function(closure_ctx_t *ctx, closure_t *closure);
+
+/* rewrites a call for the kind of callee it just saw, then makes the call */
+static value_t closure_call_respecialize(closure_ctx_t *ctx, closure_t *closure, value_t callee)
+{
+    closure_handler_t handler = closure_call;
+    closure_function_t *target = closure->call.target;
+    if (callee.type == VALUE_FUNCTION && closure->rewrites < CLOSURE_REWRITES_LIMIT)
+    {
+        handler = callee.function->is_native ? closure_call_native : closure_call_function;
+        if (!callee.function->is_native)
+            closure->call.target = callee.function->user.closures;
+    }
+
+    closure_rewrite(ctx, closure, handler, closure->call.target != target);
+
+    value_t *args = closure_args(ctx, closure);
+    return closure_invoke(ctx, callee, NULL, args, closure->call.argc);
+}
+
+static value_t closure_call_uninitialized(closure_ctx_t *ctx, closure_t *closure)
+{
+    return closure_call_respecialize(ctx, closure, CLOSURE_RUN(closure->call.callee));
+}
+
+static value_t closure_call_native(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t callee = CLOSURE_RUN(closure->call.callee);
+    if (callee.type != VALUE_FUNCTION || !callee.function->is_native)
+        return closure_call_respecialize(ctx, closure, callee);
+
+    value_t *args = closure_args(ctx, closure);
+    value_t result = callee.function->native_ptr(NULL, closure->call.argc, args);
+    ctx->stack.top = args - ctx->stack.values;
+    return result;
+}
+
+/* the callee runs the code it ran last time, possibly with another env */
+static value_t closure_call_function(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t callee = CLOSURE_RUN(closure->call.callee);
+    if (callee.type != VALUE_FUNCTION || callee.function->is_native ||
+        callee.function->user.closures != closure->call.target)
+        return closure_call_respecialize(ctx, closure, callee);
+
+    value_t *args = closure_args(ctx, closure);
+    return closure_invoke(ctx, callee, closure->call.target, args, closure->call.argc);
+}
+
+/* `closure_invoke` makes the call once the body has returned */
+static value_t closure_tail_call(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t callee = CLOSURE_RUN(closure->call.callee);
+    value_t *args = closure_args(ctx, closure);
+
+    ctx->tail_callee = callee;
+    ctx->tail_args = args;
+    ctx->tail_argc = closure->call.argc;
+    ctx->completion = CLOSURE_TAIL_CALL;
+    return value_undefined();
+}
+
+/* statements */
+
+static value_t closure_nop(closure_ctx_t *ctx, closure_t *closure)
+{
+    (void) ctx;
+    (void) closure;
+    return value_undefined();
+}
+
+static value_t closure_param(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t *slot = closure_slot(ctx, closure->param.binding);
+    if (closure->param.binding.hops != NODE_HOPS_LOCAL)
+        *slot = ctx->frame[closure->param.index];
+
+    if (closure->param.default_value && slot->type == VALUE_UNDEFINED)
+    {
+        value_t value = CLOSURE_RUN(closure->param.default_value);
+        *closure_slot(ctx, closure->param.binding) = value;
+    }
+    return value_undefined();
+}
+
+static value_t closure_block(closure_ctx_t *ctx, closure_t *closure)
+{
+    for (size_t i = 0; i < closure->block.count; i++)
+    {
+        CLOSURE_RUN(closure->block.statements[i]);
+        if (ctx->completion) break;
+    }
+    return value_undefined();
+}
+
+static value_t closure_scope(closure_ctx_t *ctx, closure_t *closure)
+{
+    env_t *env = ctx->env;
+    ctx->env = env_enter_scope(env, closure->block.env_size);
+    closure_block(ctx, closure);
+    ctx->env = env;
+    return value_undefined();
+}
+
+static value_t closure_labeled(closure_ctx_t *ctx, closure_t *closure)
+{
+    CLOSURE_RUN(closure->labeled.body);
+    if (ctx->completion == CLOSURE_BREAK && ctx->label == closure->labeled.label)
+        ctx->completion = CLOSURE_NORMAL;
+    return value_undefined();
+}
+
+static value_t closure_if(closure_ctx_t *ctx, closure_t *closure)
+{
+    if (runtime_truthy(CLOSURE_RUN(closure->branch.condition)))
+        CLOSURE_RUN(closure->branch.then);
+    else if (closure->branch.otherwise)
+        CLOSURE_RUN(closure->branch.otherwise);
+    return value_undefined();
+}
+
+/* whether a loop stops after a body that did not complete normally */
+static bool closure_loop_stops(closure_ctx_t *ctx, atom_t label)
+{
+    if (ctx->completion != CLOSURE_BREAK && ctx->completion != CLOSURE_CONTINUE)
+        return true;
+
+    /* aimed at an enclosing statement */
+    if (ctx->label && ctx->label != label)
+        return true;
+
+    bool stops = ctx->completion == CLOSURE_BREAK;
+    ctx->completion = CLOSURE_NORMAL;
+    return stops;
+}
+
+static value_t closure_while(closure_ctx_t *ctx, closure_t *closure)
+{
+    while (runtime_truthy(CLOSURE_RUN(closure->loop.condition)))
+    {
+        CLOSURE_RUN(closure->loop.body);
+        if (ctx->completion && closure_loop_stops(ctx, closure->loop.label))
+            break;
+    }
+    return value_undefined();
+}
+
+static value_t closure_do_while(closure_ctx_t *ctx, closure_t *closure)
+{
+    do
+    {
+        CLOSURE_RUN(closure->loop.body);
+        if (ctx->completion && closure_loop_stops(ctx, closure->loop.label))
+            break;
+    }
+    while (runtime_truthy(CLOSURE_RUN(closure->loop.condition)));
+    return value_undefined();
+}
+
+/* captured loop variables are copied to a new env for each iteration */
+static value_t closure_for(closure_ctx_t *ctx, closure_t *closure)
+{
+    env_t *env = ctx->env;
+    uint32_t env_size = closure->loop.env_size;
+    if (env_size)
+        ctx->env = env_enter_scope(env, env_size);
+
+    if (closure->loop.init)
+        CLOSURE_RUN(closure->loop.init);
+
+    while (!closure->loop.condition || runtime_truthy(CLOSURE_RUN(closure->loop.condition)))
+    {
+        CLOSURE_RUN(closure->loop.body);
+        if (ctx->completion && closure_loop_stops(ctx, closure->loop.label))
+            break;
+
+        if (env_size)
+        {
+            env_t *copy = env_enter_scope(env, env_size);
+            memcpy(copy->slots, ctx->env->slots, env_size * sizeof(value_t));
+            ctx->env = copy;
+        }
+        if (closure->loop.update)
+            CLOSURE_RUN(closure->loop.update);
+    }
+
+    ctx->env = env;
+    return value_undefined();
+}
+
+static value_t closure_switch(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t value = CLOSURE_RUN(closure->cases.value);
+
+    size_t start = closure->cases.fallback;
+    for (size_t i = 0; i < closure->cases.label_count; i++)
+    {
+        if (runtime_strict_equals(value, CLOSURE_RUN(closure->cases.labels[i])))
+        {
+            start = closure->cases.label_cases[i];
+            break;
+        }
+    }
+
+    for (size_t i = start; i < closure->cases.count; i++)
+    {
+        CLOSURE_RUN(closure->cases.bodies[i]);
+        if (ctx->completion) break;
+    }
+
+    if (ctx->completion == CLOSURE_BREAK && (!ctx->label || ctx->label == closure->cases.label))
+        ctx->completion = CLOSURE_NORMAL;
+    return value_undefined();
+}
+
+static value_t closure_break(closure_ctx_t *ctx, closure_t *closure)
+{
+    ctx->completion = CLOSURE_BREAK;
+    ctx->label = closure->label;
+    return value_undefined();
+}
+
+static value_t closure_continue(closure_ctx_t *ctx, closure_t *closure)
+{
+    ctx->completion = CLOSURE_CONTINUE;
+    ctx->label = closure->label;
+    return value_undefined();
+}
+
+/* a tail call in the value has already set the completion */
+static value_t closure_return(closure_ctx_t *ctx, closure_t *closure)
+{
+    value_t value = closure->value ? CLOSURE_RUN(closure->value) : value_undefined();
+    if (ctx->completion == CLOSURE_TAIL_CALL) return value_undefined();
+
+    ctx->result = value;
+    ctx->completion = CLOSURE_RETURN;
+    return value_undefined();
+}
+
+/* compiling */
+
+void closure_compiler_init(closure_compiler_t *compiler, parser_t *parser, sema_t *sema)
+{
+    *compiler = (closure_compiler_t) {0};
+    compiler->parser = parser;
+    compiler->sema = sema;
+    arena_init(&compiler->arena);
+}
+
+void closure_compiler_free(closure_compiler_t *compiler)
+{
+    if (!compiler) return;
+    arena_free(&compiler->arena);
+}
+
+static void closure_unsupported(closure_compiler_t *compiler, node_t *node)
+{
+    CLOSURE_COMPILER_ERROR(compiler,
+        "[ERROR] [%s:%zu:%zu]: %s is not supported by the closure compiler\n",
+        LOCATION(node->loc), node_type_to_string(node->type));
+}
+
+static closure_t *closure_new(closure_compiler_t *compiler, node_t *node, closure_handler_t handler)
+{
+    closure_t *closure = arena_alloc(&compiler->arena, sizeof(closure_t));
+    closure->handler = handler;
+    closure->node = node;
+    compiler->closure_count++;
+    return closure;
+}
+
+static closure_t **closure_array(closure_compiler_t *compiler, size_t count)
+{
+    return arena_alloc(&compiler->arena, count * sizeof(closure_t *));
+}
+
+static closure_t *closure_compile_expression(closure_compiler_t *compiler, node_t *node);
+static closure_t *closure_compile_statement(closure_compiler_t *compiler, node_t *node);
+
+static closure_t *closure_compile_get(closure_compiler_t *compiler, node_t *node, node_binding_t binding)
+{
+    closure_t *closure = closure_new(compiler, node,
+        binding.hops == NODE_HOPS_GLOBAL ? closure_get_global :
+        binding.hops == NODE_HOPS_LOCAL ? closure_get_local : closure_get_env);
+    closure->binding = binding;
+    return closure;
+}
+
+static closure_t *closure_compile_set(closure_compiler_t *compiler, node_t *node, node_binding_t binding, closure_t *value)
+{
+    closure_t *closure = closure_new(compiler, node,
+        binding.hops == NODE_HOPS_GLOBAL ? closure_set_global :
+        binding.hops == NODE_HOPS_LOCAL ? closure_set_local : closure_set_env);
+    closure->store.binding = binding;
+    closure->store.value = value;
+    return closure;
+}
+
+/* the handlers a binary node rewrites itself between, NULL for operators without them */
+static const closure_specializations_t *closure_binary_specializations(node_op_t op)
+{
+    switch (op)
+    {
+        case TOKEN_PLUS:            return &closure_add_specializations;
+        case TOKEN_MINUS:           return &closure_sub_specializations;
+        case TOKEN_STAR:            return &closure_mul_specializations;
+        case TOKEN_SLASH:           return &closure_div_specializations;
+        case TOKEN_PERCENT:         return &closure_mod_specializations;
+        case TOKEN_STAR_STAR:       return &closure_pow_specializations;
+        case TOKEN_AMPERSAND:       return &closure_bit_and_specializations;
+        case TOKEN_PIPE:            return &closure_bit_or_specializations;
+        case TOKEN_CARET:           return &closure_bit_xor_specializations;
+        case TOKEN_LEFT_SHIFT:      return &closure_shl_specializations;
+        case TOKEN_RIGHT_SHIFT:     return &closure_shr_specializations;
+        case TOKEN_EQUAL_EQUAL:     return &closure_eq_specializations;
+        case TOKEN_BANG_EQUAL:      return &closure_ne_specializations;
+        case TOKEN_LESS:            return &closure_lt_specializations;
+        case TOKEN_GREATER:         return &closure_gt_specializations;
+        case TOKEN_LESS_EQUAL:      return &closure_le_specializations;
+        case TOKEN_GREATER_EQUAL:   return &closure_ge_specializations;
+        default:                    return NULL;
+    }
+}
+
+/* the handler of an operator whose operands sema proved numbers, NULL if there is none */
+static closure_handler_t closure_binary_proved(node_op_t op)
+{
+    switch (op)
+    {
+        case TOKEN_PLUS:            return closure_add_num_num;
+        case TOKEN_MINUS:           return closure_sub_num_num;
+        case TOKEN_STAR:            return closure_mul_num_num;
+        case TOKEN_SLASH:           return closure_div_num_num;
+        case TOKEN_LESS:            return closure_lt_num_num;
+        case TOKEN_GREATER:         return closure_gt_num_num;
+        case TOKEN_LESS_EQUAL:      return closure_le_num_num;
+        case TOKEN_GREATER_EQUAL:   return closure_ge_num_num;
+        default:                    return NULL;
+    }
+}
+
+/* the binary operator of a compound assignment */
+static node_op_t closure_compound_op(node_op_t op)
+{
+    switch (op)
+    {
+        case TOKEN_PLUS_EQUAL:          return TOKEN_PLUS;
+        case TOKEN_MINUS_EQUAL:         return TOKEN_MINUS;
+        case TOKEN_STAR_EQUAL:          return TOKEN_STAR;
+        case TOKEN_SLASH_EQUAL:         return TOKEN_SLASH;
+        case TOKEN_PERCENT_EQUAL:       return TOKEN_PERCENT;
+        case TOKEN_STAR_STAR_EQUAL:     return TOKEN_STAR_STAR;
+        case TOKEN_AMPERSAND_EQUAL:     return TOKEN_AMPERSAND;
+        case TOKEN_PIPE_EQUAL:          return TOKEN_PIPE;
+        case TOKEN_CARET_EQUAL:         return TOKEN_CARET;
+        case TOKEN_LEFT_SHIFT_EQUAL:    return TOKEN_LEFT_SHIFT;
+        case TOKEN_RIGHT_SHIFT_EQUAL:   return TOKEN_RIGHT_SHIFT;
+        case TOKEN_LOGICAL_AND_EQUAL:   return TOKEN_LOGICAL_AND;
+        case TOKEN_LOGICAL_OR_EQUAL:    return TOKEN_LOGICAL_OR;
+        default:                        return TOKEN_UNKNOWN;
+    }
+}
+
+static bool closure_numbers(const node_t *left, const node_t *right)
+{
+    return left->flags & right->flags & NODE_FLAG_NUMBER;
+}
+
+static closure_t *closure_compile_binary(closure_compiler_t *compiler, node_t *node, node_op_t op,
+                                         node_t *left, closure_t *left_closure, node_t *right)
+{
+    /* other operators start uninitialized and specialize once they run */
+    const closure_specializations_t *specializations = closure_binary_specializations(op);
+    closure_handler_t handler = closure_numbers(left, right) ? closure_binary_proved(op) : NULL;
+    if (op == TOKEN_LOGICAL_AND || op == TOKEN_LOGICAL_OR)
+        handler = op == TOKEN_LOGICAL_AND ? closure_and : closure_or;
+    else if (!handler && specializations)
+        handler = closure_binary_uninitialized;
+
+    if (!handler)
+    {
+        CLOSURE_COMPILER_ERROR(compiler,
+            "[ERROR] [%s:%zu:%zu]: '%s' is not supported by the closure compiler\n",
+            LOCATION(node->loc), token_type_to_lexeme(op));
+        return closure_new(compiler, node, closure_constant);
+    }
+
+    closure_t *closure = closure_new(compiler, node, handler);
+    closure->operands.left = left_closure;
+    closure->operands.right = closure_compile_expression(compiler, right);
+    closure->operands.specializations = specializations;
+    return closure;
+}
+
+/* `++x`, `x--` and the like */
+static closure_t *closure_compile_update(closure_compiler_t *compiler, node_t *node, node_t *target, bool postfix)
+{
+    if (target->type != NODE_IDENTIFIER)
+    {
+        closure_unsupported(compiler, target);
+        return closure_new(compiler, node, closure_constant);
+    }
+
+    node_binding_t binding = target->binding;
+    closure_t *closure = closure_new(compiler, node,
+        binding.hops == NODE_HOPS_GLOBAL ? closure_update_global :
+        binding.hops == NODE_HOPS_LOCAL ? closure_update_local : closure_update_env);
+    closure->store.binding = binding;
+    closure->store.delta = node->op == TOKEN_PLUS_PLUS ? 1 : -1;
+    closure->store.postfix = postfix;
+    return closure;
+}
+
+static closure_t *closure_compile_unary(closure_compiler_t *compiler, node_t *node)
+{
+    closure_handler_t handler;
+    switch (node->op)
+    {
+        case TOKEN_PLUS_PLUS:
+        case TOKEN_MINUS_MINUS:
+            return closure_compile_update(compiler, node, node->unary.right, false);
+
+        case TOKEN_MINUS: handler = closure_negate; break;
+        case TOKEN_PLUS: handler = closure_to_number; break;
+        case TOKEN_TILDE: handler = closure_bit_not; break;
+        case TOKEN_BANG: handler = closure_not; break;
+        case TOKEN_TYPEOF: handler = closure_typeof; break;
+        case TOKEN_VOID: handler = closure_void; break;
+
+        default:
+            CLOSURE_COMPILER_ERROR(compiler,
+                "[ERROR] [%s:%zu:%zu]: '%s' is not supported by the closure compiler\n",
+                LOCATION(node->loc), token_type_to_lexeme(node->op));
+            return closure_new(compiler, node, closure_constant);
+    }
+
+    closure_t *closure = closure_new(compiler, node, handler);
+    closure->operands.right = closure_compile_expression(compiler, node->unary.right);
+    return closure;
+}
+
+/* `x op= v` stores `x op v`, `x &&= v` stores `x` back when that decides it */
+static closure_t *closure_compile_assignment(closure_compiler_t *compiler, node_t *node)
+{
+    node_t *target = node->assignment.target;
+    node_t *value = node->assignment.value;
+    if (target->type != NODE_IDENTIFIER)
+    {
+        closure_unsupported(compiler, target);
+        return closure_new(compiler, node, closure_constant);
+    }
+
+    closure_t *stored;
+    if (node->op == TOKEN_EQUAL)
+        stored = closure_compile_expression(compiler, value);
+    else
+        stored = closure_compile_binary(compiler, node, closure_compound_op(node->op),
+            target, closure_compile_get(compiler, target, target->binding), value);
+
+    return closure_compile_set(compiler, node, target->binding, stored);
+}
+
+static closure_t *closure_compile_call(closure_compiler_t *compiler, node_t *node)
+{
+    /* sema only marks calls in function bodies */
+    closure_t *closure = closure_new(compiler, node,
+        node->flags & NODE_FLAG_TAIL_CALL ? closure_tail_call : closure_call_uninitialized);
+    closure->call.callee = closure_compile_expression(compiler, node->call.callee);
+    closure->call.argc = node->call.arg_count;
+    closure->call.args = closure_array(compiler, node->call.arg_count);
+    for (size_t i = 0; i < node->call.arg_count; i++)
+        closure->call.args[i] = closure_compile_expression(compiler, node->call.args[i]);
+    return closure;
+}
+
+static closure_t *closure_compile_closure(closure_compiler_t *compiler, node_t *node)
+{
+    closure_function_t *function = arena_alloc(&compiler->arena, sizeof(closure_function_t));
+    function->node = node;
+
+    /* bodies parsed lazily are compiled on their first call */
+    if (node->function.body)
+        closure_compile_function(compiler, function);
+
+    closure_t *closure = closure_new(compiler, node, closure_make_function);
+    closure->function = function;
+    return closure;
+}
+
+static closure_t *closure_compile_expression(closure_compiler_t *compiler, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'closure_compile_expression'");
+
+    closure_t *closure;
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+            closure = closure_new(compiler, node, closure_constant);
+            closure->constant = value_number(node->number);
+            return closure;
+
+        case NODE_STRING:
+            closure = closure_new(compiler, node, closure_constant);
+            closure->constant = (value_t) { .type = VALUE_STRING, .string = node->string };
+            return closure;
+
+        case NODE_BOOL:
+            closure = closure_new(compiler, node, closure_constant);
+            closure->constant = value_bool(node->boolean);
+            return closure;
+
+        case NODE_UNDEFINED:
+            closure = closure_new(compiler, node, closure_constant);
+            closure->constant = value_undefined();
+            return closure;
+
+        case NODE_NULL:
+            closure = closure_new(compiler, node, closure_constant);
+            closure->constant = value_null();
+            return closure;
+
+        case NODE_BINARY:
+            return closure_compile_binary(compiler, node, node->op, node->binary.left,
+                closure_compile_expression(compiler, node->binary.left), node->binary.right);
+
+        case NODE_TERNARY:
+            closure = closure_new(compiler, node, closure_ternary);
+            closure->branch.condition = closure_compile_expression(compiler, node->ternary.condition);
+            closure->branch.then = closure_compile_expression(compiler, node->ternary.true_expr);
+            closure->branch.otherwise = closure_compile_expression(compiler, node->ternary.false_expr);
+            return closure;
+
+        case NODE_MEMBER:
+            closure = closure_new(compiler, node, closure_member_uninitialized);
+            closure->member.object = closure_compile_expression(compiler, node->member.object);
+            closure->member.name = node->member.property->identifier;
+            return closure;
+
+        case NODE_IDENTIFIER: return closure_compile_get(compiler, node, node->binding);
+        case NODE_UNARY: return closure_compile_unary(compiler, node);
+        case NODE_POSTFIX: return closure_compile_update(compiler, node, node->postfix.left, true);
+        case NODE_ASSIGNMENT: return closure_compile_assignment(compiler, node);
+        case NODE_CALL: return closure_compile_call(compiler, node);
+        case NODE_FUNCTION: return closure_compile_closure(compiler, node);
+
+        /* a placeholder while the remaining errors are found */
+        default:
+            closure_unsupported(compiler, node);
+            return closure_new(compiler, node, closure_constant);
+    }
+}
+
+/* function declarations are set before the statements of their block run */
+static closure_t *closure_compile_statements(closure_compiler_t *compiler, node_t *node,
+                                             node_t **statements, size_t count, uint32_t result)
+{
+    size_t hoisted = 0;
+    for (size_t i = 0; i < count; i++)
+        hoisted += statements[i]->type == NODE_FUNCTION && statements[i]->function.is_declaration;
+
+    closure_t *closure = closure_new(compiler, node, closure_block);
+    closure->block.statements = closure_array(compiler, hoisted + count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        node_t *statement = statements[i];
+        if (statement->type != NODE_FUNCTION || !statement->function.is_declaration) continue;
+
+        closure->block.statements[closure->block.count++] = closure_compile_set(compiler, statement,
+            statement->function.binding, closure_compile_closure(compiler, statement));
+    }
+
+    /* the program keeps the value of its last expression statement in `result` */
+    for (size_t i = 0; i < count; i++)
+    {
+        node_t *statement = statements[i];
+        closure_t *compiled = result != NODE_SLOT_NONE && node_is_expression(statement)
+            ? closure_compile_set(compiler, statement, (node_binding_t) { NODE_HOPS_LOCAL, result },
+                closure_compile_expression(compiler, statement))
+            : closure_compile_statement(compiler, statement);
+
+        if (compiled->handler != closure_nop)
+            closure->block.statements[closure->block.count++] = compiled;
+    }
+
+    return closure;
+}
+
+static void closure_target_begin(closure_compiler_t *compiler, closure_target_t *target, atom_t label, bool is_loop)
+{
+    target->enclosing = compiler->target;
+    target->label = label;
+    target->is_loop = is_loop;
+    compiler->target = target;
+}
+
+static closure_t *closure_compile_loop(closure_compiler_t *compiler, node_t *node, atom_t label,
+                                       closure_handler_t handler, node_t *condition, node_t *body)
+{
+    closure_t *closure = closure_new(compiler, node, handler);
+    closure->loop.label = label;
+    if (condition)
+        closure->loop.condition = closure_compile_expression(compiler, condition);
+
+    closure_target_t target;
+    closure_target_begin(compiler, &target, label, true);
+    closure->loop.body = closure_compile_statement(compiler, body);
+    compiler->target = target.enclosing;
+    return closure;
+}
+
+static closure_t *closure_compile_for(closure_compiler_t *compiler, node_t *node, atom_t label)
+{
+    closure_t *closure = closure_compile_loop(compiler, node, label, closure_for,
+        node->for_stmt.condition, node->for_stmt.body);
+    closure->loop.env_size = node->for_stmt.env_size;
+
+    node_t *init = node->for_stmt.init;
+    if (init)
+        closure->loop.init = node_is_expression(init)
+            ? closure_compile_expression(compiler, init)
+            : closure_compile_statement(compiler, init);
+    if (node->for_stmt.increment)
+        closure->loop.update = closure_compile_expression(compiler, node->for_stmt.increment);
+    return closure;
+}
+
+static closure_t *closure_compile_switch(closure_compiler_t *compiler, node_t *node, atom_t label)
+{
+    size_t count = node->switch_stmt.cases_count;
+    size_t labels = 0;
+    for (size_t i = 0; i < count; i++)
+        labels += node->switch_stmt.cases[i].labels_count;
+
+    closure_t *closure = closure_new(compiler, node, closure_switch);
+    closure->cases.value = closure_compile_expression(compiler, node->switch_stmt.expr);
+    closure->cases.labels = closure_array(compiler, labels);
+    closure->cases.label_cases = arena_alloc(&compiler->arena, labels * sizeof(size_t));
+    closure->cases.bodies = closure_array(compiler, count);
+    closure->cases.count = count;
+    closure->cases.fallback = count;
+    closure->cases.label = label;
+
+    closure_target_t target;
+    closure_target_begin(compiler, &target, label, false);
+    for (size_t i = 0; i < count; i++)
+    {
+        struct node_case *c = &node->switch_stmt.cases[i];
+        if (c->is_default) closure->cases.fallback = i;
+
+        for (size_t j = 0; j < c->labels_count; j++)
+        {
+            closure->cases.labels[closure->cases.label_count] = closure_compile_expression(compiler, c->labels[j]);
+            closure->cases.label_cases[closure->cases.label_count++] = i;
+        }
+        closure->cases.bodies[i] = closure_compile_statement(compiler, c->body);
+    }
+    compiler->target = target.enclosing;
+
+    return closure;
+}
+
+static closure_t *closure_compile_jump(closure_compiler_t *compiler, node_t *node, atom_t label, bool is_continue)
+{
+    closure_target_t *target = compiler->target;
+    while (target && ((is_continue && !target->is_loop) || (label && target->label != label)))
+        target = target->enclosing;
+
+    if (!target)
+        CLOSURE_COMPILER_ERROR(compiler,
+            "[ERROR] [%s:%zu:%zu]: no target for '%s'\n",
+            LOCATION(node->loc), is_continue ? "continue" : "break");
+
+    closure_t *closure = closure_new(compiler, node, is_continue ? closure_continue : closure_break);
+    closure->label = label;
+    return closure;
+}
+
+static closure_t *closure_compile_statement(closure_compiler_t *compiler, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'closure_compile_statement'");
+
+    if (!node) return closure_new(compiler, node, closure_nop);
+
+    /* a label belongs to the statement right after it */
+    atom_t label = compiler->label;
+    compiler->label = NULL;
+
+    closure_t *closure;
+    switch (node->type)
+    {
+        case NODE_BLOCK: {
+            closure_target_t target;
+            if (label) closure_target_begin(compiler, &target, label, false);
+
+            closure = closure_compile_statements(compiler, node, node->block.statements, node->block.count, NODE_SLOT_NONE);
+            if (node->block.env_size)
+            {
+                closure->handler = closure_scope;
+                closure->block.env_size = node->block.env_size;
+            }
+            if (!label) return closure;
+
+            compiler->target = target.enclosing;
+            closure_t *labeled = closure_new(compiler, node, closure_labeled);
+            labeled->labeled.body = closure;
+            labeled->labeled.label = label;
+            return labeled;
+        }
+
+        case NODE_DECLARATION: {
+            closure = closure_new(compiler, node, closure_block);
+            closure->block.statements = closure_array(compiler, node->declaration.count);
+            for (size_t i = 0; i < node->declaration.count; i++)
+            {
+                node_t *value = node->declaration.values ? node->declaration.values[i] : NULL;
+                node_t *name = node->declaration.names[i];
+
+                /* `var x;` keeps the value of an earlier declaration */
+                if (!value && node->declaration.kind == TOKEN_VAR) continue;
+
+                closure_t *initial = value ? closure_compile_expression(compiler, value) : NULL;
+                if (!initial)
+                {
+                    initial = closure_new(compiler, name, closure_constant);
+                    initial->constant = value_undefined();
+                }
+                closure->block.statements[closure->block.count++] = closure_compile_set(compiler, name, name->binding, initial);
+            }
+            return closure->block.count == 1 ? closure->block.statements[0] : closure;
+        }
+
+        case NODE_IF:
+            closure = closure_new(compiler, node, closure_if);
+            closure->branch.condition = closure_compile_expression(compiler, node->if_stmt.condition);
+            closure->branch.then = closure_compile_statement(compiler, node->if_stmt.then_branch);
+            if (node->if_stmt.else_branch)
+                closure->branch.otherwise = closure_compile_statement(compiler, node->if_stmt.else_branch);
+            return closure;
+
+        case NODE_WHILE:
+            return closure_compile_loop(compiler, node, label, closure_while,
+                node->while_stmt.condition, node->while_stmt.body);
+
+        case NODE_DO_WHILE:
+            return closure_compile_loop(compiler, node, label, closure_do_while,
+                node->do_while_stmt.condition, node->do_while_stmt.body);
+
+        case NODE_FOR: return closure_compile_for(compiler, node, label);
+        case NODE_SWITCH: return closure_compile_switch(compiler, node, label);
+        case NODE_BREAK: return closure_compile_jump(compiler, node, node->break_stmt.label, false);
+        case NODE_CONTINUE: return closure_compile_jump(compiler, node, node->continue_stmt.label, true);
+
+        case NODE_LABEL:
+            compiler->label = node->label.name;
+            return closure_compile_statement(compiler, node->label.statement);
+
+        case NODE_RETURN:
+            closure = closure_new(compiler, node, closure_return);
+            if (node->return_stmt.value)
+                closure->value = closure_compile_expression(compiler, node->return_stmt.value);
+            return closure;
+
+        case NODE_EMPTY:
+        case NODE_DEBUGGER:
+            return closure_new(compiler, node, closure_nop);
+
+        default:
+            if (node->type == NODE_FUNCTION && node->function.is_declaration)
+                return closure_new(compiler, node, closure_nop);
+
+            if (!node_is_expression(node))
+            {
+                closure_unsupported(compiler, node);
+                return closure_new(compiler, node, closure_nop);
+            }
+
+            /* the value is dropped */
+            return closure_compile_expression(compiler, node);
+    }
+}
+
+static bool closure_compile_function(closure_compiler_t *compiler, closure_function_t *function)
+{
+    node_t *node = function->node;
+    if (!node->function.body)
+    {
+        bool checked = compiler->parser && parser_function_body(compiler->parser, node) &&
+                       sema_analyze_function(compiler->sema, node);
+        if (!checked)
+        {
+            compiler->had_error = true;
+            return false;
+        }
+    }
+
+    /* nested functions have their own targets */
+    closure_target_t *target = compiler->target;
+    atom_t label = compiler->label;
+    bool had_error = compiler->had_error;
+    compiler->target = NULL;
+    compiler->label = NULL;
+    compiler->had_error = false;
+
+    size_t count = node->function.param_count + 2;
+    closure_t *body = closure_new(compiler, node, closure_block);
+    body->block.statements = closure_array(compiler, count);
+
+    /* arguments arrive in the first frame slots, captured ones move to the env */
+    for (size_t i = 0; i < node->function.param_count; i++)
+    {
+        struct node_param *param = &node->function.params[i];
+        if (param->is_rest)
+        {
+            CLOSURE_COMPILER_ERROR(compiler,
+                "[ERROR] [%s:%zu:%zu]: rest parameters are not supported by the closure compiler\n",
+                LOCATION(node->loc));
+            continue;
+        }
+        if (param->binding.hops == NODE_HOPS_LOCAL && !param->default_value) continue;
+
+        closure_t *closure = closure_new(compiler, node, closure_param);
+        closure->param.binding = param->binding;
+        closure->param.index = i;
+        if (param->default_value)
+            closure->param.default_value = closure_compile_expression(compiler, param->default_value);
+        body->block.statements[body->block.count++] = closure;
+    }
+
+    /* a named function expression sees itself */
+    if (!node->function.is_declaration && node->function.binding.slot != NODE_SLOT_NONE)
+        body->block.statements[body->block.count++] = closure_compile_set(compiler, node,
+            node->function.binding, closure_new(compiler, node, closure_get_callee));
+
+    body->block.statements[body->block.count++] = closure_compile_statement(compiler, node->function.body);
+
+    function->param_count = node->function.param_count;
+    function->frame_size = node->function.frame_size;
+    function->env_size = node->function.env_size;
+    compiler->function_count++;
+
+    bool ok = !compiler->had_error;
+    if (ok) function->body = body;
+
+    compiler->target = target;
+    compiler->label = label;
+    compiler->had_error = had_error || !ok;
+    return ok;
+}
+
+closure_function_t *closure_compile_program(closure_compiler_t *compiler, node_t *program)
+{
+    closure_function_t *function = arena_alloc(&compiler->arena, sizeof(closure_function_t));
+    function->node = program;
+
+    /* the slot after the locals holds the value of the last expression */
+    uint32_t result = program->program.frame_size;
+    function->body = closure_compile_statements(compiler, program,
+        program->program.statements, program->program.count, result);
+    function->frame_size = result + 1;
+    compiler->function_count++;
+
+    return compiler->had_error ? NULL : function;
+}
+
+/* running */
+
+void closure_init(closure_ctx_t *ctx, closure_compiler_t *compiler)
+{
+    *ctx = (closure_ctx_t) {0};
+    ctx->compiler = compiler;
+    value_stack_init(&ctx->stack);
+}
+
+void closure_free(closure_ctx_t *ctx)
+{
+    if (!ctx) return;
+    value_stack_free(&ctx->stack);
+    env_free(ctx->globals);
+}
+
+value_t closure_run(closure_ctx_t *ctx, closure_function_t *program)
+{
+    ctx->globals = env_enter_scope(NULL, program->node->program.slot_count);
+    runtime_builtins(ctx->globals);
+
+    ctx->frame = value_stack_push_frame(&ctx->stack, program->frame_size);
+    ctx->env = NULL;
+    ctx->callee = value_undefined();
+    ctx->completion = CLOSURE_NORMAL;
+
+    CLOSURE_RUN(program->body);
+
+    value_t result = ctx->frame[program->frame_size - 1];
+    value_stack_pop_frame(&ctx->stack, program->frame_size);
+    return result;
+}
@@ -0,0 +1,858 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "compiler.h"
+
+void compiler_init(compiler_t *compiler, parser_t *parser, sema_t *sema)
+{
+    *compiler = (compiler_t) {0};
+    compiler->parser = parser;
+    compiler->sema = sema;
+}
+
+static void compile_unsupported(compiler_t *compiler, node_t *node)
+{
+    COMPILER_ERROR(compiler,
+        "[ERROR] [%s:%zu:%zu]: %s is not supported by the bytecode compiler\n",
+        LOCATION(node->loc), node_type_to_string(node->type));
+}
+
+static void compile_adjust(compiler_t *compiler, int effect)
+{
+    assert(effect >= 0 || compiler->depth >= (size_t) -effect);
+    compiler->depth += effect;
+    if (compiler->depth > compiler->function->stack_size)
+        compiler->function->stack_size = compiler->depth;
+}
+
+static void compile_op(compiler_t *compiler, bytecode_op_t op)
+{
+    bytecode_emit(compiler->function, op);
+    compile_adjust(compiler, bytecode_op_effect(op));
+}
+
+static void compile_op1(compiler_t *compiler, bytecode_op_t op, uint32_t operand)
+{
+    compile_op(compiler, op);
+    bytecode_emit_operand(compiler->function, operand);
+}
+
+static void compile_op2(compiler_t *compiler, bytecode_op_t op, uint32_t first, uint32_t second)
+{
+    compile_op1(compiler, op, first);
+    bytecode_emit_operand(compiler->function, second);
+}
+
+/* emits a jump to a later target, returns where its offset goes */
+static size_t compile_jump(compiler_t *compiler, bytecode_op_t op)
+{
+    compile_op1(compiler, op, 0);
+    return compiler->function->length - sizeof(uint32_t);
+}
+
+static void compile_patch_to(compiler_t *compiler, size_t at, size_t target)
+{
+    int32_t offset = (int32_t) target - (int32_t) (at + sizeof(uint32_t));
+    bytecode_patch_operand(compiler->function, at, (uint32_t) offset);
+}
+
+/* points a jump from `compile_jump` at the next instruction */
+static void compile_patch(compiler_t *compiler, size_t at)
+{
+    compile_patch_to(compiler, at, compiler->function->length);
+}
+
+/* the back-edge of a loop, the VM counts it down to trace the loop */
+static void compile_loop_to(compiler_t *compiler, size_t target)
+{
+    compile_op2(compiler, BYTECODE_LOOP, 0, bytecode_add_loop(compiler->function));
+    size_t at = compiler->function->length - 2 * sizeof(uint32_t);
+    int32_t offset = (int32_t) target - (int32_t) compiler->function->length;
+    bytecode_patch_operand(compiler->function, at, (uint32_t) offset);
+}
+
+static void compile_constant(compiler_t *compiler, value_t value)
+{
+    compile_op1(compiler, BYTECODE_PUSH_CONSTANT, bytecode_add_constant(compiler->function, value));
+}
+
+/* pool entry of a name, strings in the pool are never freed */
+static uint32_t compile_name(compiler_t *compiler, atom_t name)
+{
+    value_t value = { .type = VALUE_STRING, .string = (char *) name };
+    return bytecode_add_constant(compiler->function, value);
+}
+
+static void compile_get(compiler_t *compiler, node_binding_t binding)
+{
+    if (binding.hops == NODE_HOPS_GLOBAL)
+        compile_op1(compiler, BYTECODE_GET_GLOBAL, binding.slot);
+    else if (binding.hops == NODE_HOPS_LOCAL)
+        compile_op1(compiler, BYTECODE_GET_LOCAL, binding.slot);
+    else
+        compile_op2(compiler, BYTECODE_GET_ENV, binding.hops, binding.slot);
+}
+
+/* stores the top of the stack, which stays there */
+static void compile_set(compiler_t *compiler, node_binding_t binding)
+{
+    if (binding.hops == NODE_HOPS_GLOBAL)
+        compile_op1(compiler, BYTECODE_SET_GLOBAL, binding.slot);
+    else if (binding.hops == NODE_HOPS_LOCAL)
+        compile_op1(compiler, BYTECODE_SET_LOCAL, binding.slot);
+    else
+        compile_op2(compiler, BYTECODE_SET_ENV, binding.hops, binding.slot);
+}
+
+static void compile_expression(compiler_t *compiler, node_t *node);
+static void compile_statement(compiler_t *compiler, node_t *node);
+
+/* BYTECODE_COUNT for operators without an instruction */
+static bytecode_op_t compile_binary_op(node_op_t op, bool numbers)
+{
+    switch (op)
+    {
+        case TOKEN_PLUS:            return numbers ? BYTECODE_ADD_NUMBER : BYTECODE_ADD;
+        case TOKEN_MINUS:           return numbers ? BYTECODE_SUB_NUMBER : BYTECODE_SUB;
+        case TOKEN_STAR:            return numbers ? BYTECODE_MUL_NUMBER : BYTECODE_MUL;
+        case TOKEN_SLASH:           return numbers ? BYTECODE_DIV_NUMBER : BYTECODE_DIV;
+        case TOKEN_PERCENT:         return BYTECODE_MOD;
+        case TOKEN_STAR_STAR:       return BYTECODE_POW;
+        case TOKEN_AMPERSAND:       return BYTECODE_BIT_AND;
+        case TOKEN_PIPE:            return BYTECODE_BIT_OR;
+        case TOKEN_CARET:           return BYTECODE_BIT_XOR;
+        case TOKEN_LEFT_SHIFT:      return BYTECODE_SHL;
+        case TOKEN_RIGHT_SHIFT:     return BYTECODE_SHR;
+        case TOKEN_EQUAL_EQUAL:     return BYTECODE_EQ;
+        case TOKEN_BANG_EQUAL:      return BYTECODE_NE;
+        case TOKEN_LESS:            return numbers ? BYTECODE_LT_NUMBER : BYTECODE_LT;
+        case TOKEN_GREATER:         return numbers ? BYTECODE_GT_NUMBER : BYTECODE_GT;
+        case TOKEN_LESS_EQUAL:      return numbers ? BYTECODE_LE_NUMBER : BYTECODE_LE;
+        case TOKEN_GREATER_EQUAL:   return numbers ? BYTECODE_GE_NUMBER : BYTECODE_GE;
+        default:                    return BYTECODE_COUNT;
+    }
+}
+
+/* the binary operator of a compound assignment */
+static node_op_t compile_compound_op(node_op_t op)
+{
+    switch (op)
+    {
+        case TOKEN_PLUS_EQUAL:          return TOKEN_PLUS;
+        case TOKEN_MINUS_EQUAL:         return TOKEN_MINUS;
+        case TOKEN_STAR_EQUAL:          return TOKEN_STAR;
+        case TOKEN_SLASH_EQUAL:         return TOKEN_SLASH;
+        case TOKEN_PERCENT_EQUAL:       return TOKEN_PERCENT;
+        case TOKEN_STAR_STAR_EQUAL:     return TOKEN_STAR_STAR;
+        case TOKEN_AMPERSAND_EQUAL:     return TOKEN_AMPERSAND;
+        case TOKEN_PIPE_EQUAL:          return TOKEN_PIPE;
+        case TOKEN_CARET_EQUAL:         return TOKEN_CARET;
+        case TOKEN_LEFT_SHIFT_EQUAL:    return TOKEN_LEFT_SHIFT;
+        case TOKEN_RIGHT_SHIFT_EQUAL:   return TOKEN_RIGHT_SHIFT;
+        default:                        return TOKEN_UNKNOWN;
+    }
+}
+
+static bool compile_numbers(const node_t *left, const node_t *right)
+{
+    return left->flags & right->flags & NODE_FLAG_NUMBER;
+}
+
+static void compile_binary(compiler_t *compiler, node_t *node)
+{
+    compile_expression(compiler, node->binary.left);
+
+    /* `a && b` is `a` when that decides it and `b` otherwise */
+    if (node->op == TOKEN_LOGICAL_AND || node->op == TOKEN_LOGICAL_OR)
+    {
+        size_t end = compile_jump(compiler, node->op == TOKEN_LOGICAL_AND
+            ? BYTECODE_JUMP_IF_FALSE_KEEP : BYTECODE_JUMP_IF_TRUE_KEEP);
+        compile_op(compiler, BYTECODE_POP);
+        compile_expression(compiler, node->binary.right);
+        compile_patch(compiler, end);
+        return;
+    }
+
+    compile_expression(compiler, node->binary.right);
+
+    bytecode_op_t op = compile_binary_op(node->op, compile_numbers(node->binary.left, node->binary.right));
+    if (op == BYTECODE_COUNT)
+    {
+        COMPILER_ERROR(compiler,
+            "[ERROR] [%s:%zu:%zu]: '%s' is not supported by the bytecode compiler\n",
+            LOCATION(node->loc), token_type_to_lexeme(node->op));
+        compile_op(compiler, BYTECODE_POP);
+        return;
+    }
+    compile_op(compiler, op);
+}
+
+/* `++x`, `x--` and the like */
+static void compile_update(compiler_t *compiler, node_t *node, node_t *target, bool postfix)
+{
+    if (target->type != NODE_IDENTIFIER)
+    {
+        compile_unsupported(compiler, target);
+        compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+        return;
+    }
+
+    /* the old value of `x++` is converted too */
+    compile_get(compiler, target->binding);
+    if (postfix)
+    {
+        compile_op(compiler, BYTECODE_TO_NUMBER);
+        compile_op(compiler, BYTECODE_DUP);
+    }
+
+    compile_op(compiler, node->op == TOKEN_PLUS_PLUS ? BYTECODE_INC : BYTECODE_DEC);
+    compile_set(compiler, target->binding);
+    if (postfix)
+        compile_op(compiler, BYTECODE_POP);
+}
+
+static void compile_unary(compiler_t *compiler, node_t *node)
+{
+    switch (node->op)
+    {
+        case TOKEN_PLUS_PLUS:
+        case TOKEN_MINUS_MINUS:
+            compile_update(compiler, node, node->unary.right, false);
+            return;
+
+        case TOKEN_VOID:
+            compile_expression(compiler, node->unary.right);
+            compile_op(compiler, BYTECODE_POP);
+            compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+            return;
+
+        default:
+            break;
+    }
+
+    compile_expression(compiler, node->unary.right);
+    switch (node->op)
+    {
+        case TOKEN_MINUS: compile_op(compiler, BYTECODE_NEGATE); break;
+        case TOKEN_PLUS: compile_op(compiler, BYTECODE_TO_NUMBER); break;
+        case TOKEN_TILDE: compile_op(compiler, BYTECODE_BIT_NOT); break;
+        case TOKEN_BANG: compile_op(compiler, BYTECODE_NOT); break;
+        case TOKEN_TYPEOF: compile_op(compiler, BYTECODE_TYPEOF); break;
+
+        default:
+            COMPILER_ERROR(compiler,
+                "[ERROR] [%s:%zu:%zu]: '%s' is not supported by the bytecode compiler\n",
+                LOCATION(node->loc), token_type_to_lexeme(node->op));
+            break;
+    }
+}
+
+static void compile_assignment(compiler_t *compiler, node_t *node)
+{
+    node_t *target = node->assignment.target;
+    node_t *value = node->assignment.value;
+    if (target->type != NODE_IDENTIFIER)
+    {
+        compile_unsupported(compiler, target);
+        compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+        return;
+    }
+
+    switch (node->op)
+    {
+        case TOKEN_EQUAL:
+            compile_expression(compiler, value);
+            break;
+
+        case TOKEN_LOGICAL_AND_EQUAL:
+        case TOKEN_LOGICAL_OR_EQUAL: {
+            compile_get(compiler, target->binding);
+            size_t end = compile_jump(compiler, node->op == TOKEN_LOGICAL_AND_EQUAL
+                ? BYTECODE_JUMP_IF_FALSE_KEEP : BYTECODE_JUMP_IF_TRUE_KEEP);
+            compile_op(compiler, BYTECODE_POP);
+            compile_expression(compiler, value);
+            compile_set(compiler, target->binding);
+            compile_patch(compiler, end);
+            return;
+        }
+
+        default:
+            compile_get(compiler, target->binding);
+            compile_expression(compiler, value);
+            compile_op(compiler, compile_binary_op(compile_compound_op(node->op), compile_numbers(target, value)));
+            break;
+    }
+
+    compile_set(compiler, target->binding);
+}
+
+static void compile_ternary(compiler_t *compiler, node_t *node)
+{
+    compile_expression(compiler, node->ternary.condition);
+    size_t otherwise = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+    compile_expression(compiler, node->ternary.true_expr);
+    size_t end = compile_jump(compiler, BYTECODE_JUMP);
+
+    /* only one of the branches pushes */
+    compile_adjust(compiler, -1);
+    compile_patch(compiler, otherwise);
+    compile_expression(compiler, node->ternary.false_expr);
+    compile_patch(compiler, end);
+}
+
+static void compile_call(compiler_t *compiler, node_t *node)
+{
+    compile_expression(compiler, node->call.callee);
+    for (size_t i = 0; i < node->call.arg_count; i++)
+        compile_expression(compiler, node->call.args[i]);
+
+    /* sema only marks calls in function bodies */
+    bool tail = node->flags & NODE_FLAG_TAIL_CALL;
+    compile_op1(compiler, tail ? BYTECODE_TAIL_CALL : BYTECODE_CALL, node->call.arg_count);
+    compile_adjust(compiler, -(int) node->call.arg_count);
+}
+
+static void compile_member(compiler_t *compiler, node_t *node)
+{
+    compile_expression(compiler, node->member.object);
+    compile_op1(compiler, BYTECODE_GET_MEMBER, compile_name(compiler, node->member.property->identifier));
+}
+
+static void compile_closure(compiler_t *compiler, node_t *node)
+{
+    bytecode_function_t *nested = bytecode_function_create(node);
+    compile_op1(compiler, BYTECODE_CLOSURE, bytecode_add_function(compiler->function, nested));
+
+    /* bodies parsed lazily are compiled on their first call */
+    if (node->function.body)
+        compile_function(compiler, nested);
+}
+
+static void compile_expression(compiler_t *compiler, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'compile_expression'");
+
+    switch (node->type)
+    {
+        case NODE_NUMBER: compile_constant(compiler, value_number(node->number)); break;
+        case NODE_STRING: compile_constant(compiler, (value_t) { .type = VALUE_STRING, .string = node->string }); break;
+        case NODE_BOOL: compile_op(compiler, node->boolean ? BYTECODE_PUSH_TRUE : BYTECODE_PUSH_FALSE); break;
+        case NODE_UNDEFINED: compile_op(compiler, BYTECODE_PUSH_UNDEFINED); break;
+        case NODE_NULL: compile_op(compiler, BYTECODE_PUSH_NULL); break;
+        case NODE_IDENTIFIER: compile_get(compiler, node->binding); break;
+        case NODE_BINARY: compile_binary(compiler, node); break;
+        case NODE_UNARY: compile_unary(compiler, node); break;
+        case NODE_POSTFIX: compile_update(compiler, node, node->postfix.left, true); break;
+        case NODE_ASSIGNMENT: compile_assignment(compiler, node); break;
+        case NODE_TERNARY: compile_ternary(compiler, node); break;
+        case NODE_CALL: compile_call(compiler, node); break;
+        case NODE_MEMBER: compile_member(compiler, node); break;
+        case NODE_FUNCTION: compile_closure(compiler, node); break;
+
+        /* keeps the stack balanced while the remaining errors are found */
+        default:
+            compile_unsupported(compiler, node);
+            compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+            break;
+    }
+}
+
+/* function declarations are set before the statements of their block run */
+static void compile_hoist(compiler_t *compiler, node_t **statements, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        node_t *statement = statements[i];
+        if (statement->type != NODE_FUNCTION || !statement->function.is_declaration) continue;
+
+        compile_closure(compiler, statement);
+        compile_set(compiler, statement->function.binding);
+        compile_op(compiler, BYTECODE_POP);
+    }
+}
+
+static void compile_block(compiler_t *compiler, node_t *node)
+{
+    if (node->block.env_size)
+    {
+        compile_op1(compiler, BYTECODE_ENTER_SCOPE, node->block.env_size);
+        compiler->scope_depth++;
+    }
+
+    compile_hoist(compiler, node->block.statements, node->block.count);
+    for (size_t i = 0; i < node->block.count; i++)
+        compile_statement(compiler, node->block.statements[i]);
+
+    if (node->block.env_size)
+    {
+        compile_op(compiler, BYTECODE_LEAVE_SCOPE);
+        compiler->scope_depth--;
+    }
+}
+
+static void compile_declaration(compiler_t *compiler, node_t *node)
+{
+    for (size_t i = 0; i < node->declaration.count; i++)
+    {
+        node_t *value = node->declaration.values ? node->declaration.values[i] : NULL;
+
+        /* `var x;` keeps the value of an earlier declaration */
+        if (!value && node->declaration.kind == TOKEN_VAR) continue;
+
+        if (value) compile_expression(compiler, value);
+        else compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+
+        compile_set(compiler, node->declaration.names[i]->binding);
+        compile_op(compiler, BYTECODE_POP);
+    }
+}
+
+static void compile_if(compiler_t *compiler, node_t *node)
+{
+    compile_expression(compiler, node->if_stmt.condition);
+    size_t otherwise = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+    compile_statement(compiler, node->if_stmt.then_branch);
+
+    if (!node->if_stmt.else_branch)
+    {
+        compile_patch(compiler, otherwise);
+        return;
+    }
+
+    size_t end = compile_jump(compiler, BYTECODE_JUMP);
+    compile_patch(compiler, otherwise);
+    compile_statement(compiler, node->if_stmt.else_branch);
+    compile_patch(compiler, end);
+}
+
+static void compile_loop_begin(compiler_t *compiler, compiler_loop_t *loop, atom_t label, bool is_loop)
+{
+    *loop = (compiler_loop_t) {0};
+    loop->enclosing = compiler->loop;
+    loop->label = label;
+    loop->is_loop = is_loop;
+    loop->scope_depth = compiler->scope_depth;
+    compiler->loop = loop;
+}
+
+static void compile_patch_list(compiler_t *compiler, size_t *jumps, size_t count, size_t target)
+{
+    for (size_t i = 0; i < count; i++)
+        compile_patch_to(compiler, jumps[i], target);
+}
+
+/* the breaks jump to the next instruction */
+static void compile_loop_end(compiler_t *compiler, compiler_loop_t *loop)
+{
+    compile_patch_list(compiler, loop->breaks, loop->break_count, compiler->function->length);
+    free(loop->breaks);
+    free(loop->continues);
+    compiler->loop = loop->enclosing;
+}
+
+static void compile_while(compiler_t *compiler, node_t *node, atom_t label)
+{
+    compiler_loop_t loop;
+    compile_loop_begin(compiler, &loop, label, true);
+
+    size_t start = compiler->function->length;
+    compile_expression(compiler, node->while_stmt.condition);
+    size_t end = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+    compile_statement(compiler, node->while_stmt.body);
+    compile_loop_to(compiler, start);
+    compile_patch(compiler, end);
+
+    compile_patch_list(compiler, loop.continues, loop.continue_count, start);
+    compile_loop_end(compiler, &loop);
+}
+
+static void compile_do_while(compiler_t *compiler, node_t *node, atom_t label)
+{
+    compiler_loop_t loop;
+    compile_loop_begin(compiler, &loop, label, true);
+
+    size_t start = compiler->function->length;
+    compile_statement(compiler, node->do_while_stmt.body);
+    compile_patch_list(compiler, loop.continues, loop.continue_count, compiler->function->length);
+    compile_expression(compiler, node->do_while_stmt.condition);
+    size_t end = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+    compile_loop_to(compiler, start);
+    compile_patch(compiler, end);
+
+    compile_loop_end(compiler, &loop);
+}
+
+static void compile_for(compiler_t *compiler, node_t *node, atom_t label)
+{
+    /* captured loop variables are copied to a new env for each iteration */
+    uint32_t env_size = node->for_stmt.env_size;
+    if (env_size)
+    {
+        compile_op1(compiler, BYTECODE_ENTER_SCOPE, env_size);
+        compiler->scope_depth++;
+    }
+
+    node_t *init = node->for_stmt.init;
+    if (init && node_is_expression(init))
+    {
+        compile_expression(compiler, init);
+        compile_op(compiler, BYTECODE_POP);
+    }
+    else
+    {
+        compile_statement(compiler, init);
+    }
+
+    compiler_loop_t loop;
+    compile_loop_begin(compiler, &loop, label, true);
+
+    size_t start = compiler->function->length;
+    size_t end = SIZE_MAX;
+    if (node->for_stmt.condition)
+    {
+        compile_expression(compiler, node->for_stmt.condition);
+        end = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+    }
+
+    compile_statement(compiler, node->for_stmt.body);
+    compile_patch_list(compiler, loop.continues, loop.continue_count, compiler->function->length);
+
+    if (env_size)
+        compile_op(compiler, BYTECODE_COPY_SCOPE);
+    if (node->for_stmt.increment)
+    {
+        compile_expression(compiler, node->for_stmt.increment);
+        compile_op(compiler, BYTECODE_POP);
+    }
+    compile_loop_to(compiler, start);
+
+    if (end != SIZE_MAX)
+        compile_patch(compiler, end);
+    compile_loop_end(compiler, &loop);
+
+    if (env_size)
+    {
+        compile_op(compiler, BYTECODE_LEAVE_SCOPE);
+        compiler->scope_depth--;
+    }
+}
+
+/*
+ * The value is compared with each label in order while it is on the stack,
+ * a match pops it and jumps to the case's body. The bodies follow each
+ * other, so a body without `break` falls through.
+ */
+static void compile_switch(compiler_t *compiler, node_t *node, atom_t label)
+{
+    size_t count = node->switch_stmt.cases_count;
+    size_t labels = 0;
+    for (size_t i = 0; i < count; i++)
+        labels += node->switch_stmt.cases[i].labels_count;
+
+    size_t *matches = malloc(labels * sizeof(size_t));  /**< jump of each label's match */
+    size_t *cases = malloc(labels * sizeof(size_t));    /**< case of each label */
+    size_t *bodies = malloc(count * sizeof(size_t));
+    if ((labels && (!matches || !cases)) || (count && !bodies))
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    compile_expression(compiler, node->switch_stmt.expr);
+
+    size_t fallback_case = SIZE_MAX;
+    size_t match = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        struct node_case *c = &node->switch_stmt.cases[i];
+        if (c->is_default) fallback_case = i;
+
+        for (size_t j = 0; j < c->labels_count; j++)
+        {
+            compile_op(compiler, BYTECODE_DUP);
+            compile_expression(compiler, c->labels[j]);
+            compile_op(compiler, BYTECODE_STRICT_EQ);
+            size_t next = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+            compile_op(compiler, BYTECODE_POP);
+            matches[match] = compile_jump(compiler, BYTECODE_JUMP);
+            cases[match++] = i;
+
+            /* the next comparison still has the value */
+            compile_adjust(compiler, 1);
+            compile_patch(compiler, next);
+        }
+    }
+
+    compile_op(compiler, BYTECODE_POP);
+    size_t fallback = compile_jump(compiler, BYTECODE_JUMP);
+
+    compiler_loop_t loop;
+    compile_loop_begin(compiler, &loop, label, false);
+    for (size_t i = 0; i < count; i++)
+    {
+        bodies[i] = compiler->function->length;
+        compile_statement(compiler, node->switch_stmt.cases[i].body);
+    }
+
+    for (size_t i = 0; i < labels; i++)
+        compile_patch_to(compiler, matches[i], bodies[cases[i]]);
+    compile_patch_to(compiler, fallback,
+        fallback_case != SIZE_MAX ? bodies[fallback_case] : compiler->function->length);
+    compile_loop_end(compiler, &loop);
+
+    free(matches);
+    free(cases);
+    free(bodies);
+}
+
+/* `break` and `continue`, leaving the envs entered since their target */
+static void compile_jump_out(compiler_t *compiler, node_t *node, atom_t label, bool is_continue)
+{
+    compiler_loop_t *target = compiler->loop;
+    while (target && ((is_continue && !target->is_loop) || (label && target->label != label)))
+        target = target->enclosing;
+
+    if (!target)
+    {
+        COMPILER_ERROR(compiler,
+            "[ERROR] [%s:%zu:%zu]: no target for '%s'\n",
+            LOCATION(node->loc), is_continue ? "continue" : "break");
+        return;
+    }
+
+    for (size_t i = target->scope_depth; i < compiler->scope_depth; i++)
+        compile_op(compiler, BYTECODE_LEAVE_SCOPE);
+
+    size_t at = compile_jump(compiler, BYTECODE_JUMP);
+    size_t **jumps = is_continue ? &target->continues : &target->breaks;
+    size_t *count = is_continue ? &target->continue_count : &target->break_count;
+
+    *jumps = realloc(*jumps, (*count + 1) * sizeof(size_t));
+    if (!*jumps)
+    {
+        ERROR("Realloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    (*jumps)[(*count)++] = at;
+}
+
+static void compile_statement(compiler_t *compiler, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'compile_statement'");
+
+    if (!node) return;
+
+    /* a label belongs to the statement right after it */
+    atom_t label = compiler->label;
+    compiler->label = NULL;
+
+    switch (node->type)
+    {
+        case NODE_BLOCK: {
+            if (!label)
+            {
+                compile_block(compiler, node);
+                break;
+            }
+
+            compiler_loop_t loop;
+            compile_loop_begin(compiler, &loop, label, false);
+            compile_block(compiler, node);
+            compile_loop_end(compiler, &loop);
+            break;
+        }
+
+        case NODE_DECLARATION: compile_declaration(compiler, node); break;
+        case NODE_IF: compile_if(compiler, node); break;
+        case NODE_WHILE: compile_while(compiler, node, label); break;
+        case NODE_DO_WHILE: compile_do_while(compiler, node, label); break;
+        case NODE_FOR: compile_for(compiler, node, label); break;
+        case NODE_SWITCH: compile_switch(compiler, node, label); break;
+        case NODE_BREAK: compile_jump_out(compiler, node, node->break_stmt.label, false); break;
+        case NODE_CONTINUE: compile_jump_out(compiler, node, node->continue_stmt.label, true); break;
+
+        case NODE_LABEL:
+            compiler->label = node->label.name;
+            compile_statement(compiler, node->label.statement);
+            break;
+
+        case NODE_RETURN:
+            if (node->return_stmt.value)
+                compile_expression(compiler, node->return_stmt.value);
+            else
+                compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+            compile_op(compiler, BYTECODE_RETURN);
+            break;
+
+        case NODE_EMPTY:
+        case NODE_DEBUGGER:
+            break;
+
+        default:
+            if (node->type == NODE_FUNCTION && node->function.is_declaration)
+                break;
+
+            if (!node_is_expression(node))
+            {
+                compile_unsupported(compiler, node);
+                break;
+            }
+
+            compile_expression(compiler, node);
+            compile_op(compiler, BYTECODE_POP);
+            break;
+    }
+}
+
+/* the state of the function being compiled, nested functions are compiled in between */
+typedef struct compiler_state
+{
+    bytecode_function_t *function;
+    size_t depth;
+    size_t scope_depth;
+    compiler_loop_t *loop;
+    atom_t label;
+    bool had_error;
+} compiler_state_t;
+
+static compiler_state_t compile_enter(compiler_t *compiler, bytecode_function_t *function)
+{
+    compiler_state_t state = {
+        .function = compiler->function,
+        .depth = compiler->depth,
+        .scope_depth = compiler->scope_depth,
+        .loop = compiler->loop,
+        .label = compiler->label,
+        .had_error = compiler->had_error,
+    };
+
+    compiler->function = function;
+    compiler->depth = 0;
+    compiler->scope_depth = 0;
+    compiler->loop = NULL;
+    compiler->label = NULL;
+    compiler->had_error = false;
+    return state;
+}
+
+/* returns whether the function compiled */
+static bool compile_leave(compiler_t *compiler, compiler_state_t state)
+{
+    bytecode_function_t *function = compiler->function;
+    bool ok = !compiler->had_error;
+    function->compiled = ok;
+
+    compiler->function_count++;
+    compiler->code_bytes += function->length;
+
+    compiler->function = state.function;
+    compiler->depth = state.depth;
+    compiler->scope_depth = state.scope_depth;
+    compiler->loop = state.loop;
+    compiler->label = state.label;
+    compiler->had_error = state.had_error || !ok;
+    return ok;
+}
+
+bool compile_function(compiler_t *compiler, bytecode_function_t *function)
+{
+    node_t *node = function->node;
+    if (function->compiled) return true;
+
+    if (!node->function.body)
+    {
+        bool checked = compiler->parser && parser_function_body(compiler->parser, node) &&
+                       sema_analyze_function(compiler->sema, node);
+        if (!checked)
+        {
+            compiler->had_error = true;
+            return false;
+        }
+    }
+
+    compiler_state_t state = compile_enter(compiler, function);
+
+    /* arguments arrive in the first frame slots, captured ones move to the env */
+    for (size_t i = 0; i < node->function.param_count; i++)
+    {
+        struct node_param *param = &node->function.params[i];
+        if (param->is_rest)
+        {
+            COMPILER_ERROR(compiler,
+                "[ERROR] [%s:%zu:%zu]: rest parameters are not supported by the bytecode compiler\n",
+                LOCATION(node->loc));
+            continue;
+        }
+
+        if (param->binding.hops != NODE_HOPS_LOCAL)
+        {
+            compile_op1(compiler, BYTECODE_GET_LOCAL, i);
+            compile_set(compiler, param->binding);
+            compile_op(compiler, BYTECODE_POP);
+        }
+
+        if (param->default_value)
+        {
+            compile_get(compiler, param->binding);
+            compile_op(compiler, BYTECODE_IS_UNDEFINED);
+            size_t skip = compile_jump(compiler, BYTECODE_JUMP_IF_FALSE);
+            compile_expression(compiler, param->default_value);
+            compile_set(compiler, param->binding);
+            compile_op(compiler, BYTECODE_POP);
+            compile_patch(compiler, skip);
+        }
+    }
+
+    /* a named function expression sees itself */
+    if (!node->function.is_declaration && node->function.binding.slot != NODE_SLOT_NONE)
+    {
+        compile_op(compiler, BYTECODE_GET_CALLEE);
+        compile_set(compiler, node->function.binding);
+        compile_op(compiler, BYTECODE_POP);
+    }
+
+    compile_statement(compiler, node->function.body);
+    compile_op(compiler, BYTECODE_PUSH_UNDEFINED);
+    compile_op(compiler, BYTECODE_RETURN);
+
+    function->param_count = node->function.param_count;
+    function->frame_size = node->function.frame_size;
+    function->env_size = node->function.env_size;
+    return compile_leave(compiler, state);
+}
+
+bytecode_function_t *compile_program(compiler_t *compiler, node_t *program)
+{
+    bytecode_function_t *function = bytecode_function_create(program);
+    compiler_state_t state = compile_enter(compiler, function);
+
+    /* the slot after the locals holds the value of the last expression */
+    uint32_t result = program->program.frame_size;
+
+    compile_hoist(compiler, program->program.statements, program->program.count);
+    for (size_t i = 0; i < program->program.count; i++)
+    {
+        node_t *statement = program->program.statements[i];
+        if (!node_is_expression(statement))
+        {
+            compile_statement(compiler, statement);
+            continue;
+        }
+
+        compile_expression(compiler, statement);
+        compile_op1(compiler, BYTECODE_SET_LOCAL, result);
+        compile_op(compiler, BYTECODE_POP);
+    }
+
+    compile_op1(compiler, BYTECODE_GET_LOCAL, result);
+    compile_op(compiler, BYTECODE_RETURN);
+
+    function->frame_size = result + 1;
+    if (compile_leave(compiler, state)) return function;
+
+    bytecode_function_free(function);
+    return NULL;
+}
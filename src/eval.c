@@ -7,16 +7,33 @@
 #include "eval.h"
 #include "utils.h"
 #include "env.h"
+#include "sema.h"
 
 void eval_init(eval_context_t *ctx)
 {
-    ctx->current_scope = env_create(NULL);
+    /* sized by sema, created in `eval_program` */
+    ctx->globals = NULL;
+    ctx->current_scope = NULL;
+
+    value_stack_init(&ctx->stack);
+    ctx->frame = NULL;
 }
 
 void eval_free(eval_context_t *ctx)
 {
     if (!ctx) return;
-    env_free(ctx->current_scope);
+    env_free(ctx->globals);
+    value_stack_free(&ctx->stack);
+}
+
+static value_t *eval_variable(eval_context_t *ctx, node_t *identifier)
+{
+    node_binding_t binding = identifier->binding;
+    if (binding.hops == NODE_HOPS_GLOBAL)
+        return &ctx->globals->slots[binding.slot];
+    if (binding.hops == NODE_HOPS_LOCAL)
+        return &ctx->frame[binding.slot];
+    return env_lookup(ctx->current_scope, binding.hops, binding.slot);
 }
 
 value_t math_sin(eval_context_t *ctx, size_t argc, value_t *argv)
@@ -291,17 +308,34 @@ value_t math_ceil(eval_context_t *ctx, size_t argc, value_t *argv)
     return val;
 }
 
+/* writes the arguments separated by spaces, strings without quotes */
+value_t eval_print(eval_context_t *ctx, size_t argc, value_t *argv)
+{
+    (void)ctx;
+    for (size_t i = 0; i < argc; i++) {
+        char *text = value_to_string(&argv[i]);
+        printf("%s%s", i ? " " : "", text);
+        free(text);
+    }
+    return value_undefined();
+}
 
 void math_add_function(object_t *obj, const char *name, value_t (*func)(eval_context_t *ctx, size_t argc, value_t *argv))
 {
     function_t *fn = malloc(sizeof(function_t));
     fn->is_native = true;
     fn->native_ptr = func;
-    object_set(obj, name, value_function(fn));
+    object_set(obj, atom_from_cstr(name), value_function(fn));
 }
 
 value_t eval_program(eval_context_t *ctx, node_t *program)
 {
+    if (!program) return value_undefined();
+
+    ctx->globals = env_create(NULL, program->program.slot_count);
+    ctx->current_scope = ctx->globals;
+    ctx->frame = value_stack_push_frame(&ctx->stack, program->program.frame_size);
+
     /* add build-ins */
     value_t math_obj = value_object_create();
 
@@ -309,7 +343,7 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
     number_t pi;
     mpfr_init2(pi, MPFR_PRECISION);     // set desired precision
     mpfr_const_pi(pi, MPFR_RNDN);       // set pi
-    object_set(&math_obj.object, "PI", value_number(pi));
+    object_set(&math_obj.object, atom_from_cstr("PI"), value_number(pi));
     mpfr_clear(pi); // clear after wrapping into value_t
     
     // E
@@ -317,7 +351,7 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
     mpfr_init2(e, MPFR_PRECISION);
     mpfr_set_ui(e, 1, MPFR_RNDN);       // e = 1
     mpfr_exp(e, e, MPFR_RNDN);          // e = exp(1)
-    object_set(&math_obj.object, "E", value_number(e));
+    object_set(&math_obj.object, atom_from_cstr("E"), value_number(e));
     mpfr_clear(e); // clear after wrapping
 
     // PHI = (1 + sqrt(5)) / 2
@@ -336,7 +370,7 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
     // phi = phi / 2
     mpfr_div_ui(phi, phi, 2, MPFR_RNDN);
 
-    object_set(&math_obj.object, "PHI", value_number(phi));
+    object_set(&math_obj.object, atom_from_cstr("PHI"), value_number(phi));
 
     mpfr_clear(phi);
     mpfr_clear(tmp);
@@ -382,11 +416,31 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
     math_add_function(&math_obj.object, "sign", math_sign);
     math_add_function(&math_obj.object, "random", math_random);
     
-    /* set the `Math` object */
-    env_set(ctx->current_scope, "Math", math_obj);
+    /* set the builtins in the cells sema reserved for them */
+    ctx->globals->slots[SEMA_BUILTIN_MATH] = math_obj;
+
+    number_t infinity;
+    mpfr_init2(infinity, MPFR_PRECISION);
+    mpfr_set_inf(infinity, 1);
+    ctx->globals->slots[SEMA_BUILTIN_INFINITY] = value_number(infinity);
+    mpfr_clear(infinity);
+
+    number_t nan;
+    mpfr_init2(nan, MPFR_PRECISION);
+    mpfr_set_nan(nan);
+    ctx->globals->slots[SEMA_BUILTIN_NAN] = value_number(nan);
+    mpfr_clear(nan);
+
+    function_t *print = malloc(sizeof(function_t));
+    if (!print) {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    print->is_native = true;
+    print->native_ptr = eval_print;
+    ctx->globals->slots[SEMA_BUILTIN_PRINT] = value_function(print);
 
     value_t result = value_undefined();
-    if (!program) return result;
 
     /* hoisting */
     for (size_t i = 0; i < program->program.count; i++)
@@ -399,7 +453,7 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
                 /* define function */
                 break;
             case NODE_DECLARATION:
-                if (stmt->declaration.kind.type == TOKEN_VAR)
+                if (stmt->declaration.kind == TOKEN_VAR)
                 {
                     for (size_t j = 0; j < stmt->declaration.count; j++)
                     {
@@ -420,6 +474,75 @@ value_t eval_program(eval_context_t *ctx, node_t *program)
     return result;
 }
 
+/* a binary with number operands that `eval_number` computes in place */
+static bool eval_number_binary(const node_t *node)
+{
+    if (!(node->binary.left->flags & node->binary.right->flags & NODE_FLAG_NUMBER))
+        return false;
+
+    switch (node->op)
+    {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+        case TOKEN_STAR:
+        case TOKEN_SLASH:
+        case TOKEN_PERCENT:
+        case TOKEN_STAR_STAR:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/*
+ * Computes a subtree sema flagged NODE_FLAG_NUMBER into `result`, binaries
+ * whose operands are flagged too are done in place without type checks or
+ * values in between.
+ */
+static void eval_number(eval_context_t *ctx, node_t *node, number_t result)
+{
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+            mpfr_set(result, node->number, MPFR_RNDN);
+            return;
+
+        case NODE_IDENTIFIER:
+            mpfr_set(result, eval_variable(ctx, node)->number, MPFR_RNDN);
+            return;
+
+        case NODE_BINARY: {
+            if (!eval_number_binary(node)) break;
+
+            number_t rhs;
+            mpfr_init2(rhs, MPFR_PRECISION);
+            eval_number(ctx, node->binary.left, result);
+            eval_number(ctx, node->binary.right, rhs);
+
+            switch (node->op)
+            {
+                case TOKEN_PLUS: mpfr_add(result, result, rhs, MPFR_RNDN); break;
+                case TOKEN_MINUS: mpfr_sub(result, result, rhs, MPFR_RNDN); break;
+                case TOKEN_STAR: mpfr_mul(result, result, rhs, MPFR_RNDN); break;
+                case TOKEN_SLASH: mpfr_div(result, result, rhs, MPFR_RNDN); break;
+                case TOKEN_PERCENT: mpfr_fmod(result, result, rhs, MPFR_RNDN); break;
+                case TOKEN_STAR_STAR: mpfr_pow(result, result, rhs, MPFR_RNDN); break;
+                default: UNREACHABLE;
+            }
+
+            mpfr_clear(rhs);
+            return;
+        }
+
+        default:
+            break;
+    }
+
+    value_t value = eval_node(ctx, node);
+    mpfr_set(result, value.number, MPFR_RNDN);
+}
+
 value_t eval_node(eval_context_t *ctx, node_t *node)
 {
     if (!node) return value_undefined();
@@ -435,11 +558,8 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
         case NODE_BOOL:
             return value_bool(node->boolean);
 
-        case NODE_IDENTIFIER: {
-            variable_t *ident = env_get(ctx->current_scope, node->identifier);
-            if (!ident) TODO("Identifier '%s' not found", node->identifier);
-            return ident->value;
-        }
+        case NODE_IDENTIFIER:
+            return *eval_variable(ctx, node);
 
         case NODE_ARRAY:
             TODO("NODE_ARRAY not implemented");
@@ -460,31 +580,27 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
             TODO("NODE_PROGRAM should be handled by eval_program");
 
         case NODE_BLOCK: {
-            env_enter_scope(ctx->current_scope);
-
             value_t result = value_undefined();
 
-            /* hoisting */
+            /* blocks that declare nothing run in the enclosing scope */
+            if (!node->block.scoped)
+            {
+                for (size_t i = 0; i < node->block.count; i++)
+                    result = eval_node(ctx, node->block.statements[i]);
+                return result;
+            }
+
+            /* only blocks with captured variables need an env */
+            if (node->block.env_size)
+                ctx->current_scope = env_enter_scope(ctx->current_scope, node->block.env_size);
+
+            /* hoisting, `var`s live in the function's frame or env already */
             for (size_t i = 0; i < node->block.count; i++)
             {
                 node_t *stmt = node->block.statements[i];
-                /* hoisting only functions and vars */
-                switch (stmt->type)
+                if (stmt->type == NODE_FUNCTION && stmt->function.is_declaration)
                 {
-                    case NODE_FUNCTION:
-                        /* define function */
-                        break;
-                    case NODE_DECLARATION:
-                        if (stmt->declaration.kind.type == TOKEN_VAR)
-                        {
-                            for (size_t j = 0; j < stmt->declaration.count; j++)
-                            {
-                                /* define var */
-                            }
-                        }
-                        break;
-                    default:
-                        break;
+                    /* define function */
                 }
             }
 
@@ -494,16 +610,29 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
                 result = eval_node(ctx, node->block.statements[i]);
             }
 
-            env_leave_scope(ctx->current_scope);
+            if (node->block.env_size)
+                ctx->current_scope = env_leave_scope(ctx->current_scope);
 
             return result;
         }
 
         case NODE_BINARY: {
+            /* number-only subtree, boxed once at its root */
+            if (eval_number_binary(node))
+            {
+                number_t result;
+                mpfr_init2(result, MPFR_PRECISION);
+                eval_number(ctx, node, result);
+
+                value_t val = value_number(result);
+                mpfr_clear(result);
+                return val;
+            }
+
             value_t left = eval_node(ctx, node->binary.left);
             value_t right = eval_node(ctx, node->binary.right);
 
-            switch (node->binary.op.type)
+            switch (node->op)
             {
                 case TOKEN_PLUS: {
                     if (left.type == VALUE_NUMBER && right.type == VALUE_NUMBER)
@@ -599,7 +728,7 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
                     break;
                 }
                 default: {
-                    TODO("Unimplemented binary operator %d", node->binary.op.type);
+                    TODO("Unimplemented binary operator %d", node->op);
                 }
             }
             UNREACHABLE;
@@ -608,8 +737,14 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
         case NODE_UNARY:
             TODO("NODE_UNARY not implemented");
 
-        case NODE_ASSIGNMENT:
-            TODO("NODE_ASSIGNMENT not implemented");
+        case NODE_ASSIGNMENT: {
+            if (node->op != TOKEN_EQUAL || node->assignment.target->type != NODE_IDENTIFIER)
+                TODO("NODE_ASSIGNMENT '%s' not implemented", token_type_to_lexeme(node->op));
+
+            value_t value = eval_node(ctx, node->assignment.value);
+            *eval_variable(ctx, node->assignment.target) = value;
+            return value;
+        }
 
         case NODE_TERNARY:
             TODO("NODE_TERNARY not implemented");
@@ -648,7 +783,7 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
                 result = callee.function->native_ptr(ctx, argc, argv);
             } else {
                 // User-defined function
-                // TODO: implement user-defined function call
+                // TODO: implement user-defined function call, see TAIL_CALL in vm.c and closure_tail_call
                 TODO("User-defined function calls not implemented yet");
             }
 
@@ -666,12 +801,12 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
             }
             
             // The member name (right-hand side) should be a string
-            const char *key = node->member.property->identifier;
+            atom_t key = node->member.property->identifier;
 
             // Look up the key in the object
             object_t *obj = &obj_val.object;
             for (size_t i = 0; i < obj->count; i++) {
-                if (strcmp(obj->keys[i], key) == 0) {
+                if (obj->keys[i] == key) {
                     return obj->values[i];  // found
                 }
             }
@@ -686,8 +821,17 @@ value_t eval_node(eval_context_t *ctx, node_t *node)
         case NODE_FUNCTION:
             TODO("NODE_FUNCTION not implemented");
 
-        case NODE_DECLARATION:
-            TODO("NODE_DECLARATION not implemented");
+        case NODE_DECLARATION: {
+            for (size_t i = 0; i < node->declaration.count; i++)
+            {
+                node_t *value = node->declaration.values ? node->declaration.values[i] : NULL;
+
+                /* `var x;` keeps the value of an earlier declaration */
+                if (!value && node->declaration.kind == TOKEN_VAR) continue;
+                *eval_variable(ctx, node->declaration.names[i]) = eval_node(ctx, value);
+            }
+            return value_undefined();
+        }
 
         case NODE_SWITCH:
             TODO("NODE_SWITCH not implemented");
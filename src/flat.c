@@ -0,0 +1,415 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "flat.h"
+
+#define FLAT_INITIAL_CAPACITY 256
+
+static_assert(NODE_COUNT <= UINT8_MAX + 1, "Node kinds must fit in 'flat_t.kinds'");
+
+void flat_init(flat_t *flat)
+{
+    *flat = (flat_t) {0};
+}
+
+void flat_free(flat_t *flat)
+{
+    free(flat->kinds);
+    free(flat->ops);
+    free(flat->flags);
+    free(flat->offsets);
+    free(flat->ends);
+    free(flat->payloads);
+    free(flat->nodes);
+    free(flat->lists);
+    free(flat->numbers);
+    free(flat->atoms);
+    free(flat->chars);
+
+    *flat = (flat_t) {0};
+}
+
+size_t flat_bytes(const flat_t *flat)
+{
+    size_t node = sizeof(*flat->kinds) + sizeof(*flat->ops) + sizeof(*flat->flags) +
+                  sizeof(*flat->offsets) + sizeof(*flat->ends) + sizeof(*flat->payloads) +
+                  sizeof(*flat->nodes);
+
+    return flat->count * node +
+           flat->list_count * sizeof(flat_index_t) +
+           flat->number_count * sizeof(number_t) +
+           flat->atom_count * sizeof(atom_t) +
+           flat->char_count;
+}
+
+/* makes room for `count` more items of `size` bytes */
+static void *flat_grow(void *items, size_t *capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity) return items;
+
+    size_t new_capacity = *capacity ? *capacity : FLAT_INITIAL_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    items = realloc(items, new_capacity * size);
+    if (!items)
+    {
+        ERROR("Realloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *capacity = new_capacity;
+    return items;
+}
+
+static flat_index_t flat_node(flat_t *flat, node_t *node)
+{
+    if (flat->count == flat->capacity)
+    {
+        size_t capacity = flat->capacity;
+        flat->kinds = flat_grow(flat->kinds, &capacity, flat->count + 1, sizeof(*flat->kinds));
+
+        /* the per node arrays share one capacity */
+        size_t same = flat->capacity;
+        flat->ops = flat_grow(flat->ops, &same, flat->count + 1, sizeof(*flat->ops));
+        same = flat->capacity;
+        flat->flags = flat_grow(flat->flags, &same, flat->count + 1, sizeof(*flat->flags));
+        same = flat->capacity;
+        flat->offsets = flat_grow(flat->offsets, &same, flat->count + 1, sizeof(*flat->offsets));
+        same = flat->capacity;
+        flat->ends = flat_grow(flat->ends, &same, flat->count + 1, sizeof(*flat->ends));
+        same = flat->capacity;
+        flat->payloads = flat_grow(flat->payloads, &same, flat->count + 1, sizeof(*flat->payloads));
+        same = flat->capacity;
+        flat->nodes = flat_grow(flat->nodes, &same, flat->count + 1, sizeof(*flat->nodes));
+
+        flat->capacity = capacity;
+    }
+
+    if (flat->count == 0) flat->file = node->loc.file;
+    assert(node->loc.file == flat->file);
+    assert(flat->count < FLAT_NONE);
+
+    flat_index_t index = flat->count++;
+    flat->kinds[index] = node->type;
+    flat->ops[index] = node->op;
+    flat->flags[index] = node->flags;
+    flat->offsets[index] = node->loc.offset;
+    flat->payloads[index] = (flat_payload_t) { FLAT_NONE, FLAT_NONE, FLAT_NONE };
+    flat->nodes[index] = node;
+    return index;
+}
+
+/* `count` list words, filled in by the caller */
+static flat_index_t flat_list(flat_t *flat, size_t count)
+{
+    flat->lists = flat_grow(flat->lists, &flat->list_capacity, flat->list_count + count, sizeof(flat_index_t));
+
+    flat_index_t start = flat->list_count;
+    flat->list_count += count;
+    return start;
+}
+
+static flat_index_t flat_number(flat_t *flat, number_t number)
+{
+    flat->numbers = flat_grow(flat->numbers, &flat->number_capacity, flat->number_count + 1, sizeof(number_t));
+    flat->numbers[flat->number_count] = number;
+    return flat->number_count++;
+}
+
+static flat_index_t flat_atom(flat_t *flat, atom_t atom)
+{
+    if (!atom) return FLAT_NONE;
+
+    flat->atoms = flat_grow(flat->atoms, &flat->atom_capacity, flat->atom_count + 1, sizeof(atom_t));
+    flat->atoms[flat->atom_count] = atom;
+    return flat->atom_count++;
+}
+
+static flat_index_t flat_string(flat_t *flat, const char *string)
+{
+    if (!string) return FLAT_NONE;
+
+    size_t length = strlen(string) + 1;
+    flat->chars = flat_grow(flat->chars, &flat->char_capacity, flat->char_count + length, 1);
+    memcpy(flat->chars + flat->char_count, string, length);
+
+    flat_index_t offset = flat->char_count;
+    flat->char_count += length;
+    return offset;
+}
+
+/* children are built before their slot is written, building may move the arrays */
+static flat_index_t flat_nodes(flat_t *flat, node_t **nodes, size_t count)
+{
+    flat_index_t start = flat_list(flat, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        flat_index_t child = flat_build(flat, nodes[i]);
+        flat->lists[start + i] = child;
+    }
+    return start;
+}
+
+static flat_index_t flat_strings(flat_t *flat, char **strings, size_t count)
+{
+    flat_index_t start = flat_list(flat, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        flat_index_t offset = flat_string(flat, strings[i]);
+        flat->lists[start + i] = offset;
+    }
+    return start;
+}
+
+flat_index_t flat_build(flat_t *flat, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'flat_build'");
+
+    if (!node) return FLAT_NONE;
+
+    flat_index_t index = flat_node(flat, node);
+    flat_payload_t payload = { FLAT_NONE, FLAT_NONE, FLAT_NONE };
+
+    switch (node->type)
+    {
+        case NODE_NUMBER: payload.a = flat_number(flat, node->number); break;
+        case NODE_STRING: payload.a = flat_string(flat, node->string); break;
+        case NODE_BOOL: payload.a = node->boolean; break;
+        case NODE_IDENTIFIER: payload.a = flat_atom(flat, node->identifier); break;
+
+        case NODE_UNDEFINED:
+        case NODE_NULL:
+        case NODE_THIS:
+        case NODE_DEBUGGER:
+        case NODE_EMPTY:
+            break;
+
+        case NODE_ARRAY:
+            payload.a = flat_nodes(flat, node->array.elements, node->array.count);
+            payload.b = node->array.count;
+            break;
+
+        case NODE_PROGRAM:
+            payload.a = flat_nodes(flat, node->program.statements, node->program.count);
+            payload.b = node->program.count;
+            break;
+
+        case NODE_BLOCK:
+            payload.a = flat_nodes(flat, node->block.statements, node->block.count);
+            payload.b = node->block.count;
+            break;
+
+        case NODE_OBJECT:
+        {
+            flat_index_t start = flat_list(flat, 2 * node->object.count);
+            for (size_t i = 0; i < node->object.count; i++)
+            {
+                flat_index_t key = flat_atom(flat, node->object.keys[i]);
+                flat_index_t value = flat_build(flat, node->object.values[i]);
+                flat->lists[start + 2 * i] = key;
+                flat->lists[start + 2 * i + 1] = value;
+            }
+            payload.a = start;
+            payload.b = node->object.count;
+            break;
+        }
+
+        case NODE_SPREAD: payload.a = flat_build(flat, node->spread.argument); break;
+        case NODE_UNARY: payload.a = flat_build(flat, node->unary.right); break;
+        case NODE_POSTFIX: payload.a = flat_build(flat, node->postfix.left); break;
+        case NODE_AWAIT: payload.a = flat_build(flat, node->await_expr.argument); break;
+        case NODE_NEW: payload.a = flat_build(flat, node->new_expr.argument); break;
+        case NODE_THROW: payload.a = flat_build(flat, node->throw_stmt.value); break;
+        case NODE_RETURN: payload.a = flat_build(flat, node->return_stmt.value); break;
+
+        case NODE_BINARY:
+            payload.a = flat_build(flat, node->binary.left);
+            payload.b = flat_build(flat, node->binary.right);
+            break;
+
+        case NODE_ASSIGNMENT:
+            payload.a = flat_build(flat, node->assignment.target);
+            payload.b = flat_build(flat, node->assignment.value);
+            break;
+
+        case NODE_TERNARY:
+            payload.a = flat_build(flat, node->ternary.condition);
+            payload.b = flat_build(flat, node->ternary.true_expr);
+            payload.c = flat_build(flat, node->ternary.false_expr);
+            break;
+
+        case NODE_IF:
+            payload.a = flat_build(flat, node->if_stmt.condition);
+            payload.b = flat_build(flat, node->if_stmt.then_branch);
+            payload.c = flat_build(flat, node->if_stmt.else_branch);
+            break;
+
+        case NODE_WHILE:
+            payload.a = flat_build(flat, node->while_stmt.condition);
+            payload.b = flat_build(flat, node->while_stmt.body);
+            break;
+
+        case NODE_DO_WHILE:
+            payload.a = flat_build(flat, node->do_while_stmt.body);
+            payload.b = flat_build(flat, node->do_while_stmt.condition);
+            break;
+
+        case NODE_FOR:
+        {
+            /* in evaluation order */
+            node_t *parts[] = {
+                node->for_stmt.init,
+                node->for_stmt.condition,
+                node->for_stmt.increment,
+                node->for_stmt.body,
+            };
+            payload.a = flat_nodes(flat, parts, 4);
+            break;
+        }
+
+        case NODE_CALL:
+            payload.a = flat_build(flat, node->call.callee);
+            payload.b = flat_nodes(flat, node->call.args, node->call.arg_count);
+            payload.c = node->call.arg_count;
+            break;
+
+        case NODE_INDEX:
+            payload.a = flat_build(flat, node->index.array);
+            payload.b = flat_build(flat, node->index.index);
+            break;
+
+        case NODE_MEMBER:
+            payload.a = flat_build(flat, node->member.object);
+            payload.b = flat_build(flat, node->member.property);
+            break;
+
+        case NODE_FUNCTION:
+        {
+            size_t count = node->function.param_count;
+            flat_index_t start = flat_list(flat, 2 + 3 * count);
+            flat->lists[start] = flat_atom(flat, node->function.name);
+            flat->lists[start + 1] = node->function.is_async;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                const struct node_param *param = &node->function.params[i];
+                flat_index_t name = flat_atom(flat, param->name);
+                flat_index_t value = flat_build(flat, param->default_value);
+                flat->lists[start + 2 + 3 * i] = name;
+                flat->lists[start + 3 + 3 * i] = value;
+                flat->lists[start + 4 + 3 * i] = param->is_rest;
+            }
+
+            /* a lazily pre-parsed body stays FLAT_NONE */
+            payload.a = flat_build(flat, node->function.body);
+            payload.b = start;
+            payload.c = count;
+            break;
+        }
+
+        case NODE_DECLARATION:
+        {
+            flat->ops[index] = node->declaration.kind;
+            size_t count = node->declaration.count;
+            flat_index_t start = flat_list(flat, 2 * count);
+            for (size_t i = 0; i < count; i++)
+            {
+                flat_index_t name = flat_build(flat, node->declaration.names[i]);
+                flat_index_t value = flat_build(flat,
+                    node->declaration.values ? node->declaration.values[i] : NULL);
+                flat->lists[start + 2 * i] = name;
+                flat->lists[start + 2 * i + 1] = value;
+            }
+            payload.a = start;
+            payload.b = count;
+            break;
+        }
+
+        case NODE_SWITCH:
+        {
+            payload.a = flat_build(flat, node->switch_stmt.expr);
+
+            /* cases are variable length, reserve all of them up front */
+            size_t words = 0;
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+                words += 3 + node->switch_stmt.cases[i].labels_count;
+
+            flat_index_t start = flat_list(flat, words);
+            flat_index_t at = start;
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+            {
+                const struct node_case *c = &node->switch_stmt.cases[i];
+                flat->lists[at] = c->is_default;
+                flat->lists[at + 2] = c->labels_count;
+
+                for (size_t j = 0; j < c->labels_count; j++)
+                {
+                    flat_index_t label = flat_build(flat, c->labels[j]);
+                    flat->lists[at + 3 + j] = label;
+                }
+
+                flat_index_t body = flat_build(flat, c->body);
+                flat->lists[at + 1] = body;
+                at += 3 + c->labels_count;
+            }
+
+            payload.b = start;
+            payload.c = node->switch_stmt.cases_count;
+            break;
+        }
+
+        case NODE_LABEL:
+            payload.a = flat_atom(flat, node->label.name);
+            payload.b = flat_build(flat, node->label.statement);
+            break;
+
+        case NODE_BREAK: payload.a = flat_atom(flat, node->break_stmt.label); break;
+        case NODE_CONTINUE: payload.a = flat_atom(flat, node->continue_stmt.label); break;
+
+        case NODE_TRY:
+        {
+            flat_index_t start = flat_list(flat, 4);
+            flat_index_t part = flat_build(flat, node->try_stmt.try_block);
+            flat->lists[start] = part;
+            flat->lists[start + 1] = flat_atom(flat, node->try_stmt.catch_param);
+            part = flat_build(flat, node->try_stmt.catch_block);
+            flat->lists[start + 2] = part;
+            part = flat_build(flat, node->try_stmt.finally_block);
+            flat->lists[start + 3] = part;
+            payload.a = start;
+            break;
+        }
+
+        case NODE_IMPORT:
+        {
+            flat_index_t start = flat_list(flat, 2);
+            flat_index_t text = flat_string(flat, node->import_stmt.module);
+            flat->lists[start] = text;
+            text = flat_string(flat, node->import_stmt.default_name);
+            flat->lists[start + 1] = text;
+
+            /* the names follow directly */
+            flat_strings(flat, node->import_stmt.imported, node->import_stmt.named_count);
+            payload.a = start;
+            payload.b = node->import_stmt.named_count;
+            break;
+        }
+
+        case NODE_EXPORT:
+            flat->ops[index] = node->export_stmt.is_default;
+            payload.a = flat_build(flat, node->export_stmt.declaration);
+            payload.b = flat_strings(flat, node->export_stmt.exported, node->export_stmt.named_count);
+            payload.c = node->export_stmt.named_count;
+            break;
+
+        default:
+            UNREACHABLE;
+    }
+
+    flat->payloads[index] = payload;
+    flat->ends[index] = flat->count;
+    return index;
+}
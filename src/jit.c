@@ -0,0 +1,746 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "jit.h"
+#include "runtime.h"
+#include "vm.h"
+
+#if JIT_AVAILABLE
+
+#include <float.h>
+#include <stddef.h>
+
+#include "assembler.h"
+
+#define JIT_INITIAL_CAPACITY 256
+
+/* the VM's registers live in callee-saved ones while the code runs */
+#define JIT_SP ASM_RBX
+#define JIT_BASE ASM_R12
+#define JIT_GLOBALS ASM_R13
+#define JIT_STATE ASM_R14
+
+static_assert(sizeof(value_t) % 16 == 0, "Values are copied 16 bytes at a time");
+static_assert(LDBL_MANT_DIG == 64, "Numbers are computed with x87 extended precision");
+
+/* a jump to the template of the instruction at `target` */
+typedef struct jit_patch
+{
+    size_t at;              /**< of the 32-bit displacement */
+    uint32_t target;
+} jit_patch_t;
+
+typedef struct jit_assembler
+{
+    assembler_t as;
+    bytecode_function_t *function;
+    bool traces;            /**< loops exit to the VM to be traced */
+
+    uint32_t *offsets;
+
+    jit_patch_t *patches;
+    size_t patch_count;
+    size_t patch_capacity;
+
+    size_t epilogue;
+} jit_assembler_t;
+
+typedef uint32_t (*jit_entry_t)(jit_state_t *state, const uint8_t *resume);
+
+/* makes room for `needed` items of `size` bytes */
+static void *jit_grow(void *items, size_t *capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity) return items;
+
+    size_t new_capacity = *capacity ? *capacity : JIT_INITIAL_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    items = realloc(items, new_capacity * size);
+    if (!items)
+    {
+        ERROR("Realloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *capacity = new_capacity;
+    return items;
+}
+
+static inline uint32_t jit_operand(const uint8_t *ip)
+{
+    uint32_t operand;
+    memcpy(&operand, ip, sizeof(operand));
+    return operand;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Slow paths                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static bool jit_truthy(const value_t *value)
+{
+    return runtime_truthy(*value);
+}
+
+#define JIT_ARITHMETIC(op) \
+    do { \
+        sp--; \
+        sp[-1] = value_number(runtime_to_number(sp[-1]) op runtime_to_number(sp[0])); \
+    } while (0)
+
+#define JIT_BITWISE(expression) \
+    do { \
+        sp--; \
+        int32_t a = runtime_to_int32(runtime_to_number(sp[-1])); \
+        int32_t b = runtime_to_int32(runtime_to_number(sp[0])); \
+        sp[-1] = value_number((number_t) (expression)); \
+    } while (0)
+
+#define JIT_COMPARE(left, right, or_equal) \
+    do { \
+        sp--; \
+        sp[-1] = value_bool(runtime_less(left, right, or_equal)); \
+    } while (0)
+
+#define JIT_NUMBERS(op) \
+    do { \
+        sp--; \
+        sp[-1].number = sp[-1].number op sp[0].number; \
+    } while (0)
+
+#define JIT_NUMBERS_COMPARE(op) \
+    do { \
+        sp--; \
+        sp[-1] = value_bool(sp[-1].number op sp[0].number); \
+    } while (0)
+
+value_t *jit_step(jit_state_t *state, value_t *sp, const uint8_t *ip)
+{
+    bytecode_op_t op = *ip++;
+    switch (op)
+    {
+        case BYTECODE_PUSH_CONSTANT:
+            *sp++ = state->function->constants[jit_operand(ip)];
+            break;
+
+        case BYTECODE_PUSH_UNDEFINED: *sp++ = value_undefined(); break;
+        case BYTECODE_PUSH_NULL: *sp++ = value_null(); break;
+        case BYTECODE_PUSH_TRUE: *sp++ = value_bool(true); break;
+        case BYTECODE_PUSH_FALSE: *sp++ = value_bool(false); break;
+
+        case BYTECODE_POP:
+            sp--;
+            break;
+
+        case BYTECODE_DUP:
+            sp[0] = sp[-1];
+            sp++;
+            break;
+
+        case BYTECODE_GET_LOCAL: *sp++ = state->base[jit_operand(ip)]; break;
+        case BYTECODE_SET_LOCAL: state->base[jit_operand(ip)] = sp[-1]; break;
+        case BYTECODE_GET_GLOBAL: *sp++ = state->globals[jit_operand(ip)]; break;
+        case BYTECODE_SET_GLOBAL: state->globals[jit_operand(ip)] = sp[-1]; break;
+
+        case BYTECODE_GET_ENV:
+            *sp++ = *env_lookup(state->env, jit_operand(ip), jit_operand(ip + sizeof(uint32_t)));
+            break;
+
+        case BYTECODE_SET_ENV:
+            *env_lookup(state->env, jit_operand(ip), jit_operand(ip + sizeof(uint32_t))) = sp[-1];
+            break;
+
+        case BYTECODE_GET_CALLEE:
+            *sp++ = state->base[-1];
+            break;
+
+        case BYTECODE_GET_MEMBER:
+            sp[-1] = runtime_member(sp[-1], state->function->constants[jit_operand(ip)].string);
+            break;
+
+        case BYTECODE_ADD:
+            sp--;
+            sp[-1] = runtime_add(sp[-1], sp[0]);
+            break;
+
+        case BYTECODE_SUB: JIT_ARITHMETIC(-); break;
+        case BYTECODE_MUL: JIT_ARITHMETIC(*); break;
+        case BYTECODE_DIV: JIT_ARITHMETIC(/); break;
+
+        case BYTECODE_MOD:
+            sp--;
+            sp[-1] = value_number(fmodl(runtime_to_number(sp[-1]), runtime_to_number(sp[0])));
+            break;
+
+        case BYTECODE_POW:
+            sp--;
+            sp[-1] = value_number(powl(runtime_to_number(sp[-1]), runtime_to_number(sp[0])));
+            break;
+
+        case BYTECODE_BIT_AND: JIT_BITWISE(a & b); break;
+        case BYTECODE_BIT_OR: JIT_BITWISE(a | b); break;
+        case BYTECODE_BIT_XOR: JIT_BITWISE(a ^ b); break;
+        case BYTECODE_SHL: JIT_BITWISE((int32_t) ((uint32_t) a << (b & 31))); break;
+        case BYTECODE_SHR: JIT_BITWISE(a >> (b & 31)); break;
+
+        case BYTECODE_EQ:
+            sp--;
+            sp[-1] = value_bool(runtime_equals(sp[-1], sp[0]));
+            break;
+
+        case BYTECODE_NE:
+            sp--;
+            sp[-1] = value_bool(!runtime_equals(sp[-1], sp[0]));
+            break;
+
+        case BYTECODE_STRICT_EQ:
+            sp--;
+            sp[-1] = value_bool(runtime_strict_equals(sp[-1], sp[0]));
+            break;
+
+        case BYTECODE_LT: JIT_COMPARE(sp[-1], sp[0], false); break;
+        case BYTECODE_GT: JIT_COMPARE(sp[0], sp[-1], false); break;
+        case BYTECODE_LE: JIT_COMPARE(sp[-1], sp[0], true); break;
+        case BYTECODE_GE: JIT_COMPARE(sp[0], sp[-1], true); break;
+
+        case BYTECODE_ADD_NUMBER: JIT_NUMBERS(+); break;
+        case BYTECODE_SUB_NUMBER: JIT_NUMBERS(-); break;
+        case BYTECODE_MUL_NUMBER: JIT_NUMBERS(*); break;
+        case BYTECODE_DIV_NUMBER: JIT_NUMBERS(/); break;
+        case BYTECODE_LT_NUMBER: JIT_NUMBERS_COMPARE(<); break;
+        case BYTECODE_GT_NUMBER: JIT_NUMBERS_COMPARE(>); break;
+        case BYTECODE_LE_NUMBER: JIT_NUMBERS_COMPARE(<=); break;
+        case BYTECODE_GE_NUMBER: JIT_NUMBERS_COMPARE(>=); break;
+
+        case BYTECODE_NEGATE:
+            sp[-1] = value_number(-runtime_to_number(sp[-1]));
+            break;
+
+        case BYTECODE_TO_NUMBER:
+            sp[-1] = value_number(runtime_to_number(sp[-1]));
+            break;
+
+        case BYTECODE_BIT_NOT:
+            sp[-1] = value_number((number_t) ~runtime_to_int32(runtime_to_number(sp[-1])));
+            break;
+
+        case BYTECODE_NOT:
+            sp[-1] = value_bool(!runtime_truthy(sp[-1]));
+            break;
+
+        case BYTECODE_TYPEOF:
+            sp[-1] = (value_t) { .type = VALUE_STRING, .string = (char *) runtime_typeof(sp[-1]) };
+            break;
+
+        case BYTECODE_IS_UNDEFINED:
+            sp[-1] = value_bool(sp[-1].type == VALUE_UNDEFINED);
+            break;
+
+        case BYTECODE_INC:
+            sp[-1] = value_number(runtime_to_number(sp[-1]) + 1);
+            break;
+
+        case BYTECODE_DEC:
+            sp[-1] = value_number(runtime_to_number(sp[-1]) - 1);
+            break;
+
+        case BYTECODE_ENTER_SCOPE:
+            state->env = env_enter_scope(state->env, jit_operand(ip));
+            break;
+
+        case BYTECODE_LEAVE_SCOPE:
+            state->env = state->env->parent;
+            break;
+
+        case BYTECODE_COPY_SCOPE: {
+            env_t *copy = env_enter_scope(state->env->parent, state->env->size);
+            memcpy(copy->slots, state->env->slots, state->env->size * sizeof(value_t));
+            state->env = copy;
+            break;
+        }
+
+        case BYTECODE_CLOSURE:
+            *sp++ = value_function(vm_closure(state->function->functions[jit_operand(ip)], state->env));
+            break;
+
+        default:
+            UNREACHABLE;
+    }
+    return sp;
+}
+
+#undef JIT_ARITHMETIC
+#undef JIT_BITWISE
+#undef JIT_COMPARE
+#undef JIT_NUMBERS
+#undef JIT_NUMBERS_COMPARE
+
+/* -------------------------------------------------------------------------- */
+/* Templates                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* values are addressed relative to a register, operands as `sp[index]` */
+#define JIT_AT(index) ((index) * JIT_VALUE)
+
+static void jit_copy(assembler_t *as, int to, int32_t to_disp, int from, int32_t from_disp)
+{
+    for (int32_t i = 0; i < JIT_VALUE; i += 16)
+    {
+        asm_memory(as, false, 0x0F10, 0, from, from_disp + i);     /* movups xmm0, [from] */
+        asm_memory(as, false, 0x0F11, 0, to, to_disp + i);         /* movups [to], xmm0 */
+    }
+}
+
+static void jit_adjust(assembler_t *as, int count)
+{
+    asm_lea(as, JIT_SP, JIT_SP, JIT_AT(count));
+}
+
+static void jit_set_type(assembler_t *as, int32_t disp, value_type_t type)
+{
+    asm_memory(as, false, 0xC7, 0, JIT_SP, disp + JIT_TYPE);
+    asm_u32(as, type);
+}
+
+/* jumps away unless `sp[index]` has `type`, returns the jump */
+static size_t jit_guard(assembler_t *as, int index, value_type_t type)
+{
+    asm_memory(as, false, 0x83, 7, JIT_SP, JIT_AT(index) + JIT_TYPE);
+    asm_byte(as, type);
+    return asm_jump_forward(as, ASM_NE);
+}
+
+static void jit_fld(assembler_t *as, int index)
+{
+    asm_fld(as, JIT_SP, JIT_AT(index) + JIT_NUMBER);
+}
+
+static void jit_fstp(assembler_t *as, int index)
+{
+    asm_fstp(as, JIT_SP, JIT_AT(index) + JIT_NUMBER);
+}
+
+/* the two numbers on top, the result replaces the left one */
+static void jit_numbers(assembler_t *as, uint16_t opcode)
+{
+    jit_fld(as, -2);
+    jit_fld(as, -1);
+    asm_x87(as, opcode);
+    jit_fstp(as, -2);
+    jit_adjust(as, -1);
+}
+
+/*
+ * `fucomip` compares st(0) to st(1) like unsigned integers and sets all
+ * flags for NaN, so `a < b` is tested as `b above a`, which NaN fails.
+ */
+static void jit_numbers_compare(assembler_t *as, bool swap, bool or_equal)
+{
+    jit_fld(as, swap ? -1 : -2);
+    jit_fld(as, swap ? -2 : -1);
+    asm_x87(as, ASM_FUCOMIP);
+    asm_x87(as, ASM_FSTP_ST0);
+    asm_setcc(as, or_equal ? ASM_AE : ASM_A);
+
+    jit_set_type(as, JIT_AT(-2), VALUE_BOOL);
+    asm_memory(as, false, 0x88, ASM_RAX, JIT_SP, JIT_AT(-2) + JIT_BOOLEAN);
+    jit_adjust(as, -1);
+}
+
+/* adds or subtracts one */
+static void jit_number_step(assembler_t *as, uint16_t opcode)
+{
+    jit_fld(as, -1);
+    asm_x87(as, ASM_FLD1);
+    asm_x87(as, opcode);
+    jit_fstp(as, -1);
+}
+
+static void jit_slow(assembler_t *as, const uint8_t *ip)
+{
+    asm_mov(as, ASM_RDI, JIT_STATE);
+    asm_mov(as, ASM_RSI, JIT_SP);
+    asm_mov_imm(as, ASM_RDX, (uintptr_t) ip);
+    asm_call(as, (uintptr_t) jit_step);
+    asm_mov(as, JIT_SP, ASM_RAX);
+}
+
+/* the fast path emitted before is taken when the guards hold */
+static void jit_fallback(assembler_t *as, const uint8_t *ip, size_t *guards, size_t count)
+{
+    size_t done = asm_jump_forward(as, ASM_ALWAYS);
+    for (size_t i = 0; i < count; i++)
+        asm_bind(as, guards[i]);
+    jit_slow(as, ip);
+    asm_bind(as, done);
+}
+
+static void jit_jump(jit_assembler_t *jit, int condition, uint32_t target)
+{
+    size_t at = asm_jump_forward(&jit->as, condition);
+
+    jit->patches = jit_grow(jit->patches, &jit->patch_capacity, jit->patch_count + 1, sizeof(jit_patch_t));
+    jit->patches[jit->patch_count++] = (jit_patch_t) { .at = at, .target = target };
+}
+
+/* booleans are tested inline, other values by `runtime_truthy` */
+static void jit_branch(jit_assembler_t *jit, uint32_t target, bool when, bool keep)
+{
+    assembler_t *as = &jit->as;
+    if (!keep) jit_adjust(as, -1);
+    int index = keep ? -1 : 0;
+    int condition = when ? ASM_NE : ASM_E;
+
+    size_t guard = jit_guard(as, index, VALUE_BOOL);
+    asm_memory(as, false, 0x80, 7, JIT_SP, JIT_AT(index) + JIT_BOOLEAN);
+    asm_byte(as, 0);
+    jit_jump(jit, condition, target);
+
+    size_t done = asm_jump_forward(as, ASM_ALWAYS);
+    asm_bind(as, guard);
+    asm_lea(as, ASM_RDI, JIT_SP, JIT_AT(index));
+    asm_call(as, (uintptr_t) jit_truthy);
+    asm_byte(as, 0x84);                     /* test al, al */
+    asm_byte(as, 0xC0);
+    jit_jump(jit, condition, target);
+    asm_bind(as, done);
+}
+
+/* back to the VM, which runs the instruction at `at` */
+static void jit_exit(jit_assembler_t *jit, uint32_t at)
+{
+    assembler_t *as = &jit->as;
+    asm_memory(as, true, 0x89, JIT_SP, JIT_STATE, offsetof(jit_state_t, sp));
+    asm_byte(as, 0xB8);                     /* mov eax, at */
+    asm_u32(as, at);
+    asm_jump_to(as, ASM_ALWAYS, jit->epilogue);
+}
+
+/*
+ * A back-edge counts down like in the VM and returns to it when the loop
+ * has a trace or is about to be recorded.
+ */
+static void jit_loop(jit_assembler_t *jit, const uint8_t *ip, uint32_t target)
+{
+    assembler_t *as = &jit->as;
+    if (!jit->traces)
+    {
+        jit_jump(jit, ASM_ALWAYS, target);
+        return;
+    }
+
+    bytecode_loop_t *loop = &jit->function->loops[jit_operand(ip + 1 + sizeof(uint32_t))];
+    asm_mov_imm(as, ASM_RAX, (uintptr_t) loop);
+    asm_memory(as, true, 0x83, 7, ASM_RAX, offsetof(bytecode_loop_t, trace));
+    asm_byte(as, 0);
+    size_t traced = asm_jump_forward(as, ASM_NE);
+    asm_memory(as, false, 0x83, 7, ASM_RAX, offsetof(bytecode_loop_t, countdown));
+    asm_byte(as, 1);
+    size_t hot = asm_jump_forward(as, ASM_E);
+    asm_memory(as, false, 0xFF, 1, ASM_RAX, offsetof(bytecode_loop_t, countdown));
+    jit_jump(jit, ASM_ALWAYS, target);
+
+    asm_bind(as, traced);
+    asm_bind(as, hot);
+    jit_exit(jit, (uint32_t) (ip - jit->function->code));
+}
+
+/* enters at the address in rsi with the VM's registers loaded */
+static void jit_prologue(jit_assembler_t *jit)
+{
+    assembler_t *as = &jit->as;
+    asm_push(as, ASM_RBX);
+    asm_push(as, ASM_R12);
+    asm_push(as, ASM_R13);
+    asm_push(as, ASM_R14);
+    asm_push(as, ASM_R15);
+
+    asm_mov(as, JIT_STATE, ASM_RDI);
+    asm_memory(as, true, 0x8B, JIT_SP, JIT_STATE, offsetof(jit_state_t, sp));
+    asm_memory(as, true, 0x8B, JIT_BASE, JIT_STATE, offsetof(jit_state_t, base));
+    asm_memory(as, true, 0x8B, JIT_GLOBALS, JIT_STATE, offsetof(jit_state_t, globals));
+    asm_byte(as, 0xFF);                     /* jmp rsi */
+    asm_byte(as, 0xE6);
+
+    jit->epilogue = as->length;
+    asm_pop(as, ASM_R15);
+    asm_pop(as, ASM_R14);
+    asm_pop(as, ASM_R13);
+    asm_pop(as, ASM_R12);
+    asm_pop(as, ASM_RBX);
+    asm_byte(as, 0xC3);
+}
+
+static void jit_instruction(jit_assembler_t *jit, const uint8_t *ip, uint32_t next)
+{
+    assembler_t *as = &jit->as;
+    bytecode_op_t op = *ip;
+    uint32_t operand = bytecode_op_operands(op) ? jit_operand(ip + 1) : 0;
+    uint32_t target = next + operand;
+    size_t guards[2];
+
+    static_assert(BYTECODE_COUNT == 62, "Fix BYTECODE_COUNT in 'jit_instruction'");
+    switch (op)
+    {
+        case BYTECODE_PUSH_CONSTANT:
+            asm_mov_imm(as, ASM_RAX, (uintptr_t) &jit->function->constants[operand]);
+            jit_copy(as, JIT_SP, 0, ASM_RAX, 0);
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_PUSH_UNDEFINED:
+        case BYTECODE_PUSH_NULL:
+            jit_set_type(as, 0, op == BYTECODE_PUSH_NULL ? VALUE_NULL : VALUE_UNDEFINED);
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_PUSH_TRUE:
+        case BYTECODE_PUSH_FALSE:
+            jit_set_type(as, 0, VALUE_BOOL);
+            asm_memory(as, false, 0xC6, 0, JIT_SP, JIT_BOOLEAN);
+            asm_byte(as, op == BYTECODE_PUSH_TRUE);
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_POP:
+            jit_adjust(as, -1);
+            break;
+
+        case BYTECODE_DUP:
+            jit_copy(as, JIT_SP, 0, JIT_SP, JIT_AT(-1));
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_GET_LOCAL:
+            jit_copy(as, JIT_SP, 0, JIT_BASE, JIT_AT(operand));
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_SET_LOCAL:
+            jit_copy(as, JIT_BASE, JIT_AT(operand), JIT_SP, JIT_AT(-1));
+            break;
+
+        case BYTECODE_GET_GLOBAL:
+            jit_copy(as, JIT_SP, 0, JIT_GLOBALS, JIT_AT(operand));
+            jit_adjust(as, 1);
+            break;
+
+        case BYTECODE_SET_GLOBAL:
+            jit_copy(as, JIT_GLOBALS, JIT_AT(operand), JIT_SP, JIT_AT(-1));
+            break;
+
+        case BYTECODE_GET_CALLEE:
+            jit_copy(as, JIT_SP, 0, JIT_BASE, JIT_AT(-1));
+            jit_adjust(as, 1);
+            break;
+
+        /* numbers inline, anything else like the VM */
+        case BYTECODE_ADD:
+        case BYTECODE_SUB:
+        case BYTECODE_MUL:
+        case BYTECODE_DIV:
+        case BYTECODE_LT:
+        case BYTECODE_GT:
+        case BYTECODE_LE:
+        case BYTECODE_GE:
+            guards[0] = jit_guard(as, -2, VALUE_NUMBER);
+            guards[1] = jit_guard(as, -1, VALUE_NUMBER);
+            switch (op)
+            {
+                case BYTECODE_ADD: jit_numbers(as, ASM_FADDP); break;
+                case BYTECODE_SUB: jit_numbers(as, ASM_FSUBP); break;
+                case BYTECODE_MUL: jit_numbers(as, ASM_FMULP); break;
+                case BYTECODE_DIV: jit_numbers(as, ASM_FDIVP); break;
+                case BYTECODE_LT: jit_numbers_compare(as, false, false); break;
+                case BYTECODE_GT: jit_numbers_compare(as, true, false); break;
+                case BYTECODE_LE: jit_numbers_compare(as, false, true); break;
+                case BYTECODE_GE: jit_numbers_compare(as, true, true); break;
+                default: UNREACHABLE;
+            }
+            jit_fallback(as, ip, guards, 2);
+            break;
+
+        case BYTECODE_ADD_NUMBER: jit_numbers(as, ASM_FADDP); break;
+        case BYTECODE_SUB_NUMBER: jit_numbers(as, ASM_FSUBP); break;
+        case BYTECODE_MUL_NUMBER: jit_numbers(as, ASM_FMULP); break;
+        case BYTECODE_DIV_NUMBER: jit_numbers(as, ASM_FDIVP); break;
+        case BYTECODE_LT_NUMBER: jit_numbers_compare(as, false, false); break;
+        case BYTECODE_GT_NUMBER: jit_numbers_compare(as, true, false); break;
+        case BYTECODE_LE_NUMBER: jit_numbers_compare(as, false, true); break;
+        case BYTECODE_GE_NUMBER: jit_numbers_compare(as, true, true); break;
+
+        case BYTECODE_NEGATE:
+            guards[0] = jit_guard(as, -1, VALUE_NUMBER);
+            jit_fld(as, -1);
+            asm_x87(as, ASM_FCHS);
+            jit_fstp(as, -1);
+            jit_fallback(as, ip, guards, 1);
+            break;
+
+        case BYTECODE_INC:
+        case BYTECODE_DEC:
+            guards[0] = jit_guard(as, -1, VALUE_NUMBER);
+            jit_number_step(as, op == BYTECODE_INC ? ASM_FADDP : ASM_FSUBP);
+            jit_fallback(as, ip, guards, 1);
+            break;
+
+        case BYTECODE_JUMP:
+            jit_jump(jit, ASM_ALWAYS, target);
+            break;
+
+        case BYTECODE_JUMP_IF_FALSE: jit_branch(jit, target, false, false); break;
+        case BYTECODE_JUMP_IF_TRUE: jit_branch(jit, target, true, false); break;
+        case BYTECODE_JUMP_IF_FALSE_KEEP: jit_branch(jit, target, false, true); break;
+        case BYTECODE_JUMP_IF_TRUE_KEEP: jit_branch(jit, target, true, true); break;
+
+        case BYTECODE_LOOP:
+            jit_loop(jit, ip, target);
+            break;
+
+        /* the VM pushes and pops frames */
+        case BYTECODE_CALL:
+        case BYTECODE_TAIL_CALL:
+        case BYTECODE_RETURN:
+            jit_exit(jit, (uint32_t) (ip - jit->function->code));
+            break;
+
+        case BYTECODE_GET_ENV:
+        case BYTECODE_SET_ENV:
+        case BYTECODE_GET_MEMBER:
+        case BYTECODE_MOD:
+        case BYTECODE_POW:
+        case BYTECODE_BIT_AND:
+        case BYTECODE_BIT_OR:
+        case BYTECODE_BIT_XOR:
+        case BYTECODE_SHL:
+        case BYTECODE_SHR:
+        case BYTECODE_EQ:
+        case BYTECODE_NE:
+        case BYTECODE_STRICT_EQ:
+        case BYTECODE_TO_NUMBER:
+        case BYTECODE_BIT_NOT:
+        case BYTECODE_NOT:
+        case BYTECODE_TYPEOF:
+        case BYTECODE_IS_UNDEFINED:
+        case BYTECODE_ENTER_SCOPE:
+        case BYTECODE_LEAVE_SCOPE:
+        case BYTECODE_COPY_SCOPE:
+        case BYTECODE_CLOSURE:
+            jit_slow(as, ip);
+            break;
+
+        default:
+            UNREACHABLE;
+    }
+}
+
+#undef JIT_AT
+
+static void jit_assembler_free(jit_assembler_t *jit)
+{
+    asm_free(&jit->as);
+    free(jit->offsets);
+    free(jit->patches);
+}
+
+jit_code_t *jit_compile(bytecode_function_t *function, bool traces)
+{
+    jit_assembler_t jit = { .function = function, .traces = traces };
+    asm_init(&jit.as);
+    jit.offsets = malloc((function->length + 1) * sizeof(uint32_t));
+    if (!jit.offsets)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    jit_prologue(&jit);
+    for (size_t at = 0; at < function->length; )
+    {
+        uint32_t next = (uint32_t) (at + 1 + bytecode_op_operands(function->code[at]) * sizeof(uint32_t));
+        jit.offsets[at] = (uint32_t) jit.as.length;
+        jit_instruction(&jit, function->code + at, next);
+        at = next;
+    }
+
+    /* the last instruction returns, ud2 if it did not */
+    asm_byte(&jit.as, 0x0F);
+    asm_byte(&jit.as, 0x0B);
+
+    for (size_t i = 0; i < jit.patch_count; i++)
+        asm_patch(&jit.as, jit.patches[i].at, jit.offsets[jit.patches[i].target]);
+
+    size_t size;
+    uint8_t *code = asm_map(&jit.as, &size);
+    if (!code)
+    {
+        jit_assembler_free(&jit);
+        return NULL;
+    }
+
+    jit_code_t *result = malloc(sizeof(jit_code_t));
+    if (!result)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    result->code = code;
+    result->length = jit.as.length;
+    result->size = size;
+    result->offsets = jit.offsets;
+
+    jit.offsets = NULL;
+    jit_assembler_free(&jit);
+    return result;
+}
+
+void jit_code_free(jit_code_t *code)
+{
+    if (!code) return;
+    asm_unmap(code->code, code->size);
+    free(code->offsets);
+    free(code);
+}
+
+uint32_t jit_run(jit_code_t *code, jit_state_t *state, uint32_t at)
+{
+    jit_entry_t entry = (jit_entry_t) (uintptr_t) code->code;
+    return entry(state, code->code + code->offsets[at]);
+}
+
+#else /* !JIT_AVAILABLE */
+
+value_t *jit_step(jit_state_t *state, value_t *sp, const uint8_t *ip)
+{
+    (void) state;
+    (void) sp;
+    (void) ip;
+    UNREACHABLE;
+}
+
+jit_code_t *jit_compile(bytecode_function_t *function, bool traces)
+{
+    (void) function;
+    (void) traces;
+    return NULL;
+}
+
+void jit_code_free(jit_code_t *code)
+{
+    (void) code;
+}
+
+uint32_t jit_run(jit_code_t *code, jit_state_t *state, uint32_t at)
+{
+    (void) code;
+    (void) state;
+    (void) at;
+    UNREACHABLE;
+}
+
+#endif /* JIT_AVAILABLE */
@@ -2,136 +2,127 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <float.h>
+#include <stdint.h>
+#include <math.h>
 #include <stdbool.h>
 #include <assert.h>
 
 #include "utils.h"
 #include "lexer.h"
 
-char *lexer_strndup(const char *s, size_t n)
+const char *lexer_token_text(const lexer_t *lexer, const token_t *token)
 {
-    size_t len = strlen(s);
-    if (len > n) len = n;
+    if (token->escaped)
+        return &lexer->strings[token->string];
 
-    char *new = malloc(len + 1);
+    /* the text of a string literal starts after its opening quote */
+    if (token->type == TOKEN_STRING_LITERAL)
+        return &lexer->source[token->loc.offset + 1];
+    return &lexer->source[token->loc.offset];
+}
+
+char *lexer_token_strdup(const lexer_t *lexer, const token_t *token)
+{
+    char *new = malloc(token->length + 1);
     if (new == NULL)
         return NULL;
-    
-    new[len] = '\0';
-    return memcpy(new, s, len);
+
+    new[token->length] = '\0';
+    return memcpy(new, lexer_token_text(lexer, token), token->length);
 }
 
-char *lexer_readfile(char *filename)
+number_t lexer_token_number(const lexer_t *lexer, const token_t *token)
 {
-    FILE *f = fopen(filename, "rb");
-	if (!f)
-	{
-		perror("fopen");
-		return NULL;
-	}
-
-	if (fseek(f, 0, SEEK_END) != 0)
-	{
-		perror("fseek");
-		fclose(f);
-		return NULL;
-	}
-
-	const long size = ftell(f);
-	if (size < 0)
-	{
-		perror("ftell");
-		fclose(f);
-		return NULL;
-	}
-
-	rewind(f);
-
-	char *buffer = malloc(size + 1);
-	if (!buffer)
-	{
-		fprintf(stderr, "Memory allocation failed\n");
-		fclose(f);
-		return NULL;
-	}
-
-	const size_t read_size = fread(buffer, 1, size, f);
-	if (read_size != (size_t) size)
-	{
-		fprintf(stderr, "Could not read whole file\n");
-		free(buffer);
-		fclose(f);
-		return NULL;
-	}
-
-	buffer[size] = '\0';
-
-	fclose(f);
-	return buffer;
+    assert(token->type == TOKEN_NUMBER_LITERAL);
+    return lexer->numbers[token->number];
 }
 
-static void lexer_tokenize(lexer_t *lexer);
+/*
+ * The hash in `lexer_keyword` takes the first two characters of each
+ * reserved word from TOKEN_KEYWORDS, a C string cannot be indexed in a
+ * case label, so they are checked against the spelling here instead.
+ */
+#ifndef NDEBUG
+static bool lexer_keywords_valid(void)
+{
+#define X(type, spelling, c0, c1) \
+    if (spelling[0] != c0 || spelling[1] != c1) return false;
+    TOKEN_KEYWORDS(X)
+#undef X
+    return true;
+}
+#endif
 
 void lexer_init(lexer_t *lexer, char *filename, char *source)
 {
-    if (source) {
-        lexer->source = strdup(source);
-        lexer->loc.filename = filename ? strdup(filename) : strdup("(null)");
-    } else if (filename) {
-        lexer->source = lexer_readfile(filename);
-        if (!lexer->source) {
-            lexer->had_error = true;
-            return;
-        }
-        lexer->loc.filename = strdup(filename);
-    } else {
+    assert(lexer_keywords_valid());
+
+    lexer->pos = 0;
+
+    lexer->head = 0;
+    lexer->index = 0;
+    lexer->count = 0;
+
+    lexer->strings = NULL;
+    lexer->strings_length = 0;
+    lexer->strings_capacity = 0;
+
+    lexer->had_error = false;
+
+    if (source)
+        lexer->file = source_from_string(filename, source);
+    else if (filename)
+        lexer->file = source_load(filename);
+    else
+        lexer->file = SOURCE_NONE;
+
+    const source_t *loaded = source_get(lexer->file);
+    if (!loaded)
+    {
         lexer->source = NULL;
-        lexer->loc.filename = NULL;
+        lexer->length = 0;
         lexer->had_error = true;
         return;
     }
 
-    // lexer->source = lexer_readfile(filename);
-    // if (!lexer->source)
-    // {
-    //     lexer->had_error = true;
-    //     return;
-    // }
-
-    // lexer->loc.filename = strdup(filename);
-    lexer->length = strlen(lexer->source);
-    
-    lexer->loc.line = lexer->loc.column = 1;
-    lexer->pos = 0;
+    /* borrowed from the source registry, the text is never copied */
+    lexer->source = loaded->data;
+    lexer->length = loaded->length;
+
+    /* tokens are produced on demand by `lexer_next` */
+}
+
+void lexer_init_range(lexer_t *lexer, source_id_t file, size_t start, size_t end)
+{
+    const source_t *loaded = source_get(file);
+    assert(loaded && start <= end && end <= loaded->length);
+    assert(lexer_keywords_valid());
 
-    lexer->tokens = NULL;
+    lexer->head = 0;
     lexer->index = 0;
     lexer->count = 0;
-    lexer->capacity = 0;
+
+    lexer->strings = NULL;
+    lexer->strings_length = 0;
+    lexer->strings_capacity = 0;
 
     lexer->had_error = false;
 
-    lexer_tokenize(lexer);
+    /* the source is not cut, so offsets and locations stay file relative */
+    lexer->file = file;
+    lexer->source = loaded->data;
+    lexer->length = end;
+    lexer->pos = start;
 }
 
 void lexer_free(lexer_t *lexer)
 {
     if (!lexer) return;
 
-    for (size_t i = 0; i < lexer->count; i++)
-    {
-        token_t token = lexer->tokens[i];
-        free(token.loc.filename);
-        free(token.value);
-        token.value = NULL;
-    }
-
-    free(lexer->tokens);
-    lexer->tokens = NULL;
-    lexer->count = lexer->capacity = 0;
+    /* tokens are views into `source` and `strings`, nothing to free per token */
+    free(lexer->strings);
 
-    free(lexer->loc.filename);
-    free(lexer->source);
     free(lexer);
 }
 
@@ -149,61 +140,570 @@ static char lexer_advance(lexer_t *lex)
     unsigned char c = lex->source[lex->pos++];
 
     if (c > 127) {
-        LEXER_ERROR(lex, "Non-ASCII character encountered\n");
+        LEXER_ERROR_AT(lex, lex->pos - 1, "Non-ASCII character encountered\n");
         return '\0';
     }
 
-    if (c == '\n')
+    return c;
+}
+
+/*
+ * Skipping kernels. Each one moves `pos` to the first byte which stops the
+ * scan, or to the end of the source. Bytes above 127 always stop so that
+ * `lexer_advance` reports them. A block of LEXER_VEC_WIDTH bytes is tested at
+ * once with SSE2/AVX2 when available, the tail is scanned byte by byte.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define LEXER_VEC_WIDTH 32
+typedef __m256i lexer_vec_t;
+
+#define VEC_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define VEC_EQ(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))
+#define VEC_GT(v, c) _mm256_cmpgt_epi8((v), _mm256_set1_epi8(c))
+#define VEC_LT(v, c) _mm256_cmpgt_epi8(_mm256_set1_epi8(c), (v))
+#define VEC_OR(a, b) _mm256_or_si256((a), (b))
+#define VEC_AND(a, b) _mm256_and_si256((a), (b))
+#define VEC_MASK(v) ((uint32_t) _mm256_movemask_epi8(v))
+#define VEC_ALL 0xffffffffu
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define LEXER_VEC_WIDTH 16
+typedef __m128i lexer_vec_t;
+
+#define VEC_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define VEC_EQ(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define VEC_GT(v, c) _mm_cmpgt_epi8((v), _mm_set1_epi8(c))
+#define VEC_LT(v, c) _mm_cmpgt_epi8(_mm_set1_epi8(c), (v))
+#define VEC_OR(a, b) _mm_or_si128((a), (b))
+#define VEC_AND(a, b) _mm_and_si128((a), (b))
+#define VEC_MASK(v) ((uint32_t) _mm_movemask_epi8(v))
+#define VEC_ALL 0xffffu
+#endif
+
+/*
+ * `stop_vec` is the mask of stopping bytes in the block `v`, `stop_byte` the
+ * same test for a single byte `c`. Lines are not tracked, locations are
+ * plain offsets.
+ *
+ * VEC_MASK of a plain load has the high bit of every byte, which marks the
+ * non-ASCII ones. Comparisons are signed, so those bytes never fall into an
+ * ASCII range either.
+ */
+#ifdef LEXER_VEC_WIDTH
+#define LEXER_SKIP(lex, stop_vec, stop_byte)                                \
+    do {                                                                    \
+        const char *s = (lex)->source;                                      \
+        size_t pos = (lex)->pos, len = (lex)->length;                       \
+        for (; pos + LEXER_VEC_WIDTH <= len; pos += LEXER_VEC_WIDTH)        \
+        {                                                                   \
+            lexer_vec_t v = VEC_LOAD(&s[pos]);                              \
+            uint32_t stop = (stop_vec) | VEC_MASK(v);                       \
+            if (stop)                                                       \
+            {                                                               \
+                (lex)->pos = pos + __builtin_ctz(stop);                     \
+                return;                                                     \
+            }                                                               \
+        }                                                                   \
+        for (; pos < len; pos++)                                            \
+        {                                                                   \
+            unsigned char c = s[pos];                                       \
+            if ((stop_byte) || c > 127) break;                              \
+        }                                                                   \
+        (lex)->pos = pos;                                                   \
+    } while (0)
+#else
+#define LEXER_SKIP(lex, stop_vec, stop_byte)                                \
+    do {                                                                    \
+        const char *s = (lex)->source;                                      \
+        size_t pos = (lex)->pos, len = (lex)->length;                       \
+        for (; pos < len; pos++)                                            \
+        {                                                                   \
+            unsigned char c = s[pos];                                       \
+            if ((stop_byte) || c > 127) break;                              \
+        }                                                                   \
+        (lex)->pos = pos;                                                   \
+    } while (0)
+#endif
+
+/* same set as `isspace` in the C locale */
+static void lexer_skip_whitespace(lexer_t *lex)
+{
+    LEXER_SKIP(lex,
+        VEC_ALL & ~VEC_MASK(VEC_OR(VEC_EQ(v, ' '), VEC_AND(VEC_GT(v, '\t' - 1), VEC_LT(v, '\r' + 1)))),
+        !(c == ' ' || (c >= '\t' && c <= '\r')));
+}
+
+/* body of a `//` comment, up to the newline */
+static void lexer_skip_line_comment(lexer_t *lex)
+{
+    LEXER_SKIP(lex,
+        VEC_MASK(VEC_OR(VEC_EQ(v, '\n'), VEC_EQ(v, '\0'))),
+        c == '\n' || c == '\0');
+}
+
+/* body of a `/ *` comment, up to the next candidate for its end */
+static void lexer_skip_block_comment(lexer_t *lex)
+{
+    LEXER_SKIP(lex,
+        VEC_MASK(VEC_OR(VEC_EQ(v, '*'), VEC_EQ(v, '\0'))),
+        c == '*' || c == '\0');
+}
+
+/* body of a string literal, up to the quote or an escape sequence */
+static void lexer_skip_string(lexer_t *lex, char quote)
+{
+    LEXER_SKIP(lex,
+        VEC_MASK(VEC_OR(VEC_OR(VEC_EQ(v, quote), VEC_EQ(v, '\\')), VEC_EQ(v, '\0'))),
+        c == (unsigned char) quote || c == '\\' || c == '\0');
+}
+
+/* rest of an identifier, [A-Za-z0-9_$] */
+static void lexer_skip_identifier(lexer_t *lex)
+{
+    LEXER_SKIP(lex,
+        VEC_ALL & ~VEC_MASK(VEC_OR(
+            VEC_OR(VEC_AND(VEC_GT(v, 'a' - 1), VEC_LT(v, 'z' + 1)),
+                   VEC_AND(VEC_GT(v, 'A' - 1), VEC_LT(v, 'Z' + 1))),
+            VEC_OR(VEC_AND(VEC_GT(v, '0' - 1), VEC_LT(v, '9' + 1)),
+                   VEC_OR(VEC_EQ(v, '_'), VEC_EQ(v, '$'))))),
+        !(isalnum(c) || c == '_' || c == '$'));
+}
+
+/* longest reserved word in TOKEN_KEYWORDS */
+#define LEXER_KEYWORD_MAX 9
+
+/*
+ * Perfect hash of TOKEN_KEYWORDS on the length and the first two characters.
+ * A collision is a duplicate case label in `lexer_keyword`, so the build
+ * fails instead of a keyword silently becoming an identifier.
+ */
+#define LEXER_KEYWORD_HASH(length, c0, c1) (((c0) + (c1) * 7 + (length)) & 127)
+
+static token_type_t lexer_keyword(const char *text, size_t length)
+{
+    static_assert(TOKEN_COUNT == 88, "Fix TOKEN_KEYWORDS in 'lexer_keyword'");
+
+    if (length < 2 || length > LEXER_KEYWORD_MAX)
+        return TOKEN_IDENTIFIER;
+
+    switch (LEXER_KEYWORD_HASH(length, text[0], text[1]))
     {
-        lex->loc.line++;
-        lex->loc.column = 1;
-    } else
+#define X(type, spelling, c0, c1)                                       \
+        case LEXER_KEYWORD_HASH(sizeof(spelling) - 1, c0, c1):          \
+            if (length == sizeof(spelling) - 1 &&                       \
+                memcmp(text, spelling, sizeof(spelling) - 1) == 0)      \
+                return type;                                            \
+            break;
+        TOKEN_KEYWORDS(X)
+#undef X
+    }
+
+    return TOKEN_IDENTIFIER;
+}
+
+/*
+ * Operators are recognized by a DFA whose states are the operator tokens
+ * scanned so far. `lexer_op_start` gives the state after the first byte,
+ * `lexer_op_next` the state after each following byte, folded into one of
+ * a few classes. TOKEN_IF (0) is never an operator and marks a missing
+ * transition.
+ */
+#define LEXER_OP_NONE ((token_type_t) 0)
+
+typedef enum lexer_op_class
+{
+    OP_CLASS_OTHER = 0,
+    OP_CLASS_PLUS,      // +
+    OP_CLASS_MINUS,     // -
+    OP_CLASS_STAR,      // *
+    OP_CLASS_AMPERSAND, // &
+    OP_CLASS_PIPE,      // |
+    OP_CLASS_LESS,      // <
+    OP_CLASS_GREATER,   // >
+    OP_CLASS_EQUAL,     // =
+
+    OP_CLASS_COUNT,
+} lexer_op_class_t;
+
+static_assert(TOKEN_COUNT <= 256, "Operator tables store token types as bytes");
+
+static const uint8_t lexer_op_class[256] = {
+    ['+'] = OP_CLASS_PLUS,
+    ['-'] = OP_CLASS_MINUS,
+    ['*'] = OP_CLASS_STAR,
+    ['&'] = OP_CLASS_AMPERSAND,
+    ['|'] = OP_CLASS_PIPE,
+    ['<'] = OP_CLASS_LESS,
+    ['>'] = OP_CLASS_GREATER,
+    ['='] = OP_CLASS_EQUAL,
+};
+
+static const uint8_t lexer_op_start[256] = {
+    ['+'] = TOKEN_PLUS,
+    ['-'] = TOKEN_MINUS,
+    ['*'] = TOKEN_STAR,
+    ['/'] = TOKEN_SLASH,
+    ['%'] = TOKEN_PERCENT,
+    ['&'] = TOKEN_AMPERSAND,
+    ['|'] = TOKEN_PIPE,
+    ['^'] = TOKEN_CARET,
+    ['~'] = TOKEN_TILDE,
+    ['<'] = TOKEN_LESS,
+    ['>'] = TOKEN_GREATER,
+    ['='] = TOKEN_EQUAL,
+    ['!'] = TOKEN_BANG,
+    ['('] = TOKEN_LEFT_PAREN,
+    [')'] = TOKEN_RIGHT_PAREN,
+    ['{'] = TOKEN_LEFT_BRACE,
+    ['}'] = TOKEN_RIGHT_BRACE,
+    ['['] = TOKEN_LEFT_BRACKET,
+    [']'] = TOKEN_RIGHT_BRACKET,
+    ['.'] = TOKEN_DOT,
+    [','] = TOKEN_COMMA,
+    [';'] = TOKEN_SEMICOLON,
+    [':'] = TOKEN_COLON,
+    ['?'] = TOKEN_QUESTION,
+};
+
+static const uint8_t lexer_op_next[TOKEN_COUNT][OP_CLASS_COUNT] = {
+    [TOKEN_PLUS] = {
+        [OP_CLASS_PLUS] = TOKEN_PLUS_PLUS,
+        [OP_CLASS_EQUAL] = TOKEN_PLUS_EQUAL,
+    },
+    [TOKEN_MINUS] = {
+        [OP_CLASS_MINUS] = TOKEN_MINUS_MINUS,
+        [OP_CLASS_EQUAL] = TOKEN_MINUS_EQUAL,
+        [OP_CLASS_GREATER] = TOKEN_ARROW,
+    },
+    [TOKEN_STAR] = {
+        [OP_CLASS_STAR] = TOKEN_STAR_STAR,
+        [OP_CLASS_EQUAL] = TOKEN_STAR_EQUAL,
+    },
+    [TOKEN_STAR_STAR] = { [OP_CLASS_EQUAL] = TOKEN_STAR_STAR_EQUAL },
+    [TOKEN_SLASH] = { [OP_CLASS_EQUAL] = TOKEN_SLASH_EQUAL },
+    [TOKEN_PERCENT] = { [OP_CLASS_EQUAL] = TOKEN_PERCENT_EQUAL },
+    [TOKEN_AMPERSAND] = {
+        [OP_CLASS_AMPERSAND] = TOKEN_LOGICAL_AND,
+        [OP_CLASS_EQUAL] = TOKEN_AMPERSAND_EQUAL,
+    },
+    [TOKEN_LOGICAL_AND] = { [OP_CLASS_EQUAL] = TOKEN_LOGICAL_AND_EQUAL },
+    [TOKEN_PIPE] = {
+        [OP_CLASS_PIPE] = TOKEN_LOGICAL_OR,
+        [OP_CLASS_EQUAL] = TOKEN_PIPE_EQUAL,
+    },
+    [TOKEN_LOGICAL_OR] = { [OP_CLASS_EQUAL] = TOKEN_LOGICAL_OR_EQUAL },
+    [TOKEN_CARET] = { [OP_CLASS_EQUAL] = TOKEN_CARET_EQUAL },
+    [TOKEN_LESS] = {
+        [OP_CLASS_LESS] = TOKEN_LEFT_SHIFT,
+        [OP_CLASS_EQUAL] = TOKEN_LESS_EQUAL,
+    },
+    [TOKEN_LEFT_SHIFT] = { [OP_CLASS_EQUAL] = TOKEN_LEFT_SHIFT_EQUAL },
+    [TOKEN_GREATER] = {
+        [OP_CLASS_GREATER] = TOKEN_RIGHT_SHIFT,
+        [OP_CLASS_EQUAL] = TOKEN_GREATER_EQUAL,
+    },
+    [TOKEN_RIGHT_SHIFT] = { [OP_CLASS_EQUAL] = TOKEN_RIGHT_SHIFT_EQUAL },
+    [TOKEN_EQUAL] = { [OP_CLASS_EQUAL] = TOKEN_EQUAL_EQUAL },
+    [TOKEN_BANG] = { [OP_CLASS_EQUAL] = TOKEN_BANG_EQUAL },
+};
+
+static void lexer_emit(lexer_t *lexer, token_t *out, const token_t *token)
+{
+    *out = *token;
+    lexer->count++;
+
+#ifdef LEXER_TRACE
+    printf("[%s:%zu:%zu] %s(\"%.*s\")\n",
+        LOCATION(token->loc),
+        token_type_to_string(token->type),
+        (int) token->length,
+        lexer_token_text(lexer, token)
+    );
+#endif
+}
+
+/* append a byte to the buffer holding decoded string literals */
+static void lexer_strings_push(lexer_t *lexer, char c)
+{
+    if (lexer->strings_length == lexer->strings_capacity)
     {
-        lex->loc.column++;
+        lexer->strings_capacity = lexer->strings_capacity ? lexer->strings_capacity * 2 : 256;
+        lexer->strings = realloc(lexer->strings, lexer->strings_capacity);
+        if (!lexer->strings)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
     }
+    lexer->strings[lexer->strings_length++] = c;
+}
 
-    return c;
+static void lexer_strings_append(lexer_t *lexer, const char *text, size_t length)
+{
+    if (lexer->strings_length + length > lexer->strings_capacity)
+    {
+        size_t capacity = lexer->strings_capacity ? lexer->strings_capacity : 256;
+        while (capacity < lexer->strings_length + length)
+            capacity *= 2;
+        lexer->strings_capacity = capacity;
+        lexer->strings = realloc(lexer->strings, lexer->strings_capacity);
+        if (!lexer->strings)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(&lexer->strings[lexer->strings_length], text, length);
+    lexer->strings_length += length;
+}
+
+/*
+ * Largest mantissa and power of ten which number_t holds exactly. Their
+ * product or quotient is then correctly rounded (Clinger's fast path).
+ */
+#if LDBL_MANT_DIG >= 64
+#define LEXER_EXACT_MANTISSA UINT64_MAX
+#define LEXER_EXACT_POW10 27
+#else
+#define LEXER_EXACT_MANTISSA (UINT64_C(1) << DBL_MANT_DIG)
+#define LEXER_EXACT_POW10 22
+#endif
+
+/* significant decimal digits which always fit in a uint64_t */
+#define LEXER_MAX_DIGITS 19
+
+static const number_t lexer_pow10[] = {
+    1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+    1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+    1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+};
+
+static_assert(sizeof(lexer_pow10) / sizeof(lexer_pow10[0]) > LEXER_EXACT_POW10,
+    "Fix lexer_pow10 for LEXER_EXACT_POW10");
+
+static int lexer_digit_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    return 99;
 }
 
-static bool lexer_match(lexer_t *lexer, char expected)
+/* literal text without `_` separators, for strtold */
+static number_t lexer_number_slow(lexer_t *lexer, size_t start)
 {
-    if (lexer_peek(lexer) == expected)
+    size_t length = lexer->pos - start;
+    char small[64];
+    char *text = length < sizeof(small) ? small : malloc(length + 1);
+    if (!text)
     {
-        lexer_advance(lexer);
-        return true;
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
     }
-    return false;
+
+    size_t n = 0;
+    for (size_t i = start; i < lexer->pos; i++)
+        if (lexer->source[i] != '_')
+            text[n++] = lexer->source[i];
+    text[n] = '\0';
+
+    number_t value = strtold(text, NULL);
+
+    if (text != small) free(text);
+    return value;
 }
 
-static token_t *lexer_append(lexer_t *lexer, token_t token)
+/*
+ * Decode the numeric literal at `start`, its first digit is already
+ * consumed. Accepts `0x`, `0b` and `0o` integers, decimals with a fraction
+ * and an exponent, and `_` separators between digits.
+ */
+static bool lexer_number(lexer_t *lexer, size_t start, number_t *out)
 {
-    if (lexer->count == lexer->capacity)
+    char c = lexer->source[start];
+    char prefix = lexer_peek(lexer);
+
+    /* radix integers */
+    if (c == '0' && prefix && strchr("xXbBoO", prefix))
+    {
+        int bits = (prefix == 'x' || prefix == 'X') ? 4 :
+                   (prefix == 'b' || prefix == 'B') ? 1 : 3;
+        int radix = 1 << bits;
+        lexer->pos++;
+
+        /*
+         * integers wider than 64 bits keep their top 64 bits, `shift` counts
+         * the dropped ones, which only matter for rounding
+         */
+        uint64_t integer = 0;
+        int shift = 0;
+        bool guard = false, sticky = false;
+        size_t digits = 0;
+
+        for (;; lexer->pos++)
+        {
+            char ch = lexer_peek(lexer);
+            if (ch == '_' && digits) continue;
+
+            int digit = lexer_digit_value(ch);
+            if (digit >= radix) break;
+            digits++;
+
+            if (shift == 0 && integer <= (UINT64_MAX - digit) / radix)
+            {
+                integer = integer * radix + digit;
+                continue;
+            }
+
+            for (int bit = bits - 1; bit >= 0; bit--)
+            {
+                bool b = (digit >> bit) & 1;
+                if (shift == 0 && !(integer >> 63))
+                    integer = integer << 1 | b;
+                else if (shift++ == 0)
+                    guard = b;
+                else
+                    sticky |= b;
+            }
+        }
+
+        if (!digits || isalnum(lexer_peek(lexer)))
+        {
+            LEXER_ERROR_AT(lexer, start, "Invalid number literal '%.*s'\n",
+                (int) (lexer->pos - start), &lexer->source[start]);
+            return false;
+        }
+
+        if (shift == 0)
+        {
+            *out = (number_t) integer;
+            return true;
+        }
+
+        /* round to nearest even once */
+#if LDBL_MANT_DIG >= 64
+        number_t value = (number_t) integer;
+        if (guard && (sticky || (integer & 1)))
+            value += 1;
+#else
+        /* round to odd, the conversion then rounds correctly */
+        number_t value = (number_t) (integer | (guard || sticky));
+#endif
+        *out = ldexpl(value, shift);
+        return true;
+    }
+
+    /* decimal: the significant digits go into `mantissa`, scaled by 10^exp10 */
+    uint64_t mantissa = 0;
+    int digits = 0;
+    long exp10 = 0;
+    bool truncated = false;
+
+    lexer->pos = start;
+    while (isdigit(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
+    {
+        char ch = lexer->source[lexer->pos++];
+        if (ch == '_') continue;
+
+        if (digits < LEXER_MAX_DIGITS)
+        {
+            mantissa = mantissa * 10 + (ch - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            exp10++;
+            truncated |= ch != '0';
+        }
+    }
+
+    if (lexer_peek(lexer) == '.')
     {
-        lexer->capacity = lexer->capacity ? lexer->capacity * 2 : 8;
-        lexer->tokens = realloc(lexer->tokens, lexer->capacity * sizeof(token_t));
+        lexer->pos++;
+        while (isdigit(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
+        {
+            char ch = lexer->source[lexer->pos++];
+            if (ch == '_') continue;
+
+            if (digits < LEXER_MAX_DIGITS)
+            {
+                mantissa = mantissa * 10 + (ch - '0');
+                digits += mantissa != 0;
+                exp10--;
+            }
+            else
+            {
+                truncated |= ch != '0';
+            }
+        }
     }
-    lexer->tokens[lexer->count++] = token;
-    
-    printf("[%s:%zu:%zu] %s(\"%s\")\n",
-        token.loc.filename,
-        token.loc.line,
-        token.loc.column,
-        token_type_to_string(token.type),
-        token.value
-    );
 
-    return &lexer->tokens[lexer->count - 1];
+    if (lexer_peek(lexer) == 'e' || lexer_peek(lexer) == 'E')
+    {
+        size_t mark = lexer->pos++;
+        bool negative = false;
+        if (lexer_peek(lexer) == '+' || lexer_peek(lexer) == '-')
+            negative = lexer->source[lexer->pos++] == '-';
+
+        if (!isdigit(lexer_peek(lexer)))
+        {
+            LEXER_ERROR_AT(lexer, mark, "Missing exponent in number literal '%.*s'\n",
+                (int) (lexer->pos - start), &lexer->source[start]);
+            return false;
+        }
+
+        long exponent = 0;
+        while (isdigit(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
+        {
+            char ch = lexer->source[lexer->pos++];
+            /* anything this large is 0 or infinity anyway */
+            if (ch != '_' && exponent < 100000)
+                exponent = exponent * 10 + (ch - '0');
+        }
+        exp10 += negative ? -exponent : exponent;
+    }
+
+    if (mantissa == 0)
+    {
+        *out = 0;
+        return true;
+    }
+
+    if (!truncated &&
+        mantissa <= LEXER_EXACT_MANTISSA &&
+        exp10 >= -LEXER_EXACT_POW10 && exp10 <= LEXER_EXACT_POW10)
+    {
+        number_t value = (number_t) mantissa;
+        *out = exp10 < 0 ? value / lexer_pow10[-exp10] : value * lexer_pow10[exp10];
+        return true;
+    }
+
+    *out = lexer_number_slow(lexer, start);
+    return true;
 }
 
-static void lexer_tokenize(lexer_t *lexer)
+/* scan the next token into `out`, an unknown token is left there on error */
+static void lexer_scan(lexer_t *lexer, token_t *out)
 {
-    static_assert(TOKEN_COUNT == 88, "Fix TOKEN_COUNT in 'lexer_tokenize'");
+    static_assert(TOKEN_COUNT == 88, "Fix TOKEN_COUNT in 'lexer_scan'");
+
+    *out = (token_t) {0};
+    out->type = TOKEN_UNKNOWN;
+    out->loc.file = lexer->file;
+    out->loc.offset = (uint32_t) lexer->pos;
 
     while (true)
     {
-        /* skip whitespace */
-        while (isspace(lexer_peek(lexer)))
+        /* skip whitespace, most tokens are preceded by none or a single space */
+        if (isspace(lexer_peek(lexer)))
+        {
             lexer_advance(lexer);
+            if (isspace(lexer_peek(lexer)))
+                lexer_skip_whitespace(lexer);
+        }
 
         /* skip comments */
         if (lexer_peek(lexer) == '/' &&
@@ -219,7 +719,10 @@ static void lexer_tokenize(lexer_t *lexer)
                 while (lexer_peek(lexer) != '\n' &&
                         lexer_peek(lexer) != '\0')
                 {
-                    lexer_advance(lexer);
+                    lexer_skip_line_comment(lexer);
+                    if (lexer_peek(lexer) == '\n' || lexer_peek(lexer) == '\0')
+                        break;
+                    lexer_advance(lexer); /* non-ASCII */
                 }
                 continue; /* skip whitespace */
             }
@@ -229,6 +732,7 @@ static void lexer_tokenize(lexer_t *lexer)
                 lexer_advance(lexer); /* skip first / */
                 lexer_advance(lexer); /* skip * */
                 while (true) {
+                    lexer_skip_block_comment(lexer);
                     if (lexer_peek(lexer) == '\0')
                     {
                         LEXER_ERROR(lexer, "Unterminated multi-line comment\n");
@@ -249,36 +753,56 @@ static void lexer_tokenize(lexer_t *lexer)
         }
 
         size_t start = lexer->pos;
-        size_t start_line = lexer->loc.line;
-        size_t start_column = lexer->loc.column;
 
         char c = lexer_advance(lexer);
 
         token_t token = {0};
-        token.loc.filename = strdup(lexer->loc.filename);
-        token.loc.line = start_line;
-        token.loc.column = start_column;
+        token.loc.file = lexer->file;
+        token.loc.offset = (uint32_t) start;
 
         /* end of file */
         if (c == '\0')
         {
             token.type = TOKEN_EOF;
-            lexer_append(lexer, token);
-            break; /* stop tokenization */
+            lexer_emit(lexer, out, &token);
+            return; /* stays at end of file */
         }
 
         /* strings */
         if (c == '"' || c == '\'')
         {
             char quote = c;
-            size_t buf_capacity = 16, buf_len = 0;
-            char *buf = malloc(buf_capacity);
+
+            /*
+             * plain strings stay a view into the source, only strings with
+             * escape sequences are decoded into `lexer->strings`
+             */
+            size_t body = lexer->pos;
+            size_t mark = lexer->strings_length;
+            bool escaped = false;
 
             while (lexer_peek(lexer) != quote && lexer_peek(lexer) != '\0')
             {
+                /* plain run up to the quote or the next escape */
+                size_t run = lexer->pos;
+                lexer_skip_string(lexer, quote);
+                if (run != lexer->pos)
+                {
+                    if (escaped)
+                        lexer_strings_append(lexer, &lexer->source[run], lexer->pos - run);
+                    continue;
+                }
+
                 char ch = lexer_advance(lexer);
                 if (ch == '\\')
                 {
+                    if (!escaped)
+                    {
+                        /* first escape, copy the part scanned so far */
+                        escaped = true;
+                        lexer_strings_append(lexer, &lexer->source[body], lexer->pos - 1 - body);
+                    }
+
                     char next = lexer_advance(lexer);
                     switch (next)
                     {
@@ -295,8 +819,7 @@ static void lexer_tokenize(lexer_t *lexer)
                         case 'u':
                         {
                             if (lexer->pos + 4 > lexer->length) {
-                                free(buf);
-                                free(token.loc.filename);
+                                lexer->strings_length = mark;
                                 LEXER_ERROR(lexer, "Incomplete Unicode escape sequence\n");
                                 return;
                             }
@@ -305,8 +828,7 @@ static void lexer_tokenize(lexer_t *lexer)
                             for (int i = 0; i < 4; i++) {
                                 char hex = lexer_advance(lexer);
                                 if (!isxdigit(hex)) {
-                                    free(buf);
-                                    free(token.loc.filename);
+                                    lexer->strings_length = mark;
                                     LEXER_ERROR(lexer, "Invalid Unicode escape sequence\n");
                                     return;
                                 }
@@ -316,260 +838,131 @@ static void lexer_tokenize(lexer_t *lexer)
                                 else if (hex >= 'A' && hex <= 'F') codepoint |= hex - 'A' + 10;
                             }
 
-                            // Ensure buffer can hold up to 3 bytes
-                            if (buf_len + 3 >= buf_capacity) {
-                                buf_capacity *= 2;
-                                buf = realloc(buf, buf_capacity);
-                            }
-
                             // Encode codepoint into UTF-8
                             if (codepoint <= 0x7F) {
-                                buf[buf_len++] = (char)codepoint;
+                                lexer_strings_push(lexer, (char)codepoint);
                             } else if (codepoint <= 0x7FF) {
-                                buf[buf_len++] = 0xC0 | ((codepoint >> 6) & 0x1F);
-                                buf[buf_len++] = 0x80 | (codepoint & 0x3F);
+                                lexer_strings_push(lexer, 0xC0 | ((codepoint >> 6) & 0x1F));
+                                lexer_strings_push(lexer, 0x80 | (codepoint & 0x3F));
                             } else { // 0x800 .. 0xFFFF
-                                buf[buf_len++] = 0xE0 | ((codepoint >> 12) & 0x0F);
-                                buf[buf_len++] = 0x80 | ((codepoint >> 6) & 0x3F);
-                                buf[buf_len++] = 0x80 | (codepoint & 0x3F);
+                                lexer_strings_push(lexer, 0xE0 | ((codepoint >> 12) & 0x0F));
+                                lexer_strings_push(lexer, 0x80 | ((codepoint >> 6) & 0x3F));
+                                lexer_strings_push(lexer, 0x80 | (codepoint & 0x3F));
                             }
                             continue; // already handled
                         }
                         default:
-                            free(token.loc.filename);
-                            lexer->loc.column -= 1;
-                            LEXER_ERROR(lexer, "Unknown escape sequence '\\%c'\n", next);
+                            lexer->strings_length = mark;
+                            LEXER_ERROR_AT(lexer, lexer->pos - 1, "Unknown escape sequence '\\%c'\n", next);
                             return;
                     }
                 }
-                if (buf_len + 1 >= buf_capacity) {
-                    buf_capacity *= 2;
-                    buf = realloc(buf, buf_capacity);
-                }
-                buf[buf_len++] = ch;
+
+                if (escaped)
+                    lexer_strings_push(lexer, ch);
             }
 
             if (lexer_peek(lexer) != quote)
             {
-                free(buf);
-                free(token.loc.filename);
-                lexer->loc.line = start_line;
-                lexer->loc.column = start_column;
-                LEXER_ERROR(lexer, "Unterminated string literal\n");
+                lexer->strings_length = mark;
+                LEXER_ERROR_AT(lexer, start, "Unterminated string literal\n");
                 return;
             }
 
             lexer_advance(lexer); // closing quote
-            buf[buf_len] = '\0';
 
             token.type = TOKEN_STRING_LITERAL;
-            token.length = buf_len;
-            token.value = buf;
-            lexer_append(lexer, token);
-            continue;
+            if (escaped)
+            {
+                lexer_strings_push(lexer, '\0');
+                token.escaped = true;
+                token.string = (uint32_t) mark;
+                token.length = lexer->strings_length - mark - 1;
+            }
+            else
+            {
+                token.length = lexer->pos - 1 - body;
+            }
+            lexer_emit(lexer, out, &token);
+            return;
         }
 
         /* numbers */
         if (isdigit(c))
         {
-            size_t start = lexer->pos - 1;
-            while (isdigit(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
-                lexer_advance(lexer);
-
-            if (lexer_peek(lexer) == '.')
-            {
-                lexer_advance(lexer);
-                while (isdigit(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
-                    lexer_advance(lexer);
-            }
-
-            size_t length = lexer->pos - start;
-            char *value = lexer_strndup(&lexer->source[start], length);
+            /* stored by the ring slot the token goes to */
+            token.number = (uint32_t) (out - lexer->ring);
+            if (!lexer_number(lexer, start, &lexer->numbers[token.number]))
+                return;
 
             token.type = TOKEN_NUMBER_LITERAL;
-            token.value = value;
-            token.length = length;
+            token.length = lexer->pos - start;
 
-            lexer_append(lexer, token);
-            continue;
+            lexer_emit(lexer, out, &token);
+            return;
         }
 
         /* identifiers and keywords */
         if (isalpha(c) || c == '_' || c == '$')
         {
-            while (isalnum(lexer_peek(lexer)) || lexer_peek(lexer) == '_' ||
-                   lexer_peek(lexer) == '$')
-                lexer_advance(lexer);
-
-            size_t length = lexer->pos - start;
-            char *value = lexer_strndup(&lexer->source[start], length);
-
-            token.value = value;
-            token.length = length;
-
-            if (length == 2 && strncmp(value, "if", 2) == 0) token.type = TOKEN_IF;
-            else if (length == 4 && strncmp(value, "else", 4) == 0) token.type = TOKEN_ELSE;
-            else if (length == 5 && strncmp(value, "while", 5) == 0) token.type = TOKEN_WHILE;
-            else if (length == 2 && strncmp(value, "do", 2) == 0) token.type = TOKEN_DO;
-            else if (length == 3 && strncmp(value, "for", 3) == 0) token.type = TOKEN_FOR;
-            else if (length == 8 && strncmp(value, "function", 8) == 0) token.type = TOKEN_FUNCTION;
-            else if (length == 6 && strncmp(value, "switch", 6) == 0) token.type = TOKEN_SWITCH;
-            else if (length == 4 && strncmp(value, "case", 4) == 0) token.type = TOKEN_CASE;
-            else if (length == 7 && strncmp(value, "default", 7) == 0) token.type = TOKEN_DEFAULT;
-            else if (length == 3 && strncmp(value, "let", 3) == 0) token.type = TOKEN_LET;
-            else if (length == 5 && strncmp(value, "const", 5) == 0) token.type = TOKEN_CONST;
-            else if (length == 3 && strncmp(value, "var", 3) == 0) token.type = TOKEN_VAR;
-            else if (length == 4 && strncmp(value, "null", 4) == 0) token.type = TOKEN_NULL;
-            else if (length == 9 && strncmp(value, "undefined", 9) == 0) token.type = TOKEN_UNDEFINED;
-            else if (length == 6 && strncmp(value, "return", 6) == 0) token.type = TOKEN_RETURN;
-            else if (length == 5 && strncmp(value, "break", 5) == 0) token.type = TOKEN_BREAK;
-            else if (length == 8 && strncmp(value, "continue", 8) == 0) token.type = TOKEN_CONTINUE;
-            else if (length == 6 && strncmp(value, "import", 6) == 0) token.type = TOKEN_IMPORT;
-            else if (length == 6 && strncmp(value, "export", 6) == 0) token.type = TOKEN_EXPORT;
-            else if (length == 3 && strncmp(value, "try", 3) == 0) token.type = TOKEN_TRY;
-            else if (length == 5 && strncmp(value, "catch", 5) == 0) token.type = TOKEN_CATCH;
-            else if (length == 7 && strncmp(value, "finally", 7) == 0) token.type = TOKEN_FINALLY;
-            else if (length == 5 && strncmp(value, "throw", 5) == 0) token.type = TOKEN_THROW;
-            else if (length == 6 && strncmp(value, "typeof", 6) == 0) token.type = TOKEN_TYPEOF;
-            // else if (length == 2 && strncmp(value, "in", 2) == 0) token.type = TOKEN_IN;
-            // else if (length == 2 && strncmp(value, "of", 2) == 0) token.type = TOKEN_OF;
-            else if (length == 4 && strncmp(value, "true", 4) == 0) token.type = TOKEN_BOOL_LITERAL;
-            else if (length == 5 && strncmp(value, "false", 5) == 0) token.type = TOKEN_BOOL_LITERAL;
-            else if (length == 5 && strncmp(value, "async", 5) == 0) token.type = TOKEN_ASYNC;
-            else if (length == 5 && strncmp(value, "await", 5) == 0) token.type = TOKEN_AWAIT;
-            else if (length == 4 && strncmp(value, "from", 4) == 0) token.type = TOKEN_FROM;
-            else if (length == 6 && strncmp(value, "delete", 6) == 0) token.type = TOKEN_DELETE;
-            else if (length == 4 && strncmp(value, "this", 4) == 0) token.type = TOKEN_THIS;
-            else if (length == 4 && strncmp(value, "void", 4) == 0) token.type = TOKEN_VOID;
-            else if (length == 3 && strncmp(value, "new", 3) == 0) token.type = TOKEN_NEW;
-            else if (length == 8 && strncmp(value, "debugger", 8) == 0) token.type = TOKEN_DEBUGGER;
-            else token.type = TOKEN_IDENTIFIER;
-
-            lexer_append(lexer, token);
-            continue;
+            lexer_skip_identifier(lexer);
+
+            token.length = lexer->pos - start;
+            token.type = lexer_keyword(&lexer->source[start], token.length);
+            if (token.type == TOKEN_IDENTIFIER)
+                token.atom = atom_intern(&lexer->source[start], token.length);
+
+            lexer_emit(lexer, out, &token);
+            return;
         }
 
         /* operators, punctuation, etc. */
-        switch (c)
+        token_type_t type = lexer_op_start[(unsigned char) c];
+        if (type == LEXER_OP_NONE)
         {
-            case '+':
-                if (lexer_match(lexer, '+')) { token.type = TOKEN_PLUS_PLUS; token.value = strdup("++"); token.length = 2; }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_PLUS_EQUAL; token.value = strdup("+="); token.length = 2; }
-                else { token.type = TOKEN_PLUS; token.value = strdup("+"); token.length = 1; }
-                break;
-            case '-':
-                if (lexer_match(lexer, '-')) { token.type = TOKEN_MINUS_MINUS; token.value = strdup("--"); token.length = 2; }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_MINUS_EQUAL; token.value = strdup("-="); token.length = 2; }
-                else if (lexer_match(lexer, '>')) { token.type = TOKEN_ARROW; token.value = strdup("=>"); token.length = 2; }
-                else { token.type = TOKEN_MINUS; token.value = strdup("-"); token.length = 1; }
-                break;
-            case '*':
-                if (lexer_match(lexer, '*')) {
-                    if (lexer_match(lexer, '=')) { token.type = TOKEN_STAR_STAR_EQUAL; token.value = strdup("**="); token.length = 3; }
-                    else { token.type = TOKEN_STAR_STAR; token.value = strdup("**"); token.length = 2; }
-                }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_STAR_EQUAL; token.value = strdup("*="); token.length = 2; }
-                else { token.type = TOKEN_STAR; token.value = strdup("*"); token.length = 1; }
-                break;
-            case '/':
-                if (lexer_match(lexer, '=')) { token.type = TOKEN_SLASH_EQUAL; token.value = strdup("/="); token.length = 2; }
-                else { token.type = TOKEN_SLASH; token.value = strdup("/"); token.length = 1; }
-                break;
-            case '%':
-                if (lexer_match(lexer, '=')) { token.type = TOKEN_PERCENT_EQUAL; token.value = strdup("%="); token.length = 2; }
-                else { token.type = TOKEN_PERCENT; token.value = strdup("%"); token.length = 1; }
-                break;
-            case '&':
-                if (lexer_match(lexer, '&')) {
-                    if (lexer_match(lexer, '=')) { token.type = TOKEN_LOGICAL_AND_EQUAL; token.value = strdup("&&="); token.length = 3; }
-                    else { token.type = TOKEN_LOGICAL_AND; token.value = strdup("&&"); token.length = 2; }
-                }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_AMPERSAND_EQUAL; token.value = strdup("&="); token.length = 2; }
-                else { token.type = TOKEN_AMPERSAND; token.value = strdup("&"); token.length = 1; }
-                break;
-            case '|':
-                if (lexer_match(lexer, '|')) {
-                    if (lexer_match(lexer, '=')) { token.type = TOKEN_LOGICAL_OR_EQUAL; token.value = strdup("||="); token.length = 3; }
-                    else { token.type = TOKEN_LOGICAL_OR; token.value = strdup("||"); token.length = 2; }
-                }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_PIPE_EQUAL; token.value = strdup("|="); token.length = 2; }
-                else { token.type = TOKEN_PIPE; token.value = strdup("|"); token.length = 1; }
-                break;
-            case '^':
-                if (lexer_match(lexer, '=')) { token.type = TOKEN_CARET_EQUAL; token.value = strdup("^="); token.length = 2; }
-                else { token.type = TOKEN_CARET; token.value = strdup("^"); token.length = 1; }
-                break;
-            case '~': token.type = TOKEN_TILDE; token.value = strdup("~"); token.length = 1; break;
-            case '<':
-                if (lexer_match(lexer, '<')) {
-                    if (lexer_match(lexer, '=')) { token.type = TOKEN_LEFT_SHIFT_EQUAL; token.value = strdup("<<="); token.length = 3; }
-                    else { token.type = TOKEN_LEFT_SHIFT; token.value = strdup("<<"); token.length = 2; }
-                }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_LESS_EQUAL; token.value = strdup("<="); token.length = 2; }
-                else { token.type = TOKEN_LESS; token.value = strdup("<"); token.length = 1; }
-                break;
-            case '>':
-                if (lexer_match(lexer, '>')) {
-                    if (lexer_match(lexer, '=')) { token.type = TOKEN_RIGHT_SHIFT_EQUAL; token.value = strdup(">>="); token.length = 3; }
-                    else { token.type = TOKEN_RIGHT_SHIFT; token.value = strdup(">>"); token.length = 2; }
-                }
-                else if (lexer_match(lexer, '=')) { token.type = TOKEN_GREATER_EQUAL; token.value = strdup(">="); token.length = 2; }
-                else { token.type = TOKEN_GREATER; token.value = strdup(">"); token.length = 1; }
-                break;
-            case '=':
-                if (lexer_match(lexer, '=')) {
-                    token.type = TOKEN_EQUAL_EQUAL; token.value = strdup("=="); token.length = 2;
-                }
-                else { token.type = TOKEN_EQUAL; token.value = strdup("="); token.length = 1; }
-                break;
-            case '!':
-                if (lexer_match(lexer, '=')) {
-                    token.type = TOKEN_BANG_EQUAL; token.value = strdup("!="); token.length = 2;
-                }
-                else { token.type = TOKEN_BANG; token.value = strdup("!"); token.length = 1; }
-                break;
-            case '(': token.type = TOKEN_LEFT_PAREN; token.value = strdup("("); token.length = 1; break;
-            case ')': token.type = TOKEN_RIGHT_PAREN; token.value = strdup(")"); token.length = 1; break;
-            case '{': token.type = TOKEN_LEFT_BRACE; token.value = strdup("{"); token.length = 1; break;
-            case '}': token.type = TOKEN_RIGHT_BRACE; token.value = strdup("}"); token.length = 1; break;
-            case '[': token.type = TOKEN_LEFT_BRACKET; token.value = strdup("["); token.length = 1; break;
-            case ']': token.type = TOKEN_RIGHT_BRACKET; token.value = strdup("]"); token.length = 1; break;
-            case '.':
-                if (lexer_match(lexer, '.') && lexer_match(lexer, '.')) { token.type = TOKEN_ELLIPSIS; token.value = strdup("..."); token.length = 3; }
-                else { token.type = TOKEN_DOT; token.value = strdup("."); token.length = 1; }
-                break;
-            case ',': token.type = TOKEN_COMMA; token.value = strdup(","); token.length = 1; break;
-            case ';': token.type = TOKEN_SEMICOLON; token.value = strdup(";"); token.length = 1; break;
-            case ':': token.type = TOKEN_COLON; token.value = strdup(":"); token.length = 1; break;
-            case '?':
-                // if (lexer_match(lexer, '?')) {
-                //     token.type = TOKEN_NULLISH_COALESCING; token.value = strdup("??"); token.length = 2;
-                // }
-                // else { token.type = TOKEN_QUESTION; token.value = strdup("?"); token.length = 1;}
-                token.type = TOKEN_QUESTION; token.value = strdup("?"); token.length = 1;
-                break; 
-            default:
-                free(token.loc.filename);
-                lexer->loc.line = start_line;
-                lexer->loc.column = start_column;
-                LEXER_ERROR(lexer, "Unexpected character '%c'\n", c);
-                return;
-                // token.type = TOKEN_UNKNOWN;
-                // token.value = strndup(&lexer->source[start], 1);
-                // token.length = 1;
+            LEXER_ERROR_AT(lexer, start, "Unexpected character '%c'\n", c);
+            return;
         }
 
-        // token.loc.line = start_line;
-        // token.loc.column = start_column;
-        lexer_append(lexer, token);
+        /* longest match, operators never span a newline */
+        token_type_t next;
+        while ((next = lexer_op_next[type][lexer_op_class[(unsigned char) lexer_peek(lexer)]]) != LEXER_OP_NONE)
+        {
+            lexer->pos++;
+            type = next;
+        }
+
+        if (type == TOKEN_DOT &&
+            lexer->pos + 1 < lexer->length &&
+            lexer->source[lexer->pos] == '.' &&
+            lexer->source[lexer->pos + 1] == '.')
+        {
+            lexer->pos += 2;
+            type = TOKEN_ELLIPSIS;
+        }
+
+        token.type = type;
+        token.length = lexer->pos - start;
+        lexer_emit(lexer, out, &token);
+        return;
     }
 }
 
-token_t *lexer_next(lexer_t *lexer)
+token_t *lexer_lookahead(lexer_t *lexer)
 {
-    if (!lexer || !lexer->tokens || lexer->index >= lexer->count)
-        return NULL; // EOF reached
+    if (!lexer) return NULL;
 
-    return &lexer->tokens[lexer->index++];
+    /* scan lazily, at most one token ahead of the consumer */
+    if (lexer->index == lexer->head)
+        lexer_scan(lexer, &lexer->ring[lexer->head++ % LEXER_RING_SIZE]);
+
+    return &lexer->ring[lexer->index % LEXER_RING_SIZE];
+}
+
+token_t *lexer_next(lexer_t *lexer)
+{
+    token_t *token = lexer_lookahead(lexer);
+    if (token) lexer->index++;
+    return token;
 }
 
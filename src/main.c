@@ -11,6 +11,14 @@
 #include "parser.h"
 #include "sema.h"
 #include "eval.h"
+#include "source.h"
+#include "atom.h"
+#include "cache.h"
+#include "optimize.h"
+#include "compiler.h"
+#include "vm.h"
+#include "closure.h"
+#include "jit.h"
 
 #define VERSION "0.1.0"
 
@@ -91,7 +99,7 @@ int main(int argc, char **argv)
 
         parser_init(parser, lexer);
         ast = parse_program(parser);
-        if (!ast) {
+        if (!ast || lexer->had_error) {
             printf("Parsing failed!\n");
             parser_free(parser);
             lexer_free(lexer);
@@ -109,7 +117,6 @@ int main(int argc, char **argv)
         sema_analyze(sema);
         if (sema->had_error) {
             printf("Semantic analysis failed!\n");
-            node_free(ast);
             parser_free(parser);
             lexer_free(lexer);
             sema_free(sema);
@@ -122,8 +129,7 @@ int main(int argc, char **argv)
         // value_t result = evaluate(ast, persistent_env);
         // print_value(result);
         // printf("\n");
-        // Cleanup
-        node_free(ast);
+        // Cleanup, the parser owns the AST
         parser_free(parser);
         lexer_free(lexer);
         sema_free(sema);
@@ -134,18 +140,64 @@ int main(int argc, char **argv)
 normal:
 
     int opt;
+    bool show_stats = false;
+    bool lazy = false;
+    bool use_cache = false;
+    bool walk_ast = false;
+    bool use_closures = false;
+    bool use_jit = JIT_AVAILABLE;
+    bool use_traces = JIT_AVAILABLE;
+    int optimize = 0;
     static struct option long_options[] = {
         {"version", no_argument, 0, 'v'},
+        {"stats", no_argument, 0, 's'},
+        {"lazy", no_argument, 0, 'l'},
+        {"cache", no_argument, 0, 'C'},
+        {"optimize", required_argument, 0, 'O'},
+        {"ast", no_argument, 0, 'a'},
+        {"closures", no_argument, 0, 'c'},
+        {"jit", no_argument, 0, 'j'},
+        {"no-jit", no_argument, 0, 'J'},
+        {"no-trace", no_argument, 0, 'T'},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "v", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "vslCacjJTO:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'v':
                 printf("Rose interpreter version %s\n", VERSION);
                 return 0;
+            case 's':
+                show_stats = true;
+                break;
+            case 'l':
+                lazy = true;
+                break;
+            case 'C':
+                use_cache = true;
+                break;
+            case 'O':
+                optimize = atoi(optarg);
+                break;
+            case 'a':
+                walk_ast = true;
+                break;
+            case 'c':
+                use_closures = true;
+                break;
+            case 'j':
+                if (!JIT_AVAILABLE)
+                    fprintf(stderr, "This build has no JIT, running bytecode\n");
+                use_jit = JIT_AVAILABLE;
+                break;
+            case 'J':
+                use_jit = false;
+                break;
+            case 'T':
+                use_traces = false;
+                break;
             default:
-                fprintf(stderr, "Usage: %s [--version|-v] [file]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [--version|-v] [--stats|-s] [--lazy|-l] [--cache|-C] [--optimize|-O<level>] [--ast|-a] [--closures|-c] [--jit|-j] [--no-jit] [--no-trace] [file]\n", argv[0]);
                 return 1;
         }
     }
@@ -168,12 +220,20 @@ normal:
     parser_t *parser = NULL;
     node_t *program = NULL;
     sema_t *sema = NULL;
+    optimizer_t *optimizer = NULL;
+    compiler_t compiler;
+    bytecode_function_t *code = NULL;
+    vm_t *vm = NULL;
+    closure_compiler_t closure_compiler;
+    closure_ctx_t *closure_ctx = NULL;
+
+    cache_t cache = {0};
+    char *cache_file = NULL;
+    uint64_t hash = 0;
 
     start = clock();
-    lexer = malloc(sizeof(lexer_t));
-    lexer_init(lexer, input_file, NULL);
-    // lexer_init(lexer, argv[1], NULL);
-    if (lexer->had_error)
+    source_id_t file = source_load(input_file);
+    if (file == SOURCE_NONE)
     {
         result = 1;
         printf("Lexering failed...\n");
@@ -181,19 +241,70 @@ normal:
     }
     end = clock();
     duration = (double)(end - start) / CLOCKS_PER_SEC;
-    printf("Lexing took %.6f seconds\n", duration);
+    printf("Reading source took %.6f seconds\n", duration);
+
+    /* cached programs are fully parsed and checked, lazy bodies need a parser */
+    use_cache = use_cache && !lazy && strcmp(input_file, "-") != 0;
+    if (use_cache)
+    {
+        start = clock();
+        const source_t *source = source_get(file);
+        hash = cache_hash(source->data, source->length);
+        cache_file = cache_path(input_file, hash);
+
+        if (cache_file && cache_load(&cache, cache_file, file, hash, VERSION))
+        {
+            end = clock();
+            duration = (double)(end - start) / CLOCKS_PER_SEC;
+            printf("Loading AST cache took %.6f seconds\n", duration);
+            if (show_stats)
+                printf("AST cache: %zu bytes from %s\n", cache.size, cache_file);
+
+            program = cache.program;
+            node_print(program);
+            node_build(program);
+            goto checked;
+        }
+    }
 
+    lexer = malloc(sizeof(lexer_t));
+    lexer_init_range(lexer, file, 0, source_get(file)->length);
+
+    /* tokens are lexed on demand, lexing is timed together with parsing */
     start = clock();
     parser = malloc(sizeof(parser_t));
     parser_init(parser, lexer);
+    parser->lazy = lazy;
 
     program = parse_program(parser);
-    if (!program)
+    if (!program || lexer->had_error)
     {
         result = 1;
         printf("Parsing failed...\n");
         goto cleanup;
     }
+
+    if (show_stats)
+    {
+        duration = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("Lexed %zu tokens from %zu bytes (%.0f tokens/sec, %.2f bytes/token)\n",
+            lexer->count,
+            lexer->length,
+            duration > 0 ? lexer->count / duration : 0.0,
+            lexer->count ? (double) lexer->length / lexer->count : 0.0
+        );
+    }
+    if (show_stats)
+    {
+        printf("AST arena: %zu allocations, %zu bytes in %zu blocks\n",
+            parser->arena.allocations,
+            parser->arena.bytes,
+            parser->arena.block_count
+        );
+        if (lazy)
+            printf("Lazy functions: %zu bodies pre-parsed\n", parser->lazy_functions);
+        node_stats_print();
+    }
     node_print(program);
     node_build(program);
 
@@ -213,16 +324,155 @@ normal:
     }
 
     printf("Semantic analysis succeeded!\n");
+    if (show_stats)
+        printf("Flat AST: %zu nodes, %zu bytes\n", sema->program_flat.count, flat_bytes(&sema->program_flat));
+
+    if (use_cache && cache_file && !cache_store(cache_file, file, hash, VERSION, program) && show_stats)
+        printf("AST cache: could not write %s\n", cache_file);
 
     end = clock();
     duration = (double)(end - start) / CLOCKS_PER_SEC;
     printf("Semantic analysis took %.6f seconds\n", duration);
 
+checked:
+    /* the cache keeps the unoptimized program */
+    if (optimize > 0)
+    {
+        start = clock();
+        optimizer = malloc(sizeof(optimizer_t));
+        optimizer_init(optimizer);
+        optimize_program(optimizer, program);
+
+        end = clock();
+        duration = (double)(end - start) / CLOCKS_PER_SEC;
+        if (show_stats)
+            printf("Optimizer: %zu subtrees folded, %zu statements removed\n",
+                optimizer->folded,
+                optimizer->removed
+            );
+        node_print(program);
+        printf("Optimization took %.6f seconds\n", duration);
+    }
+
+    /* the tree walker is kept for comparison */
+    if (walk_ast)
+    {
+        start = clock();
+        eval_context_t ctx;
+        eval_init(&ctx);
+        value_print(eval_program(&ctx, program));
+        printf("\n");
+        eval_free(&ctx);
+
+        end = clock();
+        duration = (double)(end - start) / CLOCKS_PER_SEC;
+        printf("Execution took %.6f seconds\n", duration);
+        goto cleanup;
+    }
+
+    /* compiled closures, cheaper to build than bytecode */
+    if (use_closures)
+    {
+        start = clock();
+        closure_compiler_init(&closure_compiler, parser, sema);
+        closure_ctx = malloc(sizeof(closure_ctx_t));
+        closure_init(closure_ctx, &closure_compiler);
+
+        closure_function_t *closures = closure_compile_program(&closure_compiler, program);
+        if (!closures)
+        {
+            result = 1;
+            printf("Compilation failed...\n");
+            goto cleanup;
+        }
+
+        end = clock();
+        duration = (double)(end - start) / CLOCKS_PER_SEC;
+        printf("Compilation took %.6f seconds\n", duration);
+
+        start = clock();
+        value_print(closure_run(closure_ctx, closures));
+        printf("\n");
+
+        end = clock();
+        duration = (double)(end - start) / CLOCKS_PER_SEC;
+        if (show_stats)
+            printf("Closures: %zu functions, %zu closures, %zu rewrites\n",
+                closure_compiler.function_count,
+                closure_compiler.closure_count,
+                closure_ctx->rewrites
+            );
+        printf("Execution took %.6f seconds\n", duration);
+        goto cleanup;
+    }
+
+    start = clock();
+    compiler_init(&compiler, parser, sema);
+    code = compile_program(&compiler, program);
+    if (!code)
+    {
+        result = 1;
+        printf("Compilation failed...\n");
+        goto cleanup;
+    }
+
+    end = clock();
+    duration = (double)(end - start) / CLOCKS_PER_SEC;
+    printf("Compilation took %.6f seconds\n", duration);
+
+    start = clock();
+    vm = malloc(sizeof(vm_t));
+    vm_init(vm, &compiler);
+    vm->jit = use_jit;
+    vm->trace = use_jit && use_traces;
+    value_print(vm_run(vm, code));
+    printf("\n");
+
+    end = clock();
+    duration = (double)(end - start) / CLOCKS_PER_SEC;
+    if (show_stats)
+        printf("Bytecode: %zu functions, %zu bytes\n",
+            compiler.function_count,
+            compiler.code_bytes
+        );
+    if (show_stats && use_jit)
+        printf("JIT: %zu functions, %zu bytes of machine code\n",
+            vm->jit_functions,
+            vm->jit_bytes
+        );
+    if (show_stats && use_jit && use_traces)
+        printf("Traces: %zu loops, %zu recordings aborted\n",
+            vm->traces,
+            vm->trace_aborts
+        );
+    printf("Execution took %.6f seconds\n", duration);
+
 cleanup:
+    if (closure_ctx)
+    {
+        closure_free(closure_ctx);
+        free(closure_ctx);
+        closure_compiler_free(&closure_compiler);
+    }
+    if (vm)
+    {
+        vm_free(vm);
+        free(vm);
+    }
+    bytecode_function_free(code);
+    free(cache_file);
     if (sema) sema_free(sema);
-    if (program) node_free(program);
+    if (optimizer)
+    {
+        optimizer_free(optimizer);
+        free(optimizer);
+    }
+    /* releases the program as well */
     if (parser) parser_free(parser);
     if (lexer) lexer_free(lexer);
+    source_free_all();
+    atom_free_all();
+    cache_free(&cache);
 
     // mpfr_free_cache();
     return result;
@@ -45,7 +45,7 @@ static void node_print_internal(node_t *node, int level)
             break;
 
         case NODE_DECLARATION:
-            printf("Declaration (%s):\n", node->declaration.kind.value);
+            printf("Declaration (%s):\n", token_type_to_lexeme(node->declaration.kind));
             for (size_t i = 0; i < node->declaration.count; i++) {
                 node_indent(level + 1);
                 printf("%s", node->declaration.names[i]->identifier);
@@ -105,18 +105,18 @@ static void node_print_internal(node_t *node, int level)
             break;
                 
         case NODE_BINARY:
-            printf("Binary: '%s'\n", node->binary.op.value);
+            printf("Binary: '%s'\n", token_type_to_lexeme(node->op));
             node_print_internal(node->binary.left, level + 1);
             node_print_internal(node->binary.right, level + 1);
             break;
         
         case NODE_UNARY:
-            printf("Unary '%s'\n", node->unary.op.value);
+            printf("Unary '%s'\n", token_type_to_lexeme(node->op));
             node_print_internal(node->unary.right, level + 1);
             break;
         
         case NODE_ASSIGNMENT:
-            printf("Assignment '%s'\n", node->assignment.op.value);
+            printf("Assignment '%s'\n", token_type_to_lexeme(node->op));
             node_print_internal(node->assignment.target, level + 1);
             node_print_internal(node->assignment.value, level + 1);
             break;
@@ -204,7 +204,7 @@ static void node_print_internal(node_t *node, int level)
             break;
 
         case NODE_POSTFIX:
-            printf("Postfix '%s'\n", node->postfix.op.value);
+            printf("Postfix '%s'\n", token_type_to_lexeme(node->op));
     		node_print_internal(node->postfix.left, level + 1);
             break;
         
@@ -240,6 +240,10 @@ static void node_print_internal(node_t *node, int level)
             }
 
             node_indent(level + 1);
+            if (!node->function.body) {
+                printf("Body: (not parsed yet, %u bytes)\n", node->function.body_end - node->function.body_start);
+                break;
+            }
             printf("Body:\n");
             node_print_internal(node->function.body, level + 2);
             break;
@@ -391,243 +395,6 @@ static void node_print_internal(node_t *node, int level)
     }
 }
 
-void node_free(node_t *node)
-{
-    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'node_free'");
-
-    if (!node) return;
-
-    switch (node->type)
-    {
-        case NODE_PROGRAM:
-            for (size_t i = 0; i < node->program.count; i++)
-                node_free(node->program.statements[i]);
-            free(node->program.statements);
-            break;
-        
-        case NODE_BLOCK:
-            for (size_t i = 0; i < node->block.count; i++)
-                node_free(node->block.statements[i]);
-            free(node->block.statements);
-            break;
-        
-        case NODE_BINARY:
-            node_free(node->binary.left);
-            node_free(node->binary.right);
-            break;
-        
-        case NODE_UNARY:
-            node_free(node->unary.right);
-            break;
-
-        case NODE_ASSIGNMENT:
-            node_free(node->assignment.target);
-            node_free(node->assignment.value);
-            break;
-
-        case NODE_TERNARY:
-            node_free(node->ternary.condition);
-            node_free(node->ternary.true_expr);
-            node_free(node->ternary.false_expr);
-            break;
-
-        case NODE_IF:
-            node_free(node->if_stmt.condition);
-            node_free(node->if_stmt.then_branch);
-            node_free(node->if_stmt.else_branch);
-            break;
-
-        case NODE_WHILE:
-            node_free(node->while_stmt.condition);
-            node_free(node->while_stmt.body);
-            break;
-
-        case NODE_DO_WHILE:
-            node_free(node->while_stmt.body);
-            node_free(node->while_stmt.condition);
-            break;
-
-
-        case NODE_FOR:
-            node_free(node->for_stmt.body);
-            node_free(node->for_stmt.init);
-            node_free(node->for_stmt.condition);
-            node_free(node->for_stmt.increment);
-            break;
-
-        case NODE_CALL:
-            node_free(node->call.callee);
-            for (size_t i = 0; i < node->call.arg_count; ++i)
-                node_free(node->call.args[i]);
-            free(node->call.args);
-            break;
-
-        case NODE_POSTFIX:
-            node_free(node->postfix.left);
-            break;
-        
-        case NODE_INDEX:
-            node_free(node->index.array);
-            node_free(node->index.index);
-            break;
-
-        case NODE_MEMBER:
-            node_free(node->member.object);
-            node_free(node->member.property);
-            break;
-
-        case NODE_FUNCTION:
-            free(node->function.name);
-            for (size_t i = 0; i < node->function.param_count; i++) {
-                free(node->function.params[i].name);
-                node_free(node->function.params[i].default_value);
-            }
-            free(node->function.params);
-            node_free(node->function.body);
-            break;
-
-        case NODE_ARRAY:
-            for (size_t i = 0; i < node->array.count; i++)
-                node_free(node->array.elements[i]);
-            free(node->array.elements);
-            break;
-
-        case NODE_OBJECT:
-            for (size_t i = 0; i < node->object.count; i++) {
-                free(node->object.keys[i]);
-                node_free(node->object.values[i]);
-            }
-            free(node->object.keys);
-            free(node->object.values);
-            break;
-
-        case NODE_SPREAD:
-            node_free(node->spread.argument);
-            break;
-
-        case NODE_DECLARATION:
-            for (size_t i = 0; i < node->declaration.count; i++) {
-                node_free(node->declaration.names[i]);
-                node_free(node->declaration.values[i]);
-            }
-            free(node->declaration.names);
-            free(node->declaration.values);
-            break;
-
-        case NODE_SWITCH:
-            node_free(node->switch_stmt.expr);
-
-            for (size_t i = 0; i < node->switch_stmt.cases_count; i++) {
-                for (size_t j = 0; j < node->switch_stmt.cases[i].labels_count; j++) {
-                    node_free(node->switch_stmt.cases[i].labels[j]);
-                }
-                free(node->switch_stmt.cases[i].labels);
-                node_free(node->switch_stmt.cases[i].body);
-            }
-            free(node->switch_stmt.cases);
-            break;
-
-        case NODE_LABEL:
-            free(node->label.name);
-            node_free(node->label.statement);
-            break;
-        
-        case NODE_AWAIT:
-            node_free(node->await_expr.argument);
-            break;
-
-        case NODE_NEW:
-            node_free(node->new_expr.argument);
-            break;
-
-        case NODE_BREAK:
-            free(node->break_stmt.label);
-            break;
-
-        case NODE_CONTINUE:
-            free(node->continue_stmt.label);
-            break;
-
-        case NODE_THROW:
-            node_free(node->throw_stmt.value);
-            break;
-
-        case NODE_TRY:
-            node_free(node->try_stmt.try_block);
-            free(node->try_stmt.catch_param);
-            node_free(node->try_stmt.catch_block);
-            node_free(node->try_stmt.finally_block);
-            break;
-
-        case NODE_RETURN:
-            node_free(node->return_stmt.value);
-            break;
-
-        case NODE_IMPORT:
-            free(node->import_stmt.module);
-
-            if (node->import_stmt.default_name) {
-                free(node->import_stmt.default_name);
-            }
-
-            for (size_t i = 0; i < node->import_stmt.named_count; i++) {
-                free(node->import_stmt.imported[i]);
-            }
-            free(node->import_stmt.imported);
-            break;
-
-        case NODE_EXPORT:
-            node_free(node->export_stmt.declaration);
-            for (size_t i = 0; i < node->export_stmt.named_count; i++) {
-                free(node->export_stmt.exported[i]);
-            }
-            free(node->export_stmt.exported);
-            break;
-
-        case NODE_UNDEFINED:
-            /* nothing to free */
-            break;
-
-        case NODE_NULL:
-            /* nothing to free */
-            break;
-        
-        case NODE_NUMBER:
-            // mpfr_clear(node->number);
-            break;
-        
-        case NODE_STRING:
-            free(node->string);
-            break;
-        
-        case NODE_BOOL:
-            /* nothing to free */
-            break;
-
-        case NODE_IDENTIFIER:
-            free(node->identifier);
-            break;
-
-        case NODE_THIS:
-            /* nothing to free */
-            break;
-        
-        case NODE_DEBUGGER:
-            /* nothing to free */
-            break;
-
-        case NODE_EMPTY:
-            /* nothing to free */
-            break;
-    
-        default:
-            ERROR("Unreachable! For type: (%s)%d\n", node_type_to_string(node->type), node->type);
-            break;
-    }
-
-    free(node);
-}
-
 static void node_build_internal(node_t *node);
 
 void node_build(node_t *node)
@@ -662,7 +429,7 @@ static void node_build_internal(node_t *node)
             break;
 
         case NODE_DECLARATION:
-            printf("%s ", node->declaration.kind.value);
+            printf("%s ", token_type_to_lexeme(node->declaration.kind));
             for (size_t i = 0; i < node->declaration.count; i++) {
                 printf("%s", node->declaration.names[i]->identifier);
                 if (node->declaration.values[i]) {
@@ -713,19 +480,19 @@ static void node_build_internal(node_t *node)
         case NODE_BINARY:
             printf("(");
             node_build_internal(node->binary.left);
-            printf(" %s ", node->binary.op.value);
+            printf(" %s ", token_type_to_lexeme(node->op));
             node_build_internal(node->binary.right);
             printf(")");
             break;
 
         case NODE_UNARY:
-            printf("%s", node->unary.op.value);
+            printf("%s", token_type_to_lexeme(node->op));
             node_build_internal(node->unary.right);
             break;
 
         case NODE_ASSIGNMENT:
             node_build_internal(node->assignment.target);
-            printf(" %s ", node->assignment.op.value);
+            printf(" %s ", token_type_to_lexeme(node->op));
             node_build_internal(node->assignment.value);
             break;
 
@@ -786,7 +553,7 @@ static void node_build_internal(node_t *node)
 
         case NODE_POSTFIX:
             node_build_internal(node->postfix.left);
-            printf("%s", node->postfix.op.value);
+            printf("%s", token_type_to_lexeme(node->op));
             break;
 
         case NODE_INDEX:
@@ -817,6 +584,12 @@ static void node_build_internal(node_t *node)
                 if (i < node->function.param_count - 1) printf(", ");
             }
             printf(") ");
+            if (!node->function.body) {
+                /* not parsed yet, the source text is the body */
+                printf("%.*s", (int) (node->function.body_end - node->function.body_start),
+                    source_get(node->loc.file)->data + node->function.body_start);
+                break;
+            }
             node_build_internal(node->function.body);
             break;
 
@@ -954,88 +727,170 @@ static void node_build_internal(node_t *node)
     }
 }
 
-static node_t *node_new(node_type_t type, location_t loc)
+/* nodes without data end after the header */
+#define NODE_HEADER_SIZE (offsetof(node_t, flags) + sizeof(uint8_t))
+#define NODE_VARIANT_SIZE(variant) (offsetof(node_t, variant) + sizeof(((node_t *) 0)->variant))
+
+static_assert(TOKEN_COUNT <= UINT8_MAX + 1, "Fix node_op_t for TOKEN_COUNT");
+
+static const size_t node_sizes[NODE_COUNT] = {
+    [NODE_NUMBER]       = NODE_VARIANT_SIZE(number),
+    [NODE_STRING]       = NODE_VARIANT_SIZE(string),
+    [NODE_BOOL]         = NODE_VARIANT_SIZE(boolean),
+    [NODE_IDENTIFIER]   = NODE_VARIANT_SIZE(binding),
+    [NODE_ARRAY]        = NODE_VARIANT_SIZE(array),
+    [NODE_OBJECT]       = NODE_VARIANT_SIZE(object),
+    [NODE_SPREAD]       = NODE_VARIANT_SIZE(spread),
+    [NODE_UNDEFINED]    = NODE_HEADER_SIZE,
+    [NODE_NULL]         = NODE_HEADER_SIZE,
+    [NODE_PROGRAM]      = NODE_VARIANT_SIZE(program),
+    [NODE_BLOCK]        = NODE_VARIANT_SIZE(block),
+    [NODE_BINARY]       = NODE_VARIANT_SIZE(binary),
+    [NODE_UNARY]        = NODE_VARIANT_SIZE(unary),
+    [NODE_ASSIGNMENT]   = NODE_VARIANT_SIZE(assignment),
+    [NODE_TERNARY]      = NODE_VARIANT_SIZE(ternary),
+    [NODE_IF]           = NODE_VARIANT_SIZE(if_stmt),
+    [NODE_WHILE]        = NODE_VARIANT_SIZE(while_stmt),
+    [NODE_DO_WHILE]     = NODE_VARIANT_SIZE(do_while_stmt),
+    [NODE_FOR]          = NODE_VARIANT_SIZE(for_stmt),
+    [NODE_CALL]         = NODE_VARIANT_SIZE(call),
+    [NODE_INDEX]        = NODE_VARIANT_SIZE(index),
+    [NODE_MEMBER]       = NODE_VARIANT_SIZE(member),
+    [NODE_POSTFIX]      = NODE_VARIANT_SIZE(postfix),
+    [NODE_FUNCTION]     = NODE_VARIANT_SIZE(function),
+    [NODE_DECLARATION]  = NODE_VARIANT_SIZE(declaration),
+    [NODE_SWITCH]       = NODE_VARIANT_SIZE(switch_stmt),
+    [NODE_LABEL]        = NODE_VARIANT_SIZE(label),
+    [NODE_AWAIT]        = NODE_VARIANT_SIZE(await_expr),
+    [NODE_NEW]          = NODE_VARIANT_SIZE(new_expr),
+    [NODE_THIS]         = NODE_HEADER_SIZE,
+    [NODE_DEBUGGER]     = NODE_HEADER_SIZE,
+    [NODE_BREAK]        = NODE_VARIANT_SIZE(break_stmt),
+    [NODE_CONTINUE]     = NODE_VARIANT_SIZE(continue_stmt),
+    [NODE_THROW]        = NODE_VARIANT_SIZE(throw_stmt),
+    [NODE_TRY]          = NODE_VARIANT_SIZE(try_stmt),
+    [NODE_RETURN]       = NODE_VARIANT_SIZE(return_stmt),
+    [NODE_IMPORT]       = NODE_VARIANT_SIZE(import_stmt),
+    [NODE_EXPORT]       = NODE_VARIANT_SIZE(export_stmt),
+    [NODE_EMPTY]        = NODE_HEADER_SIZE,
+};
+
+static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'node_sizes'");
+
+static struct
 {
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) {
-        fprintf(stderr, "node allocation failed!\n");
-        exit(1);
-    }
+    size_t count;
+    size_t bytes;
+} node_stats[NODE_COUNT];
+
+size_t node_size(node_type_t type)
+{
+    return node_sizes[type];
+}
+
+node_t *node_new(arena_t *arena, node_type_t type, location_t loc)
+{
+    node_t *node = arena_alloc(arena, node_sizes[type]);
     node->type = type;
     node->loc = loc;
+    if (type == NODE_NUMBER) node->flags = NODE_FLAG_NUMBER;
+
+    node_stats[type].count++;
+    node_stats[type].bytes += node_sizes[type];
     return node;
 }
 
+void node_stats_print(void)
+{
+    size_t count = 0, bytes = 0;
+
+    printf("%-12s %10s %12s\n", "Node", "Count", "Bytes");
+    for (size_t type = 0; type < NODE_COUNT; type++)
+    {
+        if (!node_stats[type].count) continue;
+
+        printf("%-12s %10zu %12zu\n",
+            node_type_to_string(type),
+            node_stats[type].count,
+            node_stats[type].bytes
+        );
+        count += node_stats[type].count;
+        bytes += node_stats[type].bytes;
+    }
+    printf("%-12s %10zu %12zu (%zu at a fixed %zu bytes per node)\n",
+        "Total", count, bytes, count * sizeof(node_t), sizeof(node_t));
+}
+
 // simple literals
-node_t *node_create_number(number_t value, location_t loc)  {
-    node_t *node = node_new(NODE_NUMBER, loc);
+node_t *node_create_number(arena_t *arena, number_t value, location_t loc)  {
+    node_t *node = node_new(arena, NODE_NUMBER, loc);
     node->number = value;
     return node;
 }
 
-node_t *node_create_string(string_t value, location_t loc) {
-    node_t *node = node_new(NODE_STRING, loc);
+node_t *node_create_string(arena_t *arena, string_t value, location_t loc) {
+    node_t *node = node_new(arena, NODE_STRING, loc);
     node->string = value;
     return node;
 }
 
-node_t *node_create_bool(bool value, location_t loc) {
-    node_t *node = node_new(NODE_BOOL, loc);
+node_t *node_create_bool(arena_t *arena, bool value, location_t loc) {
+    node_t *node = node_new(arena, NODE_BOOL, loc);
     node->boolean = value;
     return node;
 }
 
-node_t *node_create_identifier(const char *name, location_t loc) {
-    node_t *node = node_new(NODE_IDENTIFIER, loc);
-    node->identifier = strdup(name);
+node_t *node_create_identifier(arena_t *arena, atom_t name, location_t loc) {
+    node_t *node = node_new(arena, NODE_IDENTIFIER, loc);
+    node->identifier = name;
     return node;
 }
 
-node_t *node_create_null(location_t loc) {
-    return node_new(NODE_NULL, loc);
+node_t *node_create_null(arena_t *arena, location_t loc) {
+    return node_new(arena, NODE_NULL, loc);
 }
 
-node_t *node_create_undefined(location_t loc) {
-    return node_new(NODE_UNDEFINED, loc);
+node_t *node_create_undefined(arena_t *arena, location_t loc) {
+    return node_new(arena, NODE_UNDEFINED, loc);
 }
 
-node_t *node_create_this(location_t loc) {
-    return node_new(NODE_THIS, loc);
+node_t *node_create_this(arena_t *arena, location_t loc) {
+    return node_new(arena, NODE_THIS, loc);
 }
 
 /* Unary / Binary / Ternary */
-node_t *node_create_unary(token_t op, node_t *right, location_t loc) {
-    node_t *node = node_new(NODE_UNARY, loc);
-    node->unary.op = op;
+node_t *node_create_unary(arena_t *arena, node_op_t op, node_t *right, location_t loc) {
+    node_t *node = node_new(arena, NODE_UNARY, loc);
+    node->op = op;
     node->unary.right = right;
     return node;
 }
 
-node_t *node_create_postfix(token_t op, node_t *left, location_t loc) {
-    node_t *node = node_new(NODE_POSTFIX, loc);
-    node->postfix.op = op;
+node_t *node_create_postfix(arena_t *arena, node_op_t op, node_t *left, location_t loc) {
+    node_t *node = node_new(arena, NODE_POSTFIX, loc);
+    node->op = op;
     node->postfix.left = left;
     return node;
 }
 
-node_t *node_create_binary(node_t *left, token_t op, node_t *right, location_t loc) {
-    node_t *node = node_new(NODE_BINARY, loc);
+node_t *node_create_binary(arena_t *arena, node_t *left, node_op_t op, node_t *right, location_t loc) {
+    node_t *node = node_new(arena, NODE_BINARY, loc);
     node->binary.left = left;
-    node->binary.op = op;
+    node->op = op;
     node->binary.right = right;
     return node;
 }
 
-node_t *node_create_assignment(node_t *target, token_t op, node_t *value, location_t loc) {
-    node_t *node = node_new(NODE_ASSIGNMENT, loc);
+node_t *node_create_assignment(arena_t *arena, node_t *target, node_op_t op, node_t *value, location_t loc) {
+    node_t *node = node_new(arena, NODE_ASSIGNMENT, loc);
     node->assignment.target = target;
-    node->assignment.op = op;
+    node->op = op;
     node->assignment.value = value;
     return node;
 }
 
-node_t *node_create_ternary(node_t *condition, node_t *true_expr, node_t *false_expr, location_t loc) {
-    node_t *node = node_new(NODE_TERNARY, loc);
+node_t *node_create_ternary(arena_t *arena, node_t *condition, node_t *true_expr, node_t *false_expr, location_t loc) {
+    node_t *node = node_new(arena, NODE_TERNARY, loc);
     node->ternary.condition = condition;
     node->ternary.true_expr = true_expr;
     node->ternary.false_expr = false_expr;
@@ -1043,30 +898,30 @@ node_t *node_create_ternary(node_t *condition, node_t *true_expr, node_t *false_
 }
 
 /* Control flow */
-node_t *node_create_if(node_t *condition, node_t *then_branch, node_t *else_branch, location_t loc) {
-    node_t *node = node_new(NODE_IF, loc);
+node_t *node_create_if(arena_t *arena, node_t *condition, node_t *then_branch, node_t *else_branch, location_t loc) {
+    node_t *node = node_new(arena, NODE_IF, loc);
     node->if_stmt.condition = condition;
     node->if_stmt.then_branch = then_branch;
     node->if_stmt.else_branch = else_branch;
     return node;
 }
 
-node_t *node_create_while(node_t *condition, node_t *body, location_t loc) {
-    node_t *node = node_new(NODE_WHILE, loc);
+node_t *node_create_while(arena_t *arena, node_t *condition, node_t *body, location_t loc) {
+    node_t *node = node_new(arena, NODE_WHILE, loc);
     node->while_stmt.condition = condition;
     node->while_stmt.body = body;
     return node;
 }
 
-node_t *node_create_do_while(node_t *body, node_t *condition, location_t loc) {
-    node_t *node = node_new(NODE_DO_WHILE, loc);
+node_t *node_create_do_while(arena_t *arena, node_t *body, node_t *condition, location_t loc) {
+    node_t *node = node_new(arena, NODE_DO_WHILE, loc);
     node->do_while_stmt.body = body;
     node->do_while_stmt.condition = condition;
     return node;
 }
 
-node_t *node_create_for(node_t *init, node_t *condition, node_t *increment, node_t *body, location_t loc) {
-    node_t *node = node_new(NODE_FOR, loc);
+node_t *node_create_for(arena_t *arena, node_t *init, node_t *condition, node_t *increment, node_t *body, location_t loc) {
+    node_t *node = node_new(arena, NODE_FOR, loc);
     node->for_stmt.init = init;
     node->for_stmt.condition = condition;
     node->for_stmt.increment = increment;
@@ -1074,65 +929,65 @@ node_t *node_create_for(node_t *init, node_t *condition, node_t *increment, node
     return node;
 }
 
-node_t *node_create_break(const char *label, location_t loc) {
-    node_t *node = node_new(NODE_BREAK, loc);
-    if (label) node->break_stmt.label = strdup(label);
+node_t *node_create_break(arena_t *arena, atom_t label, location_t loc) {
+    node_t *node = node_new(arena, NODE_BREAK, loc);
+    node->break_stmt.label = label;
     return node;
 }
 
-node_t *node_create_continue(const char *label, location_t loc) {
-    node_t *node = node_new(NODE_CONTINUE, loc);
-    if (label) node->continue_stmt.label = strdup(label);
+node_t *node_create_continue(arena_t *arena, atom_t label, location_t loc) {
+    node_t *node = node_new(arena, NODE_CONTINUE, loc);
+    node->continue_stmt.label = label;
     return node;
 }
 
-node_t *node_create_return(node_t *value, location_t loc) {
-    node_t *node = node_new(NODE_RETURN, loc);
+node_t *node_create_return(arena_t *arena, node_t *value, location_t loc) {
+    node_t *node = node_new(arena, NODE_RETURN, loc);
     node->return_stmt.value = value;
     return node;
 }
 
-node_t *node_create_throw(node_t *value, location_t loc) {
-    node_t *node = node_new(NODE_THROW, loc);
+node_t *node_create_throw(arena_t *arena, node_t *value, location_t loc) {
+    node_t *node = node_new(arena, NODE_THROW, loc);
     node->throw_stmt.value = value;
     return node;
 }
 
-node_t *node_create_try(node_t *try_block, const char *catch_param, node_t *catch_block, node_t *finally_block, location_t loc) {
-    node_t *node = node_new(NODE_TRY, loc);
+node_t *node_create_try(arena_t *arena, node_t *try_block, atom_t catch_param, node_t *catch_block, node_t *finally_block, location_t loc) {
+    node_t *node = node_new(arena, NODE_TRY, loc);
     node->try_stmt.try_block = try_block;
     node->try_stmt.catch_block = catch_block;
     node->try_stmt.finally_block = finally_block;
-    if (catch_param) node->try_stmt.catch_param = strdup(catch_param);
+    node->try_stmt.catch_param = catch_param;
     return node;
 }
 
-node_t *node_create_label(const char *name, node_t *statement, location_t loc) {
-    node_t *node = node_new(NODE_LABEL, loc);
+node_t *node_create_label(arena_t *arena, atom_t name, node_t *statement, location_t loc) {
+    node_t *node = node_new(arena, NODE_LABEL, loc);
     node->label.statement = statement;
-    if (name) node->label.name = strdup(name);
+    node->label.name = name;
     return node;
 }
 
 /* Blocks and programs */
-node_t *node_create_block(node_t **statements, size_t count, location_t loc) {
-    node_t *node = node_new(NODE_BLOCK, loc);
+node_t *node_create_block(arena_t *arena, node_t **statements, size_t count, location_t loc) {
+    node_t *node = node_new(arena, NODE_BLOCK, loc);
     node->block.statements = statements;
     node->block.count = count;
     return node;
 }
 
-node_t *node_create_program(node_t **statements, size_t count, location_t loc) {
-    node_t *node = node_new(NODE_PROGRAM, loc);
+node_t *node_create_program(arena_t *arena, node_t **statements, size_t count, location_t loc) {
+    node_t *node = node_new(arena, NODE_PROGRAM, loc);
     node->program.statements = statements;
     node->program.count = count;
     return node;
 }
 
 /* Functions and calls */
-node_t *node_create_function(const char *name, bool is_async, size_t param_count, location_t loc) {
-    node_t *node = node_new(NODE_FUNCTION, loc);
-    node->function.name = name ? strdup(name) : NULL;
+node_t *node_create_function(arena_t *arena, atom_t name, bool is_async, size_t param_count, location_t loc) {
+    node_t *node = node_new(arena, NODE_FUNCTION, loc);
+    node->function.name = name;
     node->function.is_async = is_async;
     node->function.param_count = param_count;
     node->function.params = NULL; // allocate separately if needed
@@ -1140,62 +995,62 @@ node_t *node_create_function(const char *name, bool is_async, size_t param_count
     return node;
 }
 
-node_t *node_create_call(node_t *callee, node_t **args, size_t arg_count, location_t loc) {
-    node_t *node = node_new(NODE_CALL, loc);
+node_t *node_create_call(arena_t *arena, node_t *callee, node_t **args, size_t arg_count, location_t loc) {
+    node_t *node = node_new(arena, NODE_CALL, loc);
     node->call.callee = callee;
     node->call.args = args;
     node->call.arg_count = arg_count;
     return node;
 }
 
-node_t *node_create_index(node_t *array, node_t *index, location_t loc) {
-    node_t *node = node_new(NODE_INDEX, loc);
+node_t *node_create_index(arena_t *arena, node_t *array, node_t *index, location_t loc) {
+    node_t *node = node_new(arena, NODE_INDEX, loc);
     node->index.array = array;
     node->index.index = index;
     return node;
 }
 
-node_t *node_create_member(node_t *object, node_t *property, location_t loc) {
-    node_t *node = node_new(NODE_MEMBER, loc);
+node_t *node_create_member(arena_t *arena, node_t *object, node_t *property, location_t loc) {
+    node_t *node = node_new(arena, NODE_MEMBER, loc);
     node->member.object = object;
     node->member.property = property;
     return node;
 }
 
 /* Arrays / Objects / Spread */
-node_t *node_create_array(node_t **elements, size_t count, location_t loc) {
-    node_t *node = node_new(NODE_ARRAY, loc);
+node_t *node_create_array(arena_t *arena, node_t **elements, size_t count, location_t loc) {
+    node_t *node = node_new(arena, NODE_ARRAY, loc);
     node->array.elements = elements;
     node->array.count = count;
     return node;
 }
 
-node_t *node_create_object(char **keys, node_t **values, size_t count, location_t loc) {
-    node_t *node = node_new(NODE_OBJECT, loc);
+node_t *node_create_object(arena_t *arena, atom_t *keys, node_t **values, size_t count, location_t loc) {
+    node_t *node = node_new(arena, NODE_OBJECT, loc);
     node->object.keys = keys;
     node->object.values = values;
     node->object.count = count;
     return node;
 }
 
-node_t *node_create_spread(node_t *argument, location_t loc) {
-    node_t *node = node_new(NODE_SPREAD, loc);
+node_t *node_create_spread(arena_t *arena, node_t *argument, location_t loc) {
+    node_t *node = node_new(arena, NODE_SPREAD, loc);
     node->spread.argument = argument;
     return node;
 }
 
 /* Imports / Exports / Declarations */
-node_t *node_create_import(const char *module, const char *default_name, size_t named_count, char **imported, location_t loc) {
-    node_t *node = node_new(NODE_IMPORT, loc);
-    node->import_stmt.module = strdup(module);
-    node->import_stmt.default_name = default_name ? strdup(default_name) : NULL;
+node_t *node_create_import(arena_t *arena, const char *module, const char *default_name, size_t named_count, char **imported, location_t loc) {
+    node_t *node = node_new(arena, NODE_IMPORT, loc);
+    node->import_stmt.module = arena_strndup(arena, module, strlen(module));
+    node->import_stmt.default_name = default_name ? arena_strndup(arena, default_name, strlen(default_name)) : NULL;
     node->import_stmt.named_count = named_count;
     node->import_stmt.imported = imported;
     return node;
 }
 
-node_t *node_create_export(node_t *declaration, bool is_default, size_t named_count, char **exported, location_t loc) {
-    node_t *node = node_new(NODE_EXPORT, loc);
+node_t *node_create_export(arena_t *arena, node_t *declaration, bool is_default, size_t named_count, char **exported, location_t loc) {
+    node_t *node = node_new(arena, NODE_EXPORT, loc);
     node->export_stmt.declaration = declaration;
     node->export_stmt.is_default = is_default;
     node->export_stmt.named_count = named_count;
@@ -1203,8 +1058,8 @@ node_t *node_create_export(node_t *declaration, bool is_default, size_t named_co
     return node;
 }
 
-node_t *node_create_declaration(token_t kind, node_t **names, node_t **values, size_t count, location_t loc) {
-    node_t *node = node_new(NODE_DECLARATION, loc);
+node_t *node_create_declaration(arena_t *arena, node_op_t kind, node_t **names, node_t **values, size_t count, location_t loc) {
+    node_t *node = node_new(arena, NODE_DECLARATION, loc);
     node->declaration.kind = kind;
     node->declaration.names = names;
     node->declaration.values = values;
@@ -1213,15 +1068,51 @@ node_t *node_create_declaration(token_t kind, node_t **names, node_t **values, s
 }
 
 /* Await */
-node_t *node_create_await(node_t *argument, location_t loc) {
-    node_t *node = node_new(NODE_AWAIT, loc);
+node_t *node_create_await(arena_t *arena, node_t *argument, location_t loc) {
+    node_t *node = node_new(arena, NODE_AWAIT, loc);
     node->await_expr.argument = argument;
     return node;
 }
 
 /* Empty node */
-node_t *node_create_empty(location_t loc) {
-    return node_new(NODE_EMPTY, loc);
+node_t *node_create_empty(arena_t *arena, location_t loc) {
+    return node_new(arena, NODE_EMPTY, loc);
+}
+
+bool node_is_expression(const node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'node_is_expression'");
+
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+        case NODE_STRING:
+        case NODE_BOOL:
+        case NODE_IDENTIFIER:
+        case NODE_ARRAY:
+        case NODE_OBJECT:
+        case NODE_SPREAD:
+        case NODE_UNDEFINED:
+        case NODE_NULL:
+        case NODE_BINARY:
+        case NODE_UNARY:
+        case NODE_ASSIGNMENT:
+        case NODE_TERNARY:
+        case NODE_CALL:
+        case NODE_INDEX:
+        case NODE_MEMBER:
+        case NODE_POSTFIX:
+        case NODE_AWAIT:
+        case NODE_THIS:
+        case NODE_NEW:
+            return true;
+
+        case NODE_FUNCTION:
+            return !node->function.is_declaration;
+
+        default:
+            return false;
+    }
 }
 
 const char *node_type_to_string(node_type_t type)
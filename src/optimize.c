@@ -0,0 +1,664 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "optimize.h"
+
+void optimizer_init(optimizer_t *optimizer)
+{
+    arena_init(&optimizer->arena);
+    optimizer->math = atom_from_cstr("Math");
+    optimizer->folded = 0;
+    optimizer->removed = 0;
+}
+
+void optimizer_free(optimizer_t *optimizer)
+{
+    arena_free(&optimizer->arena);
+}
+
+/* whether `node` binds or assigns `name` anywhere, lazily parsed bodies might */
+static bool optimize_rebinds(const node_t *node, atom_t name)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'optimize_rebinds'");
+
+    if (!node) return false;
+
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+        case NODE_STRING:
+        case NODE_BOOL:
+        case NODE_IDENTIFIER:
+        case NODE_UNDEFINED:
+        case NODE_NULL:
+        case NODE_THIS:
+        case NODE_DEBUGGER:
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+        case NODE_EMPTY:
+            return false;
+
+        case NODE_ARRAY:
+            for (size_t i = 0; i < node->array.count; i++)
+                if (optimize_rebinds(node->array.elements[i], name)) return true;
+            return false;
+
+        case NODE_OBJECT:
+            for (size_t i = 0; i < node->object.count; i++)
+                if (optimize_rebinds(node->object.values[i], name)) return true;
+            return false;
+
+        case NODE_PROGRAM:
+            for (size_t i = 0; i < node->program.count; i++)
+                if (optimize_rebinds(node->program.statements[i], name)) return true;
+            return false;
+
+        case NODE_BLOCK:
+            for (size_t i = 0; i < node->block.count; i++)
+                if (optimize_rebinds(node->block.statements[i], name)) return true;
+            return false;
+
+        case NODE_SPREAD: return optimize_rebinds(node->spread.argument, name);
+        case NODE_AWAIT: return optimize_rebinds(node->await_expr.argument, name);
+        case NODE_NEW: return optimize_rebinds(node->new_expr.argument, name);
+        case NODE_THROW: return optimize_rebinds(node->throw_stmt.value, name);
+        case NODE_RETURN: return optimize_rebinds(node->return_stmt.value, name);
+        case NODE_EXPORT: return optimize_rebinds(node->export_stmt.declaration, name);
+
+        case NODE_UNARY:
+        {
+            const node_t *right = node->unary.right;
+            if ((node->op == TOKEN_PLUS_PLUS || node->op == TOKEN_MINUS_MINUS) &&
+                right->type == NODE_IDENTIFIER && right->identifier == name)
+                return true;
+            return optimize_rebinds(right, name);
+        }
+
+        case NODE_POSTFIX:
+        {
+            const node_t *left = node->postfix.left;
+            if (left->type == NODE_IDENTIFIER && left->identifier == name) return true;
+            return optimize_rebinds(left, name);
+        }
+
+        case NODE_ASSIGNMENT:
+        {
+            const node_t *target = node->assignment.target;
+            if (target->type == NODE_IDENTIFIER && target->identifier == name) return true;
+            return optimize_rebinds(target, name) || optimize_rebinds(node->assignment.value, name);
+        }
+
+        case NODE_BINARY:
+            return optimize_rebinds(node->binary.left, name) ||
+                   optimize_rebinds(node->binary.right, name);
+
+        case NODE_TERNARY:
+            return optimize_rebinds(node->ternary.condition, name) ||
+                   optimize_rebinds(node->ternary.true_expr, name) ||
+                   optimize_rebinds(node->ternary.false_expr, name);
+
+        case NODE_IF:
+            return optimize_rebinds(node->if_stmt.condition, name) ||
+                   optimize_rebinds(node->if_stmt.then_branch, name) ||
+                   optimize_rebinds(node->if_stmt.else_branch, name);
+
+        case NODE_WHILE:
+            return optimize_rebinds(node->while_stmt.condition, name) ||
+                   optimize_rebinds(node->while_stmt.body, name);
+
+        case NODE_DO_WHILE:
+            return optimize_rebinds(node->do_while_stmt.body, name) ||
+                   optimize_rebinds(node->do_while_stmt.condition, name);
+
+        case NODE_FOR:
+            return optimize_rebinds(node->for_stmt.init, name) ||
+                   optimize_rebinds(node->for_stmt.condition, name) ||
+                   optimize_rebinds(node->for_stmt.increment, name) ||
+                   optimize_rebinds(node->for_stmt.body, name);
+
+        case NODE_CALL:
+            if (optimize_rebinds(node->call.callee, name)) return true;
+            for (size_t i = 0; i < node->call.arg_count; i++)
+                if (optimize_rebinds(node->call.args[i], name)) return true;
+            return false;
+
+        case NODE_INDEX:
+            return optimize_rebinds(node->index.array, name) ||
+                   optimize_rebinds(node->index.index, name);
+
+        case NODE_MEMBER:
+            return optimize_rebinds(node->member.object, name);
+
+        case NODE_FUNCTION:
+            if (node->function.name == name || !node->function.body) return true;
+            for (size_t i = 0; i < node->function.param_count; i++)
+            {
+                if (node->function.params[i].name == name) return true;
+                if (optimize_rebinds(node->function.params[i].default_value, name)) return true;
+            }
+            return optimize_rebinds(node->function.body, name);
+
+        case NODE_DECLARATION:
+            for (size_t i = 0; i < node->declaration.count; i++)
+            {
+                const node_t *binding = node->declaration.names[i];
+                if (binding->type != NODE_IDENTIFIER || binding->identifier == name) return true;
+                if (node->declaration.values && optimize_rebinds(node->declaration.values[i], name))
+                    return true;
+            }
+            return false;
+
+        case NODE_SWITCH:
+            if (optimize_rebinds(node->switch_stmt.expr, name)) return true;
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+            {
+                const struct node_case *c = &node->switch_stmt.cases[i];
+                for (size_t j = 0; j < c->labels_count; j++)
+                    if (optimize_rebinds(c->labels[j], name)) return true;
+                if (optimize_rebinds(c->body, name)) return true;
+            }
+            return false;
+
+        case NODE_LABEL:
+            return optimize_rebinds(node->label.statement, name);
+
+        case NODE_TRY:
+            return node->try_stmt.catch_param == name ||
+                   optimize_rebinds(node->try_stmt.try_block, name) ||
+                   optimize_rebinds(node->try_stmt.catch_block, name) ||
+                   optimize_rebinds(node->try_stmt.finally_block, name);
+
+        case NODE_IMPORT:
+            if (node->import_stmt.default_name && strcmp(node->import_stmt.default_name, name) == 0)
+                return true;
+            for (size_t i = 0; i < node->import_stmt.named_count; i++)
+                if (strcmp(node->import_stmt.imported[i], name) == 0) return true;
+            return false;
+
+        default:
+            UNREACHABLE;
+    }
+}
+
+/* whether dropping statement `node` would lose a hoisted or block scoped binding */
+static bool optimize_declares(const node_t *node)
+{
+    if (!node) return false;
+
+    switch (node->type)
+    {
+        case NODE_DECLARATION:
+        case NODE_FUNCTION:
+        case NODE_IMPORT:
+        case NODE_EXPORT:
+            return true;
+
+        case NODE_BLOCK:
+            for (size_t i = 0; i < node->block.count; i++)
+                if (optimize_declares(node->block.statements[i])) return true;
+            return false;
+
+        case NODE_IF:
+            return optimize_declares(node->if_stmt.then_branch) ||
+                   optimize_declares(node->if_stmt.else_branch);
+
+        case NODE_WHILE: return optimize_declares(node->while_stmt.body);
+        case NODE_DO_WHILE: return optimize_declares(node->do_while_stmt.body);
+        case NODE_LABEL: return optimize_declares(node->label.statement);
+
+        case NODE_FOR:
+            return optimize_declares(node->for_stmt.init) ||
+                   optimize_declares(node->for_stmt.body);
+
+        case NODE_TRY:
+            return optimize_declares(node->try_stmt.try_block) ||
+                   optimize_declares(node->try_stmt.catch_block) ||
+                   optimize_declares(node->try_stmt.finally_block);
+
+        case NODE_SWITCH:
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+                if (optimize_declares(node->switch_stmt.cases[i].body)) return true;
+            return false;
+
+        default:
+            /* expressions cannot declare */
+            return false;
+    }
+}
+
+/* statements after one of these never run */
+static bool optimize_terminates(const node_t *node)
+{
+    return node->type == NODE_RETURN || node->type == NODE_BREAK ||
+           node->type == NODE_CONTINUE || node->type == NODE_THROW;
+}
+
+/* false if the truthiness of `node` is not known before evaluation */
+static bool optimize_truthy(const node_t *node, bool *truthy)
+{
+    switch (node->type)
+    {
+        case NODE_NUMBER: *truthy = node->number != 0 && !isnan(node->number); return true;
+        case NODE_STRING: *truthy = node->string[0] != '\0'; return true;
+        case NODE_BOOL: *truthy = node->boolean; return true;
+        case NODE_NULL:
+        case NODE_UNDEFINED: *truthy = false; return true;
+        default: return false;
+    }
+}
+
+static int32_t optimize_int32(number_t number)
+{
+    if (!isfinite(number)) return 0;
+
+    number_t wrapped = fmodl(truncl(number), 4294967296.0L);
+    if (wrapped < 0) wrapped += 4294967296.0L;
+    return (int32_t)(uint32_t) wrapped;
+}
+
+static node_t *optimize_number(optimizer_t *optimizer, number_t number, location_t loc)
+{
+    optimizer->folded++;
+    return node_create_number(&optimizer->arena, number, loc);
+}
+
+static node_t *optimize_bool(optimizer_t *optimizer, bool boolean, location_t loc)
+{
+    optimizer->folded++;
+    return node_create_bool(&optimizer->arena, boolean, loc);
+}
+
+static node_t *optimize_binary_numbers(optimizer_t *optimizer, node_t *node)
+{
+    number_t left = node->binary.left->number;
+    number_t right = node->binary.right->number;
+
+    switch (node->op)
+    {
+        case TOKEN_PLUS: return optimize_number(optimizer, left + right, node->loc);
+        case TOKEN_MINUS: return optimize_number(optimizer, left - right, node->loc);
+        case TOKEN_STAR: return optimize_number(optimizer, left * right, node->loc);
+        case TOKEN_STAR_STAR: return optimize_number(optimizer, powl(left, right), node->loc);
+
+        /* division by zero is left to the evaluator to report */
+        case TOKEN_SLASH:
+            if (right == 0) return node;
+            return optimize_number(optimizer, left / right, node->loc);
+
+        case TOKEN_PERCENT:
+            if (right == 0) return node;
+            return optimize_number(optimizer, fmodl(left, right), node->loc);
+
+        case TOKEN_AMPERSAND:
+            return optimize_number(optimizer, optimize_int32(left) & optimize_int32(right), node->loc);
+        case TOKEN_PIPE:
+            return optimize_number(optimizer, optimize_int32(left) | optimize_int32(right), node->loc);
+        case TOKEN_CARET:
+            return optimize_number(optimizer, optimize_int32(left) ^ optimize_int32(right), node->loc);
+        case TOKEN_LEFT_SHIFT:
+            return optimize_number(optimizer,
+                (int32_t)((uint32_t) optimize_int32(left) << (optimize_int32(right) & 31)), node->loc);
+        case TOKEN_RIGHT_SHIFT:
+            return optimize_number(optimizer, optimize_int32(left) >> (optimize_int32(right) & 31), node->loc);
+
+        case TOKEN_EQUAL_EQUAL: return optimize_bool(optimizer, left == right, node->loc);
+        case TOKEN_BANG_EQUAL: return optimize_bool(optimizer, left != right, node->loc);
+        case TOKEN_LESS: return optimize_bool(optimizer, left < right, node->loc);
+        case TOKEN_GREATER: return optimize_bool(optimizer, left > right, node->loc);
+        case TOKEN_LESS_EQUAL: return optimize_bool(optimizer, left <= right, node->loc);
+        case TOKEN_GREATER_EQUAL: return optimize_bool(optimizer, left >= right, node->loc);
+
+        default: return node;
+    }
+}
+
+static node_t *optimize_binary_strings(optimizer_t *optimizer, node_t *node)
+{
+    const char *left = node->binary.left->string;
+    const char *right = node->binary.right->string;
+
+    switch (node->op)
+    {
+        case TOKEN_PLUS:
+        {
+            size_t left_length = strlen(left);
+            size_t right_length = strlen(right);
+
+            char *string = arena_alloc(&optimizer->arena, left_length + right_length + 1);
+            memcpy(string, left, left_length);
+            memcpy(string + left_length, right, right_length + 1);
+
+            optimizer->folded++;
+            return node_create_string(&optimizer->arena, string, node->loc);
+        }
+
+        case TOKEN_EQUAL_EQUAL: return optimize_bool(optimizer, strcmp(left, right) == 0, node->loc);
+        case TOKEN_BANG_EQUAL: return optimize_bool(optimizer, strcmp(left, right) != 0, node->loc);
+
+        default: return node;
+    }
+}
+
+static node_t *optimize_binary(optimizer_t *optimizer, node_t *node)
+{
+    node_t *left = node->binary.left;
+    node_t *right = node->binary.right;
+
+    /* `&&` and `||` only need the left operand */
+    bool truthy;
+    if ((node->op == TOKEN_LOGICAL_AND || node->op == TOKEN_LOGICAL_OR) && optimize_truthy(left, &truthy))
+    {
+        optimizer->folded++;
+        return truthy == (node->op == TOKEN_LOGICAL_OR) ? left : right;
+    }
+
+    if (left->type == NODE_NUMBER && right->type == NODE_NUMBER)
+        return optimize_binary_numbers(optimizer, node);
+    if (left->type == NODE_STRING && right->type == NODE_STRING)
+        return optimize_binary_strings(optimizer, node);
+    return node;
+}
+
+static node_t *optimize_unary(optimizer_t *optimizer, node_t *node)
+{
+    node_t *right = node->unary.right;
+    bool truthy;
+
+    switch (node->op)
+    {
+        case TOKEN_MINUS:
+            if (right->type != NODE_NUMBER) return node;
+            return optimize_number(optimizer, -right->number, node->loc);
+
+        case TOKEN_PLUS:
+            if (right->type != NODE_NUMBER) return node;
+            return optimize_number(optimizer, right->number, node->loc);
+
+        case TOKEN_TILDE:
+            if (right->type != NODE_NUMBER) return node;
+            return optimize_number(optimizer, ~optimize_int32(right->number), node->loc);
+
+        case TOKEN_BANG:
+            if (!optimize_truthy(right, &truthy)) return node;
+            return optimize_bool(optimizer, !truthy, node->loc);
+
+        default:
+            return node;
+    }
+}
+
+/* `Math.PI` and friends, the constants of the evaluator's `Math` object */
+static node_t *optimize_member(optimizer_t *optimizer, node_t *node)
+{
+    static const struct { const char *name; number_t value; } constants[] = {
+        { "PI",  3.141592653589793238462643383279502884L },
+        { "E",   2.718281828459045235360287471352662498L },
+        { "PHI", 1.618033988749894848204586834365638118L },
+    };
+
+    node_t *object = node->member.object;
+    node_t *property = node->member.property;
+
+    if (!optimizer->math) return node;
+    if (object->type != NODE_IDENTIFIER || object->identifier != optimizer->math) return node;
+    if (property->type != NODE_IDENTIFIER) return node;
+
+    for (size_t i = 0; i < sizeof(constants) / sizeof(*constants); i++)
+        if (strcmp(property->identifier, constants[i].name) == 0)
+            return optimize_number(optimizer, constants[i].value, node->loc);
+    return node;
+}
+
+static node_t *optimize_node(optimizer_t *optimizer, node_t *node);
+
+/* only the subexpressions of an assignment target are values */
+static void optimize_target(optimizer_t *optimizer, node_t *target)
+{
+    if (target->type == NODE_MEMBER)
+    {
+        target->member.object = optimize_node(optimizer, target->member.object);
+    }
+    else if (target->type == NODE_INDEX)
+    {
+        target->index.array = optimize_node(optimizer, target->index.array);
+        target->index.index = optimize_node(optimizer, target->index.index);
+    }
+}
+
+static void optimize_statements(optimizer_t *optimizer, node_t **statements, size_t *count)
+{
+    size_t kept = 0;
+    bool reachable = true;
+
+    for (size_t i = 0; i < *count; i++)
+    {
+        node_t *statement = statements[i];
+        if (!reachable && !optimize_declares(statement))
+        {
+            optimizer->removed++;
+            continue;
+        }
+
+        statement = optimize_node(optimizer, statement);
+        statements[kept++] = statement;
+        if (optimize_terminates(statement)) reachable = false;
+    }
+
+    *count = kept;
+}
+
+/* the branch taken by a constant condition, NULL if it cannot replace `node` */
+static node_t *optimize_branch(optimizer_t *optimizer, node_t *node, node_t *taken, node_t *dropped)
+{
+    if (optimize_declares(dropped)) return NULL;
+    if (taken && (taken->type == NODE_DECLARATION || taken->type == NODE_FUNCTION)) return NULL;
+
+    optimizer->removed++;
+    return taken ? taken : node_create_empty(&optimizer->arena, node->loc);
+}
+
+static node_t *optimize_node(optimizer_t *optimizer, node_t *node)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'optimize_node'");
+
+    if (!node) return NULL;
+
+    bool truthy;
+
+    switch (node->type)
+    {
+        case NODE_NUMBER:
+        case NODE_STRING:
+        case NODE_BOOL:
+        case NODE_IDENTIFIER:
+        case NODE_UNDEFINED:
+        case NODE_NULL:
+        case NODE_THIS:
+        case NODE_DEBUGGER:
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+        case NODE_IMPORT:
+        case NODE_EMPTY:
+            return node;
+
+        case NODE_ARRAY:
+            for (size_t i = 0; i < node->array.count; i++)
+                node->array.elements[i] = optimize_node(optimizer, node->array.elements[i]);
+            return node;
+
+        case NODE_OBJECT:
+            for (size_t i = 0; i < node->object.count; i++)
+                node->object.values[i] = optimize_node(optimizer, node->object.values[i]);
+            return node;
+
+        case NODE_PROGRAM:
+            optimize_statements(optimizer, node->program.statements, &node->program.count);
+            return node;
+
+        case NODE_BLOCK:
+            optimize_statements(optimizer, node->block.statements, &node->block.count);
+            return node;
+
+        case NODE_SPREAD:
+            node->spread.argument = optimize_node(optimizer, node->spread.argument);
+            return node;
+
+        case NODE_AWAIT:
+            node->await_expr.argument = optimize_node(optimizer, node->await_expr.argument);
+            return node;
+
+        case NODE_NEW:
+            node->new_expr.argument = optimize_node(optimizer, node->new_expr.argument);
+            return node;
+
+        case NODE_THROW:
+            node->throw_stmt.value = optimize_node(optimizer, node->throw_stmt.value);
+            return node;
+
+        case NODE_RETURN:
+            node->return_stmt.value = optimize_node(optimizer, node->return_stmt.value);
+            return node;
+
+        case NODE_EXPORT:
+            node->export_stmt.declaration = optimize_node(optimizer, node->export_stmt.declaration);
+            return node;
+
+        case NODE_BINARY:
+            node->binary.left = optimize_node(optimizer, node->binary.left);
+            node->binary.right = optimize_node(optimizer, node->binary.right);
+            return optimize_binary(optimizer, node);
+
+        case NODE_UNARY:
+            if (node->op == TOKEN_PLUS_PLUS || node->op == TOKEN_MINUS_MINUS || node->op == TOKEN_DELETE)
+            {
+                optimize_target(optimizer, node->unary.right);
+                return node;
+            }
+            node->unary.right = optimize_node(optimizer, node->unary.right);
+            return optimize_unary(optimizer, node);
+
+        case NODE_POSTFIX:
+            optimize_target(optimizer, node->postfix.left);
+            return node;
+
+        case NODE_ASSIGNMENT:
+            optimize_target(optimizer, node->assignment.target);
+            node->assignment.value = optimize_node(optimizer, node->assignment.value);
+            return node;
+
+        case NODE_TERNARY:
+            node->ternary.condition = optimize_node(optimizer, node->ternary.condition);
+            node->ternary.true_expr = optimize_node(optimizer, node->ternary.true_expr);
+            node->ternary.false_expr = optimize_node(optimizer, node->ternary.false_expr);
+
+            if (optimize_truthy(node->ternary.condition, &truthy))
+            {
+                optimizer->folded++;
+                return truthy ? node->ternary.true_expr : node->ternary.false_expr;
+            }
+            return node;
+
+        case NODE_IF:
+        {
+            node->if_stmt.condition = optimize_node(optimizer, node->if_stmt.condition);
+            node->if_stmt.then_branch = optimize_node(optimizer, node->if_stmt.then_branch);
+            node->if_stmt.else_branch = optimize_node(optimizer, node->if_stmt.else_branch);
+
+            if (!optimize_truthy(node->if_stmt.condition, &truthy)) return node;
+
+            node_t *taken = truthy ? node->if_stmt.then_branch : node->if_stmt.else_branch;
+            node_t *dropped = truthy ? node->if_stmt.else_branch : node->if_stmt.then_branch;
+            node_t *branch = optimize_branch(optimizer, node, taken, dropped);
+            return branch ? branch : node;
+        }
+
+        case NODE_WHILE:
+        {
+            node->while_stmt.condition = optimize_node(optimizer, node->while_stmt.condition);
+            node->while_stmt.body = optimize_node(optimizer, node->while_stmt.body);
+
+            if (!optimize_truthy(node->while_stmt.condition, &truthy) || truthy) return node;
+
+            node_t *branch = optimize_branch(optimizer, node, NULL, node->while_stmt.body);
+            return branch ? branch : node;
+        }
+
+        case NODE_DO_WHILE:
+            node->do_while_stmt.body = optimize_node(optimizer, node->do_while_stmt.body);
+            node->do_while_stmt.condition = optimize_node(optimizer, node->do_while_stmt.condition);
+            return node;
+
+        case NODE_FOR:
+            node->for_stmt.init = optimize_node(optimizer, node->for_stmt.init);
+            node->for_stmt.condition = optimize_node(optimizer, node->for_stmt.condition);
+            node->for_stmt.increment = optimize_node(optimizer, node->for_stmt.increment);
+            node->for_stmt.body = optimize_node(optimizer, node->for_stmt.body);
+            return node;
+
+        case NODE_CALL:
+            node->call.callee = optimize_node(optimizer, node->call.callee);
+            for (size_t i = 0; i < node->call.arg_count; i++)
+                node->call.args[i] = optimize_node(optimizer, node->call.args[i]);
+            return node;
+
+        case NODE_INDEX:
+            node->index.array = optimize_node(optimizer, node->index.array);
+            node->index.index = optimize_node(optimizer, node->index.index);
+            return node;
+
+        case NODE_MEMBER:
+            node->member.object = optimize_node(optimizer, node->member.object);
+            return optimize_member(optimizer, node);
+
+        case NODE_FUNCTION:
+            for (size_t i = 0; i < node->function.param_count; i++)
+            {
+                struct node_param *param = &node->function.params[i];
+                param->default_value = optimize_node(optimizer, param->default_value);
+            }
+            /* a lazily pre-parsed body is left alone */
+            node->function.body = optimize_node(optimizer, node->function.body);
+            return node;
+
+        case NODE_DECLARATION:
+            if (node->declaration.values)
+                for (size_t i = 0; i < node->declaration.count; i++)
+                    node->declaration.values[i] = optimize_node(optimizer, node->declaration.values[i]);
+            return node;
+
+        case NODE_SWITCH:
+            node->switch_stmt.expr = optimize_node(optimizer, node->switch_stmt.expr);
+            for (size_t i = 0; i < node->switch_stmt.cases_count; i++)
+            {
+                struct node_case *c = &node->switch_stmt.cases[i];
+                for (size_t j = 0; j < c->labels_count; j++)
+                    c->labels[j] = optimize_node(optimizer, c->labels[j]);
+                c->body = optimize_node(optimizer, c->body);
+            }
+            return node;
+
+        case NODE_LABEL:
+            node->label.statement = optimize_node(optimizer, node->label.statement);
+            return node;
+
+        case NODE_TRY:
+            node->try_stmt.try_block = optimize_node(optimizer, node->try_stmt.try_block);
+            node->try_stmt.catch_block = optimize_node(optimizer, node->try_stmt.catch_block);
+            node->try_stmt.finally_block = optimize_node(optimizer, node->try_stmt.finally_block);
+            return node;
+
+        default:
+            UNREACHABLE;
+    }
+}
+
+void optimize_program(optimizer_t *optimizer, node_t *program)
+{
+    if (optimize_rebinds(program, optimizer->math))
+        optimizer->math = NULL;
+
+    optimize_node(optimizer, program);
+}
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -8,16 +9,30 @@
 #include "utils.h"
 #include "parser.h"
 
+#define PARSER_SCRATCH_INITIAL_CAPACITY 1024
+
+/* deeper expressions are rejected instead of overflowing the stack */
+#define PARSER_MAX_DEPTH 4096
+
 void parser_init(parser_t *parser, lexer_t *lexer)
 {
     parser->lexer = lexer;
     parser->current = lexer_next(lexer);
     parser->previous = NULL;
+    parser->depth = 0;
+    parser->lazy = false;
+    parser->lazy_functions = 0;
+
+    arena_init(&parser->arena);
+    parser->scratch = NULL;
+    parser->scratch_length = 0;
+    parser->scratch_capacity = 0;
 }
 
 void parser_free(parser_t *parser)
 {
-    (void) parser;
+    arena_free(&parser->arena);
+    free(parser->scratch);
     free(parser);
 }
 
@@ -29,7 +44,7 @@ static void parser_advance(parser_t *parser)
 
 static token_t *parser_peek(parser_t *parser)
 {
-    return &parser->lexer->tokens[parser->lexer->index];
+    return lexer_lookahead(parser->lexer);
 }
 
 static bool parser_check(parser_t *parser, token_type_t type)
@@ -47,6 +62,79 @@ static bool parser_match(parser_t *parser, token_type_t type)
     return false;
 }
 
+/*
+ * Counts a level of expression recursion, paired with `parser->depth--` on
+ * success. Errors abandon the parse, so they skip the decrement.
+ */
+static bool parser_enter(parser_t *parser)
+{
+    if (++parser->depth <= PARSER_MAX_DEPTH) return true;
+
+    PARSER_ERROR(parser,
+        "[ERROR] [%s:%zu:%zu] Expression is nested too deeply\n",
+        LOCATION(parser->current->loc)
+    );
+    return false;
+}
+
+/*
+ * Child lists (statements, arguments, ...) nest, so they are collected on
+ * one scratch stack and copied into the arena in one piece once complete.
+ * A parse error abandons the whole parse, error paths do not pop lists.
+ */
+static size_t parser_list_begin(parser_t *parser)
+{
+    return parser->scratch_length;
+}
+
+static void parser_list_push(parser_t *parser, const void *item, size_t size)
+{
+    if (parser->scratch_length + size > parser->scratch_capacity)
+    {
+        size_t capacity = parser->scratch_capacity ? parser->scratch_capacity : PARSER_SCRATCH_INITIAL_CAPACITY;
+        while (parser->scratch_length + size > capacity)
+            capacity *= 2;
+
+        parser->scratch = realloc(parser->scratch, capacity);
+        if (!parser->scratch)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        parser->scratch_capacity = capacity;
+    }
+
+    memcpy(parser->scratch + parser->scratch_length, item, size);
+    parser->scratch_length += size;
+}
+
+/* items pushed since `mark`, valid until the next push */
+static void *parser_list_items(parser_t *parser, size_t mark, size_t size, size_t *count)
+{
+    *count = (parser->scratch_length - mark) / size;
+    return parser->scratch + mark;
+}
+
+static void parser_list_pop(parser_t *parser, size_t mark)
+{
+    parser->scratch_length = mark;
+}
+
+/* copy the list started at `mark` into the arena and pop it, NULL if empty */
+static void *parser_list_end(parser_t *parser, size_t mark, size_t size, size_t *count)
+{
+    void *items = parser_list_items(parser, mark, size, count);
+    void *copy = *count ? arena_memdup(&parser->arena, items, *count * size) : NULL;
+
+    parser_list_pop(parser, mark);
+    return copy;
+}
+
+static node_t *parser_node(parser_t *parser, node_type_t type, location_t loc)
+{
+    return node_new(&parser->arena, type, loc);
+}
+
 /* declaration of all functions during parsing */
 static node_t *parse_statement(parser_t *parser);
 static node_t *parse_block(parser_t *parser);
@@ -57,6 +145,7 @@ static node_t *parse_while(parser_t *parser);
 static node_t *parse_do_while(parser_t *parser);
 static node_t *parse_for(parser_t *parser);
 static node_t *parse_function(parser_t *parser);
+static bool parse_function_lazy(parser_t *parser, node_t *node);
 static node_t *parse_declaration(parser_t *parser);
 static node_t *parse_import(parser_t *parser);
 static node_t *parse_export(parser_t *parser);
@@ -70,17 +159,7 @@ static node_t *parse_comma(parser_t *parser);
 static node_t *parse_expression(parser_t *parser);
 static node_t *parse_assignment(parser_t *parser);      // =, +=, -=, ...
 static node_t *parse_ternary(parser_t *parser);         // ?:
-static node_t *parse_logical_or(parser_t *parser);      // ||
-static node_t *parse_logical_and(parser_t *parser);     // &&
-static node_t *parse_bitwise_or(parser_t *parser);      // |
-static node_t *parse_bitwise_xor(parser_t *parser);     // ^
-static node_t *parse_bitwise_and(parser_t *parser);     // &
-static node_t *parse_equality(parser_t *parser);        // ==, !=
-static node_t *parse_relational(parser_t *parser);      // >, >=, <, <=
-static node_t *parse_shift(parser_t *parser);           // <<, >>
-static node_t *parse_term(parser_t *parser);            // +, -
-static node_t *parse_factor(parser_t *parser);          // *, /
-static node_t *parse_exponent(parser_t *parser);        // **
+static node_t *parse_binary(parser_t *parser, uint8_t min_power); // ||, &&, ..., *, **
 static node_t *parse_unary(parser_t *parser);           // await, typeof, +, -, !, ~, ++, --
 static node_t *parse_postfix(parser_t *parser);         // ++, --, member, index
 static node_t *parse_primary(parser_t *parser);
@@ -97,37 +176,20 @@ static node_t *parse_object(parser_t *parser);
 
 node_t *parse_program(parser_t *parser)
 {
-    node_t *program = calloc(1, sizeof(node_t));
-    if (!program) ERROR("Malloc failed!\n");
-
-    program->type = NODE_PROGRAM;
-    program->program.count = 0;
-
-    size_t capacity = 4;
-    program->program.statements = malloc(sizeof(node_t*) * capacity);
+    node_t *program = parser_node(parser, NODE_PROGRAM, parser->current->loc);
 
+    size_t mark = parser_list_begin(parser);
     while (parser->current->type != TOKEN_EOF)
     {
         node_t *stmt = parse_statement(parser);
-        if (!stmt) {
-            for (size_t i = 0; i < program->program.count; i++) {
-                node_free(program->program.statements[i]);
-            }
-            free(program->program.statements);
-            free(program);
-            return NULL;
-        }
+        if (!stmt) return NULL;
 
-        if (program->program.count >= capacity)
-        {
-            capacity *= 2;
-            program->program.statements =
-                realloc(program->program.statements, sizeof(node_t*) * capacity);
-        }
-
-        program->program.statements[program->program.count++] = stmt;
+        parser_list_push(parser, &stmt, sizeof(stmt));
     }
 
+    program->program.statements =
+        parser_list_end(parser, mark, sizeof(node_t *), &program->program.count);
+
     return program;
 }
 
@@ -135,15 +197,8 @@ static node_t *parse_statement(parser_t *parser)
 {
     if (parser_match(parser, TOKEN_SEMICOLON))
     {
-        /* empty statement */
-        node_t *empty = calloc(1, sizeof(node_t));
-        if (!empty) ERROR("Calloc failed!\n");
-
-        empty->type = NODE_EMPTY;
-
-        /* location of semicolon */
-        empty->loc = parser->previous->loc;
-        return empty;
+        /* empty statement, location of semicolon */
+        return parser_node(parser, NODE_EMPTY, parser->previous->loc);
     }
     
     /* label check */
@@ -188,12 +243,10 @@ static node_t *parse_statement(parser_t *parser)
     if (!parser_match(parser, TOKEN_SEMICOLON))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ';' after expression, got '%s' \n",
+            "[ERROR] [%s:%zu:%zu] Expected ';' after expression, got '%.*s' \n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        /* free expr to avoid leak */
-        node_free(expr);
         return NULL;  // bubble up error
     }
 
@@ -202,19 +255,8 @@ static node_t *parse_statement(parser_t *parser)
 
 static node_t *parse_block(parser_t *parser)
 {
-    node_t *block = calloc(1, sizeof(node_t));
-    if (!block) ERROR("Calloc failed!\n");
-
-    block->type = NODE_BLOCK;
-    block->block.count = 0;
-    
-    size_t capacity = 4;
-    block->block.statements = malloc(sizeof(node_t*) * capacity);
-    if (!block->block.statements)
-    {
-        free(block);
-        ERROR("Malloc failed!\n");
-    }
+    node_t *block = parser_node(parser, NODE_BLOCK, parser->current->loc);
+    size_t mark = parser_list_begin(parser);
 
     /* block starting with '{' */
     if (parser_match(parser, TOKEN_LEFT_BRACE))
@@ -223,40 +265,18 @@ static node_t *parse_block(parser_t *parser)
                parser->current->type != TOKEN_EOF)
         {
             node_t *stmt = parse_statement(parser);
-            if (!stmt) {
-                // free any already parsed statements
-                for (size_t i = 0; i < block->block.count; ++i)
-                    node_free(block->block.statements[i]);
-                free(block->block.statements);
-                free(block);
-
-                return NULL;  // bubble error up
-            }
-
-            if (block->block.count >= capacity)
-            {
-                capacity *= 2;
-				block->block.statements =
-                    realloc(block->block.statements, sizeof(node_t*) * capacity);
-            }
+            if (!stmt) return NULL;  // bubble error up
 
-            block->block.statements[block->block.count++] = stmt;
+            parser_list_push(parser, &stmt, sizeof(stmt));
         }
         
         if (!parser_match(parser, TOKEN_RIGHT_BRACE))
         {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected '}' to end block, got '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected '}' to end block, got '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-
-            /* free the block and its statements */
-            for (size_t i = 0; i < block->block.count; ++i)
-                node_free(block->block.statements[i]);
-            free(block->block.statements);
-            free(block);
-
             return NULL;
         }
     }
@@ -264,18 +284,14 @@ static node_t *parse_block(parser_t *parser)
     else
     {
         node_t *stmt = parse_statement(parser);
-        if (stmt == NULL)
-        {
-            /* free the block and its statements */
-            free(block->block.statements);
-            free(block);
+        if (stmt == NULL) return NULL;
 
-            return NULL;
-        }
-
-        block->block.statements[block->block.count++] = stmt;
+        parser_list_push(parser, &stmt, sizeof(stmt));
     }
 
+    block->block.statements =
+        parser_list_end(parser, mark, sizeof(node_t *), &block->block.count);
+
     /* TODO: potetional optimazation: flatten single-statement nested blocks */
     return block;
 }
@@ -289,25 +305,14 @@ static node_t *parse_label(parser_t *parser)
         UNREACHABLE;
     }
 
-    char *label_name = (char*)parser->current->value;
+    node_t *label_node = parser_node(parser, NODE_LABEL, parser->current->loc);
+    label_node->label.name = parser->current->atom;
 
     parser_advance(parser); /* consume identifier */
     parser_advance(parser); /* consume colon */
 
-    node_t *label_node = calloc(1, sizeof(node_t));
-    if (!label_node) ERROR("Calloc failed!\n");
-
-    label_node->type = NODE_LABEL;
-    label_node->label.name = strdup(label_name);
-    if (!label_node->label.name) ERROR("strdup failed!\n");
-
     label_node->label.statement = parse_statement(parser);
-    if (!label_node->label.statement) {
-        /* free resources and bubble up error */
-        free(label_node->label.name);
-        free(label_node);
-        return NULL;
-    }
+    if (!label_node->label.statement) return NULL;
 
     return label_node;
 }
@@ -317,19 +322,21 @@ static node_t *parse_if(parser_t *parser)
     if (!parser_match(parser, TOKEN_IF))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'if', got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'if', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
+    location_t loc = parser->previous->loc;
+
     if (!parser_match(parser, TOKEN_LEFT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '(' after 'if', got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected '(' after 'if', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
@@ -340,19 +347,15 @@ static node_t *parse_if(parser_t *parser)
     if (!parser_match(parser, TOKEN_RIGHT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ')' after 'if' condition, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ')' after 'if' condition, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(condition);
         return NULL;
     }
 
     node_t *then_branch = parse_block(parser);
-    if (!then_branch) {
-        node_free(condition);
-        return NULL;
-    }
+    if (!then_branch) return NULL;
 
     node_t *else_branch = NULL;
     if (parser_match(parser, TOKEN_ELSE))
@@ -366,17 +369,10 @@ static node_t *parse_if(parser_t *parser)
             else_branch = parse_block(parser);
         }
 
-        if (!else_branch) {
-            node_free(condition);
-            node_free(then_branch);
-            return NULL;
-        }
+        if (!else_branch) return NULL;
     }
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_IF;
+    node_t *node = parser_node(parser, NODE_IF, loc);
     node->if_stmt.condition = condition;
 	node->if_stmt.then_branch = then_branch;
 	node->if_stmt.else_branch = else_branch;
@@ -388,145 +384,99 @@ static node_t *parse_switch(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_SWITCH)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'switch', got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'switch', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_SWITCH;
-    node->switch_stmt.expr = NULL;
-    node->switch_stmt.cases = NULL;
-    node->switch_stmt.cases_count = 0;
+    node_t *node = parser_node(parser, NODE_SWITCH, parser->previous->loc);
 
     if (!parser_match(parser, TOKEN_LEFT_PAREN)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '(' after 'switch', got '%s'\n",
-            LOCATION(parser->lexer->loc),
-            parser->current->value
+            "[ERROR] [%s:%zu:%zu] Expected '(' after 'switch', got '%.*s'\n",
+            LOCATION(parser->current->loc),
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
     node->switch_stmt.expr = parse_expression(parser);
-    if (!node->switch_stmt.expr) {
-        node_free(node);
-        return NULL;
-    }
+    if (!node->switch_stmt.expr) return NULL;
 
     if (!parser_match(parser, TOKEN_RIGHT_PAREN)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ')' after switch expression got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ')' after switch expression got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
     // Expect '{'
     if (!parser_match(parser, TOKEN_LEFT_BRACE)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '{' after switch expression, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected '{' after switch expression, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
     // Parse cases
+    size_t cases_mark = parser_list_begin(parser);
     while (parser->current->type != TOKEN_RIGHT_BRACE && parser->current->type != TOKEN_EOF) {
-        size_t case_index = node->switch_stmt.cases_count++;
-
-        node->switch_stmt.cases = realloc(
-            node->switch_stmt.cases,
-            sizeof(*node->switch_stmt.cases) * node->switch_stmt.cases_count
-        );
-        if (!node->switch_stmt.cases) ERROR("Realloc failed!\n");
-
-        node->switch_stmt.cases[case_index].labels = NULL;
-        node->switch_stmt.cases[case_index].labels_count = 0;
-        node->switch_stmt.cases[case_index].body = NULL;
-        node->switch_stmt.cases[case_index].is_default = false;
+        struct node_case switch_case = {0};
 
         // --- CASE ---
         if (parser_match(parser, TOKEN_CASE)) {
-            size_t labels_capacity = 2;
-            node->switch_stmt.cases[case_index].labels =
-                malloc(sizeof(node_t *) * labels_capacity);
-            if (!node->switch_stmt.cases[case_index].labels) ERROR("Malloc failed!\n");
+            size_t labels_mark = parser_list_begin(parser);
 
             do {
-                if (node->switch_stmt.cases[case_index].labels_count >= labels_capacity) {
-                    labels_capacity *= 2;
-                    node->switch_stmt.cases[case_index].labels = realloc(
-                        node->switch_stmt.cases[case_index].labels,
-                        sizeof(node_t *) * labels_capacity
-                    );
-                    if (!node->switch_stmt.cases[case_index].labels) ERROR("Realloc failed!\n");
-                }
-
                 node_t *label_expr = parse_comma(parser);
-                if (!label_expr) {
-                    node_free(node);
-                    return NULL;
-                }
+                if (!label_expr) return NULL;
 
-                node->switch_stmt.cases[case_index]
-                    .labels[node->switch_stmt.cases[case_index].labels_count++] = label_expr;
+                parser_list_push(parser, &label_expr, sizeof(label_expr));
 
                 if (!parser_match(parser, TOKEN_COLON)) {
                     PARSER_ERROR(parser,
-                        "[ERROR] [%s:%zu:%zu] Expected ':' after case expression, got '%s'\n",
+                        "[ERROR] [%s:%zu:%zu] Expected ':' after case expression, got '%.*s'\n",
                         LOCATION(parser->current->loc),
-                        parser->current->value
+                        TOKEN_TEXT(parser, parser->current)
                     );
-                    node_free(node);
                     return NULL;
                 }
             } while (parser_match(parser, TOKEN_CASE));
+
+            switch_case.labels =
+                parser_list_end(parser, labels_mark, sizeof(node_t *), &switch_case.labels_count);
         }
         // --- DEFAULT ---
         else if (parser_match(parser, TOKEN_DEFAULT)) {
-            // node->switch_stmt.cases[case_index].labels = NULL;
-            // node->switch_stmt.cases[case_index].labels_count = 0;
-            node->switch_stmt.cases[case_index].is_default = true;
+            switch_case.is_default = true;
 
             if (!parser_match(parser, TOKEN_COLON)) {
                 PARSER_ERROR(parser,
-                    "[ERROR] [%s:%zu:%zu] Expected ':' after 'default' got '%s'\n",
+                    "[ERROR] [%s:%zu:%zu] Expected ':' after 'default' got '%.*s'\n",
                     LOCATION(parser->current->loc),
-                    parser->current->value
+                    TOKEN_TEXT(parser, parser->current)
                 );
-                node_free(node);
                 return NULL;
             }
         }
         else {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected 'case' or 'default' got '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected 'case' or 'default' got '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(node);
             return NULL;
         }
 
         // Case body (block node)
-        node_t *body_block = calloc(1, sizeof(node_t));
-        if (!body_block) ERROR("Malloc failed!\n");
-
-        body_block->type = NODE_BLOCK;
-        body_block->block.count = 0;
-        body_block->block.statements = NULL;
-
-        node->switch_stmt.cases[case_index].body = body_block;
+        node_t *body_block = parser_node(parser, NODE_BLOCK, parser->current->loc);
+        size_t body_mark = parser_list_begin(parser);
 
         // Parse until next case/default/}
         while (parser->current->type != TOKEN_CASE &&
@@ -534,32 +484,28 @@ static node_t *parse_switch(parser_t *parser)
                parser->current->type != TOKEN_RIGHT_BRACE &&
                parser->current->type != TOKEN_EOF)
         {
-
             node_t *stmt = parse_statement(parser);
-            if (!stmt) {
-                node_free(node);
-                return NULL;
-            }
+            if (!stmt) return NULL;
 
-            size_t old_count = body_block->block.count;
-            body_block->block.statements = realloc(
-                body_block->block.statements,
-                sizeof(node_t *) * (old_count + 1)
-            );
-            if (!body_block->block.statements) ERROR("Realloc failed!\n");
-
-            body_block->block.statements[old_count] = stmt;
-            body_block->block.count++;
+            parser_list_push(parser, &stmt, sizeof(stmt));
         }
+
+        body_block->block.statements =
+            parser_list_end(parser, body_mark, sizeof(node_t *), &body_block->block.count);
+        switch_case.body = body_block;
+
+        parser_list_push(parser, &switch_case, sizeof(switch_case));
     }
 
+    node->switch_stmt.cases =
+        parser_list_end(parser, cases_mark, sizeof(struct node_case), &node->switch_stmt.cases_count);
+
     if (!parser_match(parser, TOKEN_RIGHT_BRACE)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '}' to close switch, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected '}' to close switch, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
@@ -571,19 +517,21 @@ static node_t *parse_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_WHILE))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'while' got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'while' got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
+    location_t loc = parser->previous->loc;
+
     if (!parser_match(parser, TOKEN_LEFT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '(' after 'while' got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected '(' after 'while' got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
@@ -594,24 +542,17 @@ static node_t *parse_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_RIGHT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ')' after condition got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ')' after condition got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(condition);
         return NULL;
     }
 
     node_t *body = parse_block(parser);
-    if (!body) {
-        node_free(condition);
-        return NULL;
-    }
-
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
+    if (!body) return NULL;
 
-    node->type = NODE_WHILE;
+    node_t *node = parser_node(parser, NODE_WHILE, loc);
     node->while_stmt.condition = condition;
 	node->while_stmt.body = body;
 
@@ -623,13 +564,15 @@ static node_t *parse_do_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_DO))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'do' got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'do' got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
+    location_t loc = parser->previous->loc;
+
     // parse body first
     node_t *body = parse_block(parser);
     if (!body) return NULL; // bubble up block parse error
@@ -638,11 +581,10 @@ static node_t *parse_do_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_WHILE))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'while' after 'do' block got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'while' after 'do' block got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(body);
         return NULL;
     }
 
@@ -650,29 +592,23 @@ static node_t *parse_do_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_LEFT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected '(' after 'while' got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected '(' after 'while' got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(body);
         return NULL;
     }
 
     node_t *condition = parse_comma(parser);
-    if (!condition) {
-        node_free(body);
-        return NULL;  // bubble up parse error
-    }
+    if (!condition) return NULL;  // bubble up parse error
 
     if (!parser_match(parser, TOKEN_RIGHT_PAREN))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ')' after condition got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ')' after condition got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(body);
-        node_free(condition);
         return NULL;
     }
 
@@ -680,21 +616,16 @@ static node_t *parse_do_while(parser_t *parser)
     if (!parser_match(parser, TOKEN_SEMICOLON))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ';' after 'do-while' got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ';' after 'do-while' got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(body);
-        node_free(condition);
         return NULL;
     }
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_DO_WHILE;
-    node->while_stmt.body = body;
-    node->while_stmt.condition = condition;
+    node_t *node = parser_node(parser, NODE_DO_WHILE, loc);
+    node->do_while_stmt.body = body;
+    node->do_while_stmt.condition = condition;
 
     return node;
 }
@@ -707,22 +638,14 @@ static node_t *parse_for(parser_t *parser)
         return NULL;
     }
 
-    // location_t node_location = parser->previous.location;
+    location_t loc = parser->previous->loc;
 
     if (!parser_match(parser, TOKEN_LEFT_PAREN)) {
         PARSER_ERROR(parser, "[ERROR] Expected '(' after 'for'\n");
         return NULL;
     }
 
-    node_t *for_node = malloc(sizeof(node_t));
-    if (!for_node) ERROR("Malloc failed!\n");
-
-    for_node->type = NODE_FOR;
-    // for_node->location = node_location;
-    for_node->for_stmt.body = NULL;
-    for_node->for_stmt.init = NULL;
-    for_node->for_stmt.condition = NULL;
-    for_node->for_stmt.increment = NULL;
+    node_t *for_node = parser_node(parser, NODE_FOR, loc);
 
     // parse initializer
     if (parser->current->type == TOKEN_LET ||
@@ -731,21 +654,17 @@ static node_t *parse_for(parser_t *parser)
     {
         for_node->for_stmt.init = parse_declaration(parser);
         // semicolon already consumed by `parse_var_declaration` for variable declarations
-        if (!for_node->for_stmt.init) {
-            free(for_node);
-            return NULL;  // bubble up parse error
-        }
+        if (!for_node->for_stmt.init) return NULL;  // bubble up parse error
     }
     else if (parser->current->type != TOKEN_SEMICOLON)
     {
         for_node->for_stmt.init = parse_comma(parser);
         if (!parser_match(parser, TOKEN_SEMICOLON)) {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected ';' after for-loop initializer, got '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected ';' after for-loop initializer, got '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(for_node);
             return NULL;
         }
     }
@@ -758,74 +677,43 @@ static node_t *parse_for(parser_t *parser)
     // parse condition
     if (parser->current->type != TOKEN_SEMICOLON) {
         for_node->for_stmt.condition = parse_comma(parser);
-        if (!for_node->for_stmt.condition) {
-            node_free(for_node->for_stmt.init);
-            free(for_node);
-            return NULL;
-        }
+        if (!for_node->for_stmt.condition) return NULL;
     }
 
     if (!parser_match(parser, TOKEN_SEMICOLON)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ';' after for-loop condition, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ';' after for-loop condition, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(for_node->for_stmt.init);
-        node_free(for_node->for_stmt.condition);
-        free(for_node);
         return NULL;
     }
 
     // --- Parse increment ---
     if (parser->current->type != TOKEN_RIGHT_PAREN) {
         for_node->for_stmt.increment = parse_comma(parser);
-        if (!for_node->for_stmt.increment) {
-            node_free(for_node->for_stmt.init);
-            node_free(for_node->for_stmt.condition);
-            free(for_node);
-            return NULL;
-        }
+        if (!for_node->for_stmt.increment) return NULL;
     }
 
     if (!parser_match(parser, TOKEN_RIGHT_PAREN)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected ')' after for-loop, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected ')' after for-loop, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(for_node->for_stmt.init);
-        node_free(for_node->for_stmt.condition);
-        node_free(for_node->for_stmt.increment);
-        free(for_node);
         return NULL;
     }
 
     // parse body
     for_node->for_stmt.body = parse_block(parser);
-    if (!for_node->for_stmt.body) {
-        node_free(for_node->for_stmt.init);
-        node_free(for_node->for_stmt.condition);
-        node_free(for_node->for_stmt.increment);
-        free(for_node);
-        return NULL; // bubble up parse error
-    }
+    if (!for_node->for_stmt.body) return NULL; // bubble up parse error
 
     return for_node;
 }
 
 static node_t *parse_function(parser_t *parser)
 {
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_FUNCTION;
-    node->function.is_async = false;
-    // node->location = parser->current.location;
-    node->function.param_count = 0;
-    node->function.params = NULL;
-    node->function.name = NULL;
-    node->function.body = NULL;
+    node_t *node = parser_node(parser, NODE_FUNCTION, parser->current->loc);
 
     /* Check for 'async' keyword */
     if (parser->current->type == TOKEN_ASYNC)
@@ -836,11 +724,10 @@ static node_t *parse_function(parser_t *parser)
 
     /* Expect 'function' keyword */ 
     if (!parser_match(parser, TOKEN_FUNCTION)) {
-        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'function', got '%s'\n",
+        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'function', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
@@ -851,92 +738,192 @@ static node_t *parse_function(parser_t *parser)
 
     /* function name (optional for anonymous functions) */
     if (parser->current->type == TOKEN_IDENTIFIER) {
-        node->function.name = strdup(parser->current->value);
+        node->function.name = parser->current->atom;
         parser_advance(parser);
     }
 
     // Expect '('
     if (!parser_match(parser, TOKEN_LEFT_PAREN)) {
-        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected '(' after function name, got '%s'\n",
+        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected '(' after function name, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
     /* parse parameters */
+    size_t mark = parser_list_begin(parser);
     if (parser->current->type != TOKEN_RIGHT_PAREN) {
         do {
-            bool is_rest = false;
+            struct node_param param = {0};
 
             if (parser_match(parser, TOKEN_ELLIPSIS)) {
-                is_rest = true;
+                param.is_rest = true;
             }
 
             if (parser->current->type != TOKEN_IDENTIFIER) {
                 PARSER_ERROR(parser,
-                    "[ERROR] [%s:%zu:%zu] Expected parameter name, got '%s'\n",
+                    "[ERROR] [%s:%zu:%zu] Expected parameter name, got '%.*s'\n",
                     LOCATION(parser->current->loc),
-                    parser->current->value
+                    TOKEN_TEXT(parser, parser->current)
                 );
-                node_free(node);
                 return NULL;
             }
 
-            void *tmp = realloc(
-                node->function.params,
-                sizeof(*node->function.params) * (node->function.param_count + 1)
-            );
-            if (!tmp) ERROR("Malloc failed!\n");
-            node->function.params = tmp;
-
-            node->function.params[node->function.param_count].name = strdup(parser->current->value);
-            node->function.params[node->function.param_count].default_value = NULL;
-            node->function.params[node->function.param_count].is_rest = is_rest;
+            param.name = parser->current->atom;
 
             /* consume identifier */
             parser_advance(parser);
             
             /* optional default value */
-            if (!is_rest && parser_match(parser, TOKEN_EQUAL)) {
-                node_t *default_expr = parse_expression(parser);
-                if (!default_expr) {
-                    node_free(node);
-                    return NULL;
-                }
-                node->function.params[node->function.param_count].default_value = default_expr;
-            } else if (is_rest && parser_match(parser, TOKEN_EQUAL)) {
+            if (!param.is_rest && parser_match(parser, TOKEN_EQUAL)) {
+                param.default_value = parse_expression(parser);
+                if (!param.default_value) return NULL;
+            } else if (param.is_rest && parser_match(parser, TOKEN_EQUAL)) {
                 PARSER_ERROR(parser,
                     "[ERROR] [%s:%zu:%zu] Rest parameter cannot have a default value.\n",
                     LOCATION(parser->current->loc)
                 );
-                node_free(node);
                 return NULL;
             }
 
-            node->function.param_count++;
+            parser_list_push(parser, &param, sizeof(param));
         } while (parser_match(parser, TOKEN_COMMA));
     }
 
+    node->function.params =
+        parser_list_end(parser, mark, sizeof(struct node_param), &node->function.param_count);
+
     if (!parser_match(parser, TOKEN_RIGHT_PAREN)) {
-        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected ')' after parameters name, got '%s'\n",
+        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected ')' after parameters name, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        node_free(node);
         return NULL;
     }
 
-    node->function.body = parse_block(parser);
-    if (!node->function.body) {
-        node_free(node);
-        return NULL;
+    node->function.body_start = parser->current->loc.offset;
+
+    if (parser->lazy && parser->current->type == TOKEN_LEFT_BRACE)
+    {
+        if (!parse_function_lazy(parser, node)) return NULL;
+        return node;
     }
 
+    node->function.body = parse_block(parser);
+    if (!node->function.body) return NULL;
+
+    node->function.body_end = parser->previous->loc.offset + parser->previous->length;
     return node;
 }
 
+/*
+ * Pre-parses a function body by matching its brackets, nothing is allocated.
+ * Lexical errors and unbalanced brackets are still reported here, the rest
+ * waits for `parser_function_body`.
+ */
+static bool parse_function_lazy(parser_t *parser, node_t *node)
+{
+    /* open brackets, the body's '{' first */
+    size_t mark = parser_list_begin(parser);
+
+    do
+    {
+        token_type_t type = parser->current->type;
+        switch (type)
+        {
+            case TOKEN_LEFT_BRACE:
+            case TOKEN_LEFT_PAREN:
+            case TOKEN_LEFT_BRACKET:
+            {
+                uint8_t open = type;
+                parser_list_push(parser, &open, sizeof(open));
+                break;
+            }
+
+            case TOKEN_RIGHT_BRACE:
+            case TOKEN_RIGHT_PAREN:
+            case TOKEN_RIGHT_BRACKET:
+            {
+                size_t count;
+                uint8_t *open = parser_list_items(parser, mark, sizeof(uint8_t), &count);
+                token_type_t expected =
+                    open[count - 1] == TOKEN_LEFT_BRACE ? TOKEN_RIGHT_BRACE :
+                    open[count - 1] == TOKEN_LEFT_PAREN ? TOKEN_RIGHT_PAREN : TOKEN_RIGHT_BRACKET;
+
+                if (type != expected)
+                {
+                    PARSER_ERROR(parser,
+                        "[ERROR] [%s:%zu:%zu] Expected '%s', got '%.*s'\n",
+                        LOCATION(parser->current->loc),
+                        token_type_to_lexeme(expected),
+                        TOKEN_TEXT(parser, parser->current)
+                    );
+                    return false;
+                }
+
+                parser_list_pop(parser, mark + count - 1);
+                break;
+            }
+
+            case TOKEN_EOF:
+                PARSER_ERROR(parser,
+                    "[ERROR] [%s:%zu:%zu] Expected '}' to end block, got '%.*s'\n",
+                    LOCATION(parser->current->loc),
+                    TOKEN_TEXT(parser, parser->current)
+                );
+                return false;
+
+            default:
+                break;
+        }
+
+        parser_advance(parser);
+    } while (parser->scratch_length > mark);
+
+    node->function.body_end = parser->previous->loc.offset + parser->previous->length;
+    parser->lazy_functions++;
+    return true;
+}
+
+node_t *parser_function_body(parser_t *parser, node_t *function)
+{
+    assert(function->type == NODE_FUNCTION);
+    if (function->function.body) return function->function.body;
+
+    lexer_t *lexer = malloc(sizeof(lexer_t));
+    if (!lexer)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    lexer_init_range(lexer, function->loc.file, function->function.body_start, function->function.body_end);
+
+    /* the body gets its own lexer, the arena and scratch stack are shared */
+    lexer_t *outer_lexer = parser->lexer;
+    token_t *outer_current = parser->current;
+    token_t *outer_previous = parser->previous;
+    size_t outer_depth = parser->depth;
+    size_t outer_scratch = parser->scratch_length;
+
+    parser->lexer = lexer;
+    parser->current = lexer_next(lexer);
+    parser->previous = NULL;
+
+    node_t *body = parse_block(parser);
+    if (lexer->had_error) body = NULL;
+
+    parser->lexer = outer_lexer;
+    parser->current = outer_current;
+    parser->previous = outer_previous;
+    parser->depth = outer_depth;
+    parser->scratch_length = outer_scratch;
+    lexer_free(lexer);
+
+    function->function.body = body;
+    return body;
+}
+
 static node_t *parse_declaration(parser_t *parser)
 {
     token_t kind = *parser->current;
@@ -946,119 +933,92 @@ static node_t *parse_declaration(parser_t *parser)
         !parser_match(parser, TOKEN_VAR))
     {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'let', 'const' or 'var', got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'let', 'const' or 'var', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
-    // location_t location = kind.location;
-    node_t *node = malloc(sizeof(node_t));
-    if (!node) ERROR("Malloc failed!");
-
-    node->type = NODE_DECLARATION;
-    node->declaration.kind = kind;
-    node->declaration.count = 0;
+    node_t *node = parser_node(parser, NODE_DECLARATION, kind.loc);
+    node->declaration.kind = kind.type;
 
-    size_t capacity = 2;
-    node->declaration.names =
-        malloc(sizeof(node_t *) * capacity);
-    node->declaration.values =
-        malloc(sizeof(node_t *) * capacity);
-
-    if (!node->declaration.names || !node->declaration.values) {
-        free(node->declaration.names);
-        free(node->declaration.values);
-        free(node);
-        ERROR("Malloc failed!\n");
-    }
+    /* names and their optional initializers, pushed in pairs */
+    struct declarator { node_t *name; node_t *value; };
+    size_t mark = parser_list_begin(parser);
     
     while (true)
     {
-        node_t *name = parse_identifier(parser);
-        if (!name) {
+        struct declarator declarator = {0};
+
+        declarator.name = parse_identifier(parser);
+        if (!declarator.name) {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected identifier after '%s', got: '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected identifier after '%s', got: '%.*s'\n",
                 LOCATION(parser->current->loc),
-                kind.value,
-                parser->current->value
+                token_type_to_lexeme(kind.type),
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(node); // free previously allocated names and values
             return NULL;
         }
 
-        if (node->declaration.count >= capacity) {
-            capacity *= 2;
-            void *tmp_names = realloc(node->declaration.names, sizeof(node_t *) * capacity);
-            void *tmp_values = realloc(node->declaration.values, sizeof(node_t *) * capacity);
-            if (!tmp_names || !tmp_values) {
-                free(tmp_names);
-                free(tmp_values);
-                node_free(node);
-                ERROR("Realloc failed!\n");
-            }
-            node->declaration.names = tmp_names;
-            node->declaration.values = tmp_values;
-        }
-
-        node->declaration.names[node->declaration.count] = name;
-
         /* optional assignment */
         if (parser_match(parser, TOKEN_EQUAL)) {
-            node_t *value_expr = parse_expression(parser);
-            if (!value_expr) {
-                node_free(node);
-                return NULL;
-            }
-            node->declaration.values[node->declaration.count] = value_expr;
-        } else {
-            node->declaration.values[node->declaration.count] = NULL;
+            declarator.value = parse_expression(parser);
+            if (!declarator.value) return NULL;
         }
 
-        node->declaration.count++;
+        parser_list_push(parser, &declarator, sizeof(declarator));
 
         if (!parser_match(parser, TOKEN_COMMA)) {
             if (!parser_match(parser, TOKEN_SEMICOLON))
             {
-                PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Unexpected token after variable declaration: '%s', expected ';' or ','\n",
+                PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Unexpected token after variable declaration: '%.*s', expected ';' or ','\n",
                     LOCATION(parser->current->loc),
-                    parser->current->value
+                    TOKEN_TEXT(parser, parser->current)
                 );
-                node_free(node);
                 return NULL;
             }
             break;
         }
     }
-    // node->location = location;
+
+    size_t count;
+    struct declarator *declarators = parser_list_items(parser, mark, sizeof(struct declarator), &count);
+
+    node->declaration.count = count;
+    node->declaration.names = arena_alloc(&parser->arena, sizeof(node_t *) * count);
+    node->declaration.values = arena_alloc(&parser->arena, sizeof(node_t *) * count);
+    for (size_t i = 0; i < count; i++) {
+        node->declaration.names[i] = declarators[i].name;
+        node->declaration.values[i] = declarators[i].value;
+    }
+    parser_list_pop(parser, mark);
+
     return node;
 }
 
+static char *parse_token_string(parser_t *parser, const token_t *token)
+{
+    return arena_strndup(&parser->arena, lexer_token_text(parser->lexer, token), token->length);
+}
+
 static node_t *parse_import(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_IMPORT)) {
-        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'import', got '%s'\n",
+        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'import', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-    node->type = NODE_IMPORT;
-
-    node->import_stmt.default_name = NULL;
-    node->import_stmt.named_count = 0;
-    node->import_stmt.imported = NULL;
-    node->import_stmt.module = NULL;
+    node_t *node = parser_node(parser, NODE_IMPORT, parser->previous->loc);
 
     // side-effect only import: import "module"
     if (parser->current->type == TOKEN_STRING_LITERAL)
     {
-        node->import_stmt.module = strdup(parser->current->value);
-        if (!node->import_stmt.module) ERROR("Strdup failed!\n");
+        node->import_stmt.module = parse_token_string(parser, parser->current);
 
         parser_advance(parser); // consume the string literal
         parser_match(parser, TOKEN_SEMICOLON); // optional semicolon
@@ -1068,8 +1028,7 @@ static node_t *parse_import(parser_t *parser)
     /* default import or nothing */
     if (parser->current->type == TOKEN_IDENTIFIER)
     {
-        node->import_stmt.default_name = strdup(parser->current->value);
-        if (!node->import_stmt.default_name) ERROR("Strdup failed!\n");
+        node->import_stmt.default_name = parse_token_string(parser, parser->current);
 
         parser_advance(parser); /* consume identifier */
 
@@ -1079,8 +1038,6 @@ static node_t *parse_import(parser_t *parser)
                 PARSER_ERROR(parser,
                     "[ERROR] Expected '{' after ',' in import statement\n"
                 );
-                free(node->import_stmt.default_name);
-                free(node);
                 return NULL;
             }
         }
@@ -1088,104 +1045,55 @@ static node_t *parse_import(parser_t *parser)
 
     /* named imports */
     if (parser_match(parser, TOKEN_LEFT_BRACE)) {
-        size_t cap = 4, count = 0;
-        node->import_stmt.imported = malloc(sizeof(char*) * cap);
-        if (!node->import_stmt.imported) {
-            free(node->import_stmt.default_name);
-            free(node);
-            ERROR("Malloc failed!\n");
-        }
+        size_t mark = parser_list_begin(parser);
 
         while (parser->current->type != TOKEN_RIGHT_BRACE &&
                parser->current->type != TOKEN_EOF)
         {
             if (parser->current->type != TOKEN_IDENTIFIER) {
                 PARSER_ERROR(parser,
-                    "[ERROR] Expected identifier in named imports, got: '%s'\n",
-                    parser->current->value
+                    "[ERROR] Expected identifier in named imports, got: '%.*s'\n",
+                    TOKEN_TEXT(parser, parser->current)
                 );
-                for (size_t i = 0; i < count; ++i) free(node->import_stmt.imported[i]);
-                free(node->import_stmt.imported);
-                free(node->import_stmt.default_name);
-                free(node);
                 return NULL;
             }
 
-            char *name = strdup(parser->current->value);
-            if (!name) {
-                for (size_t i = 0; i < count; ++i) free(node->import_stmt.imported[i]);
-                free(node->import_stmt.imported);
-                free(node->import_stmt.default_name);
-                free(node);
-                ERROR("Strdup failed!\n");
-            }
-            node->import_stmt.imported[count++] = name;
+            char *name = parse_token_string(parser, parser->current);
+            parser_list_push(parser, &name, sizeof(name));
             parser_advance(parser);
 
             parser_match(parser, TOKEN_COMMA); // skip comma if present
-
-            if (count >= cap) {
-                cap *= 2;
-                void *tmp = realloc(node->import_stmt.imported, sizeof(char*) * cap);
-                if (!tmp) {
-                    for (size_t i = 0; i < count; ++i) free(node->import_stmt.imported[i]);
-                    free(node->import_stmt.imported);
-                    free(node->import_stmt.default_name);
-                    free(node);
-                    ERROR("Realloc failed!\n");
-                }
-                node->import_stmt.imported = tmp;
-            }
         }
         if (!parser_match(parser, TOKEN_RIGHT_BRACE)) {
             PARSER_ERROR(parser,
                 "[ERROR] Expected '}' after named imports\n"
             );
-            for (size_t i = 0; i < count; ++i) free(node->import_stmt.imported[i]);
-            free(node->import_stmt.imported);
-            free(node->import_stmt.default_name);
-            free(node);
             return NULL;
         }
 
-        node->import_stmt.named_count = count;
+        node->import_stmt.imported =
+            parser_list_end(parser, mark, sizeof(char *), &node->import_stmt.named_count);
     }
 
     /* 'from' keyword */
     if (!parser_match(parser, TOKEN_FROM)) {
         PARSER_ERROR(parser,
-            "[ERROR] [%s:%zu:%zu] Expected 'from' keyword in import statement, got '%s'\n",
+            "[ERROR] [%s:%zu:%zu] Expected 'from' keyword in import statement, got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
-        for (size_t i = 0; i < node->import_stmt.named_count; ++i) free(node->import_stmt.imported[i]);
-        free(node->import_stmt.imported);
-        free(node->import_stmt.default_name);
-        free(node);
         return NULL;
     }
 
     if (parser->current->type != TOKEN_STRING_LITERAL) {
         PARSER_ERROR(parser,
-            "[ERROR] Expected module after 'from', got '%s'\n",
-            parser->current->value
+            "[ERROR] Expected module after 'from', got '%.*s'\n",
+            TOKEN_TEXT(parser, parser->current)
         );
-        for (size_t i = 0; i < node->import_stmt.named_count; ++i) free(node->import_stmt.imported[i]);
-        free(node->import_stmt.imported);
-        free(node->import_stmt.default_name);
-        free(node);
         return NULL;
     }
 
-    // node->location = parser->current.location;
-    node->import_stmt.module = strdup(parser->current->value);
-    if (!node->import_stmt.module) {
-        for (size_t i = 0; i < node->import_stmt.named_count; ++i) free(node->import_stmt.imported[i]);
-        free(node->import_stmt.imported);
-        free(node->import_stmt.default_name);
-        free(node);
-        ERROR("Strdup failed!\n");
-    }
+    node->import_stmt.module = parse_token_string(parser, parser->current);
 
     parser_advance(parser); // consume the string literal
     parser_match(parser, TOKEN_SEMICOLON); // consume optional semicolon
@@ -1197,16 +1105,7 @@ static node_t *parse_export(parser_t *parser)
 {
     parser_advance(parser); // consume 'export'
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_EXPORT;
-    node->export_stmt.is_default = false;
-    node->export_stmt.declaration = NULL;
-    node->export_stmt.named_count = 0;
-    node->export_stmt.exported = NULL;
-
-    // node->location = parser->current.location;
+    node_t *node = parser_node(parser, NODE_EXPORT, parser->previous->loc);
 
     // export default
     if (parser_match(parser, TOKEN_DEFAULT))
@@ -1216,71 +1115,39 @@ static node_t *parse_export(parser_t *parser)
 
         if (!node->export_stmt.declaration) {
             PARSER_ERROR(parser, "[ERROR] Expected declaration after 'export default'\n");
-            free(node);
             return NULL;
         }
     }
     // named exports: export { a, b, c };
     else if (parser_match(parser, TOKEN_LEFT_BRACE))
     {
-        size_t capacity = 4;
-        node->export_stmt.exported = malloc(sizeof(char*) * capacity);
-        if (!node->export_stmt.exported) ERROR("Malloc failed!\n");
+        size_t mark = parser_list_begin(parser);
         
         while (parser->current->type != TOKEN_RIGHT_BRACE &&
                parser->current->type != TOKEN_EOF)
         {
             if (!parser_check(parser, TOKEN_IDENTIFIER)) {
                 PARSER_ERROR(parser, "[ERROR] Expected identifier in export list\n");
-                for (size_t i = 0; i < node->export_stmt.named_count; ++i)
-                    free(node->export_stmt.exported[i]);
-                free(node->export_stmt.exported);
-                free(node);
                 return NULL;
             }
 
-            char *name = strdup(parser->current->value);
-            if (!name) {
-                for (size_t i = 0; i < node->export_stmt.named_count; ++i)
-                    free(node->export_stmt.exported[i]);
-                free(node->export_stmt.exported);
-                free(node);
-                ERROR("Strdup failed!\n");
-            }
-
-            if (node->export_stmt.named_count >= capacity) {
-                capacity *= 2;
-                void *tmp = realloc(node->export_stmt.exported, sizeof(char*) * capacity);
-                if (!tmp) {
-                    for (size_t i = 0; i < node->export_stmt.named_count; ++i)
-                        free(node->export_stmt.exported[i]);
-                    free(node->export_stmt.exported);
-                    free(node);
-                    ERROR("Realloc failed!\n");
-                }
-                node->export_stmt.exported = tmp;
-            }
-
-            node->export_stmt.exported[node->export_stmt.named_count++] = name;
+            char *name = parse_token_string(parser, parser->current);
+            parser_list_push(parser, &name, sizeof(name));
             parser_advance(parser); // consume identifier
             parser_match(parser, TOKEN_COMMA); // optional comma
         }
+
+        node->export_stmt.exported =
+            parser_list_end(parser, mark, sizeof(char *), &node->export_stmt.named_count);
+
         printf("%d\n", parser->current->type);
         if (!parser_match(parser, TOKEN_RIGHT_BRACE)) {
             PARSER_ERROR(parser, "[ERROR] Expected '}' after export list\n");
-            for (size_t i = 0; i < node->export_stmt.named_count; ++i)
-                free(node->export_stmt.exported[i]);
-            free(node->export_stmt.exported);
-            free(node);
             return NULL;
         }
 
         if (!parser_match(parser, TOKEN_SEMICOLON)) {
             PARSER_ERROR(parser, "[ERROR] Expected ';' after export list\n");
-            for (size_t i = 0; i < node->export_stmt.named_count; ++i)
-                free(node->export_stmt.exported[i]);
-            free(node->export_stmt.exported);
-            free(node);
             return NULL;
         }
     }
@@ -1289,7 +1156,6 @@ static node_t *parse_export(parser_t *parser)
         node->export_stmt.declaration = parse_statement(parser);
         if (!node->export_stmt.declaration) {
             PARSER_ERROR(parser, "[ERROR] Expected declaration after 'export'\n");
-            free(node);
             return NULL;
         }
     }
@@ -1301,22 +1167,14 @@ static node_t *parse_return(parser_t *parser)
 {
     parser_advance(parser); // consume 'return'
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_RETURN;
-    node->return_stmt.value = NULL;
-    // node->location = parser->current.location;
+    node_t *node = parser_node(parser, NODE_RETURN, parser->previous->loc);
 
     /* match the semicolon (if no return value) */
     if (!parser_match(parser, TOKEN_SEMICOLON)) {
         node->return_stmt.value = parse_comma(parser);
-        if (!node->return_stmt.value) {
-            node_free(node);
-            return NULL; // bubble up error
-        }
+        if (!node->return_stmt.value) return NULL; // bubble up error
+
         if (!parser_match(parser, TOKEN_SEMICOLON)) {
-            node_free(node);
             PARSER_ERROR(parser, "[ERROR] Expected ';' after return value\n");
             return NULL;
         }
@@ -1329,24 +1187,14 @@ static node_t *parse_break(parser_t *parser)
 {
     parser_advance(parser); // consume 'break'
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_BREAK;
-    node->break_stmt.label = NULL;
-    node->loc = parser->current->loc;
+    node_t *node = parser_node(parser, NODE_BREAK, parser->previous->loc);
 
     if (parser->current->type == TOKEN_IDENTIFIER) {
-        node->break_stmt.label = strdup(parser->current->value);
-        if (!node->break_stmt.label) {
-            node_free(node);
-            ERROR("Strdup failed!\n");
-        }
+        node->break_stmt.label = parser->current->atom;
         parser_advance(parser); // consume label
     }
 
     if (!parser_match(parser, TOKEN_SEMICOLON)) {
-        node_free(node);
         PARSER_ERROR(parser, "[ERROR] Expected ';' after break\n");
         return NULL;
     }
@@ -1358,32 +1206,22 @@ static node_t *parse_continue(parser_t *parser)
 {
     // consume 'continue'
     if (!parser_match(parser, TOKEN_CONTINUE)) {
-        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'continue', got '%s'\n",
+        PARSER_ERROR(parser, "[ERROR] [%s:%zu:%zu] Expected 'continue', got '%.*s'\n",
             LOCATION(parser->current->loc),
-            parser->current->value
+            TOKEN_TEXT(parser, parser->current)
         );
         return NULL;
     }
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_CONTINUE;
-    node->continue_stmt.label = NULL;
-    node->loc = parser->previous->loc;
+    node_t *node = parser_node(parser, NODE_CONTINUE, parser->previous->loc);
 
     if (parser->current->type == TOKEN_IDENTIFIER) {
-        node->continue_stmt.label = strdup(parser->current->value);
-        if (!node->continue_stmt.label) {
-            node_free(node);
-            ERROR("Strdup failed!\n");
-        }
+        node->continue_stmt.label = parser->current->atom;
         parser_advance(parser); // consume label
     }
 
     if (!parser_match(parser, TOKEN_SEMICOLON)) {
         PARSER_ERROR(parser, "[ERROR] Expected ';' after continue\n");
-        node_free(node);
         return NULL;
     }
 
@@ -1394,26 +1232,18 @@ static node_t *parse_throw(parser_t *parser)
 {
     parser_advance(parser); // consume 'throw'
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_THROW;
+    node_t *node = parser_node(parser, NODE_THROW, parser->previous->loc);
 
     if (parser->current->type == TOKEN_SEMICOLON) {
         PARSER_ERROR(parser, "[ERROR] 'throw' must have an expression\n");
-        node_free(node);
         return NULL;
     }
 
     node->throw_stmt.value = parse_comma(parser);
-    if (!node->throw_stmt.value) {
-        node_free(node);
-        return NULL; // bubble error
-    }
+    if (!node->throw_stmt.value) return NULL; // bubble error
 
     if (!parser_match(parser, TOKEN_SEMICOLON)) {
         PARSER_ERROR(parser, "[ERROR] Expected ';' after throw expression\n");
-        node_free(node);
         return NULL;
     }
 
@@ -1424,25 +1254,14 @@ static node_t *parse_try(parser_t *parser)
 {
     parser_advance(parser); // consume 'try'
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Calloc failed!\n");
-
-    node->type = NODE_TRY;
-    node->try_stmt.try_block = NULL;
-    node->try_stmt.catch_param = NULL;
-    node->try_stmt.catch_block = NULL;
-    node->try_stmt.finally_block = NULL;
+    node_t *node = parser_node(parser, NODE_TRY, parser->previous->loc);
 
     if (parser->current->type != TOKEN_LEFT_BRACE) {
         PARSER_ERROR(parser, "[ERROR] Expected '{' after 'try'\n");
-        node_free(node);
         return NULL;
     }
     node->try_stmt.try_block = parse_block(parser);
-    if (!node->try_stmt.try_block) {
-        node_free(node);
-        return NULL;
-    }
+    if (!node->try_stmt.try_block) return NULL;
 
     if (parser->current->type == TOKEN_CATCH) {
         parser_advance(parser); // consume 'catch'
@@ -1452,37 +1271,27 @@ static node_t *parse_try(parser_t *parser)
 
             if (parser->current->type != TOKEN_IDENTIFIER) {
                 PARSER_ERROR(parser, "[ERROR] Expected identifier after 'catch('\n");
-                node_free(node);
                 return NULL;
             }
 
-            node->try_stmt.catch_param = strdup(parser->current->value);
-            if (!node->try_stmt.catch_param) {
-                node_free(node);
-                ERROR("Strdup failed!\n");
-            }
+            node->try_stmt.catch_param = parser->current->atom;
 
             parser_advance(parser); // consume identifier
 
             if (!parser_match(parser, TOKEN_RIGHT_PAREN)) {
-                PARSER_ERROR(parser, "[ERROR] Expected ')' after catch parameter, got: '%s'\n",
-                             parser->current->value);
-                node_free(node);
+                PARSER_ERROR(parser, "[ERROR] Expected ')' after catch parameter, got: '%.*s'\n",
+                             TOKEN_TEXT(parser, parser->current));
                 return NULL;
             }
         }
 
         if (parser->current->type != TOKEN_LEFT_BRACE) {
             PARSER_ERROR(parser, "[ERROR] Expected '{' after 'catch'\n");
-            node_free(node);
             return NULL;
         }
         
         node->try_stmt.catch_block = parse_block(parser);
-        if (!node->try_stmt.catch_block) {
-            node_free(node);
-            return NULL;
-        }
+        if (!node->try_stmt.catch_block) return NULL;
     }
 
     if (parser->current->type == TOKEN_FINALLY) {
@@ -1490,26 +1299,63 @@ static node_t *parse_try(parser_t *parser)
 
         if (parser->current->type != TOKEN_LEFT_BRACE) {
             PARSER_ERROR(parser, "[ERROR] Expected '{' after 'finally'\n");
-            node_free(node);
             return NULL;
         }
 
         node->try_stmt.finally_block = parse_block(parser);
-        if (!node->try_stmt.finally_block) {
-            node_free(node);
-            return NULL;
-        }
+        if (!node->try_stmt.finally_block) return NULL;
     }
 
     if (!node->try_stmt.catch_block && !node->try_stmt.finally_block) {
         PARSER_ERROR(parser, "[ERROR] 'try' must have at least a 'catch' or 'finally'\n");
-        node_free(node);
         return NULL;
     }
 
     return node;
 }
 
+/*
+ * Binding powers of the binary operators, higher binds tighter. Tokens
+ * which are not binary operators have power 0 and end the expression.
+ */
+enum
+{
+    POWER_NONE,
+    POWER_LOGICAL_OR,   // ||
+    POWER_LOGICAL_AND,  // &&
+    POWER_BITWISE_OR,   // |
+    POWER_BITWISE_XOR,  // ^
+    POWER_BITWISE_AND,  // &
+    POWER_EQUALITY,     // ==, !=
+    POWER_RELATIONAL,   // >, >=, <, <=
+    POWER_SHIFT,        // <<, >>
+    POWER_TERM,         // +, -
+    POWER_FACTOR,       // *, /, %
+    POWER_EXPONENT,     // **
+};
+
+static const uint8_t binary_powers[TOKEN_COUNT] = {
+    [TOKEN_LOGICAL_OR]    = POWER_LOGICAL_OR,
+    [TOKEN_LOGICAL_AND]   = POWER_LOGICAL_AND,
+    [TOKEN_PIPE]          = POWER_BITWISE_OR,
+    [TOKEN_CARET]         = POWER_BITWISE_XOR,
+    [TOKEN_AMPERSAND]     = POWER_BITWISE_AND,
+    [TOKEN_EQUAL_EQUAL]   = POWER_EQUALITY,
+    [TOKEN_BANG_EQUAL]    = POWER_EQUALITY,
+    [TOKEN_LESS]          = POWER_RELATIONAL,
+    [TOKEN_LESS_EQUAL]    = POWER_RELATIONAL,
+    [TOKEN_GREATER]       = POWER_RELATIONAL,
+    [TOKEN_GREATER_EQUAL] = POWER_RELATIONAL,
+    [TOKEN_LEFT_SHIFT]    = POWER_SHIFT,
+    [TOKEN_RIGHT_SHIFT]   = POWER_SHIFT,
+    [TOKEN_PLUS]          = POWER_TERM,
+    [TOKEN_MINUS]         = POWER_TERM,
+    [TOKEN_STAR]          = POWER_FACTOR,
+    [TOKEN_SLASH]         = POWER_FACTOR,
+    [TOKEN_PERCENT]       = POWER_FACTOR,
+    [TOKEN_STAR_STAR]     = POWER_EXPONENT,
+};
+
 static node_t *parse_comma(parser_t *parser)
 {
     node_t *left = parse_expression(parser);
@@ -1519,17 +1365,10 @@ static node_t *parse_comma(parser_t *parser)
     {
         token_t op = *parser->previous;
         node_t *right = parse_expression(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
+        if (!right) return NULL;
 
-        node->type = NODE_BINARY;
-        node->binary.op = op;
+        node_t *node = parser_node(parser, NODE_BINARY, op.loc);
+        node->op = op.type;
         node->binary.left = left;
         node->binary.right = right;
 
@@ -1546,6 +1385,8 @@ static node_t *parse_expression(parser_t *parser)
 
 static node_t *parse_assignment(parser_t *parser)
 {
+    if (!parser_enter(parser)) return NULL;
+
     node_t *left = parse_ternary(parser);
     if (!left) return NULL;
 
@@ -1568,57 +1409,42 @@ static node_t *parse_assignment(parser_t *parser)
 
         /* right association */
         node_t *right = parse_assignment(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
+        if (!right) return NULL;
 
-        // node_t *node = calloc(1, sizeof(node_t));
-        // if (!node) ERROR("Malloc failed!\n");
-
-        // node->type = NODE_ASSIGNMENT;
-        // node->assignment.op = op;
-        // node->assignment.target = left;
-        // node->assignment.value = right;
-
-        // return node;
-
-        return node_create_assignment(left, op, right, op.loc);
+        left = node_create_assignment(&parser->arena, left, op.type, right, op.loc);
     }
 
+    parser->depth--;
     return left;
 }
 
 static node_t *parse_ternary(parser_t *parser)
 {
-    node_t *condition = parse_logical_or(parser);
+    node_t *condition = parse_binary(parser, POWER_LOGICAL_OR);
     if (!condition) return NULL;
 
     if (parser_match(parser, TOKEN_QUESTION))
     {
+        location_t loc = parser->previous->loc;
+
         node_t *true_expr = parse_expression(parser);
         if (!true_expr)
         {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected expression after '?' in ternary expression, got: '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected expression after '?' in ternary expression, got: '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-
-            node_free(condition);
             return NULL;
         }
 
         if (!parser_match(parser, TOKEN_COLON))
         {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected ':' in ternary expression, got: '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected ':' in ternary expression, got: '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(condition);
-            node_free(true_expr);
             return NULL;
         }
 
@@ -1626,19 +1452,14 @@ static node_t *parse_ternary(parser_t *parser)
         if (!false_expr)
         {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected expression after ':' in ternary expression, got: '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected expression after ':' in ternary expression, got: '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(condition);
-            node_free(true_expr);
             return NULL;
         }
 
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_TERNARY;
+        node_t *node = parser_node(parser, NODE_TERNARY, loc);
         node->ternary.condition = condition;
         node->ternary.true_expr = true_expr;
         node->ternary.false_expr = false_expr;
@@ -1649,370 +1470,59 @@ static node_t *parse_ternary(parser_t *parser)
     return condition;
 }
 
-static node_t *parse_logical_or(parser_t *parser)
-{
-    node_t *left = parse_logical_and(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_LOGICAL_OR))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_logical_and(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-
-static node_t *parse_logical_and(parser_t *parser)
-{
-    node_t *left = parse_bitwise_or(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_LOGICAL_AND))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_bitwise_or(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-
-static node_t *parse_bitwise_or(parser_t *parser)
+/* parses operators binding at least as tight as `min_power` */
+static node_t *parse_binary(parser_t *parser, uint8_t min_power)
 {
-    node_t *left = parse_bitwise_xor(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_PIPE))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_bitwise_xor(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-static node_t *parse_bitwise_xor(parser_t *parser)
-{
-    node_t *left = parse_bitwise_and(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_CARET))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_bitwise_and(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-
-static node_t *parse_bitwise_and(parser_t *parser)
-{
-    node_t *left = parse_equality(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_AMPERSAND))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_equality(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-static node_t *parse_equality(parser_t *parser)
-{
-    node_t *left = parse_relational(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_EQUAL_EQUAL) ||
-           parser_match(parser, TOKEN_BANG_EQUAL))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_relational(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-static node_t *parse_relational(parser_t *parser)
-{
-    node_t *left = parse_shift(parser);
-    if (!left) return NULL;
-
-    while (
-        parser_match(parser, TOKEN_LESS)       || // <
-        parser_match(parser, TOKEN_LESS_EQUAL) || // <=
-        parser_match(parser, TOKEN_GREATER)    || // >
-        parser_match(parser, TOKEN_GREATER_EQUAL)   // >=
-    )
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_shift(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-
-static node_t *parse_shift(parser_t *parser)
-{
-    node_t *left = parse_term(parser);
-    if (!left) return NULL;
+    if (!parser_enter(parser)) return NULL;
 
-    while (parser_match(parser, TOKEN_LEFT_SHIFT) ||
-           parser_match(parser, TOKEN_RIGHT_SHIFT))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_term(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
-
-    return left;
-}
-
-
-static node_t *parse_term(parser_t *parser)
-{
-    node_t *left = parse_factor(parser);
+    node_t *left = parse_unary(parser);
     if (!left) return NULL;
 
-    while (parser_match(parser, TOKEN_PLUS) ||
-           parser_match(parser, TOKEN_MINUS))
+    while (true)
     {
-        token_t op = *parser->previous;
-        node_t *right = parse_factor(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        left = node;
-    }
+        uint8_t power = binary_powers[parser->current->type];
+        if (power == POWER_NONE || power < min_power) break;
 
-    return left;
-}
-
-static node_t *parse_factor(parser_t *parser)
-{
-    node_t *left = parse_exponent(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOKEN_STAR) ||
-           parser_match(parser, TOKEN_SLASH) ||
-           parser_match(parser, TOKEN_PERCENT))
-    {
-        token_t op = *parser->previous;
-        node_t *right = parse_exponent(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
+        token_t op = *parser->current;
+        parser_advance(parser);
 
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
+        /* `**` is right associative, the rest associate to the left */
+        node_t *right = parse_binary(parser, power == POWER_EXPONENT ? power : power + 1);
+        if (!right) return NULL;
 
-        node->type = NODE_BINARY;
-        node->binary.op = op;
+        node_t *node = parser_node(parser, NODE_BINARY, op.loc);
+        node->op = op.type;
         node->binary.left = left;
         node->binary.right = right;
 
         left = node;
     }
 
+    parser->depth--;
     return left;
 }
 
-
-static node_t *parse_exponent(parser_t *parser)
+static node_t *parse_unary(parser_t *parser)
 {
-    node_t *left = parse_unary(parser);
-    if (!left) return NULL;
-
-    if (parser_match(parser, TOKEN_STAR_STAR))
-    {
-        token_t op = *parser->previous;
-
-        /* right association */
-        node_t *right = parse_exponent(parser);
-        if (!right)
-        {
-            node_free(left);
-            return NULL;
-        }
-
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_BINARY;
-        node->binary.op = op;
-        node->binary.left = left;
-        node->binary.right = right;
-
-        return node;
-    }
+    if (!parser_enter(parser)) return NULL;
 
-    return left;
-}
+    node_t *node;
 
-static node_t *parse_unary(parser_t *parser)
-{
     if (parser_match(parser, TOKEN_AWAIT)) {
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
+        node = parser_node(parser, NODE_AWAIT, parser->previous->loc);
 
-        node->type = NODE_AWAIT;
-        node->loc = parser->previous->loc;
         node->await_expr.argument = parse_unary(parser);
-
-        if (!node->await_expr.argument) {
-            free(node);
-            return NULL;
-        }
-
-        return node;
-    }
-
-    if (parser_match(parser, TOKEN_BANG) ||
-        parser_match(parser, TOKEN_PLUS) ||
-        parser_match(parser, TOKEN_MINUS) ||
-        parser_match(parser, TOKEN_TILDE) ||
-        parser_match(parser, TOKEN_PLUS_PLUS) ||
-        parser_match(parser, TOKEN_MINUS_MINUS) ||
-        parser_match(parser, TOKEN_TYPEOF) ||
-        parser_match(parser, TOKEN_DELETE) ||
-        parser_match(parser, TOKEN_VOID))
+        if (!node->await_expr.argument) return NULL;
+    }
+    else if (parser_match(parser, TOKEN_BANG) ||
+             parser_match(parser, TOKEN_PLUS) ||
+             parser_match(parser, TOKEN_MINUS) ||
+             parser_match(parser, TOKEN_TILDE) ||
+             parser_match(parser, TOKEN_PLUS_PLUS) ||
+             parser_match(parser, TOKEN_MINUS_MINUS) ||
+             parser_match(parser, TOKEN_TYPEOF) ||
+             parser_match(parser, TOKEN_DELETE) ||
+             parser_match(parser, TOKEN_VOID))
     {
         token_t op = *parser->previous;
         node_t *right = parse_unary(parser);
@@ -2020,18 +1530,17 @@ static node_t *parse_unary(parser_t *parser)
             return NULL;
         }
 
-        node_t *node = calloc(1, sizeof(node_t));
-        if (!node) ERROR("Malloc failed!\n");
-
-        node->type = NODE_UNARY;
-        node->loc = op.loc;
-        node->unary.op = op;
+        node = parser_node(parser, NODE_UNARY, op.loc);
+        node->op = op.type;
         node->unary.right = right;
-
-        return node; 
+    }
+    else
+    {
+        node = parse_postfix(parser);
     }
 
-    return parse_postfix(parser);
+    parser->depth--;
+    return node;
 }
 
 static node_t *parse_postfix(parser_t *parser)
@@ -2044,82 +1553,49 @@ static node_t *parse_postfix(parser_t *parser)
         /* function call */
         if (parser_match(parser, TOKEN_LEFT_PAREN))
         {
-            node_t *call = malloc(sizeof(node_t));
-            if (!call) ERROR("Malloc failed!\n");
-
-            call->type = NODE_CALL;
-            // call->location = parser->previous.location;
-            
-            size_t argc = 0, cap = 4;
-            node_t **args = malloc(sizeof(node_t*) * cap);
-            if (!args) ERROR("Malloc failed!\n");
+            node_t *call = parser_node(parser, NODE_CALL, parser->previous->loc);
+            size_t mark = parser_list_begin(parser);
 
             if (parser->current->type != TOKEN_RIGHT_PAREN)
             {
                 do
                 {
                     node_t *arg = parse_expression(parser);
-                    if (!arg)
-                    {
-                        /* free already parsed args before returning NULL */
-                        for (size_t i = 0; i < argc; ++i) node_free(args[i]);
-                        free(args); node_free(call); node_free(expr);
-                        return NULL;
-                    }
-                    if (argc >= cap)
-                    {
-                        cap *= 2;
-                        /* FIXME: assume reallocation never fails */
-                        args = realloc(args, sizeof(node_t*) * cap);
-                    }
-
-                    args[argc++] = arg;
+                    if (!arg) return NULL;
+
+                    parser_list_push(parser, &arg, sizeof(arg));
                 } while (parser_match(parser, TOKEN_COMMA));
             }
 
             if (!parser_match(parser, TOKEN_RIGHT_PAREN))
             {
                 PARSER_ERROR(parser,
-                    "[ERROR] [%s:%zu:%zu] Expected ',' or ')' after function argument got: '%s'\n",
+                    "[ERROR] [%s:%zu:%zu] Expected ',' or ')' after function argument got: '%.*s'\n",
                         LOCATION(parser->current->loc),
-                        parser->current->value
+                        TOKEN_TEXT(parser, parser->current)
                 );
-
-                /* free already parsed args before returning NULL */
-                for (size_t i = 0; i < argc; ++i) node_free(args[i]);
-                free(args); node_free(call); node_free(expr);
-
                 return NULL;
             }
 
             call->call.callee = expr;
-            call->call.args = args;
-            call->call.arg_count = argc;
+            call->call.args = parser_list_end(parser, mark, sizeof(node_t *), &call->call.arg_count);
 
             expr = call;
         }
         /* indexing */
         else if (parser_match(parser, TOKEN_LEFT_BRACKET))
         {
-            node_t *node = malloc(sizeof(node_t));
-            if (!node) ERROR("Malloc failed!\n");
-
-            node->type = NODE_INDEX;
-            // node->location = parser->previous.location;
+            node_t *node = parser_node(parser, NODE_INDEX, parser->previous->loc);
             node->index.array = expr;
             node->index.index = parse_comma(parser);
-            if (!node->index.index) {
-                node_free(node);
-                return NULL;
-            }
+            if (!node->index.index) return NULL;
 
             if (!parser_match(parser, TOKEN_RIGHT_BRACKET)) {
                 PARSER_ERROR(parser,
-                    "[ERROR] [%s:%zu:%zu] Expected ']' after array index, got: '%s'\n",
+                    "[ERROR] [%s:%zu:%zu] Expected ']' after array index, got: '%.*s'\n",
                     LOCATION(parser->current->loc),
-                    parser->current->value
+                    TOKEN_TEXT(parser, parser->current)
                 );
-                node_free(node);
                 return NULL;
             }
 
@@ -2128,11 +1604,7 @@ static node_t *parse_postfix(parser_t *parser)
         /* member */
         else if (parser_match(parser, TOKEN_DOT))
         {
-            node_t *node = malloc(sizeof(node_t));
-            if (!node) ERROR("Malloc failed!\n");
-
-            node->type = NODE_MEMBER;
-            // node->location = parser->previous.location; // the '.' token
+            node_t *node = parser_node(parser, NODE_MEMBER, parser->previous->loc); // the '.' token
             node->member.object = expr;                 // the object being accessed
 
             // Only allow identifier (no arbitrary expression here)
@@ -2141,7 +1613,6 @@ static node_t *parse_postfix(parser_t *parser)
                     "[ERROR] [%s:%zu:%zu] Expected identifier after '.'\n",
                     LOCATION(parser->current->loc)
                 );
-                node_free(node);
                 return NULL;
             }
 
@@ -2151,11 +1622,8 @@ static node_t *parse_postfix(parser_t *parser)
         else if (parser_match(parser, TOKEN_PLUS_PLUS) ||
             parser_match(parser, TOKEN_MINUS_MINUS))
         {
-            node_t *node = malloc(sizeof(node_t));
-            if (!node) ERROR("Malloc failed!\n");
-
-            node->type = NODE_POSTFIX;
-            node->postfix.op = *parser->previous;
+            node_t *node = parser_node(parser, NODE_POSTFIX, parser->previous->loc);
+            node->op = parser->previous->type;
 			node->postfix.left = expr;
             expr = node;
         }
@@ -2183,9 +1651,7 @@ static node_t *parse_primary(parser_t *parser)
     if (parser->current->type == TOKEN_LEFT_BRACE)      return parse_object(parser);
 
     if (parser->current->type == TOKEN_THIS) {
-        node_t *node = calloc(1, sizeof(node_t));
-        node->type = NODE_THIS;
-        node->loc = parser->current->loc;
+        node_t *node = parser_node(parser, NODE_THIS, parser->current->loc);
         parser_advance(parser);
         return node;
     }
@@ -2197,11 +1663,10 @@ static node_t *parse_primary(parser_t *parser)
 
         if (!parser_match(parser, TOKEN_RIGHT_PAREN)) {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected ')' after expression got: '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected ')' after expression got: '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            node_free(expr);
             return NULL;
         }
 
@@ -2209,9 +1674,9 @@ static node_t *parse_primary(parser_t *parser)
     }
 
     PARSER_ERROR(parser,
-        "[ERROR] [%s:%zu:%zu] Expected primary expression, got '%s'\n",
+        "[ERROR] [%s:%zu:%zu] Expected primary expression, got '%.*s'\n",
         LOCATION(parser->current->loc),
-        parser->current->value
+        TOKEN_TEXT(parser, parser->current)
     );
 
     return NULL;
@@ -2221,21 +1686,15 @@ static node_t *parse_number(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_NUMBER_LITERAL)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_NUMBER;
+    node_t *node = parser_node(parser, NODE_NUMBER, parser->previous->loc);
 
     // mpfr_init2(node->number, MPFR_PRECISION);    
     // if (mpfr_set_str(node->number, parser->previous->value, 10, MPFR_RNDN) != 0) {
     //     ERROR("Invalid number literal: %s\n", parser->previous->value);
     // }
 
-    char *endptr = NULL;
-    node->number = strtold(parser->previous->value, &endptr);
-    if (endptr == parser->previous->value || *endptr != '\0') {
-        ERROR("Invalid number literal: %s\n", parser->previous->value);
-    }
+    /* decoded by the lexer */
+    node->number = lexer_token_number(parser->lexer, parser->previous);
 
     return node;
 }
@@ -2244,11 +1703,8 @@ static node_t *parse_string(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_STRING_LITERAL)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_STRING;
-    node->string = strdup(parser->previous->value); 
+    node_t *node = parser_node(parser, NODE_STRING, parser->previous->loc);
+    node->string = parse_token_string(parser, parser->previous);
     return node;
 }
 
@@ -2256,11 +1712,8 @@ static node_t *parse_bool(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_BOOL_LITERAL)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_BOOL;
-    node->boolean = strcmp(parser->previous->value, "true") == 0; 
+    node_t *node = parser_node(parser, NODE_BOOL, parser->previous->loc);
+    node->boolean = parser->previous->length == 4; /* "true" vs. "false" */
     return node;
 }
 
@@ -2268,20 +1721,21 @@ static node_t *parse_identifier(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_IDENTIFIER)) return NULL;
 
-    const char *name = parser->previous->value;
+    const char *name = lexer_token_text(parser->lexer, parser->previous);
+    size_t length = parser->previous->length;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
+    node_t *node;
 
-    if (strncmp(name, "Infinity", 8) == 0) {
-        node->type = NODE_NUMBER;
+    /* nodes are sized by type, decide before allocating */
+    if (length == 8 && strncmp(name, "Infinity", 8) == 0) {
+        node = parser_node(parser, NODE_NUMBER, parser->previous->loc);
         node->number = INFINITY;
-    } else if (strncmp(name, "NaN", 3) == 0) {
-        node->type = NODE_NUMBER;
+    } else if (length == 3 && strncmp(name, "NaN", 3) == 0) {
+        node = parser_node(parser, NODE_NUMBER, parser->previous->loc);
         node->number = NAN;
     } else {
-        node->type = NODE_IDENTIFIER;
-        node->identifier = strdup(parser->previous->value);    
+        node = parser_node(parser, NODE_IDENTIFIER, parser->previous->loc);
+        node->identifier = parser->previous->atom;
     }
 
     return node;
@@ -2291,35 +1745,26 @@ static node_t *parse_undefined(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_UNDEFINED)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_UNDEFINED;
-    return node;
+    return parser_node(parser, NODE_UNDEFINED, parser->previous->loc);
 }
 
 static node_t *parse_null(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_NULL)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_NULL;
-    return node;
+    return parser_node(parser, NODE_NULL, parser->previous->loc);
 }
 
 static node_t *parse_spread(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_ELLIPSIS)) return NULL;
 
+    location_t loc = parser->previous->loc;
+
     node_t *argument = parse_expression(parser);
     if (!argument) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_SPREAD;
+    node_t *node = parser_node(parser, NODE_SPREAD, loc);
     node->spread.argument = argument;
     return node;
 }
@@ -2328,181 +1773,132 @@ static node_t *parse_array(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_LEFT_BRACKET)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
-
-    node->type = NODE_ARRAY;
-    node->array.elements = NULL;
-    node->array.count = 0;
-
-    node_t **elements = NULL;
-    size_t count = 0;
+    node_t *node = parser_node(parser, NODE_ARRAY, parser->previous->loc);
+    size_t mark = parser_list_begin(parser);
 
     if (!parser_match(parser, TOKEN_RIGHT_BRACKET)) {
         do {
             node_t *element = NULL;
 
             // spread element
-            if (parser_match(parser, TOKEN_ELLIPSIS)) {
-                node_t *argument = parse_expression(parser);
-                if (!argument) goto fail;
-
-                element = calloc(1, sizeof(node_t));
-                if (!element) ERROR("Malloc failed!\n");
-
-                element->type = NODE_SPREAD;
-                element->spread.argument = argument;
+            if (parser_check(parser, TOKEN_ELLIPSIS)) {
+                element = parse_spread(parser);
+                if (!element) return NULL;
             }
             // elision (undefined)
             else if (parser->current->type == TOKEN_COMMA) {
-                element = calloc(1, sizeof(node_t));
-                if (!element) ERROR("Malloc failed!\n");
-
-                element->type = NODE_UNDEFINED;
+                element = parser_node(parser, NODE_UNDEFINED, parser->current->loc);
             }
             else
             {
                 element = parse_expression(parser);
-                if (!element) goto fail;
+                if (!element) return NULL;
             }
 
-            node_t **tmp = realloc(elements, sizeof(node_t *) * (count + 1));
-            if (!tmp) ERROR("Realloc failed!\n");
-            elements = tmp;
-            elements[count++] = element;
+            parser_list_push(parser, &element, sizeof(element));
 
         } while (parser_match(parser, TOKEN_COMMA) && parser->current->type != TOKEN_RIGHT_BRACKET);
 
         if (!parser_match(parser, TOKEN_RIGHT_BRACKET)) {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected ',' or ']' after array element, got '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected ',' or ']' after array element, got '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            goto fail;
+            return NULL;
         }
     }
 
-    node->array.elements = elements;
-    node->array.count = count;
+    node->array.elements = parser_list_end(parser, mark, sizeof(node_t *), &node->array.count);
     return node;
-
-fail:
-    for (size_t i = 0; i < count; i++) node_free(elements[i]);
-    free(elements);
-    free(node);
-    return NULL;
 }
 
 static node_t *parse_object(parser_t *parser)
 {
     if (!parser_match(parser, TOKEN_LEFT_BRACE)) return NULL;
 
-    node_t *node = calloc(1, sizeof(node_t));
-    if (!node) ERROR("Malloc failed!\n");
+    node_t *node = parser_node(parser, NODE_OBJECT, parser->previous->loc);
 
-    node->type = NODE_OBJECT;
-    node->object.keys = NULL;
-    node->object.values = NULL;
-    node->object.count = 0;
-
-    char **keys = NULL;
-    node_t **values = NULL;
-    size_t count = 0;
+    /* keys and values, pushed in pairs */
+    struct property { atom_t key; node_t *value; };
+    size_t mark = parser_list_begin(parser);
 
     if (!parser_match(parser, TOKEN_RIGHT_BRACE)) {
         do {
-            node_t *value = NULL;
-            char *key = NULL;
+            struct property property = {0};
 
             // spread property
-            // if (parser_match(parser, TOKEN_ELLIPSIS)) {
-            //     value = parse_expression(parser);
-            //     if (!value) goto fail;
-            //     key = NULL;
-            // }
             if (parser_check(parser, TOKEN_ELLIPSIS)) {
-                value = parse_spread(parser);
-                if (!value) goto fail;
-                key = NULL;
+                property.value = parse_spread(parser);
+                if (!property.value) return NULL;
             }
 
             else {
                 if (!(parser_match(parser, TOKEN_IDENTIFIER) ||
                       parser_match(parser, TOKEN_STRING_LITERAL))) {
                     PARSER_ERROR(parser,
-                        "[ERROR] [%s:%zu:%zu] Expected identifier or string literal for object key, got: '%s'\n",
+                        "[ERROR] [%s:%zu:%zu] Expected identifier or string literal for object key, got: '%.*s'\n",
                         LOCATION(parser->current->loc),
-                        parser->current->value
+                        TOKEN_TEXT(parser, parser->current)
                     );
-                    goto fail;
+                    return NULL;
                 }
 
-                key = strdup(parser->previous->value);
-                if (!key) ERROR("Strdup failed!\n");
+                /* string keys are interned too, lookups compare atoms */
+                if (parser->previous->type == TOKEN_IDENTIFIER)
+                    property.key = parser->previous->atom;
+                else
+                    property.key = atom_intern(lexer_token_text(parser->lexer, parser->previous), parser->previous->length);
+
+                location_t key_loc = parser->previous->loc;
 
                 if (parser_match(parser, TOKEN_COLON)) {
-                    value = parse_expression(parser);
-                    if (!value) {
-                        free(key);
-                        goto fail;
-                    }
+                    property.value = parse_expression(parser);
+                    if (!property.value) return NULL;
                 }
                 else if (parser->current->type == TOKEN_COMMA ||
                          parser->current->type == TOKEN_RIGHT_BRACE) {
                     // shorthand { a, b }
-                    value = calloc(1, sizeof(node_t));
-                    if (!value) ERROR("Malloc failed!\n");
-
-                    value->type = NODE_IDENTIFIER;
-                    value->identifier = strdup(key);
-                    if (!value->identifier) ERROR("Strdup failed!\n");
+                    property.value = parser_node(parser, NODE_IDENTIFIER, key_loc);
+                    property.value->identifier = property.key;
                 }
                 else {
                     PARSER_ERROR(parser,
-                        "[ERROR] [%s:%zu:%zu] Expected ':' or ',' after object key, got '%s'\n",
+                        "[ERROR] [%s:%zu:%zu] Expected ':' or ',' after object key, got '%.*s'\n",
                         LOCATION(parser->current->loc),
-                        parser->current->value
+                        TOKEN_TEXT(parser, parser->current)
                     );
-                    free(key);
-                    goto fail;
+                    return NULL;
                 }
             }
 
-            char **tmp_keys = realloc(keys, sizeof(char *) * (count + 1));
-            node_t **tmp_values = realloc(values, sizeof(node_t *) * (count + 1));
-            if (!tmp_keys || !tmp_values) ERROR("Realloc failed!\n");
-
-            keys = tmp_keys;
-            values = tmp_values;
-            keys[count] = key;
-            values[count] = value;
-            count++;
+            parser_list_push(parser, &property, sizeof(property));
 
         } while (parser_match(parser, TOKEN_COMMA) && parser->current->type != TOKEN_RIGHT_BRACE);
 
         if (!parser_match(parser, TOKEN_RIGHT_BRACE)) {
             PARSER_ERROR(parser,
-                "[ERROR] [%s:%zu:%zu] Expected ',' or '}' after object entry, got '%s'\n",
+                "[ERROR] [%s:%zu:%zu] Expected ',' or '}' after object entry, got '%.*s'\n",
                 LOCATION(parser->current->loc),
-                parser->current->value
+                TOKEN_TEXT(parser, parser->current)
             );
-            goto fail;
+            return NULL;
         }
     }
 
-    node->object.keys = keys;
-    node->object.values = values;
-    node->object.count = count;
-    return node;
+    size_t count;
+    struct property *properties = parser_list_items(parser, mark, sizeof(struct property), &count);
 
-fail:
-    for (size_t i = 0; i < count; i++) {
-        free(keys[i]);
-        node_free(values[i]);
+    node->object.count = count;
+    if (count) {
+        node->object.keys = arena_alloc(&parser->arena, sizeof(atom_t) * count);
+        node->object.values = arena_alloc(&parser->arena, sizeof(node_t *) * count);
+        for (size_t i = 0; i < count; i++) {
+            node->object.keys[i] = properties[i].key;
+            node->object.values[i] = properties[i].value;
+        }
     }
-    free(keys);
-    free(values);
-    free(node);
-    return NULL;
+    parser_list_pop(parser, mark);
+
+    return node;
 }
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "runtime.h"
+#include "sema.h"
+
+bool runtime_truthy(value_t value)
+{
+    switch (value.type)
+    {
+        case VALUE_BOOL: return value.boolean;
+        case VALUE_NUMBER: return value.number != 0 && !isnan(value.number);
+        case VALUE_STRING: return value.string[0] != '\0';
+        case VALUE_NULL:
+        case VALUE_UNDEFINED: return false;
+        default: return true;
+    }
+}
+
+number_t runtime_to_number(value_t value)
+{
+    switch (value.type)
+    {
+        case VALUE_NUMBER: return value.number;
+        case VALUE_BOOL: return value.boolean;
+        case VALUE_NULL: return 0;
+
+        case VALUE_STRING: {
+            const char *text = value.string;
+            while (*text == ' ' || *text == '\t' || *text == '\n') text++;
+            if (!*text) return 0;
+
+            char *end;
+            number_t number = strtold(text, &end);
+            while (*end == ' ' || *end == '\t' || *end == '\n') end++;
+            return *end ? NAN : number;
+        }
+
+        default: return NAN;
+    }
+}
+
+int32_t runtime_to_int32(number_t number)
+{
+    if (!isfinite(number)) return 0;
+
+    number_t wrapped = fmodl(truncl(number), 4294967296.0L);
+    if (wrapped < 0) wrapped += 4294967296.0L;
+    return (int32_t) (uint32_t) wrapped;
+}
+
+const char *runtime_typeof(value_t value)
+{
+    switch (value.type)
+    {
+        case VALUE_NUMBER: return "number";
+        case VALUE_STRING: return "string";
+        case VALUE_BOOL: return "boolean";
+        case VALUE_FUNCTION: return "function";
+        case VALUE_UNDEFINED: return "undefined";
+        default: return "object";
+    }
+}
+
+value_t runtime_concat(value_t left, value_t right)
+{
+    char *a = value_to_string(&left);
+    char *b = value_to_string(&right);
+    size_t a_length = strlen(a), b_length = strlen(b);
+
+    char *string = malloc(a_length + b_length + 1);
+    if (!string)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(string, a, a_length);
+    memcpy(string + a_length, b, b_length + 1);
+
+    free(a);
+    free(b);
+    return (value_t) { .type = VALUE_STRING, .string = string };
+}
+
+value_t runtime_add(value_t left, value_t right)
+{
+    if (left.type == VALUE_NUMBER && right.type == VALUE_NUMBER)
+        return value_number(left.number + right.number);
+    if (left.type == VALUE_STRING || right.type == VALUE_STRING)
+        return runtime_concat(left, right);
+    return value_number(runtime_to_number(left) + runtime_to_number(right));
+}
+
+/* strings compare by their characters, everything else as numbers */
+bool runtime_less(value_t left, value_t right, bool or_equal)
+{
+    if (left.type == VALUE_STRING && right.type == VALUE_STRING)
+    {
+        int order = strcmp(left.string, right.string);
+        return or_equal ? order <= 0 : order < 0;
+    }
+
+    number_t a = runtime_to_number(left), b = runtime_to_number(right);
+    return or_equal ? a <= b : a < b;
+}
+
+bool runtime_strict_equals(value_t a, value_t b)
+{
+    if (a.type != b.type) return false;
+
+    switch (a.type)
+    {
+        case VALUE_NUMBER: return a.number == b.number;
+        case VALUE_STRING: return a.string == b.string || strcmp(a.string, b.string) == 0;
+        case VALUE_BOOL: return a.boolean == b.boolean;
+        case VALUE_FUNCTION: return a.function == b.function;
+        case VALUE_ARRAY: return a.array.elements == b.array.elements;
+        case VALUE_OBJECT: return a.object.keys == b.object.keys;
+        default: return true;
+    }
+}
+
+bool runtime_equals(value_t a, value_t b)
+{
+    if (a.type == b.type) return runtime_strict_equals(a, b);
+
+    bool a_nullish = a.type == VALUE_NULL || a.type == VALUE_UNDEFINED;
+    bool b_nullish = b.type == VALUE_NULL || b.type == VALUE_UNDEFINED;
+    if (a_nullish || b_nullish) return a_nullish && b_nullish;
+
+    /* numbers, strings and booleans compare as numbers */
+    bool a_primitive = a.type == VALUE_NUMBER || a.type == VALUE_STRING || a.type == VALUE_BOOL;
+    bool b_primitive = b.type == VALUE_NUMBER || b.type == VALUE_STRING || b.type == VALUE_BOOL;
+    return a_primitive && b_primitive && runtime_to_number(a) == runtime_to_number(b);
+}
+
+value_t runtime_member(value_t object, atom_t name)
+{
+    if (object.type != VALUE_OBJECT)
+    {
+        ERROR("Cannot read property '%s' of %s\n", name, runtime_typeof(object));
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < object.object.count; i++)
+        if (object.object.keys[i] == name)
+            return object.object.values[i];
+    return value_undefined();
+}
+
+#define RUNTIME_MATH_UNARY(name, function) \
+    static value_t runtime_math_##name(eval_context_t *ctx, size_t argc, value_t *argv) \
+    { \
+        (void) ctx; \
+        return value_number(function(argc ? runtime_to_number(argv[0]) : NAN)); \
+    }
+
+static number_t runtime_signl(number_t x)
+{
+    return isnan(x) || x == 0 ? x : x > 0 ? 1 : -1;
+}
+
+RUNTIME_MATH_UNARY(sin, sinl)
+RUNTIME_MATH_UNARY(cos, cosl)
+RUNTIME_MATH_UNARY(tan, tanl)
+RUNTIME_MATH_UNARY(asin, asinl)
+RUNTIME_MATH_UNARY(acos, acosl)
+RUNTIME_MATH_UNARY(atan, atanl)
+RUNTIME_MATH_UNARY(sqrt, sqrtl)
+RUNTIME_MATH_UNARY(log, logl)
+RUNTIME_MATH_UNARY(exp, expl)
+RUNTIME_MATH_UNARY(abs, fabsl)
+RUNTIME_MATH_UNARY(floor, floorl)
+RUNTIME_MATH_UNARY(ceil, ceill)
+RUNTIME_MATH_UNARY(sign, runtime_signl)
+
+static value_t runtime_math_min(eval_context_t *ctx, size_t argc, value_t *argv)
+{
+    (void) ctx;
+    number_t result = INFINITY;
+    for (size_t i = 0; i < argc; i++)
+    {
+        number_t x = runtime_to_number(argv[i]);
+        if (isnan(x) || x < result) result = x;
+        if (isnan(result)) break;
+    }
+    return value_number(result);
+}
+
+static value_t runtime_math_max(eval_context_t *ctx, size_t argc, value_t *argv)
+{
+    (void) ctx;
+    number_t result = -INFINITY;
+    for (size_t i = 0; i < argc; i++)
+    {
+        number_t x = runtime_to_number(argv[i]);
+        if (isnan(x) || x > result) result = x;
+        if (isnan(result)) break;
+    }
+    return value_number(result);
+}
+
+static value_t runtime_math_random(eval_context_t *ctx, size_t argc, value_t *argv)
+{
+    (void) ctx;
+    (void) argc;
+    (void) argv;
+    return value_number((number_t) rand() / ((number_t) RAND_MAX + 1));
+}
+
+/* writes the arguments separated by spaces, strings without quotes */
+static value_t runtime_print(eval_context_t *ctx, size_t argc, value_t *argv)
+{
+    (void) ctx;
+    for (size_t i = 0; i < argc; i++)
+    {
+        char *text = value_to_string(&argv[i]);
+        printf("%s%s", i ? " " : "", text);
+        free(text);
+    }
+    return value_undefined();
+}
+
+static const struct
+{
+    const char *name;
+    value_t (*native)(eval_context_t *ctx, size_t argc, value_t *argv);
+} runtime_math_functions[] = {
+    { "sin", runtime_math_sin },       { "cos", runtime_math_cos },       { "tan", runtime_math_tan },
+    { "asin", runtime_math_asin },     { "acos", runtime_math_acos },     { "atan", runtime_math_atan },
+    { "sqrt", runtime_math_sqrt },     { "log", runtime_math_log },       { "exp", runtime_math_exp },
+    { "abs", runtime_math_abs },       { "floor", runtime_math_floor },   { "ceil", runtime_math_ceil },
+    { "min", runtime_math_min },       { "max", runtime_math_max },       { "sign", runtime_math_sign },
+    { "random", runtime_math_random },
+};
+
+static value_t runtime_native(value_t (*native_ptr)(eval_context_t *ctx, size_t argc, value_t *argv))
+{
+    function_t *native = malloc(sizeof(function_t));
+    if (!native)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    native->is_native = true;
+    native->native_ptr = native_ptr;
+    return value_function(native);
+}
+
+/* sets the builtins in the cells sema reserved for them */
+void runtime_builtins(env_t *globals)
+{
+    static_assert(SEMA_BUILTIN_COUNT == 4, "Fix SEMA_BUILTIN_COUNT in 'runtime_builtins'");
+
+    value_t math = value_object_create();
+    for (size_t i = 0; i < sizeof(runtime_math_functions) / sizeof(*runtime_math_functions); i++)
+        object_set(&math.object, atom_from_cstr(runtime_math_functions[i].name),
+            runtime_native(runtime_math_functions[i].native));
+
+    object_set(&math.object, atom_from_cstr("PI"), value_number(3.141592653589793238462643383279502884L));
+    object_set(&math.object, atom_from_cstr("E"), value_number(2.718281828459045235360287471352662498L));
+    object_set(&math.object, atom_from_cstr("PHI"), value_number(1.618033988749894848204586834365638118L));
+
+    globals->slots[SEMA_BUILTIN_MATH] = math;
+    globals->slots[SEMA_BUILTIN_INFINITY] = value_number(INFINITY);
+    globals->slots[SEMA_BUILTIN_NAN] = value_number(NAN);
+    globals->slots[SEMA_BUILTIN_PRINT] = runtime_native(runtime_print);
+}
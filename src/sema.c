@@ -1,247 +1,1003 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdbool.h>
 
 #include "sema.h"
 
+#define SEMA_SCOPE_INITIAL_CAPACITY 8
+
+static const char *sema_builtins[SEMA_BUILTIN_COUNT] = {
+    [SEMA_BUILTIN_MATH]     = "Math",
+    [SEMA_BUILTIN_INFINITY] = "Infinity",
+    [SEMA_BUILTIN_NAN]      = "NaN",
+    [SEMA_BUILTIN_PRINT]    = "print",
+};
+
+static_assert(SEMA_BUILTIN_COUNT == 4, "Fix SEMA_BUILTIN_COUNT in 'sema_builtins'");
+
+const char *sema_builtin_name(sema_builtin_t builtin)
+{
+    return sema_builtins[builtin];
+}
+
 void sema_init(sema_t *sema, node_t *program)
 {
     sema->program = program;
     sema->loop_depth = 0;
+    sema->switch_depth = 0;
+    sema->try_depth = 0;
     sema->in_async_function = false;
     sema->had_error = false;
+
+    sema->declarations = 0;
+    sema->hoisted_at = 0;
+
+    flat_init(&sema->program_flat);
+    sema->flat = NULL;
+
+    arena_init(&sema->arena);
+    sema->scope = NULL;
+
+    sema->writes = NULL;
+    sema->write_count = sema->write_capacity = 0;
+    sema->uses = NULL;
+    sema->use_count = sema->use_capacity = 0;
+    sema->expressions = NULL;
+    sema->expression_count = sema->expression_capacity = 0;
+
+    sema->math_uses = 0;
+    sema->math_reads = 0;
+    sema->lazy_bodies = false;
 }
 
 void sema_free(sema_t *sema)
 {
+    flat_free(&sema->program_flat);
+    arena_free(&sema->arena);
     free(sema);
 }
 
-static void sema_visit(sema_t *sema, node_t *node);
+/* grows an array in the arena, the old one stays there */
+static void *sema_grow(sema_t *sema, void *items, size_t count, size_t *capacity, size_t size)
+{
+    if (count < *capacity) return items;
+
+    size_t new_capacity = *capacity ? *capacity * 2 : SEMA_SCOPE_INITIAL_CAPACITY;
+    void *new_items = arena_alloc(&sema->arena, new_capacity * size);
+    if (count) memcpy(new_items, items, count * size);
+
+    *capacity = new_capacity;
+    return new_items;
+}
 
-static void sema_visit_program(sema_t *sema, node_t *node)
+static void sema_scope_push(sema_t *sema, bool is_function)
 {
-    for (size_t i = 0; i < node->block.count; i++)
-        sema_visit(sema, node->block.statements[i]);
+    sema_scope_t *parent = sema->scope;
+    sema_scope_t *scope = arena_alloc(&sema->arena, sizeof(sema_scope_t));
+    scope->parent = parent;
+    scope->is_function = is_function;
+
+    /* the variables of enclosing scopes are all declared by now */
+    if (!is_function && parent && parent->parent)
+        scope->frame_base = parent->frame_base + parent->count;
+
+    sema->scope = scope;
 }
 
-static void sema_visit_block(sema_t *sema, node_t *node)
+static sema_scope_t *sema_function_scope(sema_scope_t *scope)
 {
-    for (size_t i = 0; i < node->block.count; i++)
-        sema_visit(sema, node->block.statements[i]);
-} 
+    while (!scope->is_function)
+        scope = scope->parent;
+    return scope;
+}
 
-static void sema_visit_binary(sema_t *sema, node_t *node)
+/* places the variables of the scope and binds their references */
+static sema_scope_t *sema_scope_pop(sema_t *sema)
 {
-    sema_visit(sema, node->binary.left);
-    sema_visit(sema, node->binary.right);
+    sema_scope_t *scope = sema->scope;
+    sema->scope = scope->parent;
+    scope->closed = true;
+
+    /* variables of the global scope are cells */
+    if (!scope->parent) return scope;
+
+    for (size_t i = 0; i < scope->count; i++)
+    {
+        sema_variable_t *variable = &scope->variables[i];
+        variable->index = variable->captured ? scope->env_size++ : scope->frame_base + i;
+    }
+
+    sema_scope_t *function = sema_function_scope(scope);
+    if (function->frame_size < scope->frame_base + scope->count)
+        function->frame_size = scope->frame_base + scope->count;
+
+    for (size_t i = 0; i < scope->reference_count; i++)
+    {
+        sema_reference_t *reference = &scope->references[i];
+        sema_variable_t *variable = &reference->declared->variables[reference->variable];
+        if (!variable->captured)
+        {
+            *reference->binding = (node_binding_t) { NODE_HOPS_LOCAL, variable->index };
+            continue;
+        }
+
+        /* only scopes with captured variables have an env */
+        uint32_t hops = 0;
+        for (sema_scope_t *between = reference->scope; between != reference->declared; between = between->parent)
+            hops += between->env_size > 0;
+        *reference->binding = (node_binding_t) { hops, variable->index };
+    }
+
+    return scope;
 }
 
-static void sema_visit_unary(sema_t *sema, node_t *node)
+/* binds `binding` to a variable of `declared` once both are placed */
+static void sema_reference(sema_t *sema, node_binding_t *binding, sema_scope_t *scope,
+                           sema_scope_t *declared, uint32_t variable)
 {
-    sema_visit(sema, node->unary.right);
+    if (!declared->parent)
+    {
+        *binding = (node_binding_t) { NODE_HOPS_GLOBAL, variable };
+        return;
+    }
+
+    /* a lazily parsed body closes after the scopes around it */
+    sema_scope_t *owner = declared->closed ? sema_function_scope(scope) : declared;
+    owner->references = sema_grow(sema, owner->references, owner->reference_count,
+        &owner->reference_capacity, sizeof(sema_reference_t));
+    owner->references[owner->reference_count++] = (sema_reference_t) {
+        .binding = binding,
+        .scope = scope,
+        .declared = declared,
+        .variable = variable,
+    };
 }
 
-static void sema_visit_assignment(sema_t *sema, node_t *node)
+/* returns the slot of `name`, `var`s and functions may be declared again */
+static uint32_t sema_declare(sema_t *sema, sema_scope_t *scope, atom_t name, node_op_t kind, location_t loc)
 {
-    sema_visit(sema, node->assignment.target);
-    sema_visit(sema, node->assignment.value);
+    for (size_t i = 0; i < scope->count; i++)
+    {
+        sema_variable_t *variable = &scope->variables[i];
+        if (variable->name != name) continue;
+
+        bool let = kind == TOKEN_LET || kind == TOKEN_CONST;
+        if (let || variable->kind == TOKEN_LET || variable->kind == TOKEN_CONST)
+            SEMA_ERROR(sema,
+                "[ERROR] [%s:%zu:%zu]: '%s' has already been declared\n",
+                LOCATION(loc), name);
+        return i;
+    }
+
+    scope->variables = sema_grow(sema, scope->variables, scope->count, &scope->capacity, sizeof(sema_variable_t));
+    scope->variables[scope->count] = (sema_variable_t) { .name = name, .kind = kind };
+    return scope->count++;
 }
 
-static void sema_visit_ternary(sema_t *sema, node_t *node)
+/* declares `name` in the current scope and binds `binding` to it */
+static void sema_declare_binding(sema_t *sema, node_binding_t *binding, atom_t name, node_op_t kind, location_t loc)
 {
-    sema_visit(sema, node->ternary.condition);
-    sema_visit(sema, node->ternary.true_expr);
-    sema_visit(sema, node->ternary.false_expr);
+    uint32_t variable = sema_declare(sema, sema->scope, name, kind, loc);
+    sema_reference(sema, binding, sema->scope, sema->scope, variable);
 }
 
-static void sema_visit_if(sema_t *sema, node_t *node)
+/*
+ * Whether a use in the current scope of a variable declared in `declared`
+ * can run before the declaration. A function runs no earlier than it is
+ * created, or for a declaration, than its block is entered.
+ */
+static bool sema_before_declaration(const sema_t *sema, const sema_scope_t *declared, uint32_t variable)
 {
-    sema_visit(sema, node->if_stmt.condition);
-    sema_visit(sema, node->if_stmt.then_branch);
-    sema_visit(sema, node->if_stmt.else_branch);
+    uint32_t declared_at = declared->variables[variable].declared_at;
+    if (declared_at == 0) return true;
+
+    for (const sema_scope_t *scope = sema->scope; scope != declared; scope = scope->parent)
+        if (scope->is_function && declared_at > scope->callable_at)
+            return true;
+    return false;
 }
 
-static void sema_visit_while(sema_t *sema, node_t *node)
+/* returns the use of the variable, valid until the next one, NULL if undefined */
+static sema_use_t *sema_resolve(sema_t *sema, flat_index_t identifier)
 {
-    sema->loop_depth++;
-    sema_visit(sema, node->while_stmt.condition);
-    sema_visit(sema, node->while_stmt.body);
-    sema->loop_depth--;
+    const flat_t *flat = sema->flat;
+    atom_t name = flat->atoms[flat->payloads[identifier].a];
+
+    bool crossed = false;
+    for (sema_scope_t *scope = sema->scope; scope; scope = scope->parent)
+    {
+        for (size_t i = 0; i < scope->count; i++)
+        {
+            if (scope->variables[i].name != name) continue;
+
+            if (crossed) scope->variables[i].captured = true;
+
+            /* there is no TDZ, such a read is undefined */
+            if (scope->variables[i].numeric && sema_before_declaration(sema, scope, i))
+                scope->variables[i].numeric = false;
+            sema_reference(sema, &flat->nodes[identifier]->binding, sema->scope, scope, i);
+
+            if (!scope->parent && i == SEMA_BUILTIN_MATH)
+                sema->math_uses++;
+
+            sema->uses = sema_grow(sema, sema->uses, sema->use_count, &sema->use_capacity, sizeof(sema_use_t));
+            sema->uses[sema->use_count] = (sema_use_t) { identifier, scope, i };
+            return &sema->uses[sema->use_count++];
+        }
+
+        /* leaving a function, its enclosing variables are captured */
+        crossed = crossed || scope->is_function;
+    }
+
+    SEMA_ERROR(sema,
+        "[ERROR] [%s:%zu:%zu]: '%s' is not defined\n",
+        LOCATION(FLAT_LOCATION(flat, identifier)), name);
+    return NULL;
 }
 
-static void sema_visit_do_while(sema_t *sema, node_t *node)
+/* records that `value` is stored into the variable of `use` by `op` */
+static void sema_write(sema_t *sema, const sema_use_t *use, flat_index_t value, node_op_t op)
 {
-    sema->loop_depth++;
-    sema_visit(sema, node->do_while_stmt.body);
-    sema_visit(sema, node->do_while_stmt.condition);
-    sema->loop_depth--;
+    if (!use) return;
+
+    sema->writes = sema_grow(sema, sema->writes, sema->write_count, &sema->write_capacity, sizeof(sema_write_t));
+    sema->writes[sema->write_count++] = (sema_write_t) {
+        .scope = use->scope,
+        .variable = use->variable,
+        .value = value,
+        .op = op,
+    };
 }
 
-static void sema_visit_for(sema_t *sema, node_t *node)
+/*
+ * Declares the `var`s in [start, end) in the function scope. Only statements
+ * hold declarations and nodes are in pre-order, so this is a scan that skips
+ * nested functions, which keep theirs, by jumping to their end.
+ */
+static void sema_hoist(sema_t *sema, flat_index_t start, flat_index_t end)
 {
-    sema->loop_depth++;
-    sema_visit(sema, node->for_stmt.init);
-    sema_visit(sema, node->for_stmt.condition);
-    sema_visit(sema, node->for_stmt.increment);
-    sema_visit(sema, node->for_stmt.body);
-    sema->loop_depth--;
+    const flat_t *flat = sema->flat;
+    sema_scope_t *scope = sema_function_scope(sema->scope);
+
+    for (flat_index_t index = start; index < end; )
+    {
+        if (flat->kinds[index] == NODE_FUNCTION)
+        {
+            index = flat->ends[index];
+            continue;
+        }
+
+        if (flat->kinds[index] == NODE_DECLARATION && flat->ops[index] == TOKEN_VAR)
+        {
+            flat_payload_t payload = flat->payloads[index];
+            for (size_t i = 0; i < payload.b; i++)
+            {
+                flat_index_t name = flat->lists[payload.a + 2 * i];
+                sema_declare(sema, scope, flat->atoms[flat->payloads[name].a], TOKEN_VAR,
+                    FLAT_LOCATION(flat, name));
+            }
+        }
+        index++;
+    }
+}
+
+/* declares what a statement binds in the current scope, `var`s are hoisted */
+static void sema_declare_statement(sema_t *sema, flat_index_t index)
+{
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+
+    switch (flat->kinds[index])
+    {
+        case NODE_DECLARATION:
+            if (flat->ops[index] == TOKEN_VAR) break;
+            for (size_t i = 0; i < payload.b; i++)
+            {
+                flat_index_t name = flat->lists[payload.a + 2 * i];
+                uint32_t variable = sema_declare(sema, sema->scope, flat->atoms[flat->payloads[name].a],
+                    flat->ops[index], FLAT_LOCATION(flat, name));
+
+                /* until a read before the declaration or a write says otherwise */
+                sema->scope->variables[variable].numeric = true;
+            }
+            break;
+
+        case NODE_FUNCTION:
+        {
+            atom_t name = FLAT_ATOM(flat, flat->lists[payload.b]);
+            if (!name) break;
+
+            node_t *node = flat->nodes[index];
+            node->function.is_declaration = true;
+            sema_declare_binding(sema, &node->function.binding, name, TOKEN_FUNCTION, FLAT_LOCATION(flat, index));
+            break;
+        }
+
+        case NODE_EXPORT:
+            if (payload.a != FLAT_NONE)
+                sema_declare_statement(sema, payload.a);
+            break;
+
+        case NODE_IMPORT:
+        {
+            /* the module, the default name, then the imported names */
+            for (size_t i = 1; i < 2 + payload.b; i++)
+            {
+                flat_index_t text = flat->lists[payload.a + i];
+                if (text != FLAT_NONE)
+                    sema_declare(sema, sema->scope, atom_from_cstr(flat->chars + text), TOKEN_CONST,
+                        FLAT_LOCATION(flat, index));
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void sema_visit(sema_t *sema, flat_index_t index);
+
+/* visits the `count` nodes listed from `start` */
+static void sema_visit_list(sema_t *sema, flat_index_t start, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        sema_visit(sema, sema->flat->lists[start + i]);
+}
+
+static void sema_visit_program(sema_t *sema, flat_index_t index)
+{
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+
+    sema_scope_push(sema, true);
+    for (size_t i = 0; i < SEMA_BUILTIN_COUNT; i++)
+        sema_declare(sema, sema->scope, atom_from_cstr(sema_builtins[i]), TOKEN_CONST, FLAT_LOCATION(flat, index));
+    sema->scope->variables[SEMA_BUILTIN_INFINITY].numeric = true;
+    sema->scope->variables[SEMA_BUILTIN_NAN].numeric = true;
+
+    sema_hoist(sema, index + 1, flat->ends[index]);
+    for (size_t i = 0; i < payload.b; i++)
+        sema_declare_statement(sema, flat->lists[payload.a + i]);
+    sema->hoisted_at = sema->declarations;
+
+    sema_visit_list(sema, payload.a, payload.b);
+
+    node_t *node = flat->nodes[index];
+    sema_scope_t *scope = sema_scope_pop(sema);
+    node->program.slot_count = scope->count;
+    node->program.frame_size = scope->frame_size;
+}
+
+/* whether a statement declares a variable in its block, `var`s are hoisted */
+static bool sema_declares(const flat_t *flat, flat_index_t index)
+{
+    flat_payload_t payload = flat->payloads[index];
+    switch (flat->kinds[index])
+    {
+        case NODE_DECLARATION: return flat->ops[index] != TOKEN_VAR;
+        case NODE_FUNCTION: return flat->lists[payload.b] != FLAT_NONE;
+        case NODE_IMPORT: return true;
+        case NODE_EXPORT: return payload.a != FLAT_NONE && sema_declares(flat, payload.a);
+        default: return false;
+    }
+}
+
+static void sema_visit_block(sema_t *sema, flat_index_t index)
+{
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+    node_t *node = flat->nodes[index];
+
+    node->block.scoped = false;
+    for (size_t i = 0; i < payload.b && !node->block.scoped; i++)
+        node->block.scoped = sema_declares(flat, flat->lists[payload.a + i]);
+
+    if (!node->block.scoped)
+    {
+        node->block.env_size = 0;
+        sema_visit_list(sema, payload.a, payload.b);
+        return;
+    }
+
+    sema_scope_push(sema, false);
+    for (size_t i = 0; i < payload.b; i++)
+        sema_declare_statement(sema, flat->lists[payload.a + i]);
+
+    uint32_t prev_hoisted_at = sema->hoisted_at;
+    sema->hoisted_at = sema->declarations;
+    sema_visit_list(sema, payload.a, payload.b);
+    sema->hoisted_at = prev_hoisted_at;
+    node->block.env_size = sema_scope_pop(sema)->env_size;
+}
+
+static void sema_visit_binary(sema_t *sema, flat_index_t index)
+{
+    flat_payload_t payload = sema->flat->payloads[index];
+    sema_visit(sema, payload.a);
+    sema_visit(sema, payload.b);
+}
+
+/* visits what `index` is stored into, returns the use if it is a variable */
+static sema_use_t *sema_visit_target(sema_t *sema, flat_index_t index)
+{
+    if (index == FLAT_NONE) return NULL;
+
+    switch (sema->flat->kinds[index])
+    {
+        case NODE_IDENTIFIER:
+            return sema_resolve(sema, index);
+
+        /* not a read of `Math.name`, the object may be changed */
+        case NODE_MEMBER:
+            sema_visit(sema, sema->flat->payloads[index].a);
+            return NULL;
+
+        default:
+            sema_visit(sema, index);
+            return NULL;
+    }
+}
+
+static void sema_visit_unary(sema_t *sema, flat_index_t index)
+{
+    sema_visit_target(sema, sema->flat->payloads[index].a);
+}
+
+static void sema_visit_assignment(sema_t *sema, flat_index_t index)
+{
+    flat_payload_t payload = sema->flat->payloads[index];
+
+    sema_use_t use, *target = sema_visit_target(sema, payload.a);
+    if (target) use = *target;
+
+    sema_visit(sema, payload.b);
+    if (target) sema_write(sema, &use, payload.b, sema->flat->ops[index]);
+}
+
+static void sema_visit_ternary(sema_t *sema, flat_index_t index)
+{
+    flat_payload_t payload = sema->flat->payloads[index];
+    sema_visit(sema, payload.a);
+    sema_visit(sema, payload.b);
+    sema_visit(sema, payload.c);
 }
 
-static void sema_visit_call(sema_t *sema, node_t *node)
+static void sema_visit_while(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->call.callee);
-    for (size_t i = 0; i < node->call.arg_count; i++)
-        sema_visit(sema, node->call.args[i]);
+    flat_payload_t payload = sema->flat->payloads[index];
+    sema->loop_depth++;
+    sema_visit(sema, payload.a);
+    sema_visit(sema, payload.b);
+    sema->loop_depth--;
 }
 
-static void sema_visit_index(sema_t *sema, node_t *node)
+static void sema_visit_for(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->index.array);
-    sema_visit(sema, node->index.index);
+    const flat_t *flat = sema->flat;
+    flat_index_t parts = flat->payloads[index].a;
+    flat_index_t init = flat->lists[parts];
+
+    bool scoped = init != FLAT_NONE && flat->kinds[init] == NODE_DECLARATION && flat->ops[init] != TOKEN_VAR;
+    if (scoped)
+    {
+        sema_scope_push(sema, false);
+        sema_declare_statement(sema, init);
+    }
+
+    /* init, condition, increment and body */
+    sema->loop_depth++;
+    sema_visit_list(sema, parts, 4);
+    sema->loop_depth--;
+
+    flat->nodes[index]->for_stmt.env_size = scoped ? sema_scope_pop(sema)->env_size : 0;
 }
 
-static void sema_visit_member(sema_t *sema, node_t *node)
+static void sema_visit_call(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->member.object);
+    flat_payload_t payload = sema->flat->payloads[index];
+    sema_visit(sema, payload.a);
+    sema_visit_list(sema, payload.b, payload.c);
 }
 
-static void sema_visit_postfix(sema_t *sema, node_t *node)
+static void sema_visit_member(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->postfix.left);
+    flat_index_t object = sema->flat->payloads[index].a;
+    if (sema->flat->kinds[object] != NODE_IDENTIFIER)
+    {
+        sema_visit(sema, object);
+        return;
+    }
+
+    sema_use_t *use = sema_resolve(sema, object);
+    if (use && !use->scope->parent && use->variable == SEMA_BUILTIN_MATH)
+        sema->math_reads++;
 }
 
-static void sema_visit_function(sema_t *sema, node_t *node)
+static void sema_visit_function(sema_t *sema, flat_index_t index)
 {
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+    node_t *node = flat->nodes[index];
+
+    if (!node->function.is_declaration)
+        node->function.binding = (node_binding_t) { NODE_HOPS_LOCAL, NODE_SLOT_NONE };
+
+    /*
+     * Checked with this scope once the body is parsed. Until then it is not
+     * known what the body uses, so every variable it can see is captured.
+     */
+    if (payload.a == FLAT_NONE)
+    {
+        node->function.scope = sema->scope;
+        for (sema_scope_t *scope = sema->scope; scope; scope = scope->parent)
+        {
+            for (size_t i = 0; i < scope->count; i++)
+            {
+                if (scope->parent) scope->variables[i].captured = true;
+                scope->variables[i].numeric = false;
+            }
+        }
+        sema->lazy_bodies = true;
+        return;
+    }
+
     bool prev_async = sema->in_async_function;
-    sema->in_async_function = node->function.is_async;
+    size_t prev_loop_depth = sema->loop_depth;
+    size_t prev_switch_depth = sema->switch_depth;
+    size_t prev_try_depth = sema->try_depth;
+    sema->in_async_function = flat->lists[payload.b + 1];
+    sema->loop_depth = 0;
+    sema->switch_depth = 0;
+    sema->try_depth = 0;
+
+    /* (name, default value, rest) per parameter */
+    atom_t name = FLAT_ATOM(flat, flat->lists[payload.b]);
+    const flat_index_t *params = &flat->lists[payload.b + 2];
+
+    sema_scope_push(sema, true);
+    sema->scope->callable_at = node->function.is_declaration ? sema->hoisted_at : sema->declarations;
+    for (size_t i = 0; i < payload.c; i++)
+        sema_declare_binding(sema, &node->function.params[i].binding, flat->atoms[params[3 * i]], TOKEN_VAR,
+            FLAT_LOCATION(flat, index));
+
+    /* a parameter of the same name hides a named expression */
+    bool shadowed = false;
+    for (size_t i = 0; i < payload.c; i++)
+        shadowed = shadowed || flat->atoms[params[3 * i]] == name;
+    if (!node->function.is_declaration && name && !shadowed)
+        sema_declare_binding(sema, &node->function.binding, name, TOKEN_FUNCTION, FLAT_LOCATION(flat, index));
 
-    for (size_t i = 0; i < node->function.param_count; i++)
-        ; /* no symbol table logic for now */
+    sema_hoist(sema, payload.a, flat->ends[payload.a]);
+
+    for (size_t i = 0; i < payload.c; i++)
+        sema_visit(sema, params[3 * i + 1]);
+    sema_visit(sema, payload.a);
+
+    sema_scope_t *scope = sema_scope_pop(sema);
+    node->function.frame_size = scope->frame_size;
+    node->function.env_size = scope->env_size;
 
-    sema_visit(sema, node->function.body);
     sema->in_async_function = prev_async;
+    sema->loop_depth = prev_loop_depth;
+    sema->switch_depth = prev_switch_depth;
+    sema->try_depth = prev_try_depth;
+}
+
+static void sema_visit_declaration(sema_t *sema, flat_index_t index)
+{
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+
+    for (size_t i = 0; i < payload.b; i++)
+    {
+        flat_index_t value = flat->lists[payload.a + 2 * i + 1];
+        sema_use_t *name = sema_resolve(sema, flat->lists[payload.a + 2 * i]);
+        if (!name || flat->ops[index] == TOKEN_VAR)
+        {
+            sema_visit(sema, value);
+            continue;
+        }
+
+        /* `let x;` holds undefined until assigned */
+        sema_use_t use = *name;
+        if (value == FLAT_NONE) use.scope->variables[use.variable].numeric = false;
+
+        sema_visit(sema, value);
+        if (value != FLAT_NONE) sema_write(sema, &use, value, TOKEN_EQUAL);
+        use.scope->variables[use.variable].declared_at = ++sema->declarations;
+    }
 }
 
-static void sema_visit_declaration(sema_t *sema, node_t *node)
+static void sema_visit_switch(sema_t *sema, flat_index_t index)
 {
-    for (size_t i = 0; i < node->declaration.count; i++)
-        sema_visit(sema, node->declaration.values ? node->declaration.values[i] : NULL);
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
+
+    sema_visit(sema, payload.a);
+
+    /* (default, body, count, labels...) per case */
+    sema->switch_depth++;
+    flat_index_t at = payload.b;
+    for (size_t i = 0; i < payload.c; i++)
+    {
+        flat_index_t count = flat->lists[at + 2];
+        sema_visit_list(sema, at + 3, count);
+        sema_visit(sema, flat->lists[at + 1]);
+        at += 3 + count;
+    }
+    sema->switch_depth--;
 }
 
-static void sema_visit_await(sema_t *sema, node_t *node)
+static void sema_visit_await(sema_t *sema, flat_index_t index)
 {
     if (!sema->in_async_function)
         SEMA_ERROR(sema,
             "[ERROR] [%s:%zu:%zu]: 'await' can only be used inside async functions\n",
-            node->loc.filename, node->loc.line, node->loc.column);
-    sema_visit(sema, node->await_expr.argument);
+            LOCATION(FLAT_LOCATION(sema->flat, index)));
+    sema_visit(sema, sema->flat->payloads[index].a);
 }
 
-static void sema_visit_break(sema_t *sema, node_t *node)
+static void sema_visit_break(sema_t *sema, flat_index_t index)
 {
-    if (sema->loop_depth == 0)
+    if (sema->loop_depth == 0 && sema->switch_depth == 0)
         SEMA_ERROR(sema,
             "[ERROR] [%s:%zu:%zu]: break not in loop\n",
-            node->loc.filename, node->loc.line, node->loc.column);
+            LOCATION(FLAT_LOCATION(sema->flat, index)));
 }
 
-static void sema_visit_continue(sema_t *sema, node_t *node)
+static void sema_visit_continue(sema_t *sema, flat_index_t index)
 {
     if (sema->loop_depth == 0)
         SEMA_ERROR(sema,
             "[ERROR] [%s:%zu:%zu]: continue not in loop\n",
-            node->loc.filename, node->loc.line, node->loc.column);
+            LOCATION(FLAT_LOCATION(sema->flat, index)));
 }
 
-static void sema_visit_throw(sema_t *sema, node_t *node)
+static void sema_visit_try(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->throw_stmt.value);
-}
+    const flat_t *flat = sema->flat;
+    flat_index_t parts = flat->payloads[index].a;
+    node_t *node = flat->nodes[index];
+
+    /* try, catch parameter atom, catch and finally */
+    flat_index_t finally_block = flat->lists[parts + 3];
+    atom_t catch_param = FLAT_ATOM(flat, flat->lists[parts + 1]);
+
+    sema->try_depth++;
+    sema_visit(sema, flat->lists[parts]);
+    sema->try_depth--;
+
+    /* the call must finish before the `finally` runs */
+    bool finally = finally_block != FLAT_NONE;
+    sema->try_depth += finally;
+    if (catch_param)
+    {
+        sema_scope_push(sema, false);
+        sema_declare_binding(sema, &node->try_stmt.catch_binding, catch_param, TOKEN_LET, FLAT_LOCATION(flat, index));
+        sema_visit(sema, flat->lists[parts + 2]);
+        node->try_stmt.catch_env_size = sema_scope_pop(sema)->env_size;
+    }
+    else
+    {
+        sema_visit(sema, flat->lists[parts + 2]);
+    }
+    sema->try_depth -= finally;
 
-static void sema_visit_try(sema_t *sema, node_t *node)
-{
-    sema_visit(sema, node->try_stmt.try_block);
-    sema_visit(sema, node->try_stmt.catch_block);
-    sema_visit(sema, node->try_stmt.finally_block);
+    sema_visit(sema, finally_block);
 }
 
-static void sema_visit_return(sema_t *sema, node_t *node)
+/* flags the calls whose result is returned as is */
+static void sema_tail(const flat_t *flat, flat_index_t index)
 {
-    sema_visit(sema, node->return_stmt.value);
-}
+    if (index == FLAT_NONE) return;
 
-static void sema_visit_identifier(sema_t *sema, node_t *node)
-{
-    (void)sema; (void)node;
-}
+    switch (flat->kinds[index])
+    {
+        case NODE_CALL:
+            flat->nodes[index]->flags |= NODE_FLAG_TAIL_CALL;
+            break;
 
-static void sema_visit_array(sema_t *sema, node_t *node)
-{
-    for (size_t i = 0; i < node->array.count; i++)
-        sema_visit(sema, node->array.elements[i]);
+        case NODE_TERNARY:
+            sema_tail(flat, flat->payloads[index].b);
+            sema_tail(flat, flat->payloads[index].c);
+            break;
+
+        default:
+            break;
+    }
 }
 
-static void sema_visit_object(sema_t *sema, node_t *node)
+static void sema_visit_return(sema_t *sema, flat_index_t index)
 {
-    for (size_t i = 0; i < node->object.count; i++)
-        sema_visit(sema, node->object.values[i]);
+    flat_index_t value = sema->flat->payloads[index].a;
+    sema_visit(sema, value);
+
+    /* a `try` or an async function still has work after the call returns */
+    bool in_function = sema_function_scope(sema->scope)->parent != NULL;
+    if (in_function && sema->try_depth == 0 && !sema->in_async_function)
+        sema_tail(sema->flat, value);
 }
 
-static void sema_visit_spread(sema_t *sema, node_t *node)
+static void sema_visit_object(sema_t *sema, flat_index_t index)
 {
-    sema_visit(sema, node->spread.argument);
+    flat_payload_t payload = sema->flat->payloads[index];
+
+    /* (key atom, value) pairs */
+    for (size_t i = 0; i < payload.b; i++)
+        sema_visit(sema, sema->flat->lists[payload.a + 2 * i + 1]);
 }
 
-static void sema_visit(sema_t *sema, node_t *node)
+static void sema_visit(sema_t *sema, flat_index_t index)
 {
-    static_assert(NODE_COUNT == 37, "Fix NODE_COUNT in 'sema_visit'");
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'sema_visit'");
+
+    if (index == FLAT_NONE) return;
 
-    if (!node) return;
+    const flat_t *flat = sema->flat;
+    flat_payload_t payload = flat->payloads[index];
 
-    switch (node->type)
+    switch (flat->kinds[index])
     {
         case NODE_NUMBER:
         case NODE_STRING:
         case NODE_BOOL:
         case NODE_UNDEFINED:
         case NODE_NULL:
-        case NODE_THIS: break;
-
-        case NODE_IDENTIFIER: sema_visit_identifier(sema, node); break;
-        case NODE_ARRAY: sema_visit_array(sema, node); break;
-        case NODE_OBJECT: sema_visit_object(sema, node); break;
-        case NODE_SPREAD: sema_visit_spread(sema, node); break;
-        case NODE_PROGRAM: sema_visit_program(sema, node); break;
-        case NODE_BLOCK: sema_visit_block(sema, node); break;
-        case NODE_BINARY: sema_visit_binary(sema, node); break;
-        case NODE_UNARY: sema_visit_unary(sema, node); break;
-        case NODE_ASSIGNMENT: sema_visit_assignment(sema, node); break;
-        case NODE_TERNARY: sema_visit_ternary(sema, node); break;
-        case NODE_IF: sema_visit_if(sema, node); break;
-        case NODE_WHILE: sema_visit_while(sema, node); break;
-        case NODE_DO_WHILE: sema_visit_do_while(sema, node); break;
-        case NODE_FOR: sema_visit_for(sema, node); break;
-        case NODE_CALL: sema_visit_call(sema, node); break;
-        case NODE_INDEX: sema_visit_index(sema, node); break;
-        case NODE_MEMBER: sema_visit_member(sema, node); break;
-        case NODE_POSTFIX: sema_visit_postfix(sema, node); break;
-        case NODE_FUNCTION: sema_visit_function(sema, node); break;
-        case NODE_DECLARATION: sema_visit_declaration(sema, node); break;
-        case NODE_BREAK: sema_visit_break(sema, node); break;
-        case NODE_CONTINUE: sema_visit_continue(sema, node); break;
-        case NODE_THROW: sema_visit_throw(sema, node); break;
-        case NODE_TRY: sema_visit_try(sema, node); break;
-        case NODE_RETURN: sema_visit_return(sema, node); break;
-        case NODE_AWAIT: sema_visit_await(sema, node); break;
+        case NODE_THIS:
+        case NODE_DEBUGGER:
+        case NODE_IMPORT: break;
+
+        case NODE_IDENTIFIER: sema_resolve(sema, index); break;
+        case NODE_ARRAY: sema_visit_list(sema, payload.a, payload.b); break;
+        case NODE_OBJECT: sema_visit_object(sema, index); break;
+        case NODE_SPREAD: sema_visit(sema, payload.a); break;
+        case NODE_PROGRAM: sema_visit_program(sema, index); break;
+        case NODE_BLOCK: sema_visit_block(sema, index); break;
+        case NODE_BINARY: sema_visit_binary(sema, index); break;
+        case NODE_UNARY: sema_visit_unary(sema, index); break;
+        case NODE_ASSIGNMENT: sema_visit_assignment(sema, index); break;
+        case NODE_TERNARY: sema_visit_ternary(sema, index); break;
+        case NODE_IF: sema_visit_ternary(sema, index); break;
+        case NODE_WHILE: sema_visit_while(sema, index); break;
+        case NODE_DO_WHILE: sema_visit_while(sema, index); break;
+        case NODE_FOR: sema_visit_for(sema, index); break;
+        case NODE_CALL: sema_visit_call(sema, index); break;
+        case NODE_INDEX: sema_visit_binary(sema, index); break;
+        case NODE_MEMBER: sema_visit_member(sema, index); break;
+        case NODE_POSTFIX: sema_visit_target(sema, payload.a); break;
+        case NODE_FUNCTION: sema_visit_function(sema, index); break;
+        case NODE_DECLARATION: sema_visit_declaration(sema, index); break;
+        case NODE_BREAK: sema_visit_break(sema, index); break;
+        case NODE_CONTINUE: sema_visit_continue(sema, index); break;
+        case NODE_THROW: sema_visit(sema, payload.a); break;
+        case NODE_TRY: sema_visit_try(sema, index); break;
+        case NODE_RETURN: sema_visit_return(sema, index); break;
+        case NODE_AWAIT: sema_visit_await(sema, index); break;
+        case NODE_SWITCH: sema_visit_switch(sema, index); break;
+        case NODE_LABEL: sema_visit(sema, payload.b); break;
+        case NODE_NEW: sema_visit(sema, payload.a); break;
+        case NODE_EXPORT: sema_visit(sema, payload.a); break;
 
         case NODE_EMPTY: break;
         default: break;
     }
+
+    /* the operands are visited first, so they precede the node */
+    switch (flat->kinds[index])
+    {
+        case NODE_BINARY:
+        case NODE_UNARY:
+        case NODE_POSTFIX:
+        case NODE_ASSIGNMENT:
+        case NODE_TERNARY:
+        case NODE_CALL:
+        case NODE_MEMBER:
+            sema->expressions = sema_grow(sema, sema->expressions, sema->expression_count,
+                &sema->expression_capacity, sizeof(flat_index_t));
+            sema->expressions[sema->expression_count++] = index;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static const char *sema_math_constants[] = { "PI", "E", "PHI", NULL };
+static const char *sema_math_functions[] = {
+    "sin", "cos", "tan", "asin", "acos", "atan", "sqrt", "log", "exp",
+    "abs", "floor", "ceil", "min", "max", "sign", "random", NULL,
+};
+
+/* whether the member at `index` is `Math.name` for one of `names` */
+static bool sema_math_member(const flat_t *flat, flat_index_t index, const char **names)
+{
+    flat_payload_t payload = flat->payloads[index];
+    if (flat->kinds[payload.a] != NODE_IDENTIFIER) return false;
+
+    /* global bindings are set as soon as they are resolved */
+    node_binding_t binding = flat->nodes[payload.a]->binding;
+    if (binding.hops != NODE_HOPS_GLOBAL || binding.slot != SEMA_BUILTIN_MATH) return false;
+
+    atom_t property = flat->atoms[flat->payloads[payload.b].a];
+    for (size_t i = 0; names[i]; i++)
+        if (strcmp(property, names[i]) == 0)
+            return true;
+    return false;
+}
+
+/* whether assigning a value by `op` stores a number, given whether the target and the value are */
+static bool sema_assigns_number(node_op_t op, bool target, bool number)
+{
+    switch (op)
+    {
+        case TOKEN_EQUAL: return number;
+
+        case TOKEN_PLUS_EQUAL:
+        case TOKEN_LOGICAL_AND_EQUAL:
+        case TOKEN_LOGICAL_OR_EQUAL:
+            return target && number;
+
+        /* the other operators convert their operands to numbers */
+        default: return true;
+    }
+}
+
+/* whether the node at `index` evaluates to a number, given the flags of its operands */
+static bool sema_numeric(const flat_t *flat, flat_index_t index, bool math)
+{
+    static_assert(NODE_COUNT == 39, "Fix NODE_COUNT in 'sema_numeric'");
+
+    flat_payload_t payload = flat->payloads[index];
+    const uint8_t *flags = flat->flags;
+
+    switch (flat->kinds[index])
+    {
+        case NODE_BINARY:
+            switch (flat->ops[index])
+            {
+                case TOKEN_PLUS:
+                case TOKEN_LOGICAL_AND:
+                case TOKEN_LOGICAL_OR:
+                    return flags[payload.a] & flags[payload.b] & NODE_FLAG_NUMBER;
+
+                case TOKEN_MINUS:
+                case TOKEN_STAR:
+                case TOKEN_SLASH:
+                case TOKEN_PERCENT:
+                case TOKEN_STAR_STAR:
+                case TOKEN_AMPERSAND:
+                case TOKEN_PIPE:
+                case TOKEN_CARET:
+                case TOKEN_LEFT_SHIFT:
+                case TOKEN_RIGHT_SHIFT:
+                    return true;
+
+                default:
+                    return false;
+            }
+
+        case NODE_UNARY:
+        {
+            node_op_t op = flat->ops[index];
+            return op == TOKEN_MINUS || op == TOKEN_PLUS || op == TOKEN_TILDE ||
+                   op == TOKEN_PLUS_PLUS || op == TOKEN_MINUS_MINUS;
+        }
+
+        case NODE_POSTFIX:
+            return true;
+
+        case NODE_ASSIGNMENT:
+            return sema_assigns_number(flat->ops[index], flags[payload.a] & NODE_FLAG_NUMBER,
+                flags[payload.b] & NODE_FLAG_NUMBER);
+
+        case NODE_TERNARY:
+            return flags[payload.b] & flags[payload.c] & NODE_FLAG_NUMBER;
+
+        case NODE_MEMBER:
+            return math && sema_math_member(flat, index, sema_math_constants);
+
+        case NODE_CALL:
+            return math && flat->kinds[payload.a] == NODE_MEMBER &&
+                   sema_math_member(flat, payload.a, sema_math_functions);
+
+        default:
+            return false;
+    }
+}
+
+static void sema_flag(uint8_t *flags, bool number)
+{
+    if (number) *flags |= NODE_FLAG_NUMBER;
+    else *flags &= ~NODE_FLAG_NUMBER;
+}
+
+/*
+ * Flow-insensitive: a `let` or `const` is numeric if every value stored
+ * into it is, assuming so for all of them at first and dropping those with
+ * a write that is not until nothing changes. Then expressions are flagged
+ * from their operands, which the evaluator computes without boxing. This
+ * runs on the flat flags, the tree gets them once they are settled.
+ */
+static void sema_infer(sema_t *sema)
+{
+    flat_t *flat = sema->flat;
+    bool math = !sema->lazy_bodies && sema->math_uses == sema->math_reads;
+
+    bool changed = true;
+    while (changed)
+    {
+        for (size_t i = 0; i < sema->use_count; i++)
+        {
+            sema_use_t *use = &sema->uses[i];
+            sema_flag(&flat->flags[use->identifier], use->scope->variables[use->variable].numeric);
+        }
+
+        for (size_t i = 0; i < sema->expression_count; i++)
+            sema_flag(&flat->flags[sema->expressions[i]], sema_numeric(flat, sema->expressions[i], math));
+
+        changed = false;
+        for (size_t i = 0; i < sema->write_count; i++)
+        {
+            sema_write_t *write = &sema->writes[i];
+            sema_variable_t *variable = &write->scope->variables[write->variable];
+            if (variable->numeric && !sema_assigns_number(write->op, true, flat->flags[write->value] & NODE_FLAG_NUMBER))
+            {
+                variable->numeric = false;
+                changed = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sema->use_count; i++)
+    {
+        flat_index_t identifier = sema->uses[i].identifier;
+        sema_flag(&flat->nodes[identifier]->flags, flat->flags[identifier] & NODE_FLAG_NUMBER);
+    }
+    for (size_t i = 0; i < sema->expression_count; i++)
+    {
+        flat_index_t expression = sema->expressions[i];
+        sema_flag(&flat->nodes[expression]->flags, flat->flags[expression] & NODE_FLAG_NUMBER);
+    }
+
+    /* a lazily parsed body is inferred on its own */
+    sema->write_count = 0;
+    sema->use_count = 0;
+    sema->expression_count = 0;
 }
 
 void sema_analyze(sema_t *sema)
 {
-    sema_visit(sema, sema->program);
+    sema->flat = &sema->program_flat;
+    flat_index_t program = flat_build(sema->flat, sema->program);
+
+    sema_visit(sema, program);
+    sema_infer(sema);
+}
+
+bool sema_analyze_function(sema_t *sema, node_t *function)
+{
+    sema_scope_t *scope = sema->scope;
+    flat_t *prev_flat = sema->flat;
+    bool had_error = sema->had_error;
+
+    /* the body was not in the program's flat tree */
+    flat_t flat;
+    flat_init(&flat);
+    flat_index_t index = flat_build(&flat, function);
+
+    sema->flat = &flat;
+    sema->scope = function->function.scope;
+    sema->had_error = false;
+    sema_visit_function(sema, index);
+    sema_infer(sema);
+
+    bool ok = !sema->had_error;
+    sema->flat = prev_flat;
+    sema->scope = scope;
+    sema->had_error = had_error || !ok;
+    flat_free(&flat);
+    return ok;
 }
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "source.h"
+
+typedef struct source_registry
+{
+    source_t *sources;
+    size_t count;
+    size_t capacity;
+} source_registry_t;
+
+static source_registry_t registry = {0};
+
+static source_id_t source_register(const char *name, const char *data, size_t length, bool mapped)
+{
+    if (length > SOURCE_MAX_LENGTH)
+    {
+        fprintf(stderr, "File too large: %s\n", name);
+        if (mapped)
+            munmap((void *) data, length);
+        else
+            free((void *) data);
+        return SOURCE_NONE;
+    }
+
+    if (registry.count == registry.capacity)
+    {
+        registry.capacity = registry.capacity ? registry.capacity * 2 : 4;
+        registry.sources = realloc(registry.sources, registry.capacity * sizeof(source_t));
+        if (!registry.sources)
+        {
+            ERROR("Realloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    source_t *source = &registry.sources[registry.count++];
+    source->name = strdup(name);
+    source->data = data;
+    source->length = length;
+    source->mapped = mapped;
+    source->lines = NULL;
+    source->line_count = 0;
+
+    /* ids are 1-based, 0 is SOURCE_NONE */
+    return (source_id_t) registry.count;
+}
+
+/* heap fallback for streams which cannot be mapped (stdin, pipes) */
+static char *source_read_stream(FILE *f, size_t *length)
+{
+    size_t capacity = 4096, size = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    size_t read_size;
+    while ((read_size = fread(buffer + size, 1, capacity - size, f)) > 0)
+    {
+        size += read_size;
+        if (size == capacity)
+        {
+            capacity *= 2;
+            char *tmp = realloc(buffer, capacity);
+            if (!tmp)
+            {
+                fprintf(stderr, "Memory allocation failed\n");
+                free(buffer);
+                return NULL;
+            }
+            buffer = tmp;
+        }
+    }
+
+    if (ferror(f))
+    {
+        fprintf(stderr, "Could not read whole file\n");
+        free(buffer);
+        return NULL;
+    }
+
+    *length = size;
+    return buffer;
+}
+
+source_id_t source_load(const char *filename)
+{
+    if (strcmp(filename, "-") == 0)
+    {
+        size_t length = 0;
+        char *data = source_read_stream(stdin, &length);
+        if (!data) return SOURCE_NONE;
+        return source_register(filename, data, length, false);
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open");
+        return SOURCE_NONE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("fstat");
+        close(fd);
+        return SOURCE_NONE;
+    }
+
+    /* empty files and non-regular files cannot be mapped */
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        FILE *f = fdopen(fd, "rb");
+        if (!f)
+        {
+            perror("fdopen");
+            close(fd);
+            return SOURCE_NONE;
+        }
+
+        size_t length = 0;
+        char *data = source_read_stream(f, &length);
+        fclose(f);
+        if (!data) return SOURCE_NONE;
+        return source_register(filename, data, length, false);
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return SOURCE_NONE;
+    }
+
+    /* the lexer reads the source front to back exactly once */
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    return source_register(filename, data, st.st_size, true);
+}
+
+static void source_index_lines(source_t *source)
+{
+    size_t capacity = 64;
+    source->lines = malloc(capacity * sizeof(uint32_t));
+    if (!source->lines)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    source->lines[0] = 0;
+    source->line_count = 1;
+
+    const char *p = source->data;
+    const char *end = source->data + source->length;
+    while ((p = memchr(p, '\n', end - p)) != NULL)
+    {
+        if (source->line_count == capacity)
+        {
+            capacity *= 2;
+            source->lines = realloc(source->lines, capacity * sizeof(uint32_t));
+            if (!source->lines)
+            {
+                ERROR("Realloc failed!\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        source->lines[source->line_count++] = (uint32_t) (++p - source->data);
+    }
+}
+
+/* index of the line containing `offset` */
+static size_t source_find_line(source_t *source, size_t offset)
+{
+    if (!source->lines)
+        source_index_lines(source);
+
+    /* last line start <= offset */
+    size_t low = 0, high = source->line_count;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (source->lines[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+size_t source_line(source_id_t id, size_t offset)
+{
+    if (id == SOURCE_NONE || id > registry.count)
+        return 0;
+    return source_find_line(&registry.sources[id - 1], offset) + 1;
+}
+
+size_t source_column(source_id_t id, size_t offset)
+{
+    if (id == SOURCE_NONE || id > registry.count)
+        return 0;
+    source_t *source = &registry.sources[id - 1];
+    size_t line = source_find_line(source, offset);
+    return offset - source->lines[line] + 1;
+}
+
+source_id_t source_from_string(const char *name, const char *text)
+{
+    /* the caller's buffer may change (REPL), keep a copy */
+    char *data = strdup(text);
+    if (!data) ERROR("Strdup failed!\n");
+
+    return source_register(name ? name : "(null)", data, strlen(data), false);
+}
+
+const source_t *source_get(source_id_t id)
+{
+    if (id == SOURCE_NONE || id > registry.count)
+        return NULL;
+    return &registry.sources[id - 1];
+}
+
+const char *source_name(source_id_t id)
+{
+    const source_t *source = source_get(id);
+    return source ? source->name : "(null)";
+}
+
+void source_free_all(void)
+{
+    for (size_t i = 0; i < registry.count; i++)
+    {
+        source_t *source = &registry.sources[i];
+        if (source->mapped)
+            munmap((void *) source->data, source->length);
+        else
+            free((void *) source->data);
+        free(source->lines);
+        free(source->name);
+    }
+
+    free(registry.sources);
+    registry = (source_registry_t) {0};
+}
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "stack.h"
+#include "utils.h"
+
+void value_stack_init(value_stack_t *stack)
+{
+    stack->values = malloc(VALUE_STACK_CAPACITY * sizeof(value_t));
+    if (!stack->values)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    stack->top = 0;
+    stack->capacity = VALUE_STACK_CAPACITY;
+}
+
+void value_stack_free(value_stack_t *stack)
+{
+    free(stack->values);
+    stack->values = NULL;
+    stack->top = 0;
+    stack->capacity = 0;
+}
+
+value_t *value_stack_push_frame(value_stack_t *stack, size_t size)
+{
+    if (size > stack->capacity - stack->top)
+    {
+        ERROR("Stack overflow, %zu values in use\n", stack->top);
+        exit(EXIT_FAILURE);
+    }
+
+    value_t *frame = stack->values + stack->top;
+    for (size_t i = 0; i < size; i++)
+        frame[i] = value_undefined();
+
+    stack->top += size;
+    return frame;
+}
+
+void value_stack_pop_frame(value_stack_t *stack, size_t size)
+{
+    assert(size <= stack->top);
+    stack->top -= size;
+}
@@ -3,7 +3,7 @@
 
 const char *token_type_to_string(token_type_t type)
 {
-    static_assert(TOKEN_COUNT == 86, "Fix TOKEN_COUNT in 'token_type_to_string'");
+    static_assert(TOKEN_COUNT == 88, "Fix TOKEN_COUNT in 'token_type_to_string'");
 
     switch (type)
     {
@@ -37,6 +37,8 @@ const char *token_type_to_string(token_type_t type)
         case TOKEN_DELETE: return "DELETE";
         case TOKEN_THIS: return "THIS";
         case TOKEN_VOID: return "VOID";
+        case TOKEN_NEW: return "NEW";
+        case TOKEN_DEBUGGER: return "DEBUGGER";
 
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
         case TOKEN_BOOL_LITERAL: return "BOOL_LITERAL";
@@ -107,3 +109,104 @@ const char *token_type_to_string(token_type_t type)
         default: return "UNKNOWN";
     }
 }
+
+const char *token_type_to_lexeme(token_type_t type)
+{
+    static_assert(TOKEN_COUNT == 88, "Fix TOKEN_COUNT in 'token_type_to_lexeme'");
+
+    switch (type)
+    {
+        case TOKEN_IF: return "if";
+        case TOKEN_ELSE: return "else";
+        case TOKEN_WHILE: return "while";
+        case TOKEN_DO: return "do";
+        case TOKEN_FOR: return "for";
+        case TOKEN_FUNCTION: return "function";
+        case TOKEN_SWITCH: return "switch";
+        case TOKEN_CASE: return "case";
+        case TOKEN_DEFAULT: return "default";
+        case TOKEN_LET: return "let";
+        case TOKEN_CONST: return "const";
+        case TOKEN_VAR: return "var";
+        case TOKEN_NULL: return "null";
+        case TOKEN_UNDEFINED: return "undefined";
+        case TOKEN_RETURN: return "return";
+        case TOKEN_BREAK: return "break";
+        case TOKEN_CONTINUE: return "continue";
+        case TOKEN_IMPORT: return "import";
+        case TOKEN_EXPORT: return "export";
+        case TOKEN_TRY: return "try";
+        case TOKEN_CATCH: return "catch";
+        case TOKEN_FINALLY: return "finally";
+        case TOKEN_THROW: return "throw";
+        case TOKEN_TYPEOF: return "typeof";
+        case TOKEN_ASYNC: return "async";
+        case TOKEN_AWAIT: return "await";
+        case TOKEN_FROM: return "from";
+        case TOKEN_DELETE: return "delete";
+        case TOKEN_THIS: return "this";
+        case TOKEN_VOID: return "void";
+        case TOKEN_NEW: return "new";
+        case TOKEN_DEBUGGER: return "debugger";
+
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_STAR: return "*";
+        case TOKEN_SLASH: return "/";
+        case TOKEN_PERCENT: return "%";
+        case TOKEN_AMPERSAND: return "&";
+        case TOKEN_PIPE: return "|";
+        case TOKEN_CARET: return "^";
+        case TOKEN_TILDE: return "~";
+        case TOKEN_LEFT_SHIFT: return "<<";
+        case TOKEN_RIGHT_SHIFT: return ">>";
+        case TOKEN_STAR_STAR: return "**";
+
+        case TOKEN_PLUS_PLUS: return "++";
+        case TOKEN_MINUS_MINUS: return "--";
+
+        case TOKEN_EQUAL: return "=";
+        case TOKEN_PLUS_EQUAL: return "+=";
+        case TOKEN_MINUS_EQUAL: return "-=";
+        case TOKEN_STAR_EQUAL: return "*=";
+        case TOKEN_SLASH_EQUAL: return "/=";
+        case TOKEN_PERCENT_EQUAL: return "%=";
+        case TOKEN_STAR_STAR_EQUAL: return "**=";
+        case TOKEN_AMPERSAND_EQUAL: return "&=";
+        case TOKEN_PIPE_EQUAL: return "|=";
+        case TOKEN_CARET_EQUAL: return "^=";
+        case TOKEN_LEFT_SHIFT_EQUAL: return "<<=";
+        case TOKEN_RIGHT_SHIFT_EQUAL: return ">>=";
+        case TOKEN_LOGICAL_AND_EQUAL: return "&&=";
+        case TOKEN_LOGICAL_OR_EQUAL: return "||=";
+
+        case TOKEN_EQUAL_EQUAL: return "==";
+        case TOKEN_BANG_EQUAL: return "!=";
+        case TOKEN_LESS: return "<";
+        case TOKEN_GREATER: return ">";
+        case TOKEN_LESS_EQUAL: return "<=";
+        case TOKEN_GREATER_EQUAL: return ">=";
+
+        case TOKEN_LOGICAL_AND: return "&&";
+        case TOKEN_LOGICAL_OR: return "||";
+        case TOKEN_BANG: return "!";
+
+        case TOKEN_LEFT_PAREN: return "(";
+        case TOKEN_RIGHT_PAREN: return ")";
+        case TOKEN_LEFT_BRACKET: return "[";
+        case TOKEN_RIGHT_BRACKET: return "]";
+        case TOKEN_LEFT_BRACE: return "{";
+        case TOKEN_RIGHT_BRACE: return "}";
+
+        case TOKEN_DOT: return ".";
+        case TOKEN_COMMA: return ",";
+        case TOKEN_SEMICOLON: return ";";
+        case TOKEN_COLON: return ":";
+        case TOKEN_QUESTION: return "?";
+        case TOKEN_ARROW: return "=>";
+        case TOKEN_ELLIPSIS: return "...";
+
+        /* literals and special tokens have no fixed spelling */
+        default: return "";
+    }
+}
@@ -0,0 +1,988 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "trace.h"
+#include "runtime.h"
+
+#if JIT_AVAILABLE
+
+#include <stddef.h>
+
+#include "assembler.h"
+
+/* the VM's registers, as in the code of `jit_compile` */
+#define TRACE_SP ASM_RBX
+#define TRACE_BASE ASM_R12
+#define TRACE_GLOBALS ASM_R13
+#define TRACE_STATE ASM_R14
+
+/* numbers live in 16-byte slots of the trace's frame, one for each instruction */
+#define TRACE_SLOT(index) ((int32_t) (index) * 16)
+
+typedef uint32_t (*trace_entry_t)(jit_state_t *state);
+
+/* how the recording of an instruction went */
+typedef enum trace_status
+{
+    TRACE_STEP,             /**< the VM's effect is left to `jit_step` */
+    TRACE_JUMPED,
+    TRACE_CLOSED,           /**< back at the header */
+    TRACE_ABORT,            /**< not run, the VM continues with it */
+} trace_status_t;
+
+static inline uint32_t trace_operand(const uint8_t *ip)
+{
+    uint32_t operand;
+    memcpy(&operand, ip, sizeof(operand));
+    return operand;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Recording                                                                  */
+/* -------------------------------------------------------------------------- */
+
+static bool trace_is_number(const trace_recorder_t *rec, trace_ref_t ref)
+{
+    static_assert(TRACE_COUNT == 15, "Fix TRACE_COUNT in 'trace_is_number'");
+    switch (rec->ins[ref].op)
+    {
+        case TRACE_NUMBER:
+        case TRACE_LOAD:
+        case TRACE_ADD:
+        case TRACE_SUB:
+        case TRACE_MUL:
+        case TRACE_DIV:
+        case TRACE_MOD:
+        case TRACE_NEG:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static trace_ref_t trace_append(trace_recorder_t *rec, const trace_ins_t *ins)
+{
+    assert(rec->count < TRACE_MAX_LENGTH);
+    trace_ins_t *appended = &rec->ins[rec->count];
+    *appended = *ins;
+    appended->invariant = false;
+    appended->live = false;
+    return (trace_ref_t) rec->count++;
+}
+
+static trace_ref_t trace_number(trace_recorder_t *rec, number_t number)
+{
+    for (size_t i = 0; i < rec->count; i++)
+    {
+        const trace_ins_t *ins = &rec->ins[i];
+        if (ins->op == TRACE_NUMBER && ins->number == number && signbit(ins->number) == signbit(number))
+            return (trace_ref_t) i;
+    }
+    return trace_append(rec, &(trace_ins_t) { .op = TRACE_NUMBER, .left = TRACE_NONE, .right = TRACE_NONE, .number = number });
+}
+
+static trace_ref_t trace_bool(trace_recorder_t *rec, bool boolean)
+{
+    for (size_t i = 0; i < rec->count; i++)
+        if (rec->ins[i].op == TRACE_BOOL && rec->ins[i].boolean == boolean)
+            return (trace_ref_t) i;
+    return trace_append(rec, &(trace_ins_t) { .op = TRACE_BOOL, .left = TRACE_NONE, .right = TRACE_NONE, .boolean = boolean });
+}
+
+/* constant operands are folded, the operation of the VM on the same numbers */
+static trace_ref_t trace_fold(trace_recorder_t *rec, trace_op_t op, trace_ref_t left, trace_ref_t right)
+{
+    const trace_ins_t *a = &rec->ins[left];
+    const trace_ins_t *b = right == TRACE_NONE ? NULL : &rec->ins[right];
+
+    if (op == TRACE_NOT)
+    {
+        if (a->op == TRACE_BOOL) return trace_bool(rec, !a->boolean);
+        if (a->op == TRACE_NOT) return a->left;
+        return TRACE_NONE;
+    }
+
+    if (a->op != TRACE_NUMBER || (b && b->op != TRACE_NUMBER))
+        return TRACE_NONE;
+
+    number_t x = a->number;
+    number_t y = b ? b->number : 0;
+    switch (op)
+    {
+        case TRACE_ADD: return trace_number(rec, x + y);
+        case TRACE_SUB: return trace_number(rec, x - y);
+        case TRACE_MUL: return trace_number(rec, x * y);
+        case TRACE_DIV: return trace_number(rec, x / y);
+        case TRACE_MOD: return trace_number(rec, fmodl(x, y));
+        case TRACE_NEG: return trace_number(rec, -x);
+        case TRACE_LT: return trace_bool(rec, x < y);
+        case TRACE_LE: return trace_bool(rec, x <= y);
+        case TRACE_EQ: return trace_bool(rec, x == y);
+        default: UNREACHABLE;
+    }
+}
+
+/* an operation without effects, computed once for the same operands */
+static trace_ref_t trace_pure(trace_recorder_t *rec, trace_op_t op, trace_ref_t left, trace_ref_t right)
+{
+    trace_ref_t folded = trace_fold(rec, op, left, right);
+    if (folded != TRACE_NONE) return folded;
+
+    for (size_t i = 0; i < rec->count; i++)
+    {
+        const trace_ins_t *ins = &rec->ins[i];
+        if (ins->op == op && ins->left == left && ins->right == right)
+            return (trace_ref_t) i;
+    }
+    return trace_append(rec, &(trace_ins_t) { .op = op, .left = left, .right = right });
+}
+
+static trace_slot_t *trace_slot(trace_recorder_t *rec, trace_var_t var)
+{
+    for (size_t i = 0; i < rec->slot_count; i++)
+    {
+        trace_slot_t *slot = &rec->slots[i];
+        if (slot->var.global == var.global && slot->var.slot == var.slot)
+            return slot;
+    }
+
+    trace_slot_t *slot = &rec->slots[rec->slot_count++];
+    *slot = (trace_slot_t) { .var = var, .load = TRACE_NONE, .ref = TRACE_NONE };
+    return slot;
+}
+
+static value_t *trace_value(jit_state_t *state, trace_var_t var)
+{
+    return var.global ? &state->globals[var.slot] : &state->base[var.slot];
+}
+
+static bool trace_get(trace_recorder_t *rec, jit_state_t *state, trace_var_t var)
+{
+    trace_slot_t *slot = trace_slot(rec, var);
+    if (slot->ref == TRACE_NONE)
+    {
+        if (trace_value(state, var)->type != VALUE_NUMBER)
+            return false;
+
+        slot->load = trace_append(rec, &(trace_ins_t) { .op = TRACE_LOAD, .left = TRACE_NONE, .right = TRACE_NONE, .var = var });
+        slot->ref = slot->load;
+    }
+
+    rec->stack[rec->depth++] = slot->ref;
+    return true;
+}
+
+static bool trace_set(trace_recorder_t *rec, trace_var_t var)
+{
+    if (rec->depth == 0 || !trace_is_number(rec, rec->stack[rec->depth - 1]))
+        return false;
+
+    trace_ref_t ref = rec->stack[rec->depth - 1];
+    trace_append(rec, &(trace_ins_t) { .op = TRACE_STORE, .left = ref, .right = TRACE_NONE, .var = var });
+
+    trace_slot_t *slot = trace_slot(rec, var);
+    slot->ref = ref;
+    slot->stored = true;
+    return true;
+}
+
+/* the two numbers on top, `swap` for the operands of GT and GE */
+static bool trace_binary(trace_recorder_t *rec, trace_op_t op, bool swap)
+{
+    if (rec->depth < 2) return false;
+
+    trace_ref_t left = rec->stack[rec->depth - 2];
+    trace_ref_t right = rec->stack[rec->depth - 1];
+    if (!trace_is_number(rec, left) || !trace_is_number(rec, right))
+        return false;
+
+    rec->depth--;
+    rec->stack[rec->depth - 1] = swap ? trace_pure(rec, op, right, left) : trace_pure(rec, op, left, right);
+    return true;
+}
+
+/* the number on top */
+static bool trace_unary(trace_recorder_t *rec, trace_op_t op, trace_ref_t right)
+{
+    if (rec->depth == 0 || !trace_is_number(rec, rec->stack[rec->depth - 1]))
+        return false;
+
+    if (op != TRACE_COUNT)
+        rec->stack[rec->depth - 1] = trace_pure(rec, op, rec->stack[rec->depth - 1], right);
+    return true;
+}
+
+/*
+ * Leaves the trace unless `cond` is `expect`, to `exit` with the `count`
+ * operands below. A kept condition is the other boolean there. Guards on
+ * constants and guards repeated are left out.
+ */
+static bool trace_guard(trace_recorder_t *rec, trace_ref_t cond, bool expect, uint32_t exit, size_t count, bool keep)
+{
+    if (rec->ins[cond].op == TRACE_BOOL) return true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (keep && i == count - 1) continue;
+        trace_ref_t ref = rec->stack[i];
+        if (!trace_is_number(rec, ref) && rec->ins[ref].op != TRACE_BOOL)
+            return false;
+    }
+
+    trace_ref_t kept = keep ? trace_bool(rec, !expect) : TRACE_NONE;
+    while (rec->ins[cond].op == TRACE_NOT)
+    {
+        cond = rec->ins[cond].left;
+        expect = !expect;
+    }
+
+    for (size_t i = 0; i < rec->count; i++)
+        if (rec->ins[i].op == TRACE_GUARD && rec->ins[i].left == cond)
+            return true;
+
+    trace_snapshot_t *snapshot = &rec->snapshots[rec->snapshot_count];
+    *snapshot = (trace_snapshot_t) { .exit = exit, .start = (uint32_t) rec->snapshot_depth, .count = (uint32_t) count };
+    for (size_t i = 0; i < count; i++)
+        rec->snapshot_stack[rec->snapshot_depth++] = keep && i == count - 1 ? kept : rec->stack[i];
+
+    trace_append(rec, &(trace_ins_t) {
+        .op = TRACE_GUARD,
+        .left = cond,
+        .right = TRACE_NONE,
+        .guard = { .expect = expect, .snapshot = (uint32_t) rec->snapshot_count++ },
+    });
+    return true;
+}
+
+/* room for the most any instruction records */
+static bool trace_has_room(const trace_recorder_t *rec)
+{
+    return rec->count + 4 <= TRACE_MAX_LENGTH
+        && rec->slot_count < TRACE_MAX_LENGTH
+        && rec->snapshot_count < TRACE_MAX_LENGTH
+        && rec->depth < TRACE_MAX_LENGTH
+        && rec->snapshot_depth + rec->depth + 1 <= TRACE_MAX_LENGTH;
+}
+
+/*
+ * Records the instruction at `ip`. Jumps are followed here and guarded,
+ * anything the trace can not compute stops the recording before it runs.
+ */
+static trace_status_t trace_step(trace_recorder_t *rec, jit_state_t *state, bytecode_loop_t *loop,
+    const uint8_t *header, const uint8_t *back_edge, const uint8_t **ip)
+{
+    bytecode_function_t *function = rec->function;
+    bytecode_op_t op = **ip;
+    const uint8_t *next = *ip + 1 + bytecode_op_operands(op) * sizeof(uint32_t);
+    uint32_t operand = bytecode_op_operands(op) ? trace_operand(*ip + 1) : 0;
+    bool taken;
+
+    static_assert(BYTECODE_COUNT == 62, "Fix BYTECODE_COUNT in 'trace_step'");
+    switch (op)
+    {
+        case BYTECODE_PUSH_CONSTANT: {
+            value_t constant = function->constants[operand];
+            if (constant.type == VALUE_NUMBER)
+                rec->stack[rec->depth++] = trace_number(rec, constant.number);
+            else if (constant.type == VALUE_BOOL)
+                rec->stack[rec->depth++] = trace_bool(rec, constant.boolean);
+            else
+                return TRACE_ABORT;
+            return TRACE_STEP;
+        }
+
+        case BYTECODE_PUSH_TRUE:
+        case BYTECODE_PUSH_FALSE:
+            rec->stack[rec->depth++] = trace_bool(rec, op == BYTECODE_PUSH_TRUE);
+            return TRACE_STEP;
+
+        case BYTECODE_POP:
+            if (rec->depth == 0) return TRACE_ABORT;
+            rec->depth--;
+            return TRACE_STEP;
+
+        case BYTECODE_DUP:
+            if (rec->depth == 0) return TRACE_ABORT;
+            rec->stack[rec->depth] = rec->stack[rec->depth - 1];
+            rec->depth++;
+            return TRACE_STEP;
+
+        case BYTECODE_GET_LOCAL:
+        case BYTECODE_GET_GLOBAL: {
+            trace_var_t var = { .global = op == BYTECODE_GET_GLOBAL, .slot = operand };
+            return trace_get(rec, state, var) ? TRACE_STEP : TRACE_ABORT;
+        }
+
+        case BYTECODE_SET_LOCAL:
+        case BYTECODE_SET_GLOBAL: {
+            trace_var_t var = { .global = op == BYTECODE_SET_GLOBAL, .slot = operand };
+            return trace_set(rec, var) ? TRACE_STEP : TRACE_ABORT;
+        }
+
+        case BYTECODE_ADD:
+        case BYTECODE_ADD_NUMBER:
+            return trace_binary(rec, TRACE_ADD, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_SUB:
+        case BYTECODE_SUB_NUMBER:
+            return trace_binary(rec, TRACE_SUB, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_MUL:
+        case BYTECODE_MUL_NUMBER:
+            return trace_binary(rec, TRACE_MUL, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_DIV:
+        case BYTECODE_DIV_NUMBER:
+            return trace_binary(rec, TRACE_DIV, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_MOD:
+            return trace_binary(rec, TRACE_MOD, false) ? TRACE_STEP : TRACE_ABORT;
+
+        case BYTECODE_LT:
+        case BYTECODE_LT_NUMBER:
+            return trace_binary(rec, TRACE_LT, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_GT:
+        case BYTECODE_GT_NUMBER:
+            return trace_binary(rec, TRACE_LT, true) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_LE:
+        case BYTECODE_LE_NUMBER:
+            return trace_binary(rec, TRACE_LE, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_GE:
+        case BYTECODE_GE_NUMBER:
+            return trace_binary(rec, TRACE_LE, true) ? TRACE_STEP : TRACE_ABORT;
+
+        /* numbers are equal the same way strictly or not */
+        case BYTECODE_EQ:
+        case BYTECODE_STRICT_EQ:
+            return trace_binary(rec, TRACE_EQ, false) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_NE:
+            if (!trace_binary(rec, TRACE_EQ, false)) return TRACE_ABORT;
+            rec->stack[rec->depth - 1] = trace_pure(rec, TRACE_NOT, rec->stack[rec->depth - 1], TRACE_NONE);
+            return TRACE_STEP;
+
+        case BYTECODE_NEGATE:
+            return trace_unary(rec, TRACE_NEG, TRACE_NONE) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_TO_NUMBER:
+            return trace_unary(rec, TRACE_COUNT, TRACE_NONE) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_INC:
+            return trace_unary(rec, TRACE_ADD, trace_number(rec, 1)) ? TRACE_STEP : TRACE_ABORT;
+        case BYTECODE_DEC:
+            return trace_unary(rec, TRACE_SUB, trace_number(rec, 1)) ? TRACE_STEP : TRACE_ABORT;
+
+        case BYTECODE_NOT:
+            if (rec->depth == 0 || trace_is_number(rec, rec->stack[rec->depth - 1]))
+                return TRACE_ABORT;
+            rec->stack[rec->depth - 1] = trace_pure(rec, TRACE_NOT, rec->stack[rec->depth - 1], TRACE_NONE);
+            return TRACE_STEP;
+
+        case BYTECODE_JUMP:
+            next += (int32_t) operand;
+            if (next < header || next > back_edge) return TRACE_ABORT;
+            *ip = next;
+            return next == header ? TRACE_CLOSED : TRACE_JUMPED;
+
+        case BYTECODE_JUMP_IF_FALSE:
+        case BYTECODE_JUMP_IF_TRUE:
+        case BYTECODE_JUMP_IF_FALSE_KEEP:
+        case BYTECODE_JUMP_IF_TRUE_KEEP: {
+            /* booleans only, conditions on numbers are left to the VM */
+            if (rec->depth == 0 || trace_is_number(rec, rec->stack[rec->depth - 1]))
+                return TRACE_ABORT;
+
+            bool keep = op == BYTECODE_JUMP_IF_FALSE_KEEP || op == BYTECODE_JUMP_IF_TRUE_KEEP;
+            bool when = op == BYTECODE_JUMP_IF_TRUE || op == BYTECODE_JUMP_IF_TRUE_KEEP;
+            bool truthy = runtime_truthy(state->sp[-1]);
+            taken = truthy == when;
+
+            const uint8_t *target = next + (int32_t) operand;
+            const uint8_t *path = taken ? target : next;
+            const uint8_t *other = taken ? next : target;
+            if (path < header || path > back_edge) return TRACE_ABORT;
+
+            trace_ref_t cond = rec->stack[rec->depth - 1];
+            size_t count = keep ? rec->depth : rec->depth - 1;
+            if (!trace_guard(rec, cond, truthy, (uint32_t) (other - function->code), count, keep))
+                return TRACE_ABORT;
+
+            if (keep)
+                rec->stack[rec->depth - 1] = trace_bool(rec, truthy);
+            else
+            {
+                rec->depth--;
+                state->sp--;
+            }
+
+            *ip = path;
+            return path == header ? TRACE_CLOSED : TRACE_JUMPED;
+        }
+
+        /* the loop traced, other loops are traced by themselves */
+        case BYTECODE_LOOP:
+            if (&function->loops[trace_operand(*ip + 1 + sizeof(uint32_t))] != loop)
+                return TRACE_ABORT;
+            *ip = header;
+            return TRACE_CLOSED;
+
+        default:
+            return TRACE_ABORT;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Optimizing                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static trace_slot_t *trace_find(trace_recorder_t *rec, trace_var_t var)
+{
+    for (size_t i = 0; i < rec->slot_count; i++)
+        if (rec->slots[i].var.global == var.global && rec->slots[i].var.slot == var.slot)
+            return &rec->slots[i];
+    UNREACHABLE;
+}
+
+static bool trace_phi(const trace_slot_t *slot)
+{
+    return slot->load != TRACE_NONE && slot->ref != slot->load;
+}
+
+/*
+ * What does not change between iterations is computed once before the loop:
+ * constants, variables the loop does not store, operations on those and
+ * guards on them, which leave to the header before any iteration.
+ */
+static void trace_hoist(trace_recorder_t *rec)
+{
+    for (size_t i = 0; i < rec->count; i++)
+    {
+        trace_ins_t *ins = &rec->ins[i];
+        switch (ins->op)
+        {
+            case TRACE_NUMBER:
+            case TRACE_BOOL:
+                ins->invariant = true;
+                break;
+
+            case TRACE_LOAD:
+                ins->invariant = !trace_find(rec, ins->var)->stored;
+                break;
+
+            case TRACE_STORE:
+                ins->invariant = false;
+                break;
+
+            default:
+                ins->invariant = rec->ins[ins->left].invariant
+                    && (ins->right == TRACE_NONE || rec->ins[ins->right].invariant);
+                break;
+        }
+    }
+}
+
+/*
+ * Removes stores another store to the same variable overwrites before a
+ * guard could leave, then everything no guard, store or next iteration uses.
+ */
+static void trace_eliminate(trace_recorder_t *rec)
+{
+    for (size_t i = 0; i < rec->count; i++)
+    {
+        trace_ins_t *ins = &rec->ins[i];
+        if (ins->op == TRACE_GUARD || ins->op == TRACE_LOAD)
+            ins->live = true;
+        if (ins->op != TRACE_STORE)
+            continue;
+
+        ins->live = true;
+        for (size_t j = i + 1; j < rec->count; j++)
+        {
+            const trace_ins_t *later = &rec->ins[j];
+            if (later->op == TRACE_GUARD && !later->invariant)
+                break;
+            if (later->op == TRACE_STORE && later->var.global == ins->var.global && later->var.slot == ins->var.slot)
+            {
+                ins->live = false;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < rec->slot_count; i++)
+        if (trace_phi(&rec->slots[i]))
+            rec->ins[rec->slots[i].ref].live = true;
+
+    for (size_t i = rec->count; i-- > 0; )
+    {
+        trace_ins_t *ins = &rec->ins[i];
+        if (!ins->live) continue;
+
+        if (ins->left != TRACE_NONE) rec->ins[ins->left].live = true;
+        if (ins->right != TRACE_NONE) rec->ins[ins->right].live = true;
+        if (ins->op == TRACE_GUARD && !ins->invariant)
+        {
+            const trace_snapshot_t *snapshot = &rec->snapshots[ins->guard.snapshot];
+            for (uint32_t j = 0; j < snapshot->count; j++)
+                rec->ins[rec->snapshot_stack[snapshot->start + j]].live = true;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Code generation                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* a guard's jump to its exit, UINT32_MAX for the header */
+typedef struct trace_exit
+{
+    size_t at;
+    uint32_t snapshot;
+} trace_exit_t;
+
+typedef struct trace_assembler
+{
+    assembler_t as;
+    trace_recorder_t *rec;
+
+    trace_exit_t exits[2 * TRACE_MAX_LENGTH];
+    size_t exit_count;
+} trace_assembler_t;
+
+static void trace_jump_exit(trace_assembler_t *ta, int condition, uint32_t snapshot)
+{
+    trace_exit_t *exit = &ta->exits[ta->exit_count++];
+    exit->at = asm_jump_forward(&ta->as, condition);
+    exit->snapshot = snapshot;
+}
+
+static int trace_base(trace_var_t var)
+{
+    return var.global ? TRACE_GLOBALS : TRACE_BASE;
+}
+
+static void trace_fld(assembler_t *as, trace_ref_t ref)
+{
+    asm_fld(as, ASM_RSP, TRACE_SLOT(ref));
+}
+
+static void trace_fstp(assembler_t *as, trace_ref_t ref)
+{
+    asm_fstp(as, ASM_RSP, TRACE_SLOT(ref));
+}
+
+/* the 80 bits of a constant, moved through rax */
+static void trace_constant(assembler_t *as, trace_ref_t ref, number_t number)
+{
+    uint8_t bytes[16] = {0};
+    memcpy(bytes, &number, 10);
+
+    uint64_t low;
+    uint32_t high;
+    memcpy(&low, bytes, sizeof(low));
+    memcpy(&high, bytes + sizeof(low), sizeof(high));
+
+    asm_mov_imm(as, ASM_RAX, low);
+    asm_memory(as, true, 0x89, ASM_RAX, ASM_RSP, TRACE_SLOT(ref));
+    asm_byte(as, 0xB8);                     /* mov eax, high */
+    asm_u32(as, high);
+    asm_memory(as, false, 0x89, ASM_RAX, ASM_RSP, TRACE_SLOT(ref) + 8);
+}
+
+/* `fprem` leaves partial remainders until C2 is clear, like `fmodl` */
+static void trace_mod(assembler_t *as, const trace_ins_t *ins)
+{
+    trace_fld(as, ins->right);
+    trace_fld(as, ins->left);
+    asm_x87(as, ASM_FPREM);
+    asm_byte(as, 0xDF);                     /* fnstsw ax */
+    asm_byte(as, 0xE0);
+    asm_byte(as, 0xF6);                     /* test ah, 4 */
+    asm_byte(as, 0xC4);
+    asm_byte(as, 0x04);
+    asm_byte(as, 0x75);                     /* jnz fprem */
+    asm_byte(as, 0xF7);
+    asm_x87(as, ASM_FSTP_ST1);
+}
+
+/*
+ * Compares like the JIT's templates, `fucomip` sets all flags for NaN so
+ * `a < b` is `b above a`. Jumps to the exit when the guard fails, in the
+ * pre-header that is the loop's header.
+ */
+static void trace_guard_code(trace_assembler_t *ta, const trace_ins_t *guard)
+{
+    assembler_t *as = &ta->as;
+    const trace_ins_t *cond = &ta->rec->ins[guard->left];
+    uint32_t snapshot = guard->invariant ? UINT32_MAX : guard->guard.snapshot;
+    bool expect = guard->guard.expect;
+
+    trace_fld(as, cond->left);
+    trace_fld(as, cond->right);
+    asm_x87(as, ASM_FUCOMIP);
+    asm_x87(as, ASM_FSTP_ST0);
+
+    switch (cond->op)
+    {
+        case TRACE_LT:
+            trace_jump_exit(ta, expect ? ASM_BE : ASM_A, snapshot);
+            break;
+
+        case TRACE_LE:
+            trace_jump_exit(ta, expect ? ASM_B : ASM_AE, snapshot);
+            break;
+
+        case TRACE_EQ:
+            if (expect)
+            {
+                trace_jump_exit(ta, ASM_NE, snapshot);
+                trace_jump_exit(ta, ASM_P, snapshot);
+            }
+            else
+            {
+                size_t unordered = asm_jump_forward(as, ASM_P);
+                trace_jump_exit(ta, ASM_E, snapshot);
+                asm_bind(as, unordered);
+            }
+            break;
+
+        default:
+            UNREACHABLE;
+    }
+}
+
+static void trace_ins_code(trace_assembler_t *ta, trace_ref_t ref)
+{
+    assembler_t *as = &ta->as;
+    const trace_ins_t *ins = &ta->rec->ins[ref];
+
+    static_assert(TRACE_COUNT == 15, "Fix TRACE_COUNT in 'trace_ins_code'");
+    switch (ins->op)
+    {
+        case TRACE_NUMBER:
+            trace_constant(as, ref, ins->number);
+            break;
+
+        case TRACE_LOAD: {
+            int base = trace_base(ins->var);
+            int32_t disp = (int32_t) (ins->var.slot * JIT_VALUE);
+            asm_memory(as, false, 0x83, 7, base, disp + JIT_TYPE);
+            asm_byte(as, VALUE_NUMBER);
+            trace_jump_exit(ta, ASM_NE, UINT32_MAX);
+            asm_fld(as, base, disp + JIT_NUMBER);
+            trace_fstp(as, ref);
+            break;
+        }
+
+        case TRACE_ADD:
+        case TRACE_SUB:
+        case TRACE_MUL:
+        case TRACE_DIV:
+            trace_fld(as, ins->left);
+            trace_fld(as, ins->right);
+            asm_x87(as, ins->op == TRACE_ADD ? ASM_FADDP
+                : ins->op == TRACE_SUB ? ASM_FSUBP
+                : ins->op == TRACE_MUL ? ASM_FMULP : ASM_FDIVP);
+            trace_fstp(as, ref);
+            break;
+
+        case TRACE_MOD:
+            trace_mod(as, ins);
+            trace_fstp(as, ref);
+            break;
+
+        case TRACE_NEG:
+            trace_fld(as, ins->left);
+            asm_x87(as, ASM_FCHS);
+            trace_fstp(as, ref);
+            break;
+
+        /* booleans are computed by the guards on them */
+        case TRACE_BOOL:
+        case TRACE_LT:
+        case TRACE_LE:
+        case TRACE_EQ:
+        case TRACE_NOT:
+            break;
+
+        case TRACE_GUARD:
+            trace_guard_code(ta, ins);
+            break;
+
+        /* a loaded variable is a number already */
+        case TRACE_STORE: {
+            int base = trace_base(ins->var);
+            int32_t disp = (int32_t) (ins->var.slot * JIT_VALUE);
+            trace_fld(as, ins->left);
+            asm_fstp(as, base, disp + JIT_NUMBER);
+            if (trace_find(ta->rec, ins->var)->load == TRACE_NONE)
+            {
+                asm_memory(as, false, 0xC7, 0, base, disp + JIT_TYPE);
+                asm_u32(as, VALUE_NUMBER);
+            }
+            break;
+        }
+
+        default:
+            UNREACHABLE;
+    }
+}
+
+/*
+ * The next iteration reads the variables it loads from their loads' slots.
+ * Values that are loads themselves are saved first, so swaps work.
+ */
+static void trace_back_edge(trace_assembler_t *ta, size_t temps)
+{
+    assembler_t *as = &ta->as;
+    trace_recorder_t *rec = ta->rec;
+    size_t temp = temps;
+
+    for (size_t i = 0; i < rec->slot_count; i++)
+    {
+        const trace_slot_t *slot = &rec->slots[i];
+        if (!trace_phi(slot) || rec->ins[slot->ref].op != TRACE_LOAD) continue;
+        trace_fld(as, slot->ref);
+        trace_fstp(as, (trace_ref_t) temp++);
+    }
+
+    for (size_t i = 0; i < rec->slot_count; i++)
+    {
+        const trace_slot_t *slot = &rec->slots[i];
+        if (!trace_phi(slot) || rec->ins[slot->ref].op == TRACE_LOAD) continue;
+        trace_fld(as, slot->ref);
+        trace_fstp(as, slot->load);
+    }
+
+    temp = temps;
+    for (size_t i = 0; i < rec->slot_count; i++)
+    {
+        const trace_slot_t *slot = &rec->slots[i];
+        if (!trace_phi(slot) || rec->ins[slot->ref].op != TRACE_LOAD) continue;
+        trace_fld(as, (trace_ref_t) temp++);
+        trace_fstp(as, slot->load);
+    }
+}
+
+/* writes the operands the VM continues with above its `sp` */
+static void trace_snapshot_code(trace_assembler_t *ta, const trace_snapshot_t *snapshot)
+{
+    assembler_t *as = &ta->as;
+    trace_recorder_t *rec = ta->rec;
+
+    for (uint32_t i = 0; i < snapshot->count; i++)
+    {
+        trace_ref_t ref = rec->snapshot_stack[snapshot->start + i];
+        int32_t disp = (int32_t) i * JIT_VALUE;
+        const trace_ins_t *ins = &rec->ins[ref];
+        if (ins->op == TRACE_BOOL)
+        {
+            asm_memory(as, false, 0xC7, 0, TRACE_SP, disp + JIT_TYPE);
+            asm_u32(as, VALUE_BOOL);
+            asm_memory(as, false, 0xC6, 0, TRACE_SP, disp + JIT_BOOLEAN);
+            asm_byte(as, ins->boolean);
+        }
+        else
+        {
+            trace_fld(as, ref);
+            asm_fstp(as, TRACE_SP, disp + JIT_NUMBER);
+            asm_memory(as, false, 0xC7, 0, TRACE_SP, disp + JIT_TYPE);
+            asm_u32(as, VALUE_NUMBER);
+        }
+    }
+}
+
+static void trace_leave(assembler_t *as, uint32_t count, uint32_t exit, size_t epilogue)
+{
+    asm_lea(as, ASM_RAX, TRACE_SP, (int32_t) count * JIT_VALUE);
+    asm_memory(as, true, 0x89, ASM_RAX, TRACE_STATE, offsetof(jit_state_t, sp));
+    asm_byte(as, 0xB8);                     /* mov eax, exit */
+    asm_u32(as, exit);
+    asm_jump_to(as, ASM_ALWAYS, epilogue);
+}
+
+static trace_t *trace_compile(trace_recorder_t *rec)
+{
+    trace_hoist(rec);
+    trace_eliminate(rec);
+
+    size_t temps = rec->count;
+    size_t frame = rec->count;
+    for (size_t i = 0; i < rec->slot_count; i++)
+        if (trace_phi(&rec->slots[i]) && rec->ins[rec->slots[i].ref].op == TRACE_LOAD)
+            frame++;
+    int32_t frame_size = TRACE_SLOT(frame);
+
+    trace_assembler_t *ta = malloc(sizeof(trace_assembler_t));
+    if (!ta)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    ta->rec = rec;
+    ta->exit_count = 0;
+    asm_init(&ta->as);
+    assembler_t *as = &ta->as;
+
+    /* entered like the JIT's code, the frame keeps rsp 16-byte aligned */
+    asm_push(as, ASM_RBX);
+    asm_push(as, ASM_R12);
+    asm_push(as, ASM_R13);
+    asm_push(as, ASM_R14);
+    asm_push(as, ASM_R15);
+    asm_mov(as, TRACE_STATE, ASM_RDI);
+    asm_memory(as, true, 0x8B, TRACE_SP, TRACE_STATE, offsetof(jit_state_t, sp));
+    asm_memory(as, true, 0x8B, TRACE_BASE, TRACE_STATE, offsetof(jit_state_t, base));
+    asm_memory(as, true, 0x8B, TRACE_GLOBALS, TRACE_STATE, offsetof(jit_state_t, globals));
+    asm_lea(as, ASM_RSP, ASM_RSP, -frame_size);
+
+    /* the pre-header */
+    for (size_t i = 0; i < rec->count; i++)
+        if (rec->ins[i].live && (rec->ins[i].invariant || rec->ins[i].op == TRACE_LOAD))
+            trace_ins_code(ta, (trace_ref_t) i);
+
+    size_t body = as->length;
+    for (size_t i = 0; i < rec->count; i++)
+        if (rec->ins[i].live && !rec->ins[i].invariant && rec->ins[i].op != TRACE_LOAD)
+            trace_ins_code(ta, (trace_ref_t) i);
+    trace_back_edge(ta, temps);
+    asm_jump_to(as, ASM_ALWAYS, body);
+
+    size_t epilogue = as->length;
+    asm_lea(as, ASM_RSP, ASM_RSP, frame_size);
+    asm_pop(as, ASM_R15);
+    asm_pop(as, ASM_R14);
+    asm_pop(as, ASM_R13);
+    asm_pop(as, ASM_R12);
+    asm_pop(as, ASM_RBX);
+    asm_byte(as, 0xC3);
+
+    /* the exits, one for each guard and one for the header */
+    size_t header_exit = SIZE_MAX;
+    size_t stub = 0;
+    for (size_t i = 0; i < ta->exit_count; i++)
+    {
+        const trace_exit_t *exit = &ta->exits[i];
+        if (exit->snapshot == UINT32_MAX)
+        {
+            if (header_exit == SIZE_MAX)
+            {
+                header_exit = as->length;
+                trace_leave(as, 0, rec->header, epilogue);
+            }
+            asm_patch(as, exit->at, header_exit);
+            continue;
+        }
+
+        /* both jumps of an equality share one */
+        if (i == 0 || ta->exits[i - 1].snapshot != exit->snapshot)
+        {
+            const trace_snapshot_t *snapshot = &rec->snapshots[exit->snapshot];
+            stub = as->length;
+            trace_snapshot_code(ta, snapshot);
+            trace_leave(as, snapshot->count, snapshot->exit, epilogue);
+        }
+        asm_patch(as, exit->at, stub);
+    }
+
+    trace_t *trace = NULL;
+    size_t size;
+    uint8_t *code = asm_map(as, &size);
+    if (code)
+    {
+        trace = malloc(sizeof(trace_t));
+        if (!trace)
+        {
+            ERROR("Malloc failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        trace->code = code;
+        trace->length = as->length;
+        trace->size = size;
+        trace->header = rec->header;
+    }
+
+    asm_free(as);
+    free(ta);
+    return trace;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Interface                                                                  */
+/* -------------------------------------------------------------------------- */
+
+uint32_t trace_record(jit_state_t *state, bytecode_loop_t *loop, const uint8_t *header, const uint8_t *back_edge)
+{
+    trace_recorder_t *rec = malloc(sizeof(trace_recorder_t));
+    if (!rec)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    rec->function = state->function;
+    rec->header = (uint32_t) (header - state->function->code);
+    rec->count = 0;
+    rec->depth = 0;
+    rec->slot_count = 0;
+    rec->snapshot_count = 0;
+    rec->snapshot_depth = 0;
+
+    const uint8_t *ip = header;
+    for (;;)
+    {
+        if (!trace_has_room(rec)) break;
+
+        const uint8_t *at = ip;
+        trace_status_t status = trace_step(rec, state, loop, header, back_edge, &ip);
+        if (status == TRACE_ABORT)
+            break;
+        if (status == TRACE_STEP)
+        {
+            state->sp = jit_step(state, state->sp, at);
+            ip = at + 1 + bytecode_op_operands(*at) * sizeof(uint32_t);
+        }
+        if (status == TRACE_CLOSED)
+        {
+            if (rec->depth == 0)
+                loop->trace = trace_compile(rec);
+            break;
+        }
+    }
+
+    free(rec);
+    return (uint32_t) (ip - state->function->code);
+}
+
+uint32_t trace_run(trace_t *trace, jit_state_t *state)
+{
+    trace_entry_t entry = (trace_entry_t) (uintptr_t) trace->code;
+    return entry(state);
+}
+
+void trace_free(trace_t *trace)
+{
+    if (!trace) return;
+    asm_unmap(trace->code, trace->size);
+    free(trace);
+}
+
+#else /* !JIT_AVAILABLE */
+
+uint32_t trace_record(jit_state_t *state, bytecode_loop_t *loop, const uint8_t *header, const uint8_t *back_edge)
+{
+    (void) loop;
+    (void) back_edge;
+    return (uint32_t) (header - state->function->code);
+}
+
+uint32_t trace_run(trace_t *trace, jit_state_t *state)
+{
+    (void) trace;
+    (void) state;
+    UNREACHABLE;
+}
+
+void trace_free(trace_t *trace)
+{
+    (void) trace;
+}
+
+#endif /* JIT_AVAILABLE */
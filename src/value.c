@@ -1,20 +1,26 @@
 
 
 #include <string.h>
+#include <math.h>
 
 #include "utils.h"
 #include "value.h"
 
-void value_number_print(const number_t num, int decimals)
+/* at most `decimals` decimals without trailing zeros */
+static void value_number_format(char *buf, size_t size, number_t num, int decimals)
 {
-    char buf[2048];
+    if (isnan(num) || isinf(num))
+    {
+        snprintf(buf, size, "%s", isnan(num) ? "NaN" : num < 0 ? "-Infinity" : "Infinity");
+        return;
+    }
 
-    // convert number to string with fixed max decimals
-    mpfr_sprintf(buf, "%.*Rf", decimals, num);
+    snprintf(buf, size, "%.*Lf", decimals, num);
 
     // trim trailing zeros
     char *p = buf + strlen(buf) - 1;
-    while (p > buf && *p == '0') p--;
+    if (strchr(buf, '.'))
+        while (p > buf && *p == '0') p--;
 
     // remove decimal point if no fractional part left
     if (*p == '.') p--;
@@ -24,7 +30,12 @@ void value_number_print(const number_t num, int decimals)
     if (strcmp(buf, "-0") == 0) {
         strcpy(buf, "0");
     }
+}
 
+void value_number_print(const number_t num, int decimals)
+{
+    char buf[2048];
+    value_number_format(buf, sizeof(buf), num, decimals);
     printf("%s", buf);
 }
 
@@ -95,10 +106,7 @@ value_t value_number(number_t number)
     value_t value = { 0 };
     value.type = VALUE_NUMBER;
 
-    // value.number = number;
-
-    // mpfr_init2(value.number, MPFR_PRECISION);
-    // mpfr_set(value.number, number, MPFR_RNDN);
+    value.number = number;
 
     return value;
 }
@@ -151,17 +159,17 @@ value_t value_object_create(void)
     object_t obj = {0};
     obj.count = 0;
     obj.capacity = 8;
-    obj.keys = malloc(sizeof(char*) * obj.capacity);
+    obj.keys = malloc(sizeof(atom_t) * obj.capacity);
     obj.values = malloc(sizeof(value_t) * obj.capacity);
 
     return value_object(obj);
 }
 
-void object_set(object_t *obj, const char *key, value_t val)
+void object_set(object_t *obj, atom_t key, value_t val)
 {
     // Check if key exists, replace if found
     for (size_t i = 0; i < obj->count; i++) {
-        if (strcmp(obj->keys[i], key) == 0) {
+        if (obj->keys[i] == key) {
             obj->values[i] = val;
             return;
         }
@@ -170,12 +178,12 @@ void object_set(object_t *obj, const char *key, value_t val)
     // Resize arrays if needed
     if (obj->count == obj->capacity) {
         obj->capacity *= 2;
-        obj->keys = realloc(obj->keys, sizeof(char*) * obj->capacity);
+        obj->keys = realloc(obj->keys, sizeof(atom_t) * obj->capacity);
         obj->values = realloc(obj->values, sizeof(value_t) * obj->capacity);
     }
 
     // Add new key/value
-    obj->keys[obj->count] = strdup(key);  // copy the key
+    obj->keys[obj->count] = key;
     obj->values[obj->count] = val;
     obj->count++;
 }
@@ -198,13 +206,18 @@ value_t value_null()
 char *value_to_string(value_t *v) {
     switch (v->type) {
         case VALUE_NUMBER: {
-            char *buf = malloc(64);
-            // sprintf(buf, "%Lg", v->number);
-            sprintf(buf, "<fix not working value.c>");
-            return buf;
+            char buf[2048];
+            value_number_format(buf, sizeof(buf), v->number, 16);
+            return strdup(buf);
         }
         case VALUE_STRING:
             return strdup(v->string);
+        case VALUE_BOOL:
+            return strdup(v->boolean ? "true" : "false");
+        case VALUE_NULL:
+            return strdup("null");
+        case VALUE_UNDEFINED:
+            return strdup("undefined");
         default:
             return strdup("<unknown>");
     }
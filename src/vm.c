@@ -0,0 +1,560 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "vm.h"
+#include "runtime.h"
+#include "jit.h"
+#include "trace.h"
+
+/* computed gotos where the compiler has them, `-DVM_NO_THREADING` for the switch */
+#if defined(__GNUC__) && !defined(VM_NO_THREADING)
+#define VM_THREADED 1
+#else
+#define VM_THREADED 0
+#endif
+
+#define VM_ERROR(...) \
+    do { \
+        ERROR(__VA_ARGS__); \
+        exit(EXIT_FAILURE); \
+    } while (0)
+
+void vm_init(vm_t *vm, compiler_t *compiler)
+{
+    value_stack_init(&vm->stack);
+
+    vm->frames = malloc(VM_FRAMES_CAPACITY * sizeof(vm_frame_t));
+    if (!vm->frames)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    vm->frame_count = 0;
+
+    vm->globals = NULL;
+    vm->compiler = compiler;
+
+    vm->jit = JIT_AVAILABLE;
+    vm->jit_functions = 0;
+    vm->jit_bytes = 0;
+
+    vm->trace = JIT_AVAILABLE;
+    vm->traces = 0;
+    vm->trace_aborts = 0;
+}
+
+void vm_free(vm_t *vm)
+{
+    if (!vm) return;
+    value_stack_free(&vm->stack);
+    free(vm->frames);
+    env_free(vm->globals);
+}
+
+function_t *vm_closure(bytecode_function_t *code, env_t *env)
+{
+    function_t *function = malloc(sizeof(function_t));
+    if (!function)
+    {
+        ERROR("Malloc failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    function->is_native = false;
+    function->user.param_count = code->node->function.param_count;
+    function->user.param_names = NULL;
+    function->user.body = code->node->function.body;
+    function->user.closure = env;
+    function->user.code = code;
+    function->user.closures = NULL;
+    return function;
+}
+
+/* the code of a Rose function, compiled on its first call if it was parsed lazily */
+static bytecode_function_t *vm_target(vm_t *vm, function_t *function)
+{
+    bytecode_function_t *code = function->user.code;
+    if (!code->compiled && !compile_function(vm->compiler, code))
+        exit(EXIT_FAILURE);
+    return code;
+}
+
+static inline uint32_t vm_operand(const uint8_t *ip)
+{
+    uint32_t operand;
+    memcpy(&operand, ip, sizeof(operand));
+    return operand;
+}
+
+#define VM_READ() (ip += sizeof(uint32_t), vm_operand(ip - sizeof(uint32_t)))
+#define VM_JUMP() \
+    do { \
+        int32_t offset = (int32_t) VM_READ(); \
+        ip += offset; \
+    } while (0)
+
+#define VM_ARITHMETIC(op) \
+    do { \
+        sp--; \
+        sp[-1] = value_number(runtime_to_number(sp[-1]) op runtime_to_number(sp[0])); \
+    } while (0)
+
+#define VM_BITWISE(expression) \
+    do { \
+        sp--; \
+        int32_t a = runtime_to_int32(runtime_to_number(sp[-1])); \
+        int32_t b = runtime_to_int32(runtime_to_number(sp[0])); \
+        sp[-1] = value_number((number_t) (expression)); \
+    } while (0)
+
+/* `a > b` is `b < a` */
+#define VM_COMPARE(left, right, or_equal) \
+    do { \
+        sp--; \
+        sp[-1] = value_bool(runtime_less(left, right, or_equal)); \
+    } while (0)
+
+/* both operands are numbers, the left one is updated in place */
+#define VM_NUMBERS(op) \
+    do { \
+        sp--; \
+        sp[-1].number = sp[-1].number op sp[0].number; \
+    } while (0)
+
+#define VM_NUMBERS_COMPARE(op) \
+    do { \
+        sp--; \
+        sp[-1] = value_bool(sp[-1].number op sp[0].number); \
+    } while (0)
+
+/*
+ * A call leaves the callee and its arguments on the stack, the arguments
+ * become the first frame slots and the rest of the frame is cleared. The
+ * result replaces the callee. A tail call moves them over the caller's
+ * frame and reuses it. Hot functions run as machine code in the same
+ * frames and come back here to call and return.
+ */
+value_t vm_run(vm_t *vm, bytecode_function_t *program)
+{
+    vm->globals = env_enter_scope(NULL, program->node->program.slot_count);
+    runtime_builtins(vm->globals);
+    value_t *globals = vm->globals->slots;
+
+    value_t *stack_end = vm->stack.values + vm->stack.capacity;
+    value_t *sp = vm->stack.values + vm->stack.top;
+    size_t entry = vm->frame_count;
+
+    bytecode_function_t *function = program;
+    env_t *env = NULL;
+    const uint8_t *ip = function->code;
+
+    /* the program has no callee */
+    *sp++ = value_undefined();
+    value_t *base = sp;
+    if (base + function->frame_size + function->stack_size > stack_end)
+        VM_ERROR("Stack overflow, %zu values in use\n", vm->stack.top);
+    for (uint32_t i = 0; i < function->frame_size; i++)
+        base[i] = value_undefined();
+    sp = base + function->frame_size;
+
+    vm_frame_t *frame = &vm->frames[vm->frame_count++];
+    frame->function = function;
+    frame->base = base;
+    frame->env = env;
+
+    /* calls */
+    value_t callee, result, *args;
+    uint32_t argc;
+    bytecode_function_t *target;
+
+    /* loops */
+    bytecode_loop_t *loop;
+    const uint8_t *back_edge;
+
+#if VM_THREADED
+    static void *const vm_labels[BYTECODE_COUNT] = {
+#define VM_LABEL(name, operands, effect) [BYTECODE_##name] = &&vm_##name,
+        BYTECODE_OPS(VM_LABEL)
+#undef VM_LABEL
+    };
+#define VM_DISPATCH() goto *vm_labels[*ip++]
+#define VM_CASE(name) vm_##name
+    VM_DISPATCH();
+#else
+#define VM_DISPATCH() continue
+#define VM_CASE(name) case BYTECODE_##name
+    for (;;)
+    switch (*ip++)
+    {
+#endif
+
+    VM_CASE(PUSH_CONSTANT):
+        *sp++ = function->constants[VM_READ()];
+        VM_DISPATCH();
+
+    VM_CASE(PUSH_UNDEFINED):
+        *sp++ = value_undefined();
+        VM_DISPATCH();
+
+    VM_CASE(PUSH_NULL):
+        *sp++ = value_null();
+        VM_DISPATCH();
+
+    VM_CASE(PUSH_TRUE):
+        *sp++ = value_bool(true);
+        VM_DISPATCH();
+
+    VM_CASE(PUSH_FALSE):
+        *sp++ = value_bool(false);
+        VM_DISPATCH();
+
+    VM_CASE(POP):
+        sp--;
+        VM_DISPATCH();
+
+    VM_CASE(DUP):
+        sp[0] = sp[-1];
+        sp++;
+        VM_DISPATCH();
+
+    VM_CASE(GET_LOCAL):
+        *sp++ = base[VM_READ()];
+        VM_DISPATCH();
+
+    VM_CASE(SET_LOCAL):
+        base[VM_READ()] = sp[-1];
+        VM_DISPATCH();
+
+    VM_CASE(GET_GLOBAL):
+        *sp++ = globals[VM_READ()];
+        VM_DISPATCH();
+
+    VM_CASE(SET_GLOBAL):
+        globals[VM_READ()] = sp[-1];
+        VM_DISPATCH();
+
+    VM_CASE(GET_ENV): {
+        uint32_t hops = VM_READ();
+        uint32_t slot = VM_READ();
+        *sp++ = *env_lookup(env, hops, slot);
+        VM_DISPATCH();
+    }
+
+    VM_CASE(SET_ENV): {
+        uint32_t hops = VM_READ();
+        uint32_t slot = VM_READ();
+        *env_lookup(env, hops, slot) = sp[-1];
+        VM_DISPATCH();
+    }
+
+    VM_CASE(GET_CALLEE):
+        *sp++ = base[-1];
+        VM_DISPATCH();
+
+    VM_CASE(GET_MEMBER):
+        sp[-1] = runtime_member(sp[-1], function->constants[VM_READ()].string);
+        VM_DISPATCH();
+
+    VM_CASE(ADD):
+        sp--;
+        if (sp[-1].type == VALUE_NUMBER && sp[0].type == VALUE_NUMBER)
+            sp[-1].number += sp[0].number;
+        else if (sp[-1].type == VALUE_STRING || sp[0].type == VALUE_STRING)
+            sp[-1] = runtime_concat(sp[-1], sp[0]);
+        else
+            sp[-1] = value_number(runtime_to_number(sp[-1]) + runtime_to_number(sp[0]));
+        VM_DISPATCH();
+
+    VM_CASE(SUB): VM_ARITHMETIC(-); VM_DISPATCH();
+    VM_CASE(MUL): VM_ARITHMETIC(*); VM_DISPATCH();
+    VM_CASE(DIV): VM_ARITHMETIC(/); VM_DISPATCH();
+
+    VM_CASE(MOD):
+        sp--;
+        sp[-1] = value_number(fmodl(runtime_to_number(sp[-1]), runtime_to_number(sp[0])));
+        VM_DISPATCH();
+
+    VM_CASE(POW):
+        sp--;
+        sp[-1] = value_number(powl(runtime_to_number(sp[-1]), runtime_to_number(sp[0])));
+        VM_DISPATCH();
+
+    VM_CASE(BIT_AND): VM_BITWISE(a & b); VM_DISPATCH();
+    VM_CASE(BIT_OR): VM_BITWISE(a | b); VM_DISPATCH();
+    VM_CASE(BIT_XOR): VM_BITWISE(a ^ b); VM_DISPATCH();
+    VM_CASE(SHL): VM_BITWISE((int32_t) ((uint32_t) a << (b & 31))); VM_DISPATCH();
+    VM_CASE(SHR): VM_BITWISE(a >> (b & 31)); VM_DISPATCH();
+
+    VM_CASE(EQ):
+        sp--;
+        sp[-1] = value_bool(runtime_equals(sp[-1], sp[0]));
+        VM_DISPATCH();
+
+    VM_CASE(NE):
+        sp--;
+        sp[-1] = value_bool(!runtime_equals(sp[-1], sp[0]));
+        VM_DISPATCH();
+
+    VM_CASE(STRICT_EQ):
+        sp--;
+        sp[-1] = value_bool(runtime_strict_equals(sp[-1], sp[0]));
+        VM_DISPATCH();
+
+    VM_CASE(LT): VM_COMPARE(sp[-1], sp[0], false); VM_DISPATCH();
+    VM_CASE(GT): VM_COMPARE(sp[0], sp[-1], false); VM_DISPATCH();
+    VM_CASE(LE): VM_COMPARE(sp[-1], sp[0], true); VM_DISPATCH();
+    VM_CASE(GE): VM_COMPARE(sp[0], sp[-1], true); VM_DISPATCH();
+
+    VM_CASE(ADD_NUMBER): VM_NUMBERS(+); VM_DISPATCH();
+    VM_CASE(SUB_NUMBER): VM_NUMBERS(-); VM_DISPATCH();
+    VM_CASE(MUL_NUMBER): VM_NUMBERS(*); VM_DISPATCH();
+    VM_CASE(DIV_NUMBER): VM_NUMBERS(/); VM_DISPATCH();
+    VM_CASE(LT_NUMBER): VM_NUMBERS_COMPARE(<); VM_DISPATCH();
+    VM_CASE(GT_NUMBER): VM_NUMBERS_COMPARE(>); VM_DISPATCH();
+    VM_CASE(LE_NUMBER): VM_NUMBERS_COMPARE(<=); VM_DISPATCH();
+    VM_CASE(GE_NUMBER): VM_NUMBERS_COMPARE(>=); VM_DISPATCH();
+
+    VM_CASE(NEGATE):
+        sp[-1] = value_number(-runtime_to_number(sp[-1]));
+        VM_DISPATCH();
+
+    VM_CASE(TO_NUMBER):
+        sp[-1] = value_number(runtime_to_number(sp[-1]));
+        VM_DISPATCH();
+
+    VM_CASE(BIT_NOT):
+        sp[-1] = value_number((number_t) ~runtime_to_int32(runtime_to_number(sp[-1])));
+        VM_DISPATCH();
+
+    VM_CASE(NOT):
+        sp[-1] = value_bool(!runtime_truthy(sp[-1]));
+        VM_DISPATCH();
+
+    VM_CASE(TYPEOF):
+        sp[-1] = (value_t) { .type = VALUE_STRING, .string = (char *) runtime_typeof(sp[-1]) };
+        VM_DISPATCH();
+
+    VM_CASE(IS_UNDEFINED):
+        sp[-1] = value_bool(sp[-1].type == VALUE_UNDEFINED);
+        VM_DISPATCH();
+
+    VM_CASE(INC):
+        sp[-1] = value_number(runtime_to_number(sp[-1]) + 1);
+        VM_DISPATCH();
+
+    VM_CASE(DEC):
+        sp[-1] = value_number(runtime_to_number(sp[-1]) - 1);
+        VM_DISPATCH();
+
+    VM_CASE(JUMP):
+        VM_JUMP();
+        VM_DISPATCH();
+
+    VM_CASE(JUMP_IF_FALSE):
+        if (runtime_truthy(*--sp)) ip += sizeof(uint32_t);
+        else VM_JUMP();
+        VM_DISPATCH();
+
+    VM_CASE(JUMP_IF_TRUE):
+        if (!runtime_truthy(*--sp)) ip += sizeof(uint32_t);
+        else VM_JUMP();
+        VM_DISPATCH();
+
+    VM_CASE(JUMP_IF_FALSE_KEEP):
+        if (runtime_truthy(sp[-1])) ip += sizeof(uint32_t);
+        else VM_JUMP();
+        VM_DISPATCH();
+
+    VM_CASE(JUMP_IF_TRUE_KEEP):
+        if (!runtime_truthy(sp[-1])) ip += sizeof(uint32_t);
+        else VM_JUMP();
+        VM_DISPATCH();
+
+    /* a back-edge, hot loops are recorded and run as traces */
+    VM_CASE(LOOP): {
+        back_edge = ip - 1;
+        int32_t offset = (int32_t) VM_READ();
+        loop = &function->loops[VM_READ()];
+        ip += offset;
+        if (loop->trace)
+            goto vm_trace;
+
+        if (vm->trace && --loop->countdown == 0)
+        {
+            jit_state_t state = {
+                .sp = sp,
+                .base = base,
+                .globals = globals,
+                .env = env,
+                .function = function,
+            };
+            ip = function->code + trace_record(&state, loop, ip, back_edge);
+            sp = state.sp;
+            if (loop->trace)
+            {
+                vm->traces++;
+                goto vm_trace;
+            }
+
+            /* a loop that keeps failing is left alone, its countdown wraps */
+            vm->trace_aborts++;
+            loop->countdown = ++loop->aborts < TRACE_ABORTS_LIMIT ? TRACE_HOT_LOOP : 0;
+        }
+        if (function->jit)
+            goto vm_jit;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(ENTER_SCOPE):
+        env = env_enter_scope(env, VM_READ());
+        VM_DISPATCH();
+
+    /* closures created in the scope may still use it */
+    VM_CASE(LEAVE_SCOPE):
+        env = env->parent;
+        VM_DISPATCH();
+
+    /* the next iteration of a loop gets its own copy of the variables */
+    VM_CASE(COPY_SCOPE): {
+        env_t *copy = env_enter_scope(env->parent, env->size);
+        memcpy(copy->slots, env->slots, env->size * sizeof(value_t));
+        env = copy;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(CLOSURE):
+        *sp++ = value_function(vm_closure(function->functions[VM_READ()], env));
+        VM_DISPATCH();
+
+    VM_CASE(CALL):
+        argc = VM_READ();
+        args = sp - argc;
+        callee = args[-1];
+        if (callee.type != VALUE_FUNCTION)
+            VM_ERROR("TypeError: %s is not a function\n", runtime_typeof(callee));
+
+        if (callee.function->is_native)
+        {
+            result = callee.function->native_ptr(NULL, argc, args);
+            sp = args;
+            sp[-1] = result;
+            VM_DISPATCH();
+        }
+
+        target = vm_target(vm, callee.function);
+        if (vm->frame_count == VM_FRAMES_CAPACITY)
+            VM_ERROR("Stack overflow, %zu calls deep\n", vm->frame_count);
+
+        frame->ip = ip;
+        frame->env = env;
+        frame = &vm->frames[vm->frame_count++];
+        goto vm_enter;
+
+    VM_CASE(TAIL_CALL):
+        argc = VM_READ();
+        args = sp - argc;
+        callee = args[-1];
+        if (callee.type != VALUE_FUNCTION)
+            VM_ERROR("TypeError: %s is not a function\n", runtime_typeof(callee));
+
+        if (callee.function->is_native)
+        {
+            result = callee.function->native_ptr(NULL, argc, args);
+            goto vm_return;
+        }
+
+        target = vm_target(vm, callee.function);
+        memmove(base - 1, args - 1, (argc + 1) * sizeof(value_t));
+        args = base;
+
+    vm_enter:
+        if (args + target->frame_size + target->stack_size > stack_end)
+            VM_ERROR("Stack overflow, %zu calls deep\n", vm->frame_count);
+
+        for (uint32_t i = argc < target->param_count ? argc : target->param_count; i < target->frame_size; i++)
+            args[i] = value_undefined();
+        sp = args + target->frame_size;
+
+        env = callee.function->user.closure;
+        if (target->env_size)
+            env = env_enter_scope(env, target->env_size);
+
+        function = target;
+        base = args;
+        ip = function->code;
+        frame->function = function;
+        frame->base = base;
+
+        if (!function->jit && vm->jit && ++function->calls == JIT_THRESHOLD)
+        {
+            function->jit = jit_compile(function, vm->trace);
+            if (function->jit)
+            {
+                vm->jit_functions++;
+                vm->jit_bytes += function->jit->length;
+            }
+        }
+        if (function->jit)
+            goto vm_jit;
+        VM_DISPATCH();
+
+    VM_CASE(RETURN):
+        result = *--sp;
+
+    vm_return:
+        sp = base;
+        sp[-1] = result;
+        if (--vm->frame_count == entry)
+            return result;
+
+        frame = &vm->frames[vm->frame_count - 1];
+        function = frame->function;
+        base = frame->base;
+        env = frame->env;
+        ip = frame->ip;
+        if (function->jit)
+            goto vm_jit;
+        VM_DISPATCH();
+
+    /* machine code returns before the calls and returns it leaves to the VM */
+    vm_jit: {
+        jit_state_t state = {
+            .sp = sp,
+            .base = base,
+            .globals = globals,
+            .env = env,
+            .function = function,
+        };
+        ip = function->code + jit_run(function->jit, &state, (uint32_t) (ip - function->code));
+        sp = state.sp;
+        env = state.env;
+        VM_DISPATCH();
+    }
+
+    /* runs iterations of the loop at `ip` until one leaves the trace */
+    vm_trace: {
+        jit_state_t state = {
+            .sp = sp,
+            .base = base,
+            .globals = globals,
+            .env = env,
+            .function = function,
+        };
+        ip = function->code + trace_run(loop->trace, &state);
+        sp = state.sp;
+        if (function->jit)
+            goto vm_jit;
+        VM_DISPATCH();
+    }
+
+#if !VM_THREADED
+        default:
+            UNREACHABLE;
+    }
+#endif
+
+#undef VM_DISPATCH
+#undef VM_CASE
+}
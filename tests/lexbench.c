@@ -0,0 +1,202 @@
+/*
+ * Lexer throughput on generated inputs, tokens are pulled to EOF without
+ * parsing. Built and run by `make bench`, use `make MODE=release bench`
+ * for numbers comparable to a release build.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "source.h"
+#include "atom.h"
+
+/* bytes generated per input */
+#define BENCH_SIZE (32u << 20)
+
+/* runs per input, the fastest one is reported */
+#define BENCH_RUNS 5
+
+typedef struct bench_buffer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} bench_buffer_t;
+
+static uint64_t bench_seed = 7;
+
+/* fixed sequence, so every build lexes the same inputs */
+static uint32_t bench_random(uint32_t bound)
+{
+    bench_seed = bench_seed * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t) (bench_seed >> 33) % bound;
+}
+
+static void bench_append(bench_buffer_t *buffer, const char *text)
+{
+    size_t length = strlen(text);
+    if (buffer->length + length + 1 > buffer->capacity)
+    {
+        buffer->capacity = (buffer->length + length + 1) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data)
+        {
+            fprintf(stderr, "lexbench: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(buffer->data + buffer->length, text, length + 1);
+    buffer->length += length;
+}
+
+static const char *bench_words[] = {
+    "value", "index", "result", "count", "left", "right", "node", "table",
+    "the", "of", "a", "is", "when", "returns", "first", "next", "length",
+};
+
+#define BENCH_WORD() bench_words[bench_random(sizeof(bench_words) / sizeof(*bench_words))]
+
+static void bench_words_append(bench_buffer_t *buffer, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i) bench_append(buffer, " ");
+        bench_append(buffer, BENCH_WORD());
+    }
+}
+
+static void bench_comments(bench_buffer_t *buffer)
+{
+    char line[64];
+    while (buffer->length < BENCH_SIZE)
+    {
+        bench_append(buffer, "/*\n");
+        for (uint32_t i = 0, n = 2 + bench_random(4); i < n; i++)
+        {
+            bench_append(buffer, " * ");
+            bench_words_append(buffer, 6 + bench_random(8));
+            bench_append(buffer, "\n");
+        }
+        bench_append(buffer, " */\n// ");
+        bench_words_append(buffer, 4 + bench_random(8));
+        snprintf(line, sizeof(line), "\nlet %s%u = %u;\n", BENCH_WORD(), bench_random(1000), bench_random(100000));
+        bench_append(buffer, line);
+    }
+}
+
+static void bench_strings(bench_buffer_t *buffer)
+{
+    char line[64];
+    while (buffer->length < BENCH_SIZE)
+    {
+        snprintf(line, sizeof(line), "let %s%u = \"", BENCH_WORD(), bench_random(1000));
+        bench_append(buffer, line);
+        bench_words_append(buffer, 6 + bench_random(30));
+        if (bench_random(8) == 0)
+        {
+            bench_append(buffer, "\\n\\t");
+            bench_words_append(buffer, 2 + bench_random(6));
+        }
+        bench_append(buffer, "\";\n");
+    }
+}
+
+static void bench_mixed(bench_buffer_t *buffer)
+{
+    char line[160];
+    while (buffer->length < BENCH_SIZE)
+    {
+        const char *name = BENCH_WORD();
+        snprintf(line, sizeof(line),
+            "// %s the %s\n"
+            "function %s_%u(%s, %s) {\n"
+            "    let %s = %s + %u * 0x%x;\n"
+            "    if (%s <= %u.%u && %s != null) {\n"
+            "        return \"%s %s\";\n"
+            "    }\n",
+            BENCH_WORD(), name,
+            name, bench_random(10000), BENCH_WORD(), BENCH_WORD(),
+            BENCH_WORD(), BENCH_WORD(), bench_random(1000), bench_random(65536),
+            BENCH_WORD(), bench_random(100), bench_random(100), BENCH_WORD(),
+            BENCH_WORD(), BENCH_WORD()
+        );
+        bench_append(buffer, line);
+        snprintf(line, sizeof(line),
+            "    /* %s */\n"
+            "    while (%s < %s.%s) %s += %u;\n"
+            "    return %s(%s, %s);\n"
+            "}\n",
+            BENCH_WORD(),
+            BENCH_WORD(), BENCH_WORD(), BENCH_WORD(), BENCH_WORD(), bench_random(10),
+            BENCH_WORD(), BENCH_WORD(), BENCH_WORD()
+        );
+        bench_append(buffer, line);
+    }
+}
+
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static void bench_run(const char *name, void (*generate)(bench_buffer_t *))
+{
+    bench_buffer_t buffer = {0};
+    generate(&buffer);
+
+    source_id_t file = source_from_string(name, buffer.data);
+    free(buffer.data);
+    if (file == SOURCE_NONE)
+    {
+        fprintf(stderr, "lexbench: cannot register the %s input\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t length = source_get(file)->length;
+    double best = 0.0;
+    size_t tokens = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        lexer_t *lexer = malloc(sizeof(lexer_t));
+        lexer_init_range(lexer, file, 0, length);
+
+        double start = bench_now();
+        while (lexer_next(lexer)->type != TOKEN_EOF);
+        double duration = bench_now() - start;
+
+        if (lexer->had_error)
+        {
+            fprintf(stderr, "lexbench: the %s input failed to lex\n", name);
+            exit(EXIT_FAILURE);
+        }
+
+        tokens = lexer->count;
+        if (run == 0 || duration < best)
+            best = duration;
+        lexer_free(lexer);
+    }
+
+    printf("%-10s %6.1f MB %10zu tokens %8.0f MB/s\n",
+        name,
+        length / 1e6,
+        tokens,
+        best > 0 ? length / 1e6 / best : 0.0
+    );
+}
+
+int main(void)
+{
+    bench_run("comments", bench_comments);
+    bench_run("strings", bench_strings);
+    bench_run("mixed", bench_mixed);
+
+    source_free_all();
+    atom_free_all();
+    return 0;
+}
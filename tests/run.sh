@@ -0,0 +1,121 @@
+#!/bin/sh
+#
+# Differential tests, run by `make test`. Every example and every program
+# in tests/programs is run under each engine and must print the same in
+# all of them, and what its .out file holds when it has one. The AST
+# cache is then checked against corrupted entries. Usage:
+#
+#     sh tests/run.sh <rose>
+#
+set -u
+
+ROSE=${1:?usage: sh tests/run.sh <rose>}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+
+# "default" stands for no flag
+MODES="default --no-jit --no-trace --closures -O1"
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+passed=0
+failed=0
+
+fail()
+{
+    echo "FAIL $*"
+    failed=$((failed + 1))
+}
+
+# the program's output and its result, without the timings and AST dumps
+run()
+{
+    "$ROSE" "$@" > "$TMP/log" 2>&1
+    status=$?
+    if [ "$status" -ne 0 ]; then
+        echo "exit status $status"
+        return
+    fi
+    sed -n '/^Compilation took/,/^Execution took/p' "$TMP/log" | sed '1d;$d'
+}
+
+for program in "$ROOT"/example/* "$ROOT"/tests/programs/*.rose; do
+    case $program in *.ast|*.out) continue ;; esac
+    name=${program#"$ROOT"/}
+    expected="${program%.rose}.out"
+    [ -f "$expected" ] || expected=
+
+    run "$program" > "$TMP/default"
+    ok=true
+    for mode in $MODES; do
+        [ "$mode" = default ] && continue
+        run "$mode" "$program" > "$TMP/mode"
+        if ! cmp -s "$TMP/default" "$TMP/mode"; then
+            fail "$name: $mode differs from the default engine"
+            diff "$TMP/default" "$TMP/mode" | sed 's/^/    /'
+            ok=false
+        fi
+    done
+
+    if grep -q '^exit status' "$TMP/default"; then
+        fail "$name: $(cat "$TMP/default")"
+        ok=false
+    elif [ -n "$expected" ] && ! cmp -s "$expected" "$TMP/default"; then
+        fail "$name: output differs from ${expected#"$ROOT"/}"
+        diff "$expected" "$TMP/default" | sed 's/^/    /'
+        ok=false
+    fi
+
+    $ok && passed=$((passed + 1))
+done
+
+# a damaged cache entry is a miss, the program runs as if it was not cached
+CACHE="$TMP/cache"
+mkdir -m 700 "$CACHE"
+program="$ROOT/tests/programs/loops.rose"
+run "$program" > "$TMP/uncached"
+
+ROSE_CACHE_DIR=$CACHE run -C "$program" > /dev/null
+entry=$(ls "$CACHE"/*.ast 2> /dev/null | head -n 1)
+if [ -z "$entry" ]; then
+    fail "cache: no entry written to $CACHE"
+else
+    size=$(wc -c < "$entry")
+    ok=true
+    for i in 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19; do
+        # flips one byte, spread over the header and the nodes
+        offset=$((i < 6 ? i * 8 : size * i / 20))
+        byte=$(od -An -tu1 -j "$offset" -N1 "$entry" | tr -d ' ')
+        printf "\\$(printf %o $(((byte + 1) % 256)))" |
+            dd of="$entry" bs=1 seek="$offset" conv=notrunc 2> /dev/null
+
+        ROSE_CACHE_DIR=$CACHE run -C "$program" > "$TMP/cached"
+        if grep -q '^Loading AST cache' "$TMP/log"; then
+            fail "cache: entry with byte $offset of $size flipped was loaded"
+            ok=false
+        elif ! cmp -s "$TMP/uncached" "$TMP/cached"; then
+            fail "cache: byte $offset of $size flipped: $(head -n 1 "$TMP/cached")"
+            ok=false
+        fi
+    done
+
+    # the run before stored a fresh entry, cut it short
+    head -c $((size / 2)) "$entry" > "$TMP/short" && cp "$TMP/short" "$entry"
+    ROSE_CACHE_DIR=$CACHE run -C "$program" > "$TMP/cached"
+    if grep -q '^Loading AST cache' "$TMP/log" || ! cmp -s "$TMP/uncached" "$TMP/cached"; then
+        fail "cache: truncated entry: $(head -n 1 "$TMP/cached")"
+        ok=false
+    fi
+
+    # and an intact one is used
+    ROSE_CACHE_DIR=$CACHE run -C "$program" > "$TMP/cached"
+    if ! grep -q '^Loading AST cache' "$TMP/log" || ! cmp -s "$TMP/uncached" "$TMP/cached"; then
+        fail "cache: intact entry not used"
+        ok=false
+    fi
+
+    $ok && passed=$((passed + 1))
+fi
+
+echo "$passed passed, $failed failed"
+[ "$failed" -eq 0 ]